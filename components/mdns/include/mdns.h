@@ -117,8 +117,59 @@ typedef struct mdns_result_s {
     mdns_ip_addr_t *addr;                   /*!< linked list of IP addresses found */
 } mdns_result_t;
 
+/**
+ * @brief   Browse results changed within one notification window
+ *
+ * The results belong to the browse, they are valid only during the callback.
+ * The removed results are freed when the callback returns.
+ */
+typedef struct {
+    mdns_result_t **added;                  /*!< results found since the last notification */
+    size_t added_count;                     /*!< number of added results */
+    mdns_result_t **updated;                /*!< results whose host, port, TXT, addresses or TTL changed */
+    size_t updated_count;                   /*!< number of updated results */
+    mdns_result_t **removed;                /*!< results which sent a goodbye (TTL 0) */
+    size_t removed_count;                   /*!< number of removed results */
+} mdns_browse_changes_t;
+
+/**
+ * @brief   mDNS packets received and sent on one interface and IP protocol
+ */
+typedef struct {
+    uint32_t rx_packets;                    /*!< packets received */
+    uint32_t rx_bytes;                      /*!< bytes received */
+    uint32_t tx_packets;                    /*!< datagrams sent */
+    uint32_t tx_bytes;                      /*!< bytes sent */
+} mdns_traffic_stats_t;
+
+/**
+ * @brief   mDNS responder statistics, counted since mdns_init() or the last mdns_reset_stats()
+ */
+typedef struct {
+    struct {
+        esp_netif_t *netif;                 /*!< interface the counters belong to, NULL if the slot is unused */
+        mdns_traffic_stats_t traffic[MDNS_IP_PROTOCOL_MAX]; /*!< counters of the IPv4 and IPv6 PCB */
+    } interfaces[CONFIG_MDNS_MAX_INTERFACES];
+    uint32_t parse_failures;                /*!< received packets dropped as malformed */
+    uint32_t answers_built;                 /*!< records written to the sent responses */
+    uint32_t known_answers_suppressed;      /*!< answers not sent as the querier listed them (RFC 6762, 7.1) */
+    uint32_t duplicate_answers_suppressed;  /*!< answers not sent as another responder sent them (RFC 6762, 7.4) */
+    uint32_t answers_rate_limited;          /*!< answers not multicast as the record was multicast just before */
+    uint32_t queries_throttled;             /*!< queries dropped as their source exceeded its query budget */
+    uint32_t responses_split;               /*!< extra datagrams sent as a response did not fit one packet */
+    uint32_t records_dropped;               /*!< records which did not fit even an empty datagram */
+    uint32_t rx_dropped;                    /*!< received packets dropped from a full RX queue */
+    uint32_t action_queue_full;             /*!< actions, including received packets, refused by the full action queue */
+    uint32_t alloc_failures;                /*!< failed memory allocations */
+    uint16_t tx_queue_len;                  /*!< packets currently scheduled for sending */
+    uint16_t tx_queue_max;                  /*!< most packets scheduled for sending at once */
+    uint64_t parse_time_us;                 /*!< time spent parsing received packets */
+    uint64_t dispatch_time_us;              /*!< time spent building and sending scheduled packets */
+} mdns_stats_t;
+
 typedef void (*mdns_query_notify_t)(mdns_search_once_t *search);
 typedef void (*mdns_browse_notify_t)(mdns_result_t *result);
+typedef void (*mdns_browse_batch_notify_t)(mdns_browse_t *browse, const mdns_browse_changes_t *changes);
 
 /**
  * @brief  Initialize mDNS on given interface
@@ -167,6 +218,8 @@ esp_err_t mdns_hostname_get(char *hostname);
  * @brief  Adds a hostname and address to be delegated
  *         A/AAAA queries will be replied for the hostname and
  *         services can be added to this host.
+ *         If another host claims the hostname while it is probed, it is logged
+ *         and the hostname is not announced until its addresses are set again.
  *
  * @param  hostname     Hostname to add
  * @param  address_list The IP address list of the host
@@ -911,14 +964,38 @@ esp_err_t mdns_netif_action(esp_netif_t *esp_netif, mdns_event_actions_t event_a
 /**
  * @brief   Browse mDNS for a service `_service._proto`.
  *
+ * The changes received within CONFIG_MDNS_BROWSE_NOTIFY_WINDOW_MS are coalesced,
+ * the notifier is called once for every result which changed in the window.
+ *
+ * If `_service._proto` is browsed already, the running browse is returned with the notifier
+ * added to it, and its query is sent again.
+ *
  * @param service  Pointer to the `_service` which will be browsed.
  * @param proto    Pointer to the `_proto` which will be browsed.
  * @param notifier The callback which will be called when the browsing service changed.
- * @return mdns_browse_t pointer to new browse object if initiated successfully.
- *         NULL otherwise.
+ * @return mdns_browse_t pointer to the browse object if initiated successfully.
+ *         NULL otherwise, or if the running browse has another notifier.
  */
 mdns_browse_t *mdns_browse_new(const char *service, const char *proto, mdns_browse_notify_t notifier);
 
+/**
+ * @brief   Browse mDNS for a service `_service._proto`, notifying the changes in batches.
+ *
+ * The notifier is called once per CONFIG_MDNS_BROWSE_NOTIFY_WINDOW_MS with all results
+ * added, updated and removed in the window, or earlier once CONFIG_MDNS_BROWSE_MAX_CHANGES
+ * results changed. A result added and removed within one window is not reported.
+ *
+ * If `_service._proto` is browsed already, the running browse is returned with the notifier
+ * added to it, and its query is sent again.
+ *
+ * @param service  Pointer to the `_service` which will be browsed.
+ * @param proto    Pointer to the `_proto` which will be browsed.
+ * @param notifier The callback which will be called with the changes.
+ * @return mdns_browse_t pointer to the browse object if initiated successfully.
+ *         NULL otherwise, or if the running browse has another batch notifier.
+ */
+mdns_browse_t *mdns_browse_new_batched(const char *service, const char *proto, mdns_browse_batch_notify_t notifier);
+
 /**
  * @brief   Stop the `_service._proto` browse.
  * @param service  Pointer to the `_service` which will be browsed.
@@ -930,6 +1007,28 @@ mdns_browse_t *mdns_browse_new(const char *service, const char *proto, mdns_brow
  */
 esp_err_t mdns_browse_delete(const char *service, const char *proto);
 
+/**
+ * @brief   Get the responder statistics
+ *
+ * The counters are always maintained, reading them takes the service lock only for the copy.
+ *
+ * @param stats    Pointer to the structure to fill in.
+ * @return
+ *     - ESP_OK                 success.
+ *     - ESP_ERR_INVALID_ARG    stats is NULL.
+ *     - ESP_ERR_INVALID_STATE  mDNS is not running.
+ */
+esp_err_t mdns_get_stats(mdns_stats_t *stats);
+
+/**
+ * @brief   Reset the responder statistics to zero, the current TX queue length becomes the maximum
+ *
+ * @return
+ *     - ESP_OK                 success.
+ *     - ESP_ERR_INVALID_STATE  mDNS is not running.
+ */
+esp_err_t mdns_reset_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,6 +5,7 @@
  */
 
 #include <string.h>
+#include <stdatomic.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
@@ -20,8 +21,8 @@
 
 static void _mdns_browse_item_free(mdns_browse_t *browse);
 static esp_err_t _mdns_send_browse_action(mdns_action_type_t type, mdns_browse_t *browse);
-static esp_err_t _mdns_sync_browse_action(mdns_action_type_t type, mdns_browse_sync_t *browse_sync);
-static void _mdns_browse_sync(mdns_browse_sync_t *browse_sync);
+static void _mdns_browse_notify_due(uint32_t now);
+static bool _mdns_browse_next_notify(uint32_t *deadline);
 static void _mdns_browse_finish(mdns_browse_t *browse);
 static void _mdns_browse_add(mdns_browse_t *browse);
 static void _mdns_browse_send(mdns_browse_t *browse, mdns_if_t interface);
@@ -64,17 +65,32 @@ static const char *TAG = "mdns";
 static volatile TaskHandle_t _mdns_service_task_handle = NULL;
 static SemaphoreHandle_t _mdns_service_semaphore = NULL;
 static StackType_t *_mdns_stack_buffer;
+static portMUX_TYPE s_rx_lock = portMUX_INITIALIZER_UNLOCKED;  // RX queue, query budgets and action queue counters, used outside the service task
+
+static _Atomic(mdns_snapshot_t *) s_snapshot;   // published for the lock-free readers
+static atomic_uint s_snapshot_readers;          // readers holding any snapshot
+static atomic_uint s_alloc_failures;            // counted from the service, RX and API contexts
+static _Atomic(mdns_snapshot_t *) s_snapshot_retired;   // replaced snapshots, freed when there are no readers
+static bool s_snapshot_dirty;
+
+/**
+ * @brief  marks the snapshot stale, a new one is published when the service lock is released
+ */
+static inline void _mdns_snapshot_invalidate(void)
+{
+    s_snapshot_dirty = true;
+}
 
 static void _mdns_search_finish_done(void);
 static mdns_search_once_t *_mdns_search_find_from(mdns_search_once_t *search, mdns_name_t *name, uint16_t type, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
 static mdns_browse_t *_mdns_browse_find_from(mdns_browse_t *b, mdns_name_t *name, uint16_t type, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
-static void _mdns_browse_result_add_srv(mdns_browse_t *browse, const char *hostname, const char *instance, const char *service, const char *proto,
-                                        uint16_t port, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint32_t ttl, mdns_browse_sync_t *out_sync_browse);
+static void _mdns_browse_result_add_srv(mdns_browse_t *browse, const char *hostname, const char *instance, uint16_t port,
+                                        mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint32_t ttl);
 static void _mdns_browse_result_add_ip(mdns_browse_t *browse, const char *hostname, esp_ip_addr_t *ip,
-                                       mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint32_t ttl, mdns_browse_sync_t *out_sync_browse);
-static void _mdns_browse_result_add_txt(mdns_browse_t *browse,  const char *instance, const char *service, const char *proto,
+                                       mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint32_t ttl);
+static void _mdns_browse_result_add_txt(mdns_browse_t *browse, const char *instance,
                                         mdns_txt_item_t *txt, uint8_t *txt_value_len, size_t txt_count, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol,
-                                        uint32_t ttl, mdns_browse_sync_t *out_sync_browse);
+                                        uint32_t ttl);
 #ifdef MDNS_ENABLE_DEBUG
 static void debug_printf_browse_result(mdns_result_t *r_t, mdns_browse_t *b_t);
 static void debug_printf_browse_result_all(mdns_result_t *r_t);
@@ -89,12 +105,24 @@ static void _mdns_search_result_add_txt(mdns_search_once_t *search, mdns_txt_ite
 static mdns_result_t *_mdns_search_result_add_ptr(mdns_search_once_t *search, const char *instance,
                                                   const char *service_type, const char *proto, mdns_if_t tcpip_if,
                                                   mdns_ip_protocol_t ip_protocol, uint32_t ttl);
+static mdns_result_t *_mdns_result_find_instance(const mdns_result_index_t *index, const char *instance,
+                                                 esp_netif_t *esp_netif, mdns_ip_protocol_t ip_protocol);
+static bool _mdns_result_hostname_set(mdns_result_index_t *index, mdns_result_t *r, const char *hostname);
+static void _mdns_result_index_free(mdns_result_index_t *index);
 static bool _mdns_append_host_list_in_services(mdns_out_answer_t **destination, mdns_srv_item_t *services[], size_t services_len, bool flush, bool bye);
-static bool _mdns_append_host_list(mdns_out_answer_t **destination, bool flush, bool bye);
 static void _mdns_remap_self_service_hostname(const char *old_hostname, const char *new_hostname);
+static void _mdns_timer_arm(uint32_t deadline);
+static void _mdns_cache_add(mdns_cache_entry_t *record, bool flush);
+static void _mdns_cache_flush_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
+static bool _mdns_cache_search(mdns_search_once_t *search);
+static mdns_cache_entry_t *_mdns_cache_record_dup(mdns_mem_arena_t *arena, const mdns_cache_entry_t *record);
 static esp_err_t mdns_post_custom_action_tcpip_if(mdns_if_t mdns_if, mdns_event_actions_t event_action);
 
 static void _mdns_query_results_free(mdns_result_t *results);
+static void _mdns_snapshot_sync(void);
+static uint32_t _mdns_name_suffix_hash(const char *label, uint32_t suffix_hash);
+static void free_address_list(mdns_ip_addr_t *address_list);
+static mdns_ip_addr_t *copy_address_list(const mdns_ip_addr_t *address_list);
 typedef enum {
     MDNS_IF_STA = 0,
     MDNS_IF_AP = 1,
@@ -279,6 +307,284 @@ static bool _mdns_service_match(const mdns_service_t *srv, const char *service,
            (_str_null_or_empty(hostname) || !strcasecmp(srv->hostname, hostname));
 }
 
+/*
+ * Name indices
+ *
+ * The services and the delegated hosts are looked up for every name of every received packet,
+ * so they are kept in open-addressing hash tables. The keys are hashed case-folded and compared
+ * with strcasecmp(), lookups verify the candidates with the same predicates as a list scan would.
+ */
+
+typedef bool (*mdns_index_match_t)(const void *head, const void *key);
+
+typedef struct {
+    const char *instance;
+    const char *service;
+    const char *proto;
+} mdns_service_key_t;
+
+static mdns_index_slot_t *_mdns_index_find(const mdns_index_t *index, uint32_t hash, mdns_index_match_t match, const void *key)
+{
+    if (!index->size) {
+        return NULL;
+    }
+    uint16_t mask = index->size - 1;
+    for (uint16_t i = hash & mask; index->slots[i].head; i = (i + 1) & mask) {
+        if (index->slots[i].hash == hash && match(index->slots[i].head, key)) {
+            return &index->slots[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief  finds the next head with the key after the slot, for indices which hold several heads per key
+ */
+static mdns_index_slot_t *_mdns_index_find_next(const mdns_index_t *index, const mdns_index_slot_t *slot, uint32_t hash,
+                                                mdns_index_match_t match, const void *key)
+{
+    uint16_t mask = index->size - 1;
+    for (uint16_t i = (slot - index->slots + 1) & mask; index->slots[i].head; i = (i + 1) & mask) {
+        if (index->slots[i].hash == hash && match(index->slots[i].head, key)) {
+            return &index->slots[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief  makes room for one more key, so that the following _mdns_index_insert() cannot fail
+ */
+static bool _mdns_index_reserve(mdns_index_t *index)
+{
+    if ((index->used + 1) * 4 <= index->size * 3) {
+        return true;
+    }
+    uint16_t size = index->size ? index->size * 2 : MDNS_INDEX_MIN_SIZE;
+    if (size <= index->size) {
+        return false;
+    }
+    mdns_index_slot_t *slots = (mdns_index_slot_t *)mdns_mem_calloc(size, sizeof(mdns_index_slot_t));
+    if (!slots) {
+        HOOK_MALLOC_FAILED;
+        return false;
+    }
+    for (uint16_t i = 0; i < index->size; i++) {
+        if (index->slots[i].head) {
+            uint16_t j = index->slots[i].hash & (size - 1);
+            while (slots[j].head) {
+                j = (j + 1) & (size - 1);
+            }
+            slots[j] = index->slots[i];
+        }
+    }
+    mdns_mem_free(index->slots);
+    index->slots = slots;
+    index->size = size;
+    return true;
+}
+
+/**
+ * @brief  adds a key which is not in the index yet (or another head for it), room has to be reserved first
+ */
+static void _mdns_index_insert(mdns_index_t *index, uint32_t hash, void *head)
+{
+    uint16_t mask = index->size - 1;
+    uint16_t i = hash & mask;
+    while (index->slots[i].head) {
+        i = (i + 1) & mask;
+    }
+    index->slots[i].hash = hash;
+    index->slots[i].head = head;
+    index->used++;
+}
+
+/**
+ * @brief  removes the key, the rest of its cluster is shifted back so that no tombstones are needed
+ */
+static void _mdns_index_remove(mdns_index_t *index, mdns_index_slot_t *slot)
+{
+    uint16_t mask = index->size - 1;
+    uint16_t hole = slot - index->slots;
+    for (uint16_t i = (hole + 1) & mask; index->slots[i].head; i = (i + 1) & mask) {
+        uint16_t home = index->slots[i].hash & mask;
+        // the entry may fill the hole if the hole is not before its home slot
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            index->slots[hole] = index->slots[i];
+            hole = i;
+        }
+    }
+    index->slots[hole].head = NULL;
+    index->used--;
+}
+
+static void _mdns_index_free(mdns_index_t *index)
+{
+    mdns_mem_free(index->slots);
+    memset(index, 0, sizeof(mdns_index_t));
+}
+
+static inline uint32_t _mdns_service_type_hash(const char *service, const char *proto)
+{
+    return _mdns_name_suffix_hash(service, _mdns_name_suffix_hash(proto, 0));
+}
+
+static inline const char *_mdns_service_index_instance(const mdns_service_t *srv)
+{
+    return srv->instance ? srv->instance : "";
+}
+
+static bool _mdns_service_type_key_match(const void *head, const void *key)
+{
+    const mdns_service_t *srv = ((const mdns_srv_item_t *)head)->service;
+    const mdns_service_key_t *k = (const mdns_service_key_t *)key;
+    return !strcasecmp(srv->service, k->service) && !strcasecmp(srv->proto, k->proto);
+}
+
+static bool _mdns_service_instance_key_match(const void *head, const void *key)
+{
+    const mdns_service_t *srv = ((const mdns_srv_item_t *)head)->service;
+    const mdns_service_key_t *k = (const mdns_service_key_t *)key;
+    return _mdns_service_type_key_match(head, key) && !strcasecmp(_mdns_service_index_instance(srv), k->instance);
+}
+
+/**
+ * @brief  finds the newest service with the key, older ones follow in its type_next or instance_next chain
+ */
+static mdns_srv_item_t *_mdns_service_index_find(bool instance, const mdns_service_key_t *key)
+{
+    mdns_index_slot_t *slot;
+    if (instance) {
+        slot = _mdns_index_find(&_mdns_server->index.instances, _mdns_name_suffix_hash(key->instance, _mdns_service_type_hash(key->service, key->proto)),
+                                _mdns_service_instance_key_match, key);
+    } else {
+        slot = _mdns_index_find(&_mdns_server->index.types, _mdns_service_type_hash(key->service, key->proto),
+                                _mdns_service_type_key_match, key);
+    }
+    return slot ? (mdns_srv_item_t *)slot->head : NULL;
+}
+
+static inline mdns_srv_item_t **_mdns_service_index_next(mdns_srv_item_t *item, bool instance)
+{
+    return instance ? &item->instance_next : &item->type_next;
+}
+
+static void _mdns_service_index_link(mdns_srv_item_t *item, bool instance)
+{
+    mdns_index_t *index = instance ? &_mdns_server->index.instances : &_mdns_server->index.types;
+    mdns_service_key_t key = { _mdns_service_index_instance(item->service), item->service->service, item->service->proto };
+    uint32_t hash = _mdns_service_type_hash(key.service, key.proto);
+    if (instance) {
+        hash = _mdns_name_suffix_hash(key.instance, hash);
+    }
+    mdns_index_slot_t *slot = _mdns_index_find(index, hash, instance ? _mdns_service_instance_key_match : _mdns_service_type_key_match, &key);
+    *_mdns_service_index_next(item, instance) = NULL;
+    if (!slot) {
+        _mdns_index_insert(index, hash, item);
+        return;
+    }
+    // the chain is ordered as the services list, newest first
+    mdns_srv_item_t *prev = (mdns_srv_item_t *)slot->head;
+    if (prev->seq < item->seq) {
+        *_mdns_service_index_next(item, instance) = prev;
+        slot->head = item;
+        return;
+    }
+    while (*_mdns_service_index_next(prev, instance) && (*_mdns_service_index_next(prev, instance))->seq > item->seq) {
+        prev = *_mdns_service_index_next(prev, instance);
+    }
+    *_mdns_service_index_next(item, instance) = *_mdns_service_index_next(prev, instance);
+    *_mdns_service_index_next(prev, instance) = item;
+}
+
+static void _mdns_service_index_unlink(mdns_srv_item_t *item, bool instance)
+{
+    mdns_index_t *index = instance ? &_mdns_server->index.instances : &_mdns_server->index.types;
+    mdns_service_key_t key = { _mdns_service_index_instance(item->service), item->service->service, item->service->proto };
+    uint32_t hash = _mdns_service_type_hash(key.service, key.proto);
+    if (instance) {
+        hash = _mdns_name_suffix_hash(key.instance, hash);
+    }
+    mdns_index_slot_t *slot = _mdns_index_find(index, hash, instance ? _mdns_service_instance_key_match : _mdns_service_type_key_match, &key);
+    if (!slot) {
+        return;
+    }
+    mdns_srv_item_t *prev = (mdns_srv_item_t *)slot->head;
+    if (prev == item) {
+        if (*_mdns_service_index_next(item, instance)) {
+            slot->head = *_mdns_service_index_next(item, instance);
+        } else {
+            _mdns_index_remove(index, slot);
+        }
+        return;
+    }
+    for (; *_mdns_service_index_next(prev, instance); prev = *_mdns_service_index_next(prev, instance)) {
+        if (*_mdns_service_index_next(prev, instance) == item) {
+            *_mdns_service_index_next(prev, instance) = *_mdns_service_index_next(item, instance);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief  indexes a new service, to be called before it is added to the services list
+ *
+ * @return false if the indices could not grow
+ */
+static bool _mdns_service_index_add(mdns_srv_item_t *item)
+{
+    if (!_mdns_index_reserve(&_mdns_server->index.types) || !_mdns_index_reserve(&_mdns_server->index.instances)) {
+        return false;
+    }
+    item->seq = ++_mdns_server->index.seq;
+    _mdns_service_index_link(item, false);
+    _mdns_service_index_link(item, true);
+    _mdns_server->index.services++;
+    return true;
+}
+
+static void _mdns_service_index_remove(mdns_srv_item_t *item)
+{
+    _mdns_service_index_unlink(item, false);
+    _mdns_service_index_unlink(item, true);
+    _mdns_server->index.services--;
+}
+
+static void _mdns_service_index_clear(void)
+{
+    _mdns_index_free(&_mdns_server->index.types);
+    _mdns_index_free(&_mdns_server->index.instances);
+    _mdns_server->index.services = 0;
+}
+
+/**
+ * @brief  replaces the instance name of the service (takes the string), the old one is freed
+ *
+ * @return false if the instance index could not grow, the service is unchanged then
+ */
+static bool _mdns_service_instance_replace(mdns_srv_item_t *item, char *instance)
+{
+    if (!_mdns_index_reserve(&_mdns_server->index.instances)) {
+        return false;
+    }
+    _mdns_service_index_unlink(item, true);
+    mdns_mem_free((char *)item->service->instance);
+    item->service->instance = instance;
+    _mdns_service_index_link(item, true);
+    return true;
+}
+
+static bool _mdns_host_key_match(const void *head, const void *key)
+{
+    return !strcasecmp(((const mdns_host_item_t *)head)->hostname, (const char *)key);
+}
+
+static mdns_host_item_t *_mdns_get_delegated_host(const char *hostname)
+{
+    mdns_index_slot_t *slot = _mdns_index_find(&_mdns_server->index.hosts, _mdns_name_suffix_hash(hostname, 0), _mdns_host_key_match, hostname);
+    return slot ? (mdns_host_item_t *)slot->head : NULL;
+}
+
 /**
  * @brief  finds service from given service type
  * @param  server       the server
@@ -290,19 +596,27 @@ static bool _mdns_service_match(const mdns_service_t *srv, const char *service,
  */
 static mdns_srv_item_t *_mdns_get_service_item(const char *service, const char *proto, const char *hostname)
 {
-    mdns_srv_item_t *s = _mdns_server->services;
+    if (!service || !proto) {
+        return NULL;
+    }
+    mdns_service_key_t key = { NULL, service, proto };
+    mdns_srv_item_t *s = _mdns_service_index_find(false, &key);
     while (s) {
         if (_mdns_service_match(s->service, service, proto, hostname)) {
             return s;
         }
-        s = s->next;
+        s = s->type_next;
     }
     return NULL;
 }
 
 static mdns_srv_item_t *_mdns_get_service_item_subtype(const char *subtype, const char *service, const char *proto)
 {
-    mdns_srv_item_t *s = _mdns_server->services;
+    if (!service || !proto) {
+        return NULL;
+    }
+    mdns_service_key_t key = { NULL, service, proto };
+    mdns_srv_item_t *s = _mdns_service_index_find(false, &key);
     while (s) {
         if (_mdns_service_match(s->service, service, proto, NULL)) {
             mdns_subtype_t *subtype_item = s->service->subtype;
@@ -313,7 +627,7 @@ static mdns_srv_item_t *_mdns_get_service_item_subtype(const char *subtype, cons
                 subtype_item = subtype_item->next;
             }
         }
-        s = s->next;
+        s = s->type_next;
     }
     return NULL;
 }
@@ -323,14 +637,7 @@ static mdns_host_item_t *mdns_get_host_item(const char *hostname)
     if (hostname == NULL || strcasecmp(hostname, _mdns_server->hostname) == 0) {
         return &_mdns_self_host;
     }
-    mdns_host_item_t *host = _mdns_host_list;
-    while (host != NULL) {
-        if (strcasecmp(host->hostname, hostname) == 0) {
-            return host;
-        }
-        host = host->next;
-    }
-    return NULL;
+    return _mdns_get_delegated_host(hostname);
 }
 
 static bool _mdns_can_add_more_services(void)
@@ -338,38 +645,198 @@ static bool _mdns_can_add_more_services(void)
 #if MDNS_MAX_SERVICES == 0
     return false;
 #else
-    mdns_srv_item_t *s = _mdns_server->services;
-    uint16_t service_num = 0;
-    while (s) {
-        service_num ++;
-        s = s->next;
-        if (service_num >= MDNS_MAX_SERVICES) {
-            return false;
+    return _mdns_server->index.services < MDNS_MAX_SERVICES;
+#endif
+}
+
+static bool _mdns_ip_addr_equal(const esp_ip_addr_t *a, const esp_ip_addr_t *b)
+{
+    if (a->type != b->type) {
+        return false;
+    }
+    return a->type == ESP_IPADDR_TYPE_V6 ? !memcmp(a->u_addr.ip6.addr, b->u_addr.ip6.addr, 16)
+           : a->u_addr.ip4.addr == b->u_addr.ip4.addr;
+}
+
+/**
+ * @brief  Takes one query of the source from its budget, called with s_rx_lock held
+ *
+ * When the table is full, the source refilled least recently is replaced. A source
+ * which keeps flooding is refilled all the time, so it stays tracked.
+ *
+ * @return true if the source has not used up its budget
+ */
+static bool _mdns_query_budget_take(const esp_ip_addr_t *src, uint32_t now)
+{
+    uint16_t budget = _mdns_server->rx.query_budget;
+    mdns_query_source_t *source = NULL;
+    mdns_query_source_t *oldest = NULL;
+    size_t i;
+
+    if (!budget) {
+        return true;
+    }
+    for (i = 0; i < MDNS_QUERY_SOURCES; i++) {
+        mdns_query_source_t *s = &_mdns_server->rx.sources[i];
+        if (s->used && _mdns_ip_addr_equal(&s->addr, src)) {
+            source = s;
+            break;
         }
+        if (!oldest || !s->used || (oldest->used && (int32_t)(s->refilled_at - oldest->refilled_at) < 0)) {
+            oldest = s;
+        }
+    }
+    if (!source) {
+        source = oldest;
+        memcpy(&source->addr, src, sizeof(esp_ip_addr_t));
+        source->used = true;
+        source->tokens = budget;
+        source->refilled_at = now;
+    }
+    uint32_t elapsed = now - source->refilled_at;
+    uint32_t gained = elapsed < 1000 ? elapsed * budget / 1000 : budget;
+    if (source->tokens + gained >= budget) {
+        source->tokens = budget;
+        source->refilled_at = now;
+    } else if (gained) {
+        source->tokens += gained;
+        source->refilled_at += gained * 1000 / budget;
+    }
+    if (!source->tokens) {
+        return false;
     }
+    source->tokens--;
     return true;
-#endif
 }
 
+/**
+ * @brief  Posts the ACTION_RX_HANDLE for the packets waiting in the RX queue
+ *
+ * Called with rx.signalled set; it is cleared again if the action could not be posted, so that
+ * the next packet received or the timer retries.
+ *
+ * @return true if the action was posted
+ */
+static bool _mdns_rx_signal(void)
+{
+    mdns_action_t *action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
+    if (action) {
+        action->type = ACTION_RX_HANDLE;
+        if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) == pdPASS) {
+            return true;
+        }
+        mdns_mem_free(action);
+    } else {
+        HOOK_MALLOC_FAILED;
+    }
+    portENTER_CRITICAL(&s_rx_lock);
+    _mdns_server->rx.signalled = false;
+    _mdns_server->stats.rx_action_queue_full++;
+    portEXIT_CRITICAL(&s_rx_lock);
+    return false;
+}
+
+/**
+ * @brief  Passes a received packet to the service task
+ *
+ * Packets wait in the RX queue, a single ACTION_RX_HANDLE is posted for all of them. When the queue
+ * is full, the oldest packet is dropped. Queries over the budget of their source are dropped
+ * before they are queued.
+ *
+ * @return ESP_OK if the packet was taken over (queued or dropped), the caller frees it otherwise
+ */
 esp_err_t _mdns_send_rx_action(mdns_rx_packet_t *packet)
 {
-    mdns_action_t *action = NULL;
+    mdns_rx_packet_t *dropped = NULL;
+    bool signal = false;
+    bool query = packet->pb->len >= MDNS_HEAD_LEN
+                 && !(((const uint8_t *)packet->pb->payload)[MDNS_HEAD_FLAGS_OFFSET] & (MDNS_FLAGS_QUERY_REPSONSE >> 8));
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
 
-    action = (mdns_action_t *)mdns_mem_malloc(sizeof(mdns_action_t));
-    if (!action) {
-        HOOK_MALLOC_FAILED;
-        return ESP_ERR_NO_MEM;
+    packet->next = NULL;
+    portENTER_CRITICAL(&s_rx_lock);
+    if (query && !_mdns_query_budget_take(&packet->src, now)) {
+        _mdns_server->stats.queries_throttled++;
+        dropped = packet;
+    } else {
+        if (_mdns_server->rx.len == MDNS_PACKET_QUEUE_LEN) {
+            dropped = _mdns_server->rx.head;
+            _mdns_server->rx.head = dropped->next;
+            _mdns_server->rx.len--;
+            _mdns_server->stats.rx_dropped++;
+        }
+        if (_mdns_server->rx.head) {
+            _mdns_server->rx.tail->next = packet;
+        } else {
+            _mdns_server->rx.head = packet;
+        }
+        _mdns_server->rx.tail = packet;
+        _mdns_server->rx.len++;
+        signal = !_mdns_server->rx.signalled;
+        _mdns_server->rx.signalled = true;
     }
+    portEXIT_CRITICAL(&s_rx_lock);
 
-    action->type = ACTION_RX_HANDLE;
-    action->data.rx_handle.packet = packet;
-    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
-        mdns_mem_free(action);
-        return ESP_ERR_NO_MEM;
+    if (dropped) {
+        _mdns_packet_free(dropped);
+    }
+    if (signal && !_mdns_rx_signal()) {
+        // the timer posts the action again, it is left alone if already running
+        esp_timer_handle_t timer = _mdns_server->timer_handle;
+        if (timer) {
+            esp_timer_start_once(timer, CONFIG_MDNS_TIMER_PERIOD_MS * 1000);
+        }
     }
     return ESP_OK;
 }
 
+/**
+ * @brief  Posts an action to the service task, counting the actions refused by the full queue
+ *
+ * @return true if the action was queued, the caller keeps the ownership otherwise
+ */
+static bool _mdns_action_post(mdns_action_t *action)
+{
+    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) == pdPASS) {
+        return true;
+    }
+    portENTER_CRITICAL(&s_rx_lock);
+    _mdns_server->stats.action_queue_full++;
+    portEXIT_CRITICAL(&s_rx_lock);
+    return false;
+}
+
+/**
+ * @brief  Checks for received packets waiting without an ACTION_RX_HANDLE posted for them
+ *
+ * @param  claim  marks them signalled, the caller then posts the action with _mdns_rx_signal()
+ */
+static bool _mdns_rx_stalled(bool claim)
+{
+    portENTER_CRITICAL(&s_rx_lock);
+    bool stalled = _mdns_server->rx.len && !_mdns_server->rx.signalled;
+    if (stalled && claim) {
+        _mdns_server->rx.signalled = true;
+    }
+    portEXIT_CRITICAL(&s_rx_lock);
+    return stalled;
+}
+
+/**
+ * @brief  Takes all packets waiting in the RX queue, oldest first
+ */
+static mdns_rx_packet_t *_mdns_rx_queue_take(void)
+{
+    portENTER_CRITICAL(&s_rx_lock);
+    mdns_rx_packet_t *packets = _mdns_server->rx.head;
+    _mdns_server->rx.head = NULL;
+    _mdns_server->rx.tail = NULL;
+    _mdns_server->rx.len = 0;
+    _mdns_server->rx.signalled = false;
+    portEXIT_CRITICAL(&s_rx_lock);
+    return packets;
+}
+
 static const char *_mdns_get_default_instance_name(void)
 {
     if (_mdns_server && !_str_null_or_empty(_mdns_server->instance)) {
@@ -422,34 +889,52 @@ static bool _mdns_service_match_instance(const mdns_service_t *srv, const char *
 static mdns_srv_item_t *_mdns_get_service_item_instance(const char *instance, const char *service, const char *proto,
                                                         const char *hostname)
 {
-    mdns_srv_item_t *s = _mdns_server->services;
-    while (s) {
-        if (instance) {
+    if (!instance) {
+        return _mdns_get_service_item(service, proto, hostname);
+    }
+    if (!service || !proto) {
+        return NULL;
+    }
+    // the services without their own instance name are indexed under "", they match if the default name does
+    const char *default_instance = _mdns_get_default_instance_name();
+    const char *keys[2] = { instance, default_instance && !strcasecmp(default_instance, instance) ? "" : NULL };
+    mdns_srv_item_t *found = NULL;
+    for (size_t i = 0; i < ARRAY_SIZE(keys) && keys[i]; i++) {
+        mdns_service_key_t key = { keys[i], service, proto };
+        for (mdns_srv_item_t *s = _mdns_service_index_find(true, &key); s; s = s->instance_next) {
             if (_mdns_service_match_instance(s->service, instance, service, proto, hostname)) {
-                return s;
-            }
-        } else {
-            if (_mdns_service_match(s->service, service, proto, hostname)) {
-                return s;
+                // the first one of the services list, as a scan of the list would find
+                if (!found || s->seq > found->seq) {
+                    found = s;
+                }
+                break;
             }
         }
-        s = s->next;
     }
-    return NULL;
+    return found;
+}
+
+/**
+ * @brief  compares a label of the packet (not terminated) with a string, case insensitive
+ */
+static inline bool _mdns_label_is(const char *label, uint8_t len, const char *str)
+{
+    return strlen(str) == len && !strncasecmp(label, str, len);
 }
 
 /**
  * @brief  reads MDNS FQDN into mdns_name_t structure
  *         FQDN is in format: [hostname.|[instance.]_service._proto.]local.
  *
+ * The labels are matched in place in the packet and copied once to their part of the name.
+ *
  * @param  packet       MDNS packet
  * @param  start        Starting point of FQDN
  * @param  name         mdns_name_t structure to populate
- * @param  buf          temporary char buffer
  *
  * @return the address after the parsed FQDN in the packet or NULL on error
  */
-static const uint8_t *_mdns_read_fqdn(const uint8_t *packet, const uint8_t *start, mdns_name_t *name, char *buf, size_t packet_len)
+static const uint8_t *_mdns_read_fqdn(const uint8_t *packet, const uint8_t *start, mdns_name_t *name, size_t packet_len)
 {
     size_t index = 0;
     const uint8_t *packet_end = packet + packet_len;
@@ -463,29 +948,36 @@ static const uint8_t *_mdns_read_fqdn(const uint8_t *packet, const uint8_t *star
                 //length can not be more than 63
                 return NULL;
             }
-            uint8_t i;
-            for (i = 0; i < len; i++) {
-                if (start + index >= packet_end) {
-                    return NULL;
-                }
-                buf[i] = start[index++];
+            if (start + index + len > packet_end) {
+                return NULL;
             }
-            buf[len] = '\0';
-            if (name->parts == 1 && buf[0] != '_'
-                    && (strcasecmp(buf, MDNS_DEFAULT_DOMAIN) != 0)
-                    && (strcasecmp(buf, "arpa") != 0)
+            const char *label = (const char *)start + index;
+            index += len;
+            // a label is taken as a string, up to a NUL within it
+            len = strnlen(label, len);
+            if (name->parts == 1 && label[0] != '_'
+                    && !_mdns_label_is(label, len, MDNS_DEFAULT_DOMAIN)
+                    && !_mdns_label_is(label, len, "arpa")
 #ifndef CONFIG_MDNS_RESPOND_REVERSE_QUERIES
-                    && (strcasecmp(buf, "ip6") != 0)
-                    && (strcasecmp(buf, "in-addr") != 0)
+                    && !_mdns_label_is(label, len, "ip6")
+                    && !_mdns_label_is(label, len, "in-addr")
 #endif
                ) {
-                strlcat(name->host, ".", sizeof(name->host));
-                strlcat(name->host, buf, sizeof(name->host));
-            } else if (strcasecmp(buf, MDNS_SUB_STR) == 0) {
+                // further labels of the host (or instance) name, truncated as with strlcat()
+                size_t host_len = strlen(name->host);
+                if (host_len + 1 < sizeof(name->host)) {
+                    name->host[host_len++] = '.';
+                    size_t room = sizeof(name->host) - 1 - host_len;
+                    memcpy(name->host + host_len, label, len < room ? len : room);
+                    host_len += len < room ? len : room;
+                }
+                name->host[host_len] = '\0';
+            } else if (_mdns_label_is(label, len, MDNS_SUB_STR)) {
                 name->sub = 1;
             } else if (!name->invalid) {
                 char *mdns_name_ptrs[] = {name->host, name->service, name->proto, name->domain};
-                memcpy(mdns_name_ptrs[name->parts++], buf, len + 1);
+                memcpy(mdns_name_ptrs[name->parts], label, len);
+                mdns_name_ptrs[name->parts++][len] = '\0';
             }
         } else {
             size_t address = (((uint16_t)len & 0x3F) << 8) | start[index++];
@@ -493,7 +985,7 @@ static const uint8_t *_mdns_read_fqdn(const uint8_t *packet, const uint8_t *star
                 //reference address can not be after where we are
                 return NULL;
             }
-            if (_mdns_read_fqdn(packet, packet + address, name, buf, packet_len)) {
+            if (_mdns_read_fqdn(packet, packet + address, name, packet_len)) {
                 return start + index;
             }
             return NULL;
@@ -518,21 +1010,31 @@ static inline void _mdns_set_u16(uint8_t *packet, uint16_t index, uint16_t value
     packet[index + 1] = value & 0xFF;
 }
 
+/**
+ * @brief  marks the packet of the writer as full, tells the dispatcher to continue
+ *         in the next datagram rather than skip the record
+ */
+static inline uint8_t _mdns_packet_full(mdns_tx_writer_t *writer)
+{
+    writer->full = true;
+    return 0;
+}
+
 /**
  * @brief  appends byte in a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  value        the value to set
  *
  * @return length of added data: 0 on error or 1 on success
  */
-static inline uint8_t _mdns_append_u8(uint8_t *packet, uint16_t *index, uint8_t value)
+static inline uint8_t _mdns_append_u8(mdns_tx_writer_t *writer, uint16_t *index, uint8_t value)
 {
     if (*index >= MDNS_MAX_PACKET_SIZE) {
-        return 0;
+        return _mdns_packet_full(writer);
     }
-    packet[*index] = value;
+    writer->packet[*index] = value;
     *index += 1;
     return 1;
 }
@@ -540,92 +1042,92 @@ static inline uint8_t _mdns_append_u8(uint8_t *packet, uint16_t *index, uint8_t
 /**
  * @brief  appends uint16_t in a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  value        the value to set
  *
  * @return length of added data: 0 on error or 2 on success
  */
-static inline uint8_t _mdns_append_u16(uint8_t *packet, uint16_t *index, uint16_t value)
+static inline uint8_t _mdns_append_u16(mdns_tx_writer_t *writer, uint16_t *index, uint16_t value)
 {
     if ((*index + 1) >= MDNS_MAX_PACKET_SIZE) {
-        return 0;
+        return _mdns_packet_full(writer);
     }
-    _mdns_append_u8(packet, index, (value >> 8) & 0xFF);
-    _mdns_append_u8(packet, index, value & 0xFF);
+    _mdns_append_u8(writer, index, (value >> 8) & 0xFF);
+    _mdns_append_u8(writer, index, value & 0xFF);
     return 2;
 }
 
 /**
  * @brief  appends uint32_t in a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  value        the value to set
  *
  * @return length of added data: 0 on error or 4 on success
  */
-static inline uint8_t _mdns_append_u32(uint8_t *packet, uint16_t *index, uint32_t value)
+static inline uint8_t _mdns_append_u32(mdns_tx_writer_t *writer, uint16_t *index, uint32_t value)
 {
     if ((*index + 3) >= MDNS_MAX_PACKET_SIZE) {
-        return 0;
+        return _mdns_packet_full(writer);
     }
-    _mdns_append_u8(packet, index, (value >> 24) & 0xFF);
-    _mdns_append_u8(packet, index, (value >> 16) & 0xFF);
-    _mdns_append_u8(packet, index, (value >> 8) & 0xFF);
-    _mdns_append_u8(packet, index, value & 0xFF);
+    _mdns_append_u8(writer, index, (value >> 24) & 0xFF);
+    _mdns_append_u8(writer, index, (value >> 16) & 0xFF);
+    _mdns_append_u8(writer, index, (value >> 8) & 0xFF);
+    _mdns_append_u8(writer, index, value & 0xFF);
     return 4;
 }
 
 /**
  * @brief  appends answer type, class, ttl and data length to a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  type         answer type
  * @param  ttl          answer ttl
  *
  * @return length of added data: 0 on error or 10 on success
  */
-static inline uint8_t _mdns_append_type(uint8_t *packet, uint16_t *index, uint8_t type, bool flush, uint32_t ttl)
+static inline uint8_t _mdns_append_type(mdns_tx_writer_t *writer, uint16_t *index, uint8_t type, bool flush, uint32_t ttl)
 {
     if ((*index + 10) >= MDNS_MAX_PACKET_SIZE) {
-        return 0;
+        return _mdns_packet_full(writer);
     }
     uint16_t mdns_class = MDNS_CLASS_IN;
     if (flush) {
         mdns_class = MDNS_CLASS_IN_FLUSH_CACHE;
     }
     if (type == MDNS_ANSWER_PTR) {
-        _mdns_append_u16(packet, index, MDNS_TYPE_PTR);
-        _mdns_append_u16(packet, index, mdns_class);
+        _mdns_append_u16(writer, index, MDNS_TYPE_PTR);
+        _mdns_append_u16(writer, index, mdns_class);
     } else if (type == MDNS_ANSWER_TXT) {
-        _mdns_append_u16(packet, index, MDNS_TYPE_TXT);
-        _mdns_append_u16(packet, index, mdns_class);
+        _mdns_append_u16(writer, index, MDNS_TYPE_TXT);
+        _mdns_append_u16(writer, index, mdns_class);
     } else if (type == MDNS_ANSWER_SRV) {
-        _mdns_append_u16(packet, index, MDNS_TYPE_SRV);
-        _mdns_append_u16(packet, index, mdns_class);
+        _mdns_append_u16(writer, index, MDNS_TYPE_SRV);
+        _mdns_append_u16(writer, index, mdns_class);
     } else if (type == MDNS_ANSWER_A) {
-        _mdns_append_u16(packet, index, MDNS_TYPE_A);
-        _mdns_append_u16(packet, index, mdns_class);
+        _mdns_append_u16(writer, index, MDNS_TYPE_A);
+        _mdns_append_u16(writer, index, mdns_class);
     } else if (type == MDNS_ANSWER_AAAA) {
-        _mdns_append_u16(packet, index, MDNS_TYPE_AAAA);
-        _mdns_append_u16(packet, index, mdns_class);
+        _mdns_append_u16(writer, index, MDNS_TYPE_AAAA);
+        _mdns_append_u16(writer, index, mdns_class);
     } else {
         return 0;
     }
-    _mdns_append_u32(packet, index, ttl);
-    _mdns_append_u16(packet, index, 0);
+    _mdns_append_u32(writer, index, ttl);
+    _mdns_append_u16(writer, index, 0);
     return 10;
 }
 
-static inline uint8_t _mdns_append_string_with_len(uint8_t *packet, uint16_t *index, const char *string, uint8_t len)
+static inline uint8_t _mdns_append_string_with_len(mdns_tx_writer_t *writer, uint16_t *index, const char *string, uint8_t len)
 {
     if ((*index + len + 1) >= MDNS_MAX_PACKET_SIZE) {
-        return 0;
+        return _mdns_packet_full(writer);
     }
-    _mdns_append_u8(packet, index, len);
-    memcpy(packet + *index, string, len);
+    _mdns_append_u8(writer, index, len);
+    memcpy(writer->packet + *index, string, len);
     *index += len;
     return len + 1;
 }
@@ -633,20 +1135,20 @@ static inline uint8_t _mdns_append_string_with_len(uint8_t *packet, uint16_t *in
 /**
  * @brief  appends single string to a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  string       the string to append
  *
  * @return length of added data: 0 on error or length of the string + 1 on success
  */
-static inline uint8_t _mdns_append_string(uint8_t *packet, uint16_t *index, const char *string)
+static inline uint8_t _mdns_append_string(mdns_tx_writer_t *writer, uint16_t *index, const char *string)
 {
     uint8_t len = strlen(string);
     if ((*index + len + 1) >= MDNS_MAX_PACKET_SIZE) {
-        return 0;
+        return _mdns_packet_full(writer);
     }
-    _mdns_append_u8(packet, index, len);
-    memcpy(packet + *index, string, len);
+    _mdns_append_u8(writer, index, len);
+    memcpy(writer->packet + *index, string, len);
     *index += len;
     return len + 1;
 }
@@ -654,7 +1156,7 @@ static inline uint8_t _mdns_append_string(uint8_t *packet, uint16_t *index, cons
 /**
  * @brief  appends one TXT record ("key=value" or "key")
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  txt          one txt record
  *
@@ -662,7 +1164,7 @@ static inline uint8_t _mdns_append_string(uint8_t *packet, uint16_t *index, cons
  *         0  if data won't fit the packet
  *         -1 if invalid TXT entry
  */
-static inline int append_one_txt_record_entry(uint8_t *packet, uint16_t *index, mdns_txt_linked_item_t *txt)
+static inline int append_one_txt_record_entry(mdns_tx_writer_t *writer, uint16_t *index, mdns_txt_linked_item_t *txt)
 {
     if (txt == NULL || txt->key == NULL) {
         return -1;
@@ -670,28 +1172,28 @@ static inline int append_one_txt_record_entry(uint8_t *packet, uint16_t *index,
     size_t key_len = strlen(txt->key);
     size_t len = key_len + txt->value_len + (txt->value ? 1 : 0);
     if ((*index + len + 1) >= MDNS_MAX_PACKET_SIZE) {
-        return 0;
+        return _mdns_packet_full(writer);
     }
-    _mdns_append_u8(packet, index, len);
-    memcpy(packet + *index, txt->key, key_len);
+    _mdns_append_u8(writer, index, len);
+    memcpy(writer->packet + *index, txt->key, key_len);
     if (txt->value) {
-        packet[*index + key_len] = '=';
-        memcpy(packet + *index + key_len + 1, txt->value, txt->value_len);
+        writer->packet[*index + key_len] = '=';
+        memcpy(writer->packet + *index + key_len + 1, txt->value, txt->value_len);
     }
     *index += len;
     return len + 1;
 }
 
 #ifdef CONFIG_MDNS_RESPOND_REVERSE_QUERIES
-static inline int append_single_str(uint8_t *packet, uint16_t *index, const char *str, int len)
+static inline int append_single_str(mdns_tx_writer_t *writer, uint16_t *index, const char *str, int len)
 {
     if ((*index + len + 1) >= MDNS_MAX_PACKET_SIZE) {
-        return 0;
+        return _mdns_packet_full(writer);
     }
-    if (!_mdns_append_u8(packet, index, len)) {
+    if (!_mdns_append_u8(writer, index, len)) {
         return 0;
     }
-    memcpy(packet + *index, str, len);
+    memcpy(writer->packet + *index, str, len);
     *index += len;
     return *index;
 }
@@ -701,14 +1203,14 @@ static inline int append_single_str(uint8_t *packet, uint16_t *index, const char
  * _mdns_append_fqdn(), but refrains from DNS compression (as it's mainly used for IP addresses (many short items),
  * where we gain very little (or compression even gets counter-productive mainly for IPv6 addresses)
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  name         name representing FQDN in '.' separated parts
  * @param  last         true if appending the last part (domain, typically "arpa")
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t append_fqdn_dots(uint8_t *packet, uint16_t *index, const char *name, bool last)
+static uint16_t append_fqdn_dots(mdns_tx_writer_t *writer, uint16_t *index, const char *name, bool last)
 {
     int len = strlen(name);
     char *host = (char *)name;
@@ -718,109 +1220,290 @@ static uint16_t append_fqdn_dots(uint8_t *packet, uint16_t *index, const char *n
         end = memchr(start, '.', host + len - start);
         end = end ? end : host + len;
         int part_len = end - start;
-        if (!append_single_str(packet, index, start, part_len)) {
+        if (!append_single_str(writer, index, start, part_len)) {
             return 0;
         }
         start = ++end;
     } while (end < name + len);
 
-    if (!append_single_str(packet, index, "arpa", sizeof("arpa") - 1)) {
+    if (!append_single_str(writer, index, "arpa", sizeof("arpa") - 1)) {
         return 0;
     }
 
     //empty string so terminate
-    if (!_mdns_append_u8(packet, index, 0)) {
+    if (!_mdns_append_u8(writer, index, 0)) {
         return 0;
     }
     return *index;
 }
 #endif /* CONFIG_MDNS_RESPOND_REVERSE_QUERIES */
 
+/**
+ * @brief  starts a new name compression dictionary for the packet being built
+ */
+static void _mdns_name_dict_reset(mdns_tx_writer_t *writer)
+{
+    memset(&writer->names, 0, sizeof(writer->names));
+}
+
+/**
+ * @brief  hash of a name suffix, computed from the last label towards the first one
+ *
+ * @param  label        the first label of the suffix
+ * @param  suffix_hash  hash of the rest of the suffix (0 for the root)
+ */
+static uint32_t _mdns_name_suffix_hash(const char *label, uint32_t suffix_hash)
+{
+    uint32_t hash = 2166136261u;
+    const uint8_t *c = (const uint8_t *)label;
+    while (*c) {
+        uint8_t ch = *c++;
+        if (ch >= 'A' && ch <= 'Z') {
+            ch += 'a' - 'A';
+        }
+        hash = (hash ^ ch) * 16777619u;
+    }
+    return hash ^ (suffix_hash * 0x9E3779B1u + 0x7F4A7C15u);
+}
+
+/**
+ * @brief  checks that the name at offset in the packet equals the given labels (case insensitive)
+ */
+static bool _mdns_name_dict_match(const uint8_t *packet, uint16_t limit, uint16_t offset, const char *strings[], uint8_t count)
+{
+    uint8_t i = 0;
+    uint16_t pos = offset;
+    for (;;) {
+        if (pos >= limit) {
+            return false;
+        }
+        uint8_t len = packet[pos];
+        if ((len & 0xC0) == 0xC0) {
+            if (pos + 1 >= limit) {
+                return false;
+            }
+            uint16_t target = ((uint16_t)(len & 0x3F) << 8) | packet[pos + 1];
+            if (target >= pos) {
+                return false;
+            }
+            pos = target;
+            continue;
+        }
+        if (i == count) {
+            return len == 0;
+        }
+        if (len != strlen(strings[i]) || pos + 1 + len > limit
+                || strncasecmp((const char *)packet + pos + 1, strings[i], len)) {
+            return false;
+        }
+        pos += len + 1;
+        i++;
+    }
+}
+
+/**
+ * @brief  finds offset of the name formed by given labels in the packet
+ *
+ * @return offset of the name or 0 if not found
+ */
+static uint16_t _mdns_name_dict_find(const mdns_tx_writer_t *writer, uint16_t limit, uint32_t hash, const char *strings[], uint8_t count)
+{
+    uint16_t slot = hash & (MDNS_NAME_DICT_SIZE - 1);
+    while (writer->names.entries[slot].offset) {
+        const mdns_name_dict_entry_t *e = &writer->names.entries[slot];
+        if (e->hash == hash && _mdns_name_dict_match(writer->packet, limit, e->offset, strings, count)) {
+            return e->offset;
+        }
+        slot = (slot + 1) & (MDNS_NAME_DICT_SIZE - 1);
+    }
+    return 0;
+}
+
+static void _mdns_name_dict_add(mdns_tx_writer_t *writer, uint32_t hash, uint16_t offset)
+{
+    // keep the load low, names which do not fit are just not compressed against
+    if (writer->names.used >= (MDNS_NAME_DICT_SIZE * 3) / 4) {
+        return;
+    }
+    uint16_t slot = hash & (MDNS_NAME_DICT_SIZE - 1);
+    while (writer->names.entries[slot].offset) {
+        slot = (slot + 1) & (MDNS_NAME_DICT_SIZE - 1);
+    }
+    writer->names.entries[slot].hash = hash;
+    writer->names.entries[slot].offset = offset;
+    writer->names.used++;
+}
+
+/**
+ * @brief  computes suffix hashes of all labels of a name, hashes[i] covers strings[i..count-1]
+ */
+static void _mdns_name_hashes(const char *strings[], uint32_t hashes[], uint8_t count)
+{
+    uint32_t hash = 0;
+    for (uint8_t i = count; i > 0; i--) {
+        hash = _mdns_name_suffix_hash(strings[i - 1], hash);
+        hashes[i - 1] = hash;
+    }
+}
+
+/**
+ * @brief  appends FQDN with precomputed suffix hashes to a packet, see _mdns_append_fqdn()
+ *
+ * @param  hashes       suffix hashes of the name as computed by _mdns_name_hashes()
+ */
+static uint16_t _mdns_append_fqdn_hashed(mdns_tx_writer_t *writer, uint16_t *index, const char *strings[], const uint32_t hashes[],
+                                         uint8_t count, size_t packet_len)
+{
+    uint16_t limit = (*index < packet_len) ? *index : packet_len;
+    uint8_t i;
+    //find the longest suffix of the name which is already in the packet
+    uint16_t ref = 0;
+    uint8_t found = count;
+    for (i = 0; i < count; i++) {
+        ref = _mdns_name_dict_find(writer, limit, hashes[i], &strings[i], count - i);
+        if (ref) {
+            found = i;
+            break;
+        }
+    }
+    //add the labels preceding it
+    uint16_t written = 0;
+    for (i = 0; i < found; i++) {
+        uint16_t offset = *index;
+        uint8_t part = _mdns_append_string(writer, index, strings[i]);
+        if (!part) {
+            return 0;
+        }
+        _mdns_name_dict_add(writer, hashes[i], offset);
+        written += part;
+    }
+    if (!ref) {
+        return _mdns_append_u8(writer, index, 0) ? written + 1 : 0;
+    }
+    //we have found the rest of the name so let's insert a pointer to it instead
+    return _mdns_append_u16(writer, index, ref | MDNS_NAME_REF) ? written + 2 : 0;
+}
+
 /**
  * @brief  appends FQDN to a packet, incrementing the index and
  *         compressing the output if previous occurrence of the string (or part of it) has been found
  *
- * @param  packet       MDNS packet
+ * Suffixes of all names appended to the packet are kept in a hash dictionary, so the longest
+ * already present suffix is found in O(labels) instead of scanning the packet.
+ *
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  strings      string array containing the parts of the FQDN
  * @param  count        number of strings in the array
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t _mdns_append_fqdn(uint8_t *packet, uint16_t *index, const char *strings[], uint8_t count, size_t packet_len)
+static uint16_t _mdns_append_fqdn(mdns_tx_writer_t *writer, uint16_t *index, const char *strings[], uint8_t count, size_t packet_len)
 {
     if (!count) {
         //empty string so terminate
-        return _mdns_append_u8(packet, index, 0);
-    }
-    static char buf[MDNS_NAME_BUF_LEN];
-    uint8_t len = strlen(strings[0]);
-    //try to find first the string length in the packet (if it exists)
-    uint8_t *len_location = (uint8_t *)memchr(packet, (char)len, *index);
-    while (len_location) {
-        mdns_name_t name;
-        //check if the string after len_location is the string that we are looking for
-        if (memcmp(len_location + 1, strings[0], len)) { //not continuing with our string
-search_next:
-            //try and find the length byte further in the packet
-            len_location = (uint8_t *)memchr(len_location + 1, (char)len, *index - (len_location + 1 - packet));
-            continue;
+        return _mdns_append_u8(writer, index, 0);
+    }
+    uint32_t hashes[count];
+    _mdns_name_hashes(strings, hashes, count);
+    return _mdns_append_fqdn_hashed(writer, index, strings, hashes, count, packet_len);
+}
+
+/**
+ * @brief  drops the cached answer data of a service, it is rebuilt with the next response
+ */
+static void _mdns_service_wire_invalidate(mdns_service_t *service)
+{
+    mdns_mem_free(service->wire);
+    service->wire = NULL;
+    _mdns_snapshot_invalidate();
+}
+
+/**
+ * @brief  drops the cached answer data of all services, called when the server hostname or instance changes
+ */
+static void _mdns_service_wire_invalidate_all(void)
+{
+    _mdns_server->wire_gen++;
+    _mdns_snapshot_invalidate();
+}
+
+/**
+ * @brief  returns the cached answer data of a service, (re)building it if needed
+ *
+ * @return the cache or NULL if it could not be built (answers are then composed from the service directly)
+ */
+static mdns_service_wire_t *_mdns_service_wire_get(mdns_service_t *service)
+{
+    mdns_service_wire_t *wire = service->wire;
+    if (wire && wire->gen == _mdns_server->wire_gen) {
+        return wire;
+    }
+
+    const char *instance_str[4] = {_mdns_get_service_instance_name(service), service->service, service->proto, MDNS_DEFAULT_DOMAIN};
+    const char *host_str[2] = {service->hostname ? service->hostname : _mdns_server->hostname, MDNS_DEFAULT_DOMAIN};
+    if (!instance_str[0] || _str_null_or_empty(host_str[0])) {
+        return NULL;
+    }
+
+    size_t txt_len = 0;
+    mdns_txt_linked_item_t *txt;
+    for (txt = service->txt; txt; txt = txt->next) {
+        if (txt->key) {
+            txt_len += 1 + strlen(txt->key) + txt->value_len + (txt->value ? 1 : 0);
         }
-        //seems that we might have found the string that we are looking for
-        //read the destination into name and compare
-        name.parts = 0;
-        name.sub = 0;
-        name.invalid = false;
-        name.host[0] = 0;
-        name.service[0] = 0;
-        name.proto[0] = 0;
-        name.domain[0] = 0;
-        const uint8_t *content = _mdns_read_fqdn(packet, len_location, &name, buf, packet_len);
-        if (!content) {
-            //not a readable fqdn?
-            goto search_next; // could be our unfinished fqdn, continue searching
-        }
-        if (name.parts == count) {
-            uint8_t i;
-            for (i = 0; i < count; i++) {
-                if (strcasecmp(strings[i], (const char *)&name + (i * (MDNS_NAME_BUF_LEN)))) {
-                    //not our string! let's search more
-                    goto search_next;
-                }
-            }
-            //we actually have found the string
-            break;
-        } else {
-            goto search_next;
+    }
+    if (!txt_len) {
+        txt_len = 1;
+    }
+    if (txt_len >= MDNS_MAX_PACKET_SIZE) {
+        return NULL;
+    }
+
+    if (!wire || wire->txt_len != txt_len) {
+        mdns_mem_free(wire);
+        wire = (mdns_service_wire_t *)mdns_mem_malloc(sizeof(mdns_service_wire_t) + txt_len);
+        service->wire = wire;
+        if (!wire) {
+            return NULL;
         }
     }
-    //string is not yet in the packet, so let's add it
-    if (!len_location) {
-        uint8_t written = _mdns_append_string(packet, index, strings[0]);
-        if (!written) {
-            return 0;
+    wire->gen = _mdns_server->wire_gen;
+    _mdns_name_hashes(instance_str, wire->instance_hashes, 4);
+    _mdns_name_hashes(host_str, wire->host_hashes, 2);
+    wire->txt_len = txt_len;
+    wire->txt[0] = 0;
+    uint16_t index = 0;
+    for (txt = service->txt; txt; txt = txt->next) {
+        if (!txt->key) {
+            continue;
+        }
+        size_t key_len = strlen(txt->key);
+        wire->txt[index++] = key_len + txt->value_len + (txt->value ? 1 : 0);
+        memcpy(wire->txt + index, txt->key, key_len);
+        index += key_len;
+        if (txt->value) {
+            wire->txt[index++] = '=';
+            memcpy(wire->txt + index, txt->value, txt->value_len);
+            index += txt->value_len;
         }
-        //run the same for the other strings in the name
-        return written + _mdns_append_fqdn(packet, index, &strings[1], count - 1, packet_len);
     }
-
-    //we have found the string so let's insert a pointer to it instead
-    uint16_t offset = len_location - packet;
-    offset |= MDNS_NAME_REF;
-    return _mdns_append_u16(packet, index, offset);
+    return wire;
 }
 
 /**
  * @brief  appends PTR record for service to a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  server       the server that is hosting the service
  * @param  service      the service to add record for
+ * @param  hashes       cached suffix hashes of the instance name or NULL
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t _mdns_append_ptr_record(uint8_t *packet, uint16_t *index, const char *instance, const char *service, const char *proto, bool flush, bool bye)
+static uint16_t _mdns_append_ptr_record(mdns_tx_writer_t *writer, uint16_t *index, const char *instance, const char *service, const char *proto,
+                                        const uint32_t *hashes, bool flush, bool bye)
 {
     const char *str[4];
     uint16_t record_length = 0;
@@ -835,24 +1518,30 @@ static uint16_t _mdns_append_ptr_record(uint8_t *packet, uint16_t *index, const
     str[2] = proto;
     str[3] = MDNS_DEFAULT_DOMAIN;
 
-    part_length = _mdns_append_fqdn(packet, index, str + 1, 3, MDNS_MAX_PACKET_SIZE);
+    uint32_t computed[4];
+    if (!hashes) {
+        _mdns_name_hashes(str, computed, 4);
+        hashes = computed;
+    }
+
+    part_length = _mdns_append_fqdn_hashed(writer, index, str + 1, hashes + 1, 3, MDNS_MAX_PACKET_SIZE);
     if (!part_length) {
         return 0;
     }
     record_length += part_length;
 
-    part_length = _mdns_append_type(packet, index, MDNS_ANSWER_PTR, false, bye ? 0 : MDNS_ANSWER_PTR_TTL);
+    part_length = _mdns_append_type(writer, index, MDNS_ANSWER_PTR, false, bye ? 0 : MDNS_ANSWER_PTR_TTL);
     if (!part_length) {
         return 0;
     }
     record_length += part_length;
 
     uint16_t data_len_location = *index - 2;
-    part_length = _mdns_append_fqdn(packet, index, str, 4, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn_hashed(writer, index, str, hashes, 4, MDNS_MAX_PACKET_SIZE);
     if (!part_length) {
         return 0;
     }
-    _mdns_set_u16(packet, data_len_location, part_length);
+    _mdns_set_u16(writer->packet, data_len_location, part_length);
     record_length += part_length;
     return record_length;
 }
@@ -860,19 +1549,20 @@ static uint16_t _mdns_append_ptr_record(uint8_t *packet, uint16_t *index, const
 /**
  * @brief  appends PTR record for a subtype to a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  instance     the service instance name
  * @param  subtype      the service subtype
  * @param  proto        the service protocol
+ * @param  hashes       cached suffix hashes of the instance name or NULL
  * @param  flush        whether to set the flush flag
  * @param  bye          whether to set the bye flag
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t _mdns_append_subtype_ptr_record(uint8_t *packet, uint16_t *index, const char *instance,
-                                                const char *subtype, const char *service, const char *proto, bool flush,
-                                                bool bye)
+static uint16_t _mdns_append_subtype_ptr_record(mdns_tx_writer_t *writer, uint16_t *index, const char *instance,
+                                                const char *subtype, const char *service, const char *proto,
+                                                const uint32_t *hashes, bool flush, bool bye)
 {
     const char *subtype_str[5] = {subtype, MDNS_SUB_STR, service, proto, MDNS_DEFAULT_DOMAIN};
     const char *instance_str[4] = {instance, service, proto, MDNS_DEFAULT_DOMAIN};
@@ -883,24 +1573,28 @@ static uint16_t _mdns_append_subtype_ptr_record(uint8_t *packet, uint16_t *index
         return 0;
     }
 
-    part_length = _mdns_append_fqdn(packet, index, subtype_str, ARRAY_SIZE(subtype_str), MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(writer, index, subtype_str, ARRAY_SIZE(subtype_str), MDNS_MAX_PACKET_SIZE);
     if (!part_length) {
         return 0;
     }
     record_length += part_length;
 
-    part_length = _mdns_append_type(packet, index, MDNS_ANSWER_PTR, false, bye ? 0 : MDNS_ANSWER_PTR_TTL);
+    part_length = _mdns_append_type(writer, index, MDNS_ANSWER_PTR, false, bye ? 0 : MDNS_ANSWER_PTR_TTL);
     if (!part_length) {
         return 0;
     }
     record_length += part_length;
 
     uint16_t data_len_location = *index - 2;
-    part_length = _mdns_append_fqdn(packet, index, instance_str, ARRAY_SIZE(instance_str), MDNS_MAX_PACKET_SIZE);
+    if (hashes) {
+        part_length = _mdns_append_fqdn_hashed(writer, index, instance_str, hashes, ARRAY_SIZE(instance_str), MDNS_MAX_PACKET_SIZE);
+    } else {
+        part_length = _mdns_append_fqdn(writer, index, instance_str, ARRAY_SIZE(instance_str), MDNS_MAX_PACKET_SIZE);
+    }
     if (!part_length) {
         return 0;
     }
-    _mdns_set_u16(packet, data_len_location, part_length);
+    _mdns_set_u16(writer->packet, data_len_location, part_length);
     record_length += part_length;
     return record_length;
 }
@@ -908,14 +1602,14 @@ static uint16_t _mdns_append_subtype_ptr_record(uint8_t *packet, uint16_t *index
 /**
  * @brief  appends DNS-SD PTR record for service to a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  server       the server that is hosting the service
  * @param  service      the service to add record for
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t _mdns_append_sdptr_record(uint8_t *packet, uint16_t *index, mdns_service_t *service, bool flush, bool bye)
+static uint16_t _mdns_append_sdptr_record(mdns_tx_writer_t *writer, uint16_t *index, mdns_service_t *service, bool flush, bool bye)
 {
     const char *str[3];
     const char *sd_str[4];
@@ -935,22 +1629,28 @@ static uint16_t _mdns_append_sdptr_record(uint8_t *packet, uint16_t *index, mdns
     str[1] = service->proto;
     str[2] = MDNS_DEFAULT_DOMAIN;
 
-    part_length = _mdns_append_fqdn(packet, index, sd_str, 4, MDNS_MAX_PACKET_SIZE);
+    mdns_service_wire_t *wire = _mdns_service_wire_get(service);
+
+    part_length = _mdns_append_fqdn(writer, index, sd_str, 4, MDNS_MAX_PACKET_SIZE);
 
     record_length += part_length;
 
-    part_length = _mdns_append_type(packet, index, MDNS_ANSWER_PTR, flush, MDNS_ANSWER_PTR_TTL);
+    part_length = _mdns_append_type(writer, index, MDNS_ANSWER_PTR, flush, MDNS_ANSWER_PTR_TTL);
     if (!part_length) {
         return 0;
     }
     record_length += part_length;
 
     uint16_t data_len_location = *index - 2;
-    part_length = _mdns_append_fqdn(packet, index, str, 3, MDNS_MAX_PACKET_SIZE);
+    if (wire) {
+        part_length = _mdns_append_fqdn_hashed(writer, index, str, wire->instance_hashes + 1, 3, MDNS_MAX_PACKET_SIZE);
+    } else {
+        part_length = _mdns_append_fqdn(writer, index, str, 3, MDNS_MAX_PACKET_SIZE);
+    }
     if (!part_length) {
         return 0;
     }
-    _mdns_set_u16(packet, data_len_location, part_length);
+    _mdns_set_u16(writer->packet, data_len_location, part_length);
     record_length += part_length;
     return record_length;
 }
@@ -958,14 +1658,14 @@ static uint16_t _mdns_append_sdptr_record(uint8_t *packet, uint16_t *index, mdns
 /**
  * @brief  appends TXT record for service to a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  server       the server that is hosting the service
  * @param  service      the service to add record for
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t _mdns_append_txt_record(uint8_t *packet, uint16_t *index, mdns_service_t *service, bool flush, bool bye)
+static uint16_t _mdns_append_txt_record(mdns_tx_writer_t *writer, uint16_t *index, mdns_service_t *service, bool flush, bool bye)
 {
     const char *str[4];
     uint16_t record_length = 0;
@@ -984,13 +1684,18 @@ static uint16_t _mdns_append_txt_record(uint8_t *packet, uint16_t *index, mdns_s
         return 0;
     }
 
-    part_length = _mdns_append_fqdn(packet, index, str, 4, MDNS_MAX_PACKET_SIZE);
+    mdns_service_wire_t *wire = _mdns_service_wire_get(service);
+    if (wire) {
+        part_length = _mdns_append_fqdn_hashed(writer, index, str, wire->instance_hashes, 4, MDNS_MAX_PACKET_SIZE);
+    } else {
+        part_length = _mdns_append_fqdn(writer, index, str, 4, MDNS_MAX_PACKET_SIZE);
+    }
     if (!part_length) {
         return 0;
     }
     record_length += part_length;
 
-    part_length = _mdns_append_type(packet, index, MDNS_ANSWER_TXT, flush, bye ? 0 : MDNS_ANSWER_TXT_TTL);
+    part_length = _mdns_append_type(writer, index, MDNS_ANSWER_TXT, flush, bye ? 0 : MDNS_ANSWER_TXT_TTL);
     if (!part_length) {
         return 0;
     }
@@ -999,9 +1704,19 @@ static uint16_t _mdns_append_txt_record(uint8_t *packet, uint16_t *index, mdns_s
     uint16_t data_len_location = *index - 2;
     uint16_t data_len = 0;
 
+    if (wire) {
+        if ((*index + wire->txt_len) >= MDNS_MAX_PACKET_SIZE) {
+            return _mdns_packet_full(writer);
+        }
+        memcpy(writer->packet + *index, wire->txt, wire->txt_len);
+        *index += wire->txt_len;
+        _mdns_set_u16(writer->packet, data_len_location, wire->txt_len);
+        return record_length + wire->txt_len;
+    }
+
     mdns_txt_linked_item_t *txt = service->txt;
     while (txt) {
-        int l = append_one_txt_record_entry(packet, index, txt);
+        int l = append_one_txt_record_entry(writer, index, txt);
         if (l > 0) {
             data_len += l;
         } else if (l == 0) { // TXT entry won't fit into the mdns packet
@@ -1011,10 +1726,10 @@ static uint16_t _mdns_append_txt_record(uint8_t *packet, uint16_t *index, mdns_s
     }
     if (!data_len) {
         data_len = 1;
-        packet[*index] = 0;
+        writer->packet[*index] = 0;
         *index = *index + 1;
     }
-    _mdns_set_u16(packet, data_len_location, data_len);
+    _mdns_set_u16(writer->packet, data_len_location, data_len);
     record_length += data_len;
     return record_length;
 }
@@ -1022,14 +1737,14 @@ static uint16_t _mdns_append_txt_record(uint8_t *packet, uint16_t *index, mdns_s
 /**
  * @brief  appends SRV record for service to a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  server       the server that is hosting the service
  * @param  service      the service to add record for
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t _mdns_append_srv_record(uint8_t *packet, uint16_t *index, mdns_service_t *service, bool flush, bool bye)
+static uint16_t _mdns_append_srv_record(mdns_tx_writer_t *writer, uint16_t *index, mdns_service_t *service, bool flush, bool bye)
 {
     const char *str[4];
     uint16_t record_length = 0;
@@ -1048,13 +1763,18 @@ static uint16_t _mdns_append_srv_record(uint8_t *packet, uint16_t *index, mdns_s
         return 0;
     }
 
-    part_length = _mdns_append_fqdn(packet, index, str, 4, MDNS_MAX_PACKET_SIZE);
+    mdns_service_wire_t *wire = _mdns_service_wire_get(service);
+    if (wire) {
+        part_length = _mdns_append_fqdn_hashed(writer, index, str, wire->instance_hashes, 4, MDNS_MAX_PACKET_SIZE);
+    } else {
+        part_length = _mdns_append_fqdn(writer, index, str, 4, MDNS_MAX_PACKET_SIZE);
+    }
     if (!part_length) {
         return 0;
     }
     record_length += part_length;
 
-    part_length = _mdns_append_type(packet, index, MDNS_ANSWER_SRV, flush, bye ? 0 : MDNS_ANSWER_SRV_TTL);
+    part_length = _mdns_append_type(writer, index, MDNS_ANSWER_SRV, flush, bye ? 0 : MDNS_ANSWER_SRV_TTL);
     if (!part_length) {
         return 0;
     }
@@ -1063,9 +1783,9 @@ static uint16_t _mdns_append_srv_record(uint8_t *packet, uint16_t *index, mdns_s
     uint16_t data_len_location = *index - 2;
 
     part_length = 0;
-    part_length += _mdns_append_u16(packet, index, service->priority);
-    part_length += _mdns_append_u16(packet, index, service->weight);
-    part_length += _mdns_append_u16(packet, index, service->port);
+    part_length += _mdns_append_u16(writer, index, service->priority);
+    part_length += _mdns_append_u16(writer, index, service->weight);
+    part_length += _mdns_append_u16(writer, index, service->port);
     if (part_length != 6) {
         return 0;
     }
@@ -1081,11 +1801,15 @@ static uint16_t _mdns_append_srv_record(uint8_t *packet, uint16_t *index, mdns_s
         return 0;
     }
 
-    part_length = _mdns_append_fqdn(packet, index, str, 2, MDNS_MAX_PACKET_SIZE);
+    if (wire) {
+        part_length = _mdns_append_fqdn_hashed(writer, index, str, wire->host_hashes, 2, MDNS_MAX_PACKET_SIZE);
+    } else {
+        part_length = _mdns_append_fqdn(writer, index, str, 2, MDNS_MAX_PACKET_SIZE);
+    }
     if (!part_length) {
         return 0;
     }
-    _mdns_set_u16(packet, data_len_location, part_length + 6);
+    _mdns_set_u16(writer->packet, data_len_location, part_length + 6);
 
     record_length += part_length + 6;
     return record_length;
@@ -1095,14 +1819,14 @@ static uint16_t _mdns_append_srv_record(uint8_t *packet, uint16_t *index, mdns_s
 /**
  * @brief  appends A record to a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  hostname     the hostname address to add
  * @param  ip           the IP address to add
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t _mdns_append_a_record(uint8_t *packet, uint16_t *index, const char *hostname, uint32_t ip, bool flush, bool bye)
+static uint16_t _mdns_append_a_record(mdns_tx_writer_t *writer, uint16_t *index, const char *hostname, uint32_t ip, bool flush, bool bye)
 {
     const char *str[2];
     uint16_t record_length = 0;
@@ -1115,13 +1839,13 @@ static uint16_t _mdns_append_a_record(uint8_t *packet, uint16_t *index, const ch
         return 0;
     }
 
-    part_length = _mdns_append_fqdn(packet, index, str, 2, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(writer, index, str, 2, MDNS_MAX_PACKET_SIZE);
     if (!part_length) {
         return 0;
     }
     record_length += part_length;
 
-    part_length = _mdns_append_type(packet, index, MDNS_ANSWER_A, flush, bye ? 0 : MDNS_ANSWER_A_TTL);
+    part_length = _mdns_append_type(writer, index, MDNS_ANSWER_A, flush, bye ? 0 : MDNS_ANSWER_A_TTL);
     if (!part_length) {
         return 0;
     }
@@ -1130,13 +1854,13 @@ static uint16_t _mdns_append_a_record(uint8_t *packet, uint16_t *index, const ch
     uint16_t data_len_location = *index - 2;
 
     if ((*index + 3) >= MDNS_MAX_PACKET_SIZE) {
-        return 0;
+        return _mdns_packet_full(writer);
     }
-    _mdns_append_u8(packet, index, ip & 0xFF);
-    _mdns_append_u8(packet, index, (ip >> 8) & 0xFF);
-    _mdns_append_u8(packet, index, (ip >> 16) & 0xFF);
-    _mdns_append_u8(packet, index, (ip >> 24) & 0xFF);
-    _mdns_set_u16(packet, data_len_location, 4);
+    _mdns_append_u8(writer, index, ip & 0xFF);
+    _mdns_append_u8(writer, index, (ip >> 8) & 0xFF);
+    _mdns_append_u8(writer, index, (ip >> 16) & 0xFF);
+    _mdns_append_u8(writer, index, (ip >> 24) & 0xFF);
+    _mdns_set_u16(writer->packet, data_len_location, 4);
 
     record_length += 4;
     return record_length;
@@ -1147,14 +1871,14 @@ static uint16_t _mdns_append_a_record(uint8_t *packet, uint16_t *index, const ch
 /**
  * @brief  appends AAAA record to a packet, incrementing the index
  *
- * @param  packet       MDNS packet
+ * @param  writer       writer of the MDNS packet
  * @param  index        offset in the packet
  * @param  hostname     the hostname address to add
  * @param  ipv6         the IPv6 address to add
  *
  * @return length of added data: 0 on error or length on success
  */
-static uint16_t _mdns_append_aaaa_record(uint8_t *packet, uint16_t *index, const char *hostname, uint8_t *ipv6, bool flush, bool bye)
+static uint16_t _mdns_append_aaaa_record(mdns_tx_writer_t *writer, uint16_t *index, const char *hostname, uint8_t *ipv6, bool flush, bool bye)
 {
     const char *str[2];
     uint16_t record_length = 0;
@@ -1168,13 +1892,13 @@ static uint16_t _mdns_append_aaaa_record(uint8_t *packet, uint16_t *index, const
     }
 
 
-    part_length = _mdns_append_fqdn(packet, index, str, 2, MDNS_MAX_PACKET_SIZE);
+    part_length = _mdns_append_fqdn(writer, index, str, 2, MDNS_MAX_PACKET_SIZE);
     if (!part_length) {
         return 0;
     }
     record_length += part_length;
 
-    part_length = _mdns_append_type(packet, index, MDNS_ANSWER_AAAA, flush, bye ? 0 : MDNS_ANSWER_AAAA_TTL);
+    part_length = _mdns_append_type(writer, index, MDNS_ANSWER_AAAA, flush, bye ? 0 : MDNS_ANSWER_AAAA_TTL);
     if (!part_length) {
         return 0;
     }
@@ -1183,13 +1907,13 @@ static uint16_t _mdns_append_aaaa_record(uint8_t *packet, uint16_t *index, const
     uint16_t data_len_location = *index - 2;
 
     if ((*index + MDNS_ANSWER_AAAA_SIZE) > MDNS_MAX_PACKET_SIZE) {
-        return 0;
+        return _mdns_packet_full(writer);
     }
 
     part_length = MDNS_ANSWER_AAAA_SIZE;
-    memcpy(packet + *index, ipv6, part_length);
+    memcpy(writer->packet + *index, ipv6, part_length);
     *index += part_length;
-    _mdns_set_u16(packet, data_len_location, part_length);
+    _mdns_set_u16(writer->packet, data_len_location, part_length);
     record_length += part_length;
     return record_length;
 }
@@ -1198,12 +1922,12 @@ static uint16_t _mdns_append_aaaa_record(uint8_t *packet, uint16_t *index, const
 /**
  * @brief  Append question to packet
  */
-static uint16_t _mdns_append_question(uint8_t *packet, uint16_t *index, mdns_out_question_t *q)
+static uint16_t _mdns_append_question(mdns_tx_writer_t *writer, uint16_t *index, mdns_out_question_t *q)
 {
     uint8_t part_length;
 #ifdef CONFIG_MDNS_RESPOND_REVERSE_QUERIES
     if (q->host && (strstr(q->host, "in-addr") || strstr(q->host, "ip6"))) {
-        part_length = append_fqdn_dots(packet, index, q->host, false);
+        part_length = append_fqdn_dots(writer, index, q->host, false);
         if (!part_length) {
             return 0;
         }
@@ -1224,14 +1948,14 @@ static uint16_t _mdns_append_question(uint8_t *packet, uint16_t *index, mdns_out
         if (q->domain) {
             str[str_index++] = q->domain;
         }
-        part_length = _mdns_append_fqdn(packet, index, str, str_index, MDNS_MAX_PACKET_SIZE);
+        part_length = _mdns_append_fqdn(writer, index, str, str_index, MDNS_MAX_PACKET_SIZE);
         if (!part_length) {
             return 0;
         }
     }
 
-    part_length += _mdns_append_u16(packet, index, q->type);
-    part_length += _mdns_append_u16(packet, index, q->unicast ? 0x8001 : 0x0001);
+    part_length += _mdns_append_u16(writer, index, q->type);
+    part_length += _mdns_append_u16(writer, index, q->unicast ? 0x8001 : 0x0001);
     return part_length;
 }
 
@@ -1283,23 +2007,26 @@ static bool _ipv6_address_is_zero(esp_ip6_addr_t ip6)
 }
 #endif /* CONFIG_LWIP_IPV6 */
 
-static uint8_t _mdns_append_host_answer(uint8_t *packet, uint16_t *index, mdns_host_item_t *host,
+static uint8_t _mdns_append_host_answer(mdns_tx_writer_t *writer, uint16_t *index, mdns_host_item_t *host,
                                         uint8_t address_type, bool flush, bool bye)
 {
     mdns_ip_addr_t *addr = host->address_list;
     uint8_t num_records = 0;
 
+    if (host->conflicted) {
+        return 0;
+    }
     while (addr != NULL) {
         if (addr->addr.type == address_type) {
 #ifdef CONFIG_LWIP_IPV4
             if (address_type == ESP_IPADDR_TYPE_V4 &&
-                    _mdns_append_a_record(packet, index, host->hostname, addr->addr.u_addr.ip4.addr, flush, bye) <= 0) {
+                    _mdns_append_a_record(writer, index, host->hostname, addr->addr.u_addr.ip4.addr, flush, bye) <= 0) {
                 break;
             }
 #endif /* CONFIG_LWIP_IPV4 */
 #ifdef CONFIG_LWIP_IPV6
             if (address_type == ESP_IPADDR_TYPE_V6 &&
-                    _mdns_append_aaaa_record(packet, index, host->hostname, (uint8_t *)addr->addr.u_addr.ip6.addr, flush,
+                    _mdns_append_aaaa_record(writer, index, host->hostname, (uint8_t *)addr->addr.u_addr.ip6.addr, flush,
                                              bye) <= 0) {
                 break;
             }
@@ -1315,29 +2042,29 @@ static uint8_t _mdns_append_host_answer(uint8_t *packet, uint16_t *index, mdns_h
 /**
  * @brief Appends reverse lookup PTR record
  */
-static uint8_t _mdns_append_reverse_ptr_record(uint8_t *packet, uint16_t *index, const char *name)
+static uint8_t _mdns_append_reverse_ptr_record(mdns_tx_writer_t *writer, uint16_t *index, const char *name)
 {
     if (strstr(name, "in-addr") == NULL && strstr(name, "ip6") == NULL) {
         return 0;
     }
 
-    if (!append_fqdn_dots(packet, index, name, false)) {
+    if (!append_fqdn_dots(writer, index, name, false)) {
         return 0;
     }
 
-    if (!_mdns_append_type(packet, index, MDNS_ANSWER_PTR, false, 10 /* TTL set to 10s*/)) {
+    if (!_mdns_append_type(writer, index, MDNS_ANSWER_PTR, false, 10 /* TTL set to 10s*/)) {
         return 0;
     }
 
     uint16_t data_len_location = *index - 2; /* store the position of size (2=16bis) of this record */
     const char *str[2] = { _mdns_self_host.hostname, MDNS_DEFAULT_DOMAIN };
 
-    int part_length = _mdns_append_fqdn(packet, index, str, 2, MDNS_MAX_PACKET_SIZE);
+    int part_length = _mdns_append_fqdn(writer, index, str, 2, MDNS_MAX_PACKET_SIZE);
     if (!part_length) {
         return 0;
     }
 
-    _mdns_set_u16(packet, data_len_location, part_length);
+    _mdns_set_u16(writer->packet, data_len_location, part_length);
     return 1; /* appending only 1 record */
 }
 #endif /* CONFIG_MDNS_RESPOND_REVERSE_QUERIES */
@@ -1347,22 +2074,29 @@ static uint8_t _mdns_append_reverse_ptr_record(uint8_t *packet, uint16_t *index,
  *
  *  @return number of answers added to the packet
  */
-static uint8_t _mdns_append_service_ptr_answers(uint8_t *packet, uint16_t *index, mdns_service_t *service, bool flush,
+static uint8_t _mdns_append_service_ptr_answers(mdns_tx_writer_t *writer, uint16_t *index, mdns_service_t *service, bool flush,
                                                 bool bye)
 {
     uint8_t appended_answers = 0;
+    uint16_t start = *index;
+    mdns_service_wire_t *wire = _mdns_service_wire_get(service);
+    const uint32_t *hashes = wire ? wire->instance_hashes : NULL;
 
-    if (_mdns_append_ptr_record(packet, index, _mdns_get_service_instance_name(service), service->service,
-                                service->proto, flush, bye) <= 0) {
+    if (_mdns_append_ptr_record(writer, index, _mdns_get_service_instance_name(service), service->service,
+                                service->proto, hashes, flush, bye) <= 0) {
         return appended_answers;
     }
     appended_answers++;
 
     mdns_subtype_t *subtype = service->subtype;
     while (subtype) {
-        appended_answers +=
-            (_mdns_append_subtype_ptr_record(packet, index, _mdns_get_service_instance_name(service), subtype->subtype,
-                                             service->service, service->proto, flush, bye) > 0);
+        if (_mdns_append_subtype_ptr_record(writer, index, _mdns_get_service_instance_name(service), subtype->subtype,
+                                            service->service, service->proto, hashes, flush, bye) <= 0) {
+            // the subtype PTRs go to the same datagram as the service PTR
+            *index = start;
+            return 0;
+        }
+        appended_answers++;
         subtype = subtype->next;
     }
 
@@ -1375,41 +2109,28 @@ static uint8_t _mdns_append_service_ptr_answers(uint8_t *packet, uint16_t *index
  *
  *  @return number of answers added to the packet
  */
-static uint8_t _mdns_append_answer(uint8_t *packet, uint16_t *index, mdns_out_answer_t *answer, mdns_if_t tcpip_if)
+static uint8_t _mdns_append_answer(mdns_tx_writer_t *writer, uint16_t *index, mdns_out_answer_t *answer, mdns_if_t tcpip_if)
 {
-    if (answer->host) {
-        bool is_host_valid = (&_mdns_self_host == answer->host);
-        mdns_host_item_t *target_host = _mdns_host_list;
-        while (target_host && !is_host_valid) {
-            if (target_host == answer->host) {
-                is_host_valid = true;
-            }
-            target_host = target_host->next;
-        }
-        if (!is_host_valid) {
-            return 0;
-        }
-    }
-
+    // answers of a removed host were purged with its scheduled packets, see _mdns_remove_scheduled_host_packets()
     if (answer->type == MDNS_TYPE_PTR) {
         if (answer->service) {
-            return _mdns_append_service_ptr_answers(packet, index, answer->service, answer->flush, answer->bye);
+            return _mdns_append_service_ptr_answers(writer, index, answer->service, answer->flush, answer->bye);
 #ifdef CONFIG_MDNS_RESPOND_REVERSE_QUERIES
         } else if (answer->host && answer->host->hostname &&
                    (strstr(answer->host->hostname, "in-addr") || strstr(answer->host->hostname, "ip6"))) {
-            return _mdns_append_reverse_ptr_record(packet, index, answer->host->hostname) > 0;
+            return _mdns_append_reverse_ptr_record(writer, index, answer->host->hostname) > 0;
 #endif /* CONFIG_MDNS_RESPOND_REVERSE_QUERIES */
         } else {
-            return _mdns_append_ptr_record(packet, index,
+            return _mdns_append_ptr_record(writer, index,
                                            answer->custom_instance, answer->custom_service, answer->custom_proto,
-                                           answer->flush, answer->bye) > 0;
+                                           NULL, answer->flush, answer->bye) > 0;
         }
     } else if (answer->type == MDNS_TYPE_SRV) {
-        return _mdns_append_srv_record(packet, index, answer->service, answer->flush, answer->bye) > 0;
+        return _mdns_append_srv_record(writer, index, answer->service, answer->flush, answer->bye) > 0;
     } else if (answer->type == MDNS_TYPE_TXT) {
-        return _mdns_append_txt_record(packet, index, answer->service, answer->flush, answer->bye) > 0;
+        return _mdns_append_txt_record(writer, index, answer->service, answer->flush, answer->bye) > 0;
     } else if (answer->type == MDNS_TYPE_SDPTR) {
-        return _mdns_append_sdptr_record(packet, index, answer->service, answer->flush, answer->bye) > 0;
+        return _mdns_append_sdptr_record(writer, index, answer->service, answer->flush, answer->bye) > 0;
     }
 #ifdef CONFIG_LWIP_IPV4
     else if (answer->type == MDNS_TYPE_A) {
@@ -1421,7 +2142,7 @@ static uint8_t _mdns_append_answer(uint8_t *packet, uint16_t *index, mdns_out_an
             if (esp_netif_get_ip_info(_mdns_get_esp_netif(tcpip_if), &if_ip_info)) {
                 return 0;
             }
-            if (_mdns_append_a_record(packet, index, _mdns_server->hostname, if_ip_info.ip.addr, answer->flush, answer->bye) <= 0) {
+            if (_mdns_append_a_record(writer, index, _mdns_server->hostname, if_ip_info.ip.addr, answer->flush, answer->bye) <= 0) {
                 return 0;
             }
             if (!_mdns_if_is_dup(tcpip_if)) {
@@ -1431,12 +2152,12 @@ static uint8_t _mdns_append_answer(uint8_t *packet, uint16_t *index, mdns_out_an
             if (esp_netif_get_ip_info(_mdns_get_esp_netif(other_if), &if_ip_info)) {
                 return 1;
             }
-            if (_mdns_append_a_record(packet, index, _mdns_server->hostname, if_ip_info.ip.addr, answer->flush, answer->bye) > 0) {
+            if (_mdns_append_a_record(writer, index, _mdns_server->hostname, if_ip_info.ip.addr, answer->flush, answer->bye) > 0) {
                 return 2;
             }
             return 1;
         } else if (answer->host != NULL) {
-            return _mdns_append_host_answer(packet, index, answer->host, ESP_IPADDR_TYPE_V4, answer->flush, answer->bye);
+            return _mdns_append_host_answer(writer, index, answer->host, ESP_IPADDR_TYPE_V4, answer->flush, answer->bye);
         }
     }
 #endif /* CONFIG_LWIP_IPV4 */
@@ -1454,7 +2175,7 @@ static uint8_t _mdns_append_answer(uint8_t *packet, uint16_t *index, mdns_out_an
                 if (_ipv6_address_is_zero(if_ip6s[i])) {
                     return 0;
                 }
-                if (_mdns_append_aaaa_record(packet, index, _mdns_server->hostname, (uint8_t *)if_ip6s[i].addr,
+                if (_mdns_append_aaaa_record(writer, index, _mdns_server->hostname, (uint8_t *)if_ip6s[i].addr,
                                              answer->flush, answer->bye) <= 0) {
                     return 0;
                 }
@@ -1468,13 +2189,13 @@ static uint8_t _mdns_append_answer(uint8_t *packet, uint16_t *index, mdns_out_an
             if (esp_netif_get_ip6_linklocal(_mdns_get_esp_netif(other_if), &other_ip6)) {
                 return count;
             }
-            if (_mdns_append_aaaa_record(packet, index, _mdns_server->hostname, (uint8_t *)other_ip6.addr,
+            if (_mdns_append_aaaa_record(writer, index, _mdns_server->hostname, (uint8_t *)other_ip6.addr,
                                          answer->flush, answer->bye) > 0) {
                 return 1 + count;
             }
             return count;
         } else if (answer->host != NULL) {
-            return _mdns_append_host_answer(packet, index, answer->host, ESP_IPADDR_TYPE_V6, answer->flush,
+            return _mdns_append_host_answer(writer, index, answer->host, ESP_IPADDR_TYPE_V6, answer->flush,
                                             answer->bye);
         }
     }
@@ -1483,55 +2204,48 @@ static uint8_t _mdns_append_answer(uint8_t *packet, uint16_t *index, mdns_out_an
 }
 
 /**
- * @brief  sends a packet
- *
- * @param  p       the packet
+ * @brief  starts a datagram of the packet, with its flags and id and no records
  */
-static void _mdns_dispatch_tx_packet(mdns_tx_packet_t *p)
+static void _mdns_tx_datagram_start(mdns_tx_writer_t *writer, mdns_tx_packet_t *p, uint16_t *index)
 {
-    static uint8_t packet[MDNS_MAX_PACKET_SIZE];
-    uint16_t index = MDNS_HEAD_LEN;
-    memset(packet, 0, MDNS_HEAD_LEN);
-    mdns_out_question_t *q;
-    mdns_out_answer_t *a;
-    uint8_t count;
-
-    _mdns_set_u16(packet, MDNS_HEAD_FLAGS_OFFSET, p->flags);
-    _mdns_set_u16(packet, MDNS_HEAD_ID_OFFSET, p->id);
-
-    count = 0;
-    q = p->questions;
-    while (q) {
-        if (_mdns_append_question(packet, &index, q)) {
-            count++;
-        }
-        q = q->next;
-    }
-    _mdns_set_u16(packet, MDNS_HEAD_QUESTIONS_OFFSET, count);
+    memset(writer->packet, 0, MDNS_HEAD_LEN);
+    _mdns_name_dict_reset(writer);
+    _mdns_set_u16(writer->packet, MDNS_HEAD_FLAGS_OFFSET, p->flags);
+    _mdns_set_u16(writer->packet, MDNS_HEAD_ID_OFFSET, p->id);
+    *index = MDNS_HEAD_LEN;
+}
 
-    count = 0;
-    a = p->answers;
-    while (a) {
-        count += _mdns_append_answer(packet, &index, a, p->tcpip_if);
-        a = a->next;
+/**
+ * @brief  writes a datagram to the PCB, counting it in the PCB traffic
+ */
+static void _mdns_pcb_write(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, const esp_ip_addr_t *dst, uint16_t port, uint8_t *data, uint16_t len)
+{
+    if (_mdns_udp_pcb_write(tcpip_if, ip_protocol, dst, port, data, len)) {
+        mdns_traffic_stats_t *traffic = &_mdns_server->interfaces[tcpip_if].pcbs[ip_protocol].traffic;
+        traffic->tx_packets++;
+        traffic->tx_bytes += len;
     }
-    _mdns_set_u16(packet, MDNS_HEAD_ANSWERS_OFFSET, count);
+}
 
-    count = 0;
-    a = p->servers;
-    while (a) {
-        count += _mdns_append_answer(packet, &index, a, p->tcpip_if);
-        a = a->next;
+/**
+ * @brief  sends a datagram of the packet
+ *
+ * @param  counts       number of records in the answer, authority and additional sections
+ * @param  truncated    set the TC bit, the known answers of the query continue in the next datagram
+ */
+static void _mdns_tx_datagram_send(uint8_t *packet, mdns_tx_packet_t *p, uint16_t len, const uint16_t counts[], bool truncated)
+{
+    if (truncated) {
+        _mdns_set_u16(packet, MDNS_HEAD_FLAGS_OFFSET, p->flags | MDNS_FLAGS_DISTRIBUTED);
     }
-    _mdns_set_u16(packet, MDNS_HEAD_SERVERS_OFFSET, count);
-
-    count = 0;
-    a = p->additional;
-    while (a) {
-        count += _mdns_append_answer(packet, &index, a, p->tcpip_if);
-        a = a->next;
+    _mdns_set_u16(packet, MDNS_HEAD_ANSWERS_OFFSET, counts[0]);
+    _mdns_set_u16(packet, MDNS_HEAD_SERVERS_OFFSET, counts[1]);
+    _mdns_set_u16(packet, MDNS_HEAD_ADDITIONAL_OFFSET, counts[2]);
+    if (!(p->flags & MDNS_FLAGS_QUERY_REPSONSE)) {
+        _mdns_server->stats.known_answers_sent += counts[0];
+    } else {
+        _mdns_server->stats.answers_built += counts[0] + counts[1] + counts[2];
     }
-    _mdns_set_u16(packet, MDNS_HEAD_ADDITIONAL_OFFSET, count);
 
 #ifdef MDNS_ENABLE_DEBUG
     _mdns_dbg_printf("\nTX[%lu][%lu]: ", (unsigned long)p->tcpip_if, (unsigned long)p->ip_protocol);
@@ -1545,157 +2259,674 @@ static void _mdns_dispatch_tx_packet(mdns_tx_packet_t *p)
         _mdns_dbg_printf("To: " IPV6STR ":%u, ", IPV62STR(p->dst.u_addr.ip6), p->port);
     }
 #endif
-    mdns_debug_packet(packet, index);
+    mdns_debug_packet(packet, len);
 #endif
 
-    _mdns_udp_pcb_write(p->tcpip_if, p->ip_protocol, &p->dst, p->port, packet, index);
+    _mdns_pcb_write(p->tcpip_if, p->ip_protocol, &p->dst, p->port, packet, len);
 }
 
 /**
- * @brief  frees a packet
- *
- * @param  packet       the packet
+ * @brief  Checks if the packet is sent to the mDNS multicast group
  */
-static void _mdns_free_tx_packet(mdns_tx_packet_t *packet)
+static bool _mdns_tx_packet_is_multicast(const mdns_tx_packet_t *p)
 {
-    if (!packet) {
-        return;
+    if (p->port != MDNS_SERVICE_PORT) {
+        return false;
     }
-    mdns_out_question_t *q = packet->questions;
-    while (q) {
-        mdns_out_question_t *next = q->next;
-        if (q->own_dynamic_memory) {
-            mdns_mem_free((char *)q->host);
-            mdns_mem_free((char *)q->service);
-            mdns_mem_free((char *)q->proto);
-            mdns_mem_free((char *)q->domain);
-        }
-        mdns_mem_free(q);
-        q = next;
+#ifdef CONFIG_LWIP_IPV4
+    if (p->ip_protocol == MDNS_IP_PROTOCOL_V4) {
+        esp_ip_addr_t group = ESP_IP4ADDR_INIT(224, 0, 0, 251);
+        return p->dst.type == ESP_IPADDR_TYPE_V4 && p->dst.u_addr.ip4.addr == group.u_addr.ip4.addr;
     }
-    queueFree(mdns_out_answer_t, packet->answers);
-    queueFree(mdns_out_answer_t, packet->servers);
-    queueFree(mdns_out_answer_t, packet->additional);
-    mdns_mem_free(packet);
+#endif
+#ifdef CONFIG_LWIP_IPV6
+    if (p->ip_protocol == MDNS_IP_PROTOCOL_V6) {
+        esp_ip_addr_t group = ESP_IP6ADDR_INIT(0x000002ff, 0, 0, 0xfb000000);
+        return p->dst.type == ESP_IPADDR_TYPE_V6 && !memcmp(p->dst.u_addr.ip6.addr, group.u_addr.ip6.addr, 16);
+    }
+#endif
+    return false;
 }
 
 /**
- * @brief  schedules a packet to be sent after given milliseconds
- *
- * @param  packet       the packet
- * @param  ms_after     number of milliseconds after which the packet should be dispatched
+ * @brief  Returns the owner of the record the answer stands for, NULL for records of other responders
  */
-static void _mdns_schedule_tx_packet(mdns_tx_packet_t *packet, uint32_t ms_after)
+static const void *_mdns_answer_owner(const mdns_out_answer_t *a)
 {
-    if (!packet) {
-        return;
-    }
-    packet->send_at = (xTaskGetTickCount() * portTICK_PERIOD_MS) + ms_after;
-    packet->next = NULL;
-    if (!_mdns_server->tx_queue_head || _mdns_server->tx_queue_head->send_at > packet->send_at) {
-        packet->next = _mdns_server->tx_queue_head;
-        _mdns_server->tx_queue_head = packet;
-        return;
-    }
-    mdns_tx_packet_t *q = _mdns_server->tx_queue_head;
-    while (q->next && q->next->send_at <= packet->send_at) {
-        q = q->next;
+    if (a->custom_instance) {
+        return NULL;
     }
-    packet->next = q->next;
-    q->next = packet;
+    return a->service ? (const void *)a->service : (const void *)a->host;
 }
 
-/**
- * @brief  free all packets scheduled for sending
- */
-static void _mdns_clear_tx_queue_head(void)
+static mdns_multicast_stamp_t *_mdns_multicast_stamp_find(mdns_pcb_t *pcb, const void *owner, uint16_t type)
 {
-    mdns_tx_packet_t *q;
-    while (_mdns_server->tx_queue_head) {
-        q = _mdns_server->tx_queue_head;
-        _mdns_server->tx_queue_head = _mdns_server->tx_queue_head->next;
-        _mdns_free_tx_packet(q);
+    for (size_t i = 0; i < MDNS_MULTICAST_STAMPS; i++) {
+        if (pcb->multicast_stamps[i].owner == owner && pcb->multicast_stamps[i].type == type) {
+            return &pcb->multicast_stamps[i];
+        }
     }
+    return NULL;
 }
 
 /**
- * @brief  clear packets scheduled for sending on a specific interface
- *
- * @param  tcpip_if     the interface
- * @param  ip_protocol     pcb type V4/V6
+ * @brief  Remembers the answers of the packet as multicast now, the stamp multicast least recently is reused
  */
-static void _mdns_clear_pcb_tx_queue_head(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
-{
-    mdns_tx_packet_t *q, * p;
-    while (_mdns_server->tx_queue_head && _mdns_server->tx_queue_head->tcpip_if == tcpip_if && _mdns_server->tx_queue_head->ip_protocol == ip_protocol) {
-        q = _mdns_server->tx_queue_head;
-        _mdns_server->tx_queue_head = _mdns_server->tx_queue_head->next;
-        _mdns_free_tx_packet(q);
-    }
-    if (_mdns_server->tx_queue_head) {
-        q = _mdns_server->tx_queue_head;
-        while (q->next) {
-            if (q->next->tcpip_if == tcpip_if && q->next->ip_protocol == ip_protocol) {
-                p = q->next;
-                q->next = p->next;
-                _mdns_free_tx_packet(p);
-            } else {
-                q = q->next;
+static void _mdns_multicast_stamp_answers(mdns_tx_packet_t *p, uint32_t now)
+{
+    mdns_pcb_t *pcb = &_mdns_server->interfaces[p->tcpip_if].pcbs[p->ip_protocol];
+    for (mdns_out_answer_t *a = p->answers; a; a = a->next) {
+        const void *owner = _mdns_answer_owner(a);
+        if (!owner || a->bye) {
+            continue;
+        }
+        mdns_multicast_stamp_t *stamp = _mdns_multicast_stamp_find(pcb, owner, a->type);
+        for (size_t i = 0; !stamp && i < MDNS_MULTICAST_STAMPS; i++) {
+            mdns_multicast_stamp_t *s = &pcb->multicast_stamps[i];
+            if (!s->owner) {
+                stamp = s;
             }
         }
+        if (!stamp) {
+            stamp = &pcb->multicast_stamps[0];
+            for (size_t i = 1; i < MDNS_MULTICAST_STAMPS; i++) {
+                if ((int32_t)(pcb->multicast_stamps[i].sent_at - stamp->sent_at) < 0) {
+                    stamp = &pcb->multicast_stamps[i];
+                }
+            }
+        }
+        stamp->owner = owner;
+        stamp->type = a->type;
+        stamp->sent_at = now;
     }
 }
 
 /**
- * @brief  get the next packet scheduled for sending on a specific interface
+ * @brief  Forgets the records of a service or host being freed
+ */
+static void _mdns_multicast_stamps_forget(const void *owner)
+{
+    for (size_t i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (size_t j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            mdns_pcb_t *pcb = &_mdns_server->interfaces[i].pcbs[j];
+            for (size_t k = 0; k < MDNS_MULTICAST_STAMPS; k++) {
+                if (pcb->multicast_stamps[k].owner == owner) {
+                    pcb->multicast_stamps[k].owner = NULL;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief  Removes the answers of a response to a query which were multicast on the PCB less than
+ *         a second ago (a quarter of a second for a response to a probe), RFC 6762, 6
  *
- * @param  tcpip_if     the interface
- * @param  ip_protocol     pcb type V4/V6
+ * @return false if no answer is left
  */
-static mdns_tx_packet_t *_mdns_get_next_pcb_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+static bool _mdns_multicast_rate_limit(mdns_tx_packet_t *p, uint32_t now)
 {
-    mdns_tx_packet_t *q = _mdns_server->tx_queue_head;
-    while (q) {
-        if (q->tcpip_if == tcpip_if && q->ip_protocol == ip_protocol) {
-            return q;
+    mdns_pcb_t *pcb = &_mdns_server->interfaces[p->tcpip_if].pcbs[p->ip_protocol];
+    uint32_t interval = p->probe_defense ? MDNS_PROBE_DEFENSE_INTERVAL : _mdns_server->multicast_interval;
+    mdns_out_answer_t **link = &p->answers;
+
+    if (!_mdns_server->multicast_interval) {
+        return true;
+    }
+    while (*link) {
+        mdns_out_answer_t *a = *link;
+        const void *owner = _mdns_answer_owner(a);
+        mdns_multicast_stamp_t *stamp = owner && !a->bye ? _mdns_multicast_stamp_find(pcb, owner, a->type) : NULL;
+        if (stamp && now - stamp->sent_at < interval) {
+            *link = a->next;
+            mdns_mem_free(a);
+            _mdns_server->stats.answers_rate_limited++;
+        } else {
+            link = &a->next;
         }
-        q = q->next;
     }
-    return NULL;
+    return p->answers != NULL;
 }
 
 /**
- * @brief  Find, remove and free answer from the scheduled packets
+ * @brief  sends a packet
+ *
+ * Records which do not fit MDNS_MAX_PACKET_SIZE continue in further datagrams without the questions.
+ * The answers are written first, the authority and additional records follow them. Query datagrams
+ * followed by another one carry the TC bit (RFC 6762, 7.2), responses are simply sent as several
+ * datagrams (RFC 6762, 6).
+ *
+ * @param  p       the packet
  */
-static void _mdns_remove_scheduled_answer(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint16_t type, mdns_srv_item_t *service)
+static void _mdns_dispatch_tx_packet(mdns_tx_packet_t *p)
 {
-    mdns_srv_item_t s = {NULL, NULL};
-    if (!service) {
-        service = &s;
+    mdns_tx_writer_t *writer = &_mdns_server->tx.writer;
+    bool multicast = (p->flags & MDNS_FLAGS_QUERY_REPSONSE) && _mdns_tx_packet_is_multicast(p);
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    if (multicast && p->suppressible && !_mdns_multicast_rate_limit(p, now)) {
+        return;
     }
-    mdns_tx_packet_t *q = _mdns_server->tx_queue_head;
+    int64_t started = esp_timer_get_time();
+    mdns_out_answer_t *sections[] = { p->answers, p->servers, p->additional };
+    uint16_t counts[3] = { 0, 0, 0 };
+    uint16_t index;
+    uint16_t first_record;
+    mdns_out_question_t *q;
+    mdns_out_answer_t *a;
+    uint16_t count;
+    bool query = !(p->flags & MDNS_FLAGS_QUERY_REPSONSE);
+    size_t s;
+
+    _mdns_tx_datagram_start(writer, p, &index);
+    count = 0;
+    q = p->questions;
     while (q) {
-        if (q->tcpip_if == tcpip_if && q->ip_protocol == ip_protocol && q->distributed) {
-            mdns_out_answer_t *a = q->answers;
-            if (a) {
-                if (a->type == type && a->service == service->service) {
-                    q->answers = q->answers->next;
-                    mdns_mem_free(a);
+        if (_mdns_append_question(writer, &index, q)) {
+            count++;
+        }
+        q = q->next;
+    }
+    _mdns_set_u16(writer->packet, MDNS_HEAD_QUESTIONS_OFFSET, count);
+    first_record = index;
+
+    for (s = 0; s < ARRAY_SIZE(sections); s++) {
+        a = sections[s];
+        while (a) {
+            uint16_t start = index;
+            writer->full = false;
+            uint8_t appended = _mdns_append_answer(writer, &index, a, p->tcpip_if);
+            if (appended) {
+                counts[s] += appended;
+                a = a->next;
+                continue;
+            }
+            // drop what was written of the record, it is sent whole or not at all
+            index = start;
+            if (writer->full && start > first_record) {
+                _mdns_tx_datagram_send(writer->packet, p, start, counts, query);
+                if (query) {
+                    _mdns_server->stats.truncated_queries_sent++;
                 } else {
-                    while (a->next) {
-                        if (a->next->type == type && a->next->service == service->service) {
-                            mdns_out_answer_t *b = a->next;
-                            a->next = b->next;
-                            mdns_mem_free(b);
-                            break;
-                        }
-                        a = a->next;
-                    }
+                    _mdns_server->stats.responses_split++;
                 }
+                memset(counts, 0, sizeof(counts));
+                _mdns_tx_datagram_start(writer, p, &index);
+                first_record = index;
+                continue;
             }
+            if (writer->full) {
+                _mdns_server->stats.records_dropped++;
+            }
+            a = a->next;
+        }
+    }
+    _mdns_tx_datagram_send(writer->packet, p, index, counts, false);
+    if (multicast) {
+        _mdns_multicast_stamp_answers(p, now);
+    }
+    _mdns_server->stats.dispatch_time_us += esp_timer_get_time() - started;
+}
+
+/**
+ * @brief  owner the scheduled answer is suppressed by, the host of address records, otherwise the service
+ */
+static inline const void *_mdns_tx_answer_owner(uint16_t type, const mdns_service_t *service, const mdns_host_item_t *host)
+{
+    return (type == MDNS_TYPE_A || type == MDNS_TYPE_AAAA) ? (const void *)host : (const void *)service;
+}
+
+static inline mdns_out_answer_t **_mdns_tx_answer_bucket(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint16_t type, const void *owner)
+{
+    uint32_t hash = ((uint32_t)(uintptr_t)owner >> 3) ^ ((uint32_t)type << 16) ^ ((uint32_t)tcpip_if << 2) ^ (uint32_t)ip_protocol;
+    hash *= 2654435761u;
+    return &_mdns_server->tx.answers[(hash ^ (hash >> 16)) & (MDNS_TX_ANSWER_BUCKETS - 1)];
+}
+
+static void _mdns_tx_unindex_answer(mdns_out_answer_t *a)
+{
+    if (!a->index_link) {
+        return;
+    }
+    *a->index_link = a->index_next;
+    if (a->index_next) {
+        a->index_next->index_link = a->index_link;
+    }
+    a->index_next = NULL;
+    a->index_link = NULL;
+}
+
+/**
+ * @brief  indexes the answers of a scheduled response by (PCB, type, owner), goodbyes are never suppressed
+ */
+static void _mdns_tx_index_answers(mdns_tx_packet_t *packet)
+{
+    for (mdns_out_answer_t *a = packet->answers; a; a = a->next) {
+        if (a->bye || a->index_link) {
+            continue;
+        }
+        mdns_out_answer_t **bucket = _mdns_tx_answer_bucket(packet->tcpip_if, packet->ip_protocol, a->type,
+                                                            _mdns_tx_answer_owner(a->type, a->service, a->host));
+        a->packet = packet;
+        a->index_next = *bucket;
+        if (*bucket) {
+            (*bucket)->index_link = &a->index_next;
+        }
+        a->index_link = bucket;
+        *bucket = a;
+    }
+}
+
+static void _mdns_tx_unindex_answers(mdns_tx_packet_t *packet)
+{
+    for (mdns_out_answer_t *a = packet->answers; a; a = a->next) {
+        _mdns_tx_unindex_answer(a);
+    }
+}
+
+/**
+ * @brief  frees a packet
+ *
+ * @param  packet       the packet
+ */
+static void _mdns_free_tx_packet(mdns_tx_packet_t *packet)
+{
+    if (!packet) {
+        return;
+    }
+    mdns_out_question_t *q = packet->questions;
+    while (q) {
+        mdns_out_question_t *next = q->next;
+        if (q->own_dynamic_memory) {
+            mdns_mem_free((char *)q->host);
+            mdns_mem_free((char *)q->service);
+            mdns_mem_free((char *)q->proto);
+            mdns_mem_free((char *)q->domain);
+        }
+        mdns_mem_free(q);
+        q = next;
+    }
+    _mdns_tx_unindex_answers(packet);
+    queueFree(mdns_out_answer_t, packet->answers);
+    queueFree(mdns_out_answer_t, packet->servers);
+    queueFree(mdns_out_answer_t, packet->additional);
+    while (packet->bye_hosts) {
+        mdns_host_item_t *host = packet->bye_hosts;
+        packet->bye_hosts = host->next;
+        free_address_list(host->address_list);
+        mdns_mem_free((char *)host->hostname);
+        mdns_mem_free(host);
+    }
+    mdns_mem_free(packet);
+}
+
+/**
+ * @brief  compares scheduling order (earlier send_at first, FIFO on ties)
+ */
+static inline bool _mdns_tx_order_before(uint32_t send_at_a, uint32_t seq_a, uint32_t send_at_b, uint32_t seq_b)
+{
+    int32_t diff = (int32_t)(send_at_a - send_at_b);
+    if (diff != 0) {
+        return diff < 0;
+    }
+    return (int32_t)(seq_a - seq_b) < 0;
+}
+
+static inline bool _mdns_tx_entry_before(const mdns_tx_heap_entry_t *a, const mdns_tx_heap_entry_t *b)
+{
+    return _mdns_tx_order_before(a->send_at, a->seq, b->send_at, b->seq);
+}
+
+static inline uint16_t *_mdns_tx_heap_slot(mdns_tx_heap_t *heap, mdns_tx_packet_t *packet)
+{
+    return heap == &_mdns_server->tx.heap ? &packet->heap_index : &packet->pcb_heap_index;
+}
+
+static inline void _mdns_tx_heap_set(mdns_tx_heap_t *heap, uint16_t index, const mdns_tx_heap_entry_t *entry)
+{
+    heap->entries[index] = *entry;
+    *_mdns_tx_heap_slot(heap, entry->packet) = index;
+}
+
+static void _mdns_tx_heap_sift_up(mdns_tx_heap_t *heap, uint16_t index)
+{
+    mdns_tx_heap_entry_t entry = heap->entries[index];
+    while (index) {
+        uint16_t parent = (index - 1) / 2;
+        if (!_mdns_tx_entry_before(&entry, &heap->entries[parent])) {
+            break;
+        }
+        _mdns_tx_heap_set(heap, index, &heap->entries[parent]);
+        index = parent;
+    }
+    _mdns_tx_heap_set(heap, index, &entry);
+}
+
+static void _mdns_tx_heap_sift_down(mdns_tx_heap_t *heap, uint16_t index)
+{
+    mdns_tx_heap_entry_t entry = heap->entries[index];
+    mdns_tx_heap_entry_t *entries = heap->entries;
+    uint16_t len = heap->len;
+    for (;;) {
+        uint32_t child = 2 * (uint32_t)index + 1;
+        if (child >= len) {
+            break;
         }
+        if (child + 1 < len && _mdns_tx_entry_before(&entries[child + 1], &entries[child])) {
+            child++;
+        }
+        if (!_mdns_tx_entry_before(&entries[child], &entry)) {
+            break;
+        }
+        _mdns_tx_heap_set(heap, index, &entries[child]);
+        index = child;
+    }
+    _mdns_tx_heap_set(heap, index, &entry);
+}
+
+/**
+ * @brief  makes room for one more packet in the TX heap
+ */
+static bool _mdns_tx_heap_reserve(mdns_tx_heap_t *heap)
+{
+    if (heap->len < heap->size) {
+        return true;
+    }
+    uint32_t size = heap->size ? 2 * (uint32_t)heap->size : MDNS_TX_HEAP_INITIAL_SIZE;
+    if (size >= MDNS_TX_HEAP_NONE) {
+        size = MDNS_TX_HEAP_NONE - 1;
+        if (size <= heap->size) {
+            return false;
+        }
+    }
+    mdns_tx_heap_entry_t *entries = (mdns_tx_heap_entry_t *)mdns_mem_malloc(size * sizeof(mdns_tx_heap_entry_t));
+    if (!entries) {
+        HOOK_MALLOC_FAILED;
+        return false;
+    }
+    if (heap->len) {
+        memcpy(entries, heap->entries, heap->len * sizeof(mdns_tx_heap_entry_t));
+    }
+    mdns_mem_free(heap->entries);
+    heap->entries = entries;
+    heap->size = size;
+    return true;
+}
+
+static void _mdns_tx_heap_push(mdns_tx_heap_t *heap, mdns_tx_packet_t *packet)
+{
+    mdns_tx_heap_entry_t *entry = &heap->entries[heap->len];
+    entry->send_at = packet->send_at;
+    entry->seq = packet->seq;
+    entry->packet = packet;
+    _mdns_tx_heap_sift_up(heap, heap->len++);
+}
+
+/**
+ * @brief  removes packet from the TX heap in O(log n)
+ */
+static void _mdns_tx_heap_remove(mdns_tx_heap_t *heap, mdns_tx_packet_t *packet)
+{
+    uint16_t *slot = _mdns_tx_heap_slot(heap, packet);
+    uint16_t index = *slot;
+    if (index == MDNS_TX_HEAP_NONE) {
+        return;
+    }
+    *slot = MDNS_TX_HEAP_NONE;
+    uint16_t last = --heap->len;
+    if (index == last) {
+        return;
+    }
+    _mdns_tx_heap_set(heap, index, &heap->entries[last]);
+    if (index && _mdns_tx_entry_before(&heap->entries[index], &heap->entries[(index - 1) / 2])) {
+        _mdns_tx_heap_sift_up(heap, index);
+    } else {
+        _mdns_tx_heap_sift_down(heap, index);
+    }
+}
+
+/**
+ * @brief  detaches packet from the ready list (packets already pushed to the action queue)
+ */
+static void _mdns_tx_ready_remove(mdns_tx_packet_t *packet)
+{
+    mdns_tx_packet_t *prev = NULL;
+    mdns_tx_packet_t *q = _mdns_server->tx.ready_head;
+    while (q && q != packet) {
+        prev = q;
         q = q->next;
     }
+    if (!q) {
+        return;
+    }
+    if (prev) {
+        prev->next = q->next;
+    } else {
+        _mdns_server->tx.ready_head = q->next;
+    }
+    if (_mdns_server->tx.ready_tail == q) {
+        _mdns_server->tx.ready_tail = prev;
+    }
+    q->next = NULL;
+    q->queued = false;
+}
+
+/**
+ * @brief  detaches packet from all scheduler structures, packet is not freed
+ */
+static void _mdns_tx_queue_remove(mdns_tx_packet_t *packet)
+{
+    mdns_pcb_t *pcb = &_mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol];
+    if (packet->queued) {
+        _mdns_tx_ready_remove(packet);
+    } else {
+        _mdns_tx_heap_remove(&_mdns_server->tx.heap, packet);
+    }
+    _mdns_tx_heap_remove(&pcb->tx_heap, packet);
+    if (packet->suppressible) {
+        _mdns_tx_unindex_answers(packet);
+    }
+    if (packet->pcb_prev) {
+        packet->pcb_prev->pcb_next = packet->pcb_next;
+    } else if (pcb->tx_packets == packet) {
+        pcb->tx_packets = packet->pcb_next;
+    }
+    if (packet->pcb_next) {
+        packet->pcb_next->pcb_prev = packet->pcb_prev;
+    }
+    packet->pcb_next = NULL;
+    packet->pcb_prev = NULL;
+}
+
+/**
+ * @brief  schedules a packet to be sent after given milliseconds
+ *
+ * Packets wait in a min-heap ordered by send time and are linked into a per-PCB list, packets other than
+ * batches of delegated hosts also into a per-PCB heap, and the answers of responses into the answer index,
+ * so that neither scheduling nor per-interface lookups nor suppression need to walk the packets.
+ *
+ * @param  packet       the packet
+ * @param  ms_after     number of milliseconds after which the packet should be dispatched
+ */
+static void _mdns_schedule_tx_packet(mdns_tx_packet_t *packet, uint32_t ms_after)
+{
+    if (!packet) {
+        return;
+    }
+    mdns_pcb_t *pcb = &_mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol];
+    if (!_mdns_tx_heap_reserve(&_mdns_server->tx.heap)
+            || (packet->host_state == PCB_OFF && !_mdns_tx_heap_reserve(&pcb->tx_heap))) {
+        _mdns_free_tx_packet(packet);
+        return;
+    }
+    packet->send_at = (xTaskGetTickCount() * portTICK_PERIOD_MS) + ms_after;
+    packet->seq = _mdns_server->tx.seq++;
+    packet->next = NULL;
+    packet->queued = false;
+    packet->pcb_prev = NULL;
+    packet->pcb_next = pcb->tx_packets;
+    if (pcb->tx_packets) {
+        pcb->tx_packets->pcb_prev = packet;
+    }
+    pcb->tx_packets = packet;
+    _mdns_tx_heap_push(&_mdns_server->tx.heap, packet);
+    packet->pcb_heap_index = MDNS_TX_HEAP_NONE;
+    if (packet->host_state == PCB_OFF) {
+        _mdns_tx_heap_push(&pcb->tx_heap, packet);
+    }
+    if (packet->suppressible) {
+        _mdns_tx_index_answers(packet);
+    }
+    if (_mdns_server->tx.heap.len > _mdns_server->stats.tx_queue_max) {
+        _mdns_server->stats.tx_queue_max = _mdns_server->tx.heap.len;
+    }
+    _mdns_timer_arm(packet->send_at);
+}
+
+/**
+ * @brief  free all packets scheduled for sending
+ */
+static void _mdns_clear_tx_queue_head(void)
+{
+    uint8_t i, j;
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            mdns_pcb_t *pcb = &_mdns_server->interfaces[i].pcbs[j];
+            while (pcb->tx_packets) {
+                mdns_tx_packet_t *q = pcb->tx_packets;
+                pcb->tx_packets = q->pcb_next;
+                _mdns_free_tx_packet(q);
+            }
+            pcb->tx_heap.len = 0;
+        }
+    }
+    _mdns_server->tx.heap.len = 0;
+    memset(_mdns_server->tx.answers, 0, sizeof(_mdns_server->tx.answers));
+    _mdns_server->tx.ready_head = NULL;
+    _mdns_server->tx.ready_tail = NULL;
+}
+
+/**
+ * @brief  clear packets scheduled for sending on a specific interface
+ *
+ * @param  tcpip_if     the interface
+ * @param  ip_protocol     pcb type V4/V6
+ * @param  keep_host_batches   keep the probes and announcements of delegated hosts, which do not depend on the PCB state
+ */
+static void _mdns_clear_pcb_tx_queue_head(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, bool keep_host_batches)
+{
+    mdns_tx_packet_t *q = _mdns_server->interfaces[tcpip_if].pcbs[ip_protocol].tx_packets;
+    while (q) {
+        mdns_tx_packet_t *next = q->pcb_next;
+        if (!keep_host_batches || q->host_state == PCB_OFF) {
+            _mdns_tx_queue_remove(q);
+            _mdns_free_tx_packet(q);
+        }
+        q = next;
+    }
+}
+
+/**
+ * @brief  get the next packet scheduled for sending on a specific interface, batches of delegated hosts excluded
+ *
+ * @param  tcpip_if     the interface
+ * @param  ip_protocol     pcb type V4/V6
+ */
+static mdns_tx_packet_t *_mdns_get_next_pcb_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    mdns_tx_heap_t *heap = &_mdns_server->interfaces[tcpip_if].pcbs[ip_protocol].tx_heap;
+    return heap->len ? heap->entries[0].packet : NULL;
+}
+
+/**
+ * @brief  TTL our records of the type are sent with
+ */
+static uint32_t _mdns_answer_ttl(uint16_t type)
+{
+    switch (type) {
+    case MDNS_TYPE_PTR:
+    case MDNS_TYPE_SDPTR:
+        return MDNS_ANSWER_PTR_TTL;
+    case MDNS_TYPE_TXT:
+        return MDNS_ANSWER_TXT_TTL;
+    case MDNS_TYPE_SRV:
+        return MDNS_ANSWER_SRV_TTL;
+    case MDNS_TYPE_AAAA:
+        return MDNS_ANSWER_AAAA_TTL;
+    default:
+        return MDNS_ANSWER_A_TTL;
+    }
+}
+
+/**
+ * @brief  Checks that a copy of our record seen on the network still holds at least half of its TTL,
+ *         only then it suppresses our answer (RFC 6762, 7.1 and 7.4)
+ */
+static inline bool _mdns_answer_ttl_fresh(uint16_t type, uint32_t ttl)
+{
+    return ttl >= _mdns_answer_ttl(type) / 2;
+}
+
+/**
+ * @brief  Remove and free the indexed answers of the type and owner, responses left without answers are dropped
+ *
+ * @return number of answers removed
+ */
+static uint32_t _mdns_remove_indexed_answers(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint16_t type, const void *owner,
+                                         const mdns_parsed_packet_t *continuation)
+{
+    uint32_t removed = 0;
+    mdns_out_answer_t *a = *_mdns_tx_answer_bucket(tcpip_if, ip_protocol, type, owner);
+    while (a) {
+        mdns_out_answer_t *next = a->index_next;
+        mdns_tx_packet_t *q = a->packet;
+        if (a->type == type && _mdns_tx_answer_owner(type, a->service, a->host) == owner
+                && q->tcpip_if == tcpip_if && q->ip_protocol == ip_protocol
+                && (!continuation || (q->distributed && q->querier_port == continuation->src_port
+                                      && _mdns_ip_addr_equal(&q->querier, &continuation->src)))) {
+            mdns_out_answer_t **link = &q->answers;
+            while (*link != a) {
+                link = &(*link)->next;
+            }
+            *link = a->next;
+            _mdns_tx_unindex_answer(a);
+            mdns_mem_free(a);
+            removed++;
+            if (!q->answers) {
+                _mdns_tx_queue_remove(q);
+                _mdns_free_tx_packet(q);
+            }
+        }
+        a = next;
+    }
+    return removed;
+}
+
+/**
+ * @brief  Find, remove and free answer from the responses scheduled on the PCB
+ *
+ * Used for the known answers which follow a query with the TC bit (RFC 6762, 7.2) and for the answers
+ * another responder has just sent (RFC 6762, 7.4). Announcements are never affected, a response left
+ * without answers is dropped. Answers of responses are indexed by (PCB, type, owner) when scheduled,
+ * so only answers sharing the bucket are visited.
+ *
+ * @param  service            service of the answer, NULL for host records
+ * @param  host               host of the address answer
+ * @param  continuation       the packet continuing the known answers of a query with the TC bit, only the
+ *                            responses to that query's sender are affected; NULL for all responses
+ *
+ * @return number of answers removed
+ */
+static uint32_t _mdns_remove_scheduled_answer(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint16_t type, mdns_srv_item_t *service,
+                                              mdns_host_item_t *host, const mdns_parsed_packet_t *continuation)
+{
+    mdns_service_t *srv = service ? service->service : NULL;
+    uint32_t removed = _mdns_remove_indexed_answers(tcpip_if, ip_protocol, type, _mdns_tx_answer_owner(type, srv, host), continuation);
+    if (type == MDNS_TYPE_PTR) {
+        // SRV and TXT of the instance were added to complete its PTR answer
+        _mdns_remove_indexed_answers(tcpip_if, ip_protocol, MDNS_TYPE_SRV, srv, continuation);
+        _mdns_remove_indexed_answers(tcpip_if, ip_protocol, MDNS_TYPE_TXT, srv, continuation);
+    }
+    return removed;
 }
 
 /**
@@ -1741,7 +2972,7 @@ static bool _mdns_alloc_answer(mdns_out_answer_t **destination, uint16_t type, m
         d = d->next;
     }
 
-    mdns_out_answer_t *a = (mdns_out_answer_t *)mdns_mem_malloc(sizeof(mdns_out_answer_t));
+    mdns_out_answer_t *a = (mdns_out_answer_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ANSWER, sizeof(mdns_out_answer_t));
     if (!a) {
         HOOK_MALLOC_FAILED;
         return false;
@@ -1749,10 +2980,15 @@ static bool _mdns_alloc_answer(mdns_out_answer_t **destination, uint16_t type, m
     a->type = type;
     a->service = service;
     a->host = host;
+    a->custom_instance = NULL;
     a->custom_service = NULL;
+    a->custom_proto = NULL;
     a->bye = bye;
     a->flush = flush;
     a->next = NULL;
+    a->index_next = NULL;
+    a->index_link = NULL;
+    a->packet = NULL;
     queueToEnd(mdns_out_answer_t, *destination, a);
     return true;
 }
@@ -1762,7 +2998,7 @@ static bool _mdns_alloc_answer(mdns_out_answer_t **destination, uint16_t type, m
  */
 static mdns_tx_packet_t *_mdns_alloc_packet_default(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
 {
-    mdns_tx_packet_t *packet = (mdns_tx_packet_t *)mdns_mem_malloc(sizeof(mdns_tx_packet_t));
+    mdns_tx_packet_t *packet = (mdns_tx_packet_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_TX_PACKET, sizeof(mdns_tx_packet_t));
     if (!packet) {
         HOOK_MALLOC_FAILED;
         return NULL;
@@ -1873,6 +3109,11 @@ static void _mdns_create_answer_from_parsed_packet(mdns_parsed_packet_t *parsed_
     }
     packet->flags = MDNS_FLAGS_QR_AUTHORITATIVE;
     packet->distributed = parsed_packet->distributed;
+    if (packet->distributed) {
+        memcpy(&packet->querier, &parsed_packet->src, sizeof(esp_ip_addr_t));
+        packet->querier_port = parsed_packet->src_port;
+    }
+    packet->suppressible = true;
     packet->id = parsed_packet->id;
 
     mdns_parsed_question_t *q = parsed_packet->questions;
@@ -1892,26 +3133,25 @@ static void _mdns_create_answer_from_parsed_packet(mdns_parsed_packet_t *parsed_
                 out_record_nums++;
             }
         } else if (q->service && q->proto) {
-            mdns_srv_item_t *service = _mdns_server->services;
+            // only the services of the questioned type can match, in the order of the services list
+            mdns_service_key_t key = { NULL, q->service, q->proto };
+            mdns_srv_item_t *service = _mdns_service_index_find(false, &key);
             while (service) {
                 if (_mdns_service_match_ptr_question(service->service, q)) {
+                    // the querier lists the instances it knows (RFC 6762, 7.1)
                     mdns_parsed_record_t *r = parsed_packet->records;
                     bool is_record_exist = false;
                     while (r) {
-                        if (service->service->instance && r->host) {
-                            if (_mdns_service_match_instance(service->service, r->host, r->service, r->proto, NULL) && r->ttl > (MDNS_ANSWER_PTR_TTL / 2)) {
-                                is_record_exist = true;
-                                break;
-                            }
-                        } else if (!service->service->instance && !r->host) {
-                            if (_mdns_service_match(service->service, r->service, r->proto, NULL) && r->ttl > (MDNS_ANSWER_PTR_TTL / 2)) {
-                                is_record_exist = true;
-                                break;
-                            }
+                        if (r->type == MDNS_TYPE_PTR && r->host && _mdns_answer_ttl_fresh(r->type, r->ttl)
+                                && _mdns_service_match_instance(service->service, r->host, r->service, r->proto, NULL)) {
+                            is_record_exist = true;
+                            break;
                         }
                         r = r->next;
                     }
-                    if (!is_record_exist) {
+                    if (is_record_exist) {
+                        _mdns_server->stats.known_answers_suppressed++;
+                    } else {
                         if (!_mdns_create_answer_from_service(packet, service->service, q, shared, send_flush)) {
                             _mdns_free_tx_packet(packet);
                             return;
@@ -1920,22 +3160,16 @@ static void _mdns_create_answer_from_parsed_packet(mdns_parsed_packet_t *parsed_
                         }
                     }
                 }
-                service = service->next;
+                service = service->type_next;
             }
-        } else if (q->type == MDNS_TYPE_A || q->type == MDNS_TYPE_AAAA) {
+        } else if (q->type == MDNS_TYPE_A || q->type == MDNS_TYPE_AAAA || q->type == MDNS_TYPE_ANY) {
+            // the questioned host only, an ANY question (e.g. a probe) does not ask for every host we answer for
             if (!_mdns_create_answer_from_hostname(packet, q->host, send_flush)) {
                 _mdns_free_tx_packet(packet);
                 return;
             } else {
                 out_record_nums++;
             }
-        } else if (q->type == MDNS_TYPE_ANY) {
-            if (!_mdns_append_host_list(&packet->answers, send_flush, false)) {
-                _mdns_free_tx_packet(packet);
-                return;
-            } else {
-                out_record_nums++;
-            }
 #ifdef CONFIG_MDNS_RESPOND_REVERSE_QUERIES
         } else if (q->type == MDNS_TYPE_PTR) {
             mdns_host_item_t *host = mdns_get_host_item(q->host);
@@ -1959,7 +3193,7 @@ static void _mdns_create_answer_from_parsed_packet(mdns_parsed_packet_t *parsed_
                  || q->type == MDNS_TYPE_PTR
 #endif /* CONFIG_MDNS_RESPOND_REVERSE_QUERIES */
                 )) {
-            mdns_out_question_t *out_question = mdns_mem_malloc(sizeof(mdns_out_question_t));
+            mdns_out_question_t *out_question = mdns_mem_pool_alloc(MDNS_MEM_POOL_QUESTION, sizeof(mdns_out_question_t));
             if (out_question == NULL) {
                 HOOK_MALLOC_FAILED;
                 _mdns_free_tx_packet(packet);
@@ -1967,17 +3201,20 @@ static void _mdns_create_answer_from_parsed_packet(mdns_parsed_packet_t *parsed_
             }
             out_question->type = q->type;
             out_question->unicast = q->unicast;
-            out_question->host = q->host;
-            q->host = NULL;
-            out_question->service = q->service;
-            q->service = NULL;
-            out_question->proto = q->proto;
-            q->proto = NULL;
-            out_question->domain = q->domain;
-            q->domain = NULL;
+            // the parsed question lives in the parse memory, the repeated one needs its own copy
+            out_question->host = mdns_mem_strdup(q->host);
+            out_question->service = mdns_mem_strdup(q->service);
+            out_question->proto = mdns_mem_strdup(q->proto);
+            out_question->domain = mdns_mem_strdup(q->domain);
             out_question->next = NULL;
             out_question->own_dynamic_memory = true;
             queueToEnd(mdns_out_question_t, packet->questions, out_question);
+            if ((q->host && !out_question->host) || (q->service && !out_question->service)
+                    || (q->proto && !out_question->proto) || (q->domain && !out_question->domain)) {
+                HOOK_MALLOC_FAILED;
+                _mdns_free_tx_packet(packet);
+                return;
+            }
         }
         if (q->unicast) {
             unicast = true;
@@ -1994,10 +3231,15 @@ static void _mdns_create_answer_from_parsed_packet(mdns_parsed_packet_t *parsed_
     }
 
     static uint8_t share_step = 0;
-    if (shared) {
+    if (parsed_packet->distributed) {
+        // wait for the rest of the known answers (RFC 6762, 7.2)
+        _mdns_schedule_tx_packet(packet, MDNS_TRUNCATED_QUERY_DELAY + (share_step * 25));
+        share_step = (share_step + 1) & 0x03;
+    } else if (shared) {
         _mdns_schedule_tx_packet(packet, 25 + (share_step * 25));
         share_step = (share_step + 1) & 0x03;
     } else {
+        packet->probe_defense = true;
         _mdns_dispatch_tx_packet(packet);
         _mdns_free_tx_packet(packet);
     }
@@ -2050,27 +3292,9 @@ static bool _mdns_append_host_list_in_services(mdns_out_answer_t **destination,
     return true;
 }
 
-static bool _mdns_append_host_list(mdns_out_answer_t **destination, bool flush, bool bye)
-{
-    if (!_str_null_or_empty(_mdns_server->hostname)) {
-        mdns_host_item_t *self_host = mdns_get_host_item(_mdns_server->hostname);
-        if (!_mdns_append_host(destination, self_host, flush, bye)) {
-            return false;
-        }
-    }
-    mdns_host_item_t *host = _mdns_host_list;
-    while (host != NULL) {
-        host = host->next;
-        if (!_mdns_append_host(destination, host, flush, bye)) {
-            return false;
-        }
-    }
-    return true;
-}
-
 static bool _mdns_append_host_question(mdns_out_question_t **questions, const char *hostname, bool unicast)
 {
-    mdns_out_question_t *q = (mdns_out_question_t *)mdns_mem_malloc(sizeof(mdns_out_question_t));
+    mdns_out_question_t *q = (mdns_out_question_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_QUESTION, sizeof(mdns_out_question_t));
     if (!q) {
         HOOK_MALLOC_FAILED;
         return false;
@@ -2107,22 +3331,16 @@ static bool _mdns_append_host_questions_for_services(mdns_out_question_t **quest
 }
 
 /**
- * @brief  Create probe packet for particular services on particular PCB
+ * @brief  Add the questions and the authority records of particular services to a probe packet
  */
-static mdns_tx_packet_t *_mdns_create_probe_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t *services[], size_t len, bool first, bool include_ip)
+static bool _mdns_append_probe_services(mdns_tx_packet_t *packet, mdns_srv_item_t *services[], size_t len, bool first, bool include_ip)
 {
-    mdns_tx_packet_t *packet = _mdns_alloc_packet_default(tcpip_if, ip_protocol);
-    if (!packet) {
-        return NULL;
-    }
-
     size_t i;
     for (i = 0; i < len; i++) {
-        mdns_out_question_t *q = (mdns_out_question_t *)mdns_mem_malloc(sizeof(mdns_out_question_t));
+        mdns_out_question_t *q = (mdns_out_question_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_QUESTION, sizeof(mdns_out_question_t));
         if (!q) {
             HOOK_MALLOC_FAILED;
-            _mdns_free_tx_packet(packet);
-            return NULL;
+            return false;
         }
         q->next = NULL;
         q->unicast = first;
@@ -2140,23 +3358,35 @@ static mdns_tx_packet_t *_mdns_create_probe_packet(mdns_if_t tcpip_if, mdns_ip_p
         }
 
         if (!q->host || !_mdns_alloc_answer(&packet->servers, MDNS_TYPE_SRV, services[i]->service, NULL, false, false)) {
-            _mdns_free_tx_packet(packet);
-            return NULL;
+            return false;
         }
     }
 
     if (include_ip) {
         if (!_mdns_append_host_questions_for_services(&packet->questions, services, len, first)) {
-            _mdns_free_tx_packet(packet);
-            return NULL;
+            return false;
         }
 
         if (!_mdns_append_host_list_in_services(&packet->servers, services, len, false, false)) {
-            _mdns_free_tx_packet(packet);
-            return NULL;
+            return false;
         }
     }
+    return true;
+}
 
+/**
+ * @brief  Create probe packet for particular services on particular PCB
+ */
+static mdns_tx_packet_t *_mdns_create_probe_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t *services[], size_t len, bool first, bool include_ip)
+{
+    mdns_tx_packet_t *packet = _mdns_alloc_packet_default(tcpip_if, ip_protocol);
+    if (!packet) {
+        return NULL;
+    }
+    if (!_mdns_append_probe_services(packet, services, len, first, include_ip)) {
+        _mdns_free_tx_packet(packet);
+        return NULL;
+    }
     return packet;
 }
 
@@ -2171,7 +3401,7 @@ static mdns_tx_packet_t *_mdns_create_announce_packet(mdns_if_t tcpip_if, mdns_i
     }
     packet->flags = MDNS_FLAGS_QR_AUTHORITATIVE;
 
-    uint8_t i;
+    size_t i;
     for (i = 0; i < len; i++) {
         if (!_mdns_alloc_answer(&packet->answers, MDNS_TYPE_SDPTR, services[i]->service, NULL, false, false)
                 || !_mdns_alloc_answer(&packet->answers, MDNS_TYPE_PTR, services[i]->service, NULL, false, false)
@@ -2218,135 +3448,492 @@ static mdns_tx_packet_t *_mdns_create_announce_from_probe(mdns_tx_packet_t *prob
                 return NULL;
             }
 
-        } else if (s->type == MDNS_TYPE_A || s->type == MDNS_TYPE_AAAA) {
-            if (!_mdns_alloc_answer(&packet->answers, s->type, NULL, s->host, true, false)) {
-                _mdns_free_tx_packet(packet);
-                return NULL;
+        } else if (s->type == MDNS_TYPE_A || s->type == MDNS_TYPE_AAAA) {
+            if (!_mdns_alloc_answer(&packet->answers, s->type, NULL, s->host, true, false)) {
+                _mdns_free_tx_packet(packet);
+                return NULL;
+            }
+        }
+
+        s = s->next;
+    }
+    return packet;
+}
+
+/**
+ * @brief  Send by for particular services on particular PCB
+ */
+static void _mdns_pcb_send_bye(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t **services, size_t len, bool include_ip)
+{
+    mdns_tx_packet_t *packet = _mdns_alloc_packet_default(tcpip_if, ip_protocol);
+    if (!packet) {
+        return;
+    }
+    packet->flags = MDNS_FLAGS_QR_AUTHORITATIVE;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        if (!_mdns_alloc_answer(&packet->answers, MDNS_TYPE_PTR, services[i]->service, NULL, true, true)) {
+            _mdns_free_tx_packet(packet);
+            return;
+        }
+    }
+    if (include_ip) {
+        _mdns_append_host_list_in_services(&packet->answers, services, len, true, true);
+    }
+    _mdns_dispatch_tx_packet(packet);
+    _mdns_free_tx_packet(packet);
+}
+
+/**
+ * @brief  Send probe for additional services on particular PCB
+ */
+static void _mdns_init_pcb_probe_new_service(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t **services, size_t len, bool probe_ip)
+{
+    mdns_pcb_t *pcb = &_mdns_server->interfaces[tcpip_if].pcbs[ip_protocol];
+    size_t services_final_len = len;
+
+    if (PCB_STATE_IS_PROBING(pcb)) {
+        services_final_len += pcb->probe_services_len;
+    }
+    mdns_srv_item_t **_services = NULL;
+    if (services_final_len) {
+        _services = (mdns_srv_item_t **)mdns_mem_malloc(sizeof(mdns_srv_item_t *) * services_final_len);
+        if (!_services) {
+            HOOK_MALLOC_FAILED;
+            return;
+        }
+
+        size_t i;
+        for (i = 0; i < len; i++) {
+            _services[i] = services[i];
+        }
+        if (PCB_STATE_IS_PROBING(pcb)) {
+            for (i = 0; i < pcb->probe_services_len; i++) {
+                _services[len + i] = pcb->probe_services[i];
+            }
+        }
+    }
+    // the services of an interrupted probe are not counted above, do not copy them past the new array
+    mdns_mem_free(pcb->probe_services);
+
+    probe_ip = pcb->probe_ip || probe_ip;
+
+    pcb->probe_ip = false;
+    pcb->probe_services = NULL;
+    pcb->probe_services_len = 0;
+    pcb->probe_running = false;
+
+    mdns_tx_packet_t *packet = _mdns_create_probe_packet(tcpip_if, ip_protocol, _services, services_final_len, true, probe_ip);
+    if (!packet) {
+        mdns_mem_free(_services);
+        return;
+    }
+
+    pcb->probe_ip = probe_ip;
+    pcb->probe_services = _services;
+    pcb->probe_services_len = services_final_len;
+    pcb->probe_running = true;
+    _mdns_schedule_tx_packet(packet, ((pcb->failed_probes > 5) ? 1000 : 120) + (esp_random() & 0x7F));
+    pcb->state = PCB_PROBE_1;
+}
+
+/**
+ * @brief  Add services to the first probe of the PCB while it has not been sent yet
+ *
+ * The services join the scheduled probe sequence, so that adding services one by one does not
+ * rebuild the probe of all the services probed before.
+ *
+ * @return false if there is no such probe, the probing has to be restarted
+ */
+static bool _mdns_pcb_probe_append(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t **services, size_t len, bool probe_ip)
+{
+    mdns_pcb_t *pcb = &_mdns_server->interfaces[tcpip_if].pcbs[ip_protocol];
+    if (pcb->state != PCB_PROBE_1 || !pcb->probe_running || (probe_ip && !pcb->probe_ip)
+            || _str_null_or_empty(_mdns_server->hostname)) {
+        return false;
+    }
+    // the probe is the only query with authority records, batches of delegated hosts excluded
+    mdns_tx_packet_t *p = pcb->tx_packets;
+    while (p && (p->host_state != PCB_OFF || p->queued || p->flags || !p->questions || !p->servers || p->answers)) {
+        p = p->pcb_next;
+    }
+    if (!p) {
+        return false;
+    }
+    mdns_srv_item_t **probe_services = (mdns_srv_item_t **)mdns_mem_malloc((pcb->probe_services_len + len) * sizeof(mdns_srv_item_t *));
+    if (!probe_services) {
+        HOOK_MALLOC_FAILED;
+        return false;
+    }
+    if (pcb->probe_services_len) {
+        memcpy(probe_services, pcb->probe_services, pcb->probe_services_len * sizeof(mdns_srv_item_t *));
+    }
+    size_t probe_services_len = pcb->probe_services_len;
+    for (size_t j = 0; j < len; j++) {
+        size_t i = 0;
+        while (i < probe_services_len && probe_services[i] != services[j]) {
+            i++;
+        }
+        if (i == probe_services_len) {
+            probe_services[probe_services_len++] = services[j];
+        }
+    }
+    size_t added = probe_services_len - pcb->probe_services_len;
+    if (added && !_mdns_append_probe_services(p, probe_services + pcb->probe_services_len, added, true, pcb->probe_ip)) {
+        // the probe may be left incomplete, the caller rebuilds it
+        mdns_mem_free(probe_services);
+        return false;
+    }
+    mdns_mem_free(pcb->probe_services);
+    pcb->probe_services = probe_services;
+    pcb->probe_services_len = probe_services_len;
+    return true;
+}
+
+/**
+ * @brief  Send probe for particular services on particular PCB
+ *
+ * Tests possible duplication on probing service structure and probes only for new entries.
+ * - If the first probe has not been sent yet, add the services to it
+ * - If pcb probing then add only non-probing services and restarts probing
+ * - If pcb not probing, run probing for all specified services
+ */
+static void _mdns_init_pcb_probe(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t **services, size_t len, bool probe_ip)
+{
+    mdns_pcb_t *pcb = &_mdns_server->interfaces[tcpip_if].pcbs[ip_protocol];
+
+    if (_mdns_pcb_probe_append(tcpip_if, ip_protocol, services, len, probe_ip)) {
+        return;
+    }
+
+    _mdns_clear_pcb_tx_queue_head(tcpip_if, ip_protocol, true);
+
+    if (_str_null_or_empty(_mdns_server->hostname)) {
+        pcb->state = PCB_RUNNING;
+        return;
+    }
+
+    if (PCB_STATE_IS_PROBING(pcb)) {
+        // Looking for already probing services to resolve duplications
+        mdns_srv_item_t **new_probe_services = NULL;
+        if (len) {
+            new_probe_services = (mdns_srv_item_t **)mdns_mem_malloc(len * sizeof(mdns_srv_item_t *));
+            if (!new_probe_services) {
+                HOOK_MALLOC_FAILED;
+                return;
+            }
+        }
+        size_t new_probe_service_len = 0;
+        bool found;
+        for (size_t j = 0; j < len; ++j) {
+            found = false;
+            for (int i = 0; i < pcb->probe_services_len; ++i) {
+                if (pcb->probe_services[i] == services[j]) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                new_probe_services[new_probe_service_len++] = services[j];
+            }
+        }
+        // init probing for newly added services
+        _mdns_init_pcb_probe_new_service(tcpip_if, ip_protocol,
+                                         new_probe_service_len ? new_probe_services : NULL, new_probe_service_len, probe_ip);
+        mdns_mem_free(new_probe_services);
+    } else {
+        // not probing, so init for all services
+        _mdns_init_pcb_probe_new_service(tcpip_if, ip_protocol, services, len, probe_ip);
+    }
+}
+
+/**
+ * @brief  Collects the services (only those without own instance name if no_instance is set)
+ *
+ * The array is allocated rather than placed on the task stack, as there may be many services.
+ *
+ * @param  srv_count    number of the services collected
+ *
+ * @return the array to be freed by the caller, NULL if there are no such services or if it could not be allocated
+ */
+static mdns_srv_item_t **_mdns_collect_services(bool no_instance, size_t *srv_count)
+{
+    mdns_srv_item_t *a;
+    size_t i = 0;
+    *srv_count = 0;
+    for (a = _mdns_server->services; a; a = a->next) {
+        if (!no_instance || !a->service->instance) {
+            (*srv_count)++;
+        }
+    }
+    if (!*srv_count) {
+        return NULL;
+    }
+    mdns_srv_item_t **services = (mdns_srv_item_t **)mdns_mem_malloc(*srv_count * sizeof(mdns_srv_item_t *));
+    if (!services) {
+        HOOK_MALLOC_FAILED;
+        return NULL;
+    }
+    for (a = _mdns_server->services; a; a = a->next) {
+        if (!no_instance || !a->service->instance) {
+            services[i++] = a;
+        }
+    }
+    return services;
+}
+
+/**
+ * @brief  Estimated size of the question and of the address records of a delegated host in a batch
+ */
+static uint16_t _mdns_host_batch_len(mdns_host_item_t *host)
+{
+    // the name is written once, the records refer to it, the question adds its type and class
+    uint16_t len = strlen(host->hostname) + sizeof(MDNS_DEFAULT_DOMAIN) + 2 + 4;
+    for (mdns_ip_addr_t *addr = host->address_list; addr; addr = addr->next) {
+        len += 2 + 10 + (addr->addr.type == ESP_IPADDR_TYPE_V6 ? 16 : 4);
+    }
+    return len;
+}
+
+/**
+ * @brief  Find the batch of delegated hosts in the given round with room for one more host, or schedule a new one
+ *
+ * Hosts added, changed or removed before the batch is sent share its packets, so adding or removing
+ * many hosts costs a few packets per round instead of a probe sequence or a goodbye per host.
+ */
+static mdns_tx_packet_t *_mdns_pcb_host_batch(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_pcb_state_t state, uint16_t len)
+{
+    mdns_tx_packet_t *p = _mdns_server->interfaces[tcpip_if].pcbs[ip_protocol].tx_packets;
+    for (; p; p = p->pcb_next) {
+        if (p->host_state == state && p->host_batch_len + len <= MDNS_MAX_PACKET_SIZE - MDNS_HEAD_LEN) {
+            return p;
+        }
+    }
+    // reserve first, the scheduler frees the packet if it cannot be queued
+    if (!_mdns_tx_heap_reserve(&_mdns_server->tx.heap)) {
+        return NULL;
+    }
+    p = _mdns_alloc_packet_default(tcpip_if, ip_protocol);
+    if (!p) {
+        return NULL;
+    }
+    p->host_state = state;
+    if (state == PCB_PROBE_1) {
+        _mdns_schedule_tx_packet(p, 120 + (esp_random() & 0x7F));
+    } else {
+        p->flags = MDNS_FLAGS_QR_AUTHORITATIVE;
+        _mdns_schedule_tx_packet(p, 0);
+    }
+    return p;
+}
+
+/**
+ * @brief  Add probe for a delegated host on particular PCB
+ */
+static void _mdns_pcb_probe_host(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_host_item_t *host)
+{
+    uint16_t len = _mdns_host_batch_len(host);
+    mdns_tx_packet_t *p = _mdns_pcb_host_batch(tcpip_if, ip_protocol, PCB_PROBE_1, len);
+    if (!p) {
+        return;
+    }
+    if (!_mdns_append_host_question(&p->questions, host->hostname, true)
+            || !_mdns_append_host(&p->servers, host, false, false)) {
+        return;
+    }
+    p->host_batch_len += len;
+}
+
+/**
+ * @brief  Check if a delegated host is being probed on particular PCB, its announcement follows the probe
+ */
+static bool _mdns_pcb_host_probing(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_host_item_t *host)
+{
+    mdns_tx_packet_t *p = _mdns_server->interfaces[tcpip_if].pcbs[ip_protocol].tx_packets;
+    for (; p; p = p->pcb_next) {
+        if (p->host_state < PCB_PROBE_1 || p->host_state > PCB_PROBE_3) {
+            continue;
+        }
+        for (mdns_out_answer_t *a = p->servers; a; a = a->next) {
+            if (a->host == host) {
+                return true;
             }
         }
+    }
+    return false;
+}
 
-        s = s->next;
+/**
+ * @brief  Add announcement of a delegated host on particular PCB
+ */
+static void _mdns_pcb_announce_host(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_host_item_t *host)
+{
+    if (_mdns_pcb_host_probing(tcpip_if, ip_protocol, host)) {
+        return;
     }
-    return packet;
+    uint16_t len = _mdns_host_batch_len(host);
+    mdns_tx_packet_t *p = _mdns_pcb_host_batch(tcpip_if, ip_protocol, PCB_ANNOUNCE_1, len);
+    if (!p) {
+        return;
+    }
+    if (!_mdns_append_host(&p->answers, host, true, false)) {
+        return;
+    }
+    p->host_batch_len += len;
 }
 
 /**
- * @brief  Send by for particular services on particular PCB
+ * @brief  Add goodbye of a removed delegated host on particular PCB
+ *
+ * The host is freed before the batch is sent, so the batch keeps its own copy of the name and addresses.
  */
-static void _mdns_pcb_send_bye(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t **services, size_t len, bool include_ip)
+static void _mdns_pcb_bye_host(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_host_item_t *host)
 {
-    mdns_tx_packet_t *packet = _mdns_alloc_packet_default(tcpip_if, ip_protocol);
-    if (!packet) {
+    uint16_t len = _mdns_host_batch_len(host);
+    mdns_tx_packet_t *p = _mdns_pcb_host_batch(tcpip_if, ip_protocol, PCB_RUNNING, len);
+    if (!p) {
         return;
     }
-    packet->flags = MDNS_FLAGS_QR_AUTHORITATIVE;
-    size_t i;
-    for (i = 0; i < len; i++) {
-        if (!_mdns_alloc_answer(&packet->answers, MDNS_TYPE_PTR, services[i]->service, NULL, true, true)) {
-            _mdns_free_tx_packet(packet);
-            return;
-        }
+    mdns_host_item_t *copy = (mdns_host_item_t *)mdns_mem_malloc(sizeof(mdns_host_item_t));
+    if (!copy) {
+        HOOK_MALLOC_FAILED;
+        return;
     }
-    if (include_ip) {
-        _mdns_append_host_list_in_services(&packet->answers, services, len, true, true);
+    copy->hostname = mdns_mem_strdup(host->hostname);
+    copy->address_list = copy_address_list(host->address_list);
+    copy->conflicted = false;
+    if (!copy->hostname || !copy->address_list) {
+        HOOK_MALLOC_FAILED;
+        free_address_list(copy->address_list);
+        mdns_mem_free((char *)copy->hostname);
+        mdns_mem_free(copy);
+        return;
     }
-    _mdns_dispatch_tx_packet(packet);
-    _mdns_free_tx_packet(packet);
+    copy->next = p->bye_hosts;
+    p->bye_hosts = copy;
+    if (!_mdns_append_host(&p->answers, copy, true, true)) {
+        return;
+    }
+    p->host_batch_len += len;
 }
 
 /**
- * @brief  Send probe for additional services on particular PCB
+ * @brief  Check if delegated hosts are probed and announced on particular PCB
  */
-static void _mdns_init_pcb_probe_new_service(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t **services, size_t len, bool probe_ip)
+static bool _mdns_pcb_hosts_active(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
 {
-    mdns_pcb_t *pcb = &_mdns_server->interfaces[tcpip_if].pcbs[ip_protocol];
-    size_t services_final_len = len;
+    mdns_pcb_state_t state = _mdns_server->interfaces[tcpip_if].pcbs[ip_protocol].state;
+    return mdns_is_netif_ready(tcpip_if, ip_protocol) && state != PCB_OFF && state != PCB_DUP;
+}
 
-    if (PCB_STATE_IS_PROBING(pcb)) {
-        services_final_len += pcb->probe_services_len;
+/**
+ * @brief  Probe one delegated host on all active PCBs, other hosts are not affected
+ */
+static void _mdns_probe_host_all_pcbs(mdns_host_item_t *host)
+{
+    uint8_t i, j;
+    if (_str_null_or_empty(_mdns_server->hostname) || !host->address_list) {
+        return;
     }
-    mdns_srv_item_t **_services = NULL;
-    if (services_final_len) {
-        _services = (mdns_srv_item_t **)mdns_mem_malloc(sizeof(mdns_srv_item_t *) * services_final_len);
-        if (!_services) {
-            HOOK_MALLOC_FAILED;
-            return;
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            if (_mdns_pcb_hosts_active((mdns_if_t)i, (mdns_ip_protocol_t)j)) {
+                _mdns_pcb_probe_host((mdns_if_t)i, (mdns_ip_protocol_t)j, host);
+            }
         }
+    }
+}
 
-        size_t i;
-        for (i = 0; i < len; i++) {
-            _services[i] = services[i];
-        }
-        if (pcb->probe_services) {
-            for (i = 0; i < pcb->probe_services_len; i++) {
-                _services[len + i] = pcb->probe_services[i];
+/**
+ * @brief  Announce the changed addresses of one delegated host on all active PCBs
+ */
+static void _mdns_announce_host_all_pcbs(mdns_host_item_t *host)
+{
+    uint8_t i, j;
+    if (_str_null_or_empty(_mdns_server->hostname) || !host->address_list) {
+        return;
+    }
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            if (_mdns_pcb_hosts_active((mdns_if_t)i, (mdns_ip_protocol_t)j)) {
+                _mdns_pcb_announce_host((mdns_if_t)i, (mdns_ip_protocol_t)j, host);
             }
-            mdns_mem_free(pcb->probe_services);
         }
     }
+}
 
-    probe_ip = pcb->probe_ip || probe_ip;
-
-    pcb->probe_ip = false;
-    pcb->probe_services = NULL;
-    pcb->probe_services_len = 0;
-    pcb->probe_running = false;
-
-    mdns_tx_packet_t *packet = _mdns_create_probe_packet(tcpip_if, ip_protocol, _services, services_final_len, true, probe_ip);
-    if (!packet) {
-        mdns_mem_free(_services);
+/**
+ * @brief  Probe all delegated hosts on particular PCB
+ */
+static void _mdns_pcb_probe_hosts(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    if (_str_null_or_empty(_mdns_server->hostname) || !_mdns_pcb_hosts_active(tcpip_if, ip_protocol)) {
         return;
     }
+    for (mdns_host_item_t *host = _mdns_host_list; host; host = host->next) {
+        if (host->address_list && !host->conflicted) {
+            _mdns_pcb_probe_host(tcpip_if, ip_protocol, host);
+        }
+    }
+}
 
-    pcb->probe_ip = probe_ip;
-    pcb->probe_services = _services;
-    pcb->probe_services_len = services_final_len;
-    pcb->probe_running = true;
-    _mdns_schedule_tx_packet(packet, ((pcb->failed_probes > 5) ? 1000 : 120) + (esp_random() & 0x7F));
-    pcb->state = PCB_PROBE_1;
+/**
+ * @brief  Probe all delegated hosts on all active PCBs
+ */
+static void _mdns_probe_hosts_all_pcbs(void)
+{
+    uint8_t i, j;
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_pcb_probe_hosts((mdns_if_t)i, (mdns_ip_protocol_t)j);
+        }
+    }
 }
 
 /**
- * @brief  Send probe for particular services on particular PCB
+ * @brief  Send the next round of a batch of delegated hosts
  *
- * Tests possible duplication on probing service structure and probes only for new entries.
- * - If pcb probing then add only non-probing services and restarts probing
- * - If pcb not probing, run probing for all specified services
+ * Follows the probe and announce sequence of the PCB, but for the hosts of the batch only,
+ * a batch of goodbyes is sent once.
  */
-static void _mdns_init_pcb_probe(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t **services, size_t len, bool probe_ip)
+static void _mdns_host_batch_next(mdns_tx_packet_t *p)
 {
-    mdns_pcb_t *pcb = &_mdns_server->interfaces[tcpip_if].pcbs[ip_protocol];
-
-    _mdns_clear_pcb_tx_queue_head(tcpip_if, ip_protocol);
-
-    if (_str_null_or_empty(_mdns_server->hostname)) {
-        pcb->state = PCB_RUNNING;
-        return;
-    }
+    mdns_tx_packet_t *a = NULL;
+    mdns_out_question_t *q = NULL;
+    uint32_t send_after = 1000;
 
-    if (PCB_STATE_IS_PROBING(pcb)) {
-        // Looking for already probing services to resolve duplications
-        mdns_srv_item_t *new_probe_services[len];
-        int new_probe_service_len = 0;
-        bool found;
-        for (size_t j = 0; j < len; ++j) {
-            found = false;
-            for (int i = 0; i < pcb->probe_services_len; ++i) {
-                if (pcb->probe_services[i] == services[j]) {
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                new_probe_services[new_probe_service_len++] = services[j];
-            }
+    switch (p->host_state) {
+    case PCB_PROBE_1:
+        for (q = p->questions; q; q = q->next) {
+            q->unicast = false;
         }
-        // init probing for newly added services
-        _mdns_init_pcb_probe_new_service(tcpip_if, ip_protocol,
-                                         new_probe_service_len ? new_probe_services : NULL, new_probe_service_len, probe_ip);
-    } else {
-        // not probing, so init for all services
-        _mdns_init_pcb_probe_new_service(tcpip_if, ip_protocol, services, len, probe_ip);
+    //fallthrough
+    case PCB_PROBE_2:
+        // the scheduler frees the packet if it cannot be queued, so advance the round first
+        p->host_state = (mdns_pcb_state_t)((uint8_t)(p->host_state) + 1);
+        _mdns_schedule_tx_packet(p, 250);
+        break;
+    case PCB_PROBE_3:
+        a = _mdns_create_announce_from_probe(p);
+        if (!a) {
+            _mdns_schedule_tx_packet(p, 250);
+            break;
+        }
+        a->host_state = p->host_state;
+        a->host_batch_len = p->host_batch_len;
+        _mdns_free_tx_packet(p);
+        p = a;
+        send_after = 250;
+    //fallthrough
+    case PCB_ANNOUNCE_1:
+    //fallthrough
+    case PCB_ANNOUNCE_2:
+        p->host_state = (mdns_pcb_state_t)((uint8_t)(p->host_state) + 1);
+        _mdns_schedule_tx_packet(p, send_after);
+        break;
+    default:
+        _mdns_free_tx_packet(p);
+        break;
     }
 }
 
@@ -2355,25 +3942,21 @@ static void _mdns_init_pcb_probe(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_proto
  */
 static void _mdns_restart_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
 {
-    size_t srv_count = 0;
-    mdns_srv_item_t *a = _mdns_server->services;
-    while (a) {
-        srv_count++;
-        a = a->next;
-    }
+    size_t srv_count;
+    _mdns_clear_pcb_tx_queue_head(tcpip_if, ip_protocol, false);
+    mdns_srv_item_t **services = _mdns_collect_services(false, &srv_count);
     if (srv_count == 0) {
         // proble only IP
         _mdns_init_pcb_probe(tcpip_if, ip_protocol, NULL, 0, true);
+        _mdns_pcb_probe_hosts(tcpip_if, ip_protocol);
         return;
     }
-    mdns_srv_item_t *services[srv_count];
-    size_t i = 0;
-    a = _mdns_server->services;
-    while (a) {
-        services[i++] = a;
-        a = a->next;
+    if (!services) {
+        return;
     }
     _mdns_init_pcb_probe(tcpip_if, ip_protocol, services, srv_count, true);
+    mdns_mem_free(services);
+    _mdns_pcb_probe_hosts(tcpip_if, ip_protocol);
 }
 
 /**
@@ -2395,6 +3978,71 @@ static void _mdns_send_bye(mdns_srv_item_t **services, size_t len, bool include_
     }
 }
 
+/**
+ * @brief  Send bye for a delegated host, the goodbyes of its services and addresses share one packet per PCB
+ *
+ * The goodbyes of hosts without services are batched instead, see _mdns_pcb_bye_host().
+ */
+static void _mdns_send_host_bye(mdns_host_item_t *host)
+{
+    uint8_t i, j;
+    size_t k, len = 0;
+    mdns_srv_item_t *a;
+    if (_str_null_or_empty(_mdns_server->hostname)) {
+        return;
+    }
+    for (a = _mdns_server->services; a; a = a->next) {
+        if (strcasecmp(a->service->hostname, host->hostname) == 0) {
+            len++;
+        }
+    }
+    if (!len) {
+        if (!host->address_list || host->conflicted) {
+            return;
+        }
+        for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+            for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+                if (mdns_is_netif_ready(i, j) && _mdns_server->interfaces[i].pcbs[j].state == PCB_RUNNING) {
+                    _mdns_pcb_bye_host((mdns_if_t)i, (mdns_ip_protocol_t)j, host);
+                }
+            }
+        }
+        return;
+    }
+    mdns_srv_item_t **services = (mdns_srv_item_t **)mdns_mem_malloc(len * sizeof(mdns_srv_item_t *));
+    if (!services) {
+        HOOK_MALLOC_FAILED;
+        return;
+    }
+    k = 0;
+    for (a = _mdns_server->services; a; a = a->next) {
+        if (strcasecmp(a->service->hostname, host->hostname) == 0) {
+            services[k++] = a;
+        }
+    }
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            if (!mdns_is_netif_ready(i, j) || _mdns_server->interfaces[i].pcbs[j].state != PCB_RUNNING) {
+                continue;
+            }
+            mdns_tx_packet_t *packet = _mdns_alloc_packet_default((mdns_if_t)i, (mdns_ip_protocol_t)j);
+            if (!packet) {
+                continue;
+            }
+            packet->flags = MDNS_FLAGS_QR_AUTHORITATIVE;
+            bool appended = true;
+            for (k = 0; k < len && appended; k++) {
+                appended = _mdns_alloc_answer(&packet->answers, MDNS_TYPE_PTR, services[k]->service, NULL, true, true);
+            }
+            if (appended && _mdns_append_host(&packet->answers, host, true, true)) {
+                _mdns_dispatch_tx_packet(packet);
+            }
+            _mdns_free_tx_packet(packet);
+        }
+    }
+    mdns_mem_free(services);
+}
+
 /**
  * @brief  Send bye for particular subtypes
  */
@@ -2414,14 +4062,15 @@ static void _mdns_send_bye_subtype(mdns_srv_item_t *service, const char *instanc
                     return;
                 }
 
-                static uint8_t pkt[MDNS_MAX_PACKET_SIZE];
+                mdns_tx_writer_t *writer = &_mdns_server->tx.writer;
                 uint16_t index = MDNS_HEAD_LEN;
-                memset(pkt, 0, MDNS_HEAD_LEN);
+                memset(writer->packet, 0, MDNS_HEAD_LEN);
+                _mdns_name_dict_reset(writer);
                 mdns_out_answer_t *a;
                 uint8_t count;
 
-                _mdns_set_u16(pkt, MDNS_HEAD_FLAGS_OFFSET, packet->flags);
-                _mdns_set_u16(pkt, MDNS_HEAD_ID_OFFSET, packet->id);
+                _mdns_set_u16(writer->packet, MDNS_HEAD_FLAGS_OFFSET, packet->flags);
+                _mdns_set_u16(writer->packet, MDNS_HEAD_ID_OFFSET, packet->id);
 
                 count = 0;
                 a = packet->answers;
@@ -2429,15 +4078,15 @@ static void _mdns_send_bye_subtype(mdns_srv_item_t *service, const char *instanc
                     if (a->type == MDNS_TYPE_PTR && a->service) {
                         const mdns_subtype_t *current_subtype = remove_subtypes;
                         while (current_subtype) {
-                            count += (_mdns_append_subtype_ptr_record(pkt, &index, instance_name, current_subtype->subtype, a->service->service, a->service->proto, a->flush, a->bye) > 0);
+                            count += (_mdns_append_subtype_ptr_record(writer, &index, instance_name, current_subtype->subtype, a->service->service, a->service->proto, NULL, a->flush, a->bye) > 0);
                             current_subtype = current_subtype->next;
                         }
                     }
                     a = a->next;
                 }
-                _mdns_set_u16(pkt, MDNS_HEAD_ANSWERS_OFFSET, count);
+                _mdns_set_u16(writer->packet, MDNS_HEAD_ANSWERS_OFFSET, count);
 
-                _mdns_udp_pcb_write(packet->tcpip_if, packet->ip_protocol, &packet->dst, packet->port, pkt, index);
+                _mdns_pcb_write(packet->tcpip_if, packet->ip_protocol, &packet->dst, packet->port, writer->packet, index);
 
                 _mdns_free_tx_packet(packet);
             }
@@ -2471,6 +4120,9 @@ static void _mdns_announce_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protoco
                     _mdns_dealloc_answer(&p->additional, MDNS_TYPE_AAAA, NULL);
                     _mdns_append_host_list_in_services(&p->answers, services, len, true, false);
                 }
+                if (p->suppressible) {
+                    _mdns_tx_index_answers(p);
+                }
                 _pcb->state = PCB_ANNOUNCE_1;
             }
         } else if (_pcb->state == PCB_RUNNING) {
@@ -2529,23 +4181,13 @@ static void _mdns_announce_all_pcbs(mdns_srv_item_t **services, size_t len, bool
 static void _mdns_send_final_bye(bool include_ip)
 {
     //collect all services and start probe
-    size_t srv_count = 0;
-    mdns_srv_item_t *a = _mdns_server->services;
-    while (a) {
-        srv_count++;
-        a = a->next;
-    }
-    if (!srv_count) {
+    size_t srv_count;
+    mdns_srv_item_t **services = _mdns_collect_services(false, &srv_count);
+    if (!services) {
         return;
     }
-    mdns_srv_item_t *services[srv_count];
-    size_t i = 0;
-    a = _mdns_server->services;
-    while (a) {
-        services[i++] = a;
-        a = a->next;
-    }
     _mdns_send_bye(services, srv_count, include_ip);
+    mdns_mem_free(services);
 }
 
 /**
@@ -2553,55 +4195,27 @@ static void _mdns_send_final_bye(bool include_ip)
  */
 static void _mdns_send_bye_all_pcbs_no_instance(bool include_ip)
 {
-    size_t srv_count = 0;
-    mdns_srv_item_t *a = _mdns_server->services;
-    while (a) {
-        if (!a->service->instance) {
-            srv_count++;
-        }
-        a = a->next;
-    }
-    if (!srv_count) {
+    size_t srv_count;
+    mdns_srv_item_t **services = _mdns_collect_services(true, &srv_count);
+    if (!services) {
         return;
     }
-    mdns_srv_item_t *services[srv_count];
-    size_t i = 0;
-    a = _mdns_server->services;
-    while (a) {
-        if (!a->service->instance) {
-            services[i++] = a;
-        }
-        a = a->next;
-    }
     _mdns_send_bye(services, srv_count, include_ip);
+    mdns_mem_free(services);
 }
 
 /**
  * @brief  Restart the responder on all services without instance
  */
 static void _mdns_restart_all_pcbs_no_instance(void)
-{
-    size_t srv_count = 0;
-    mdns_srv_item_t *a = _mdns_server->services;
-    while (a) {
-        if (!a->service->instance) {
-            srv_count++;
-        }
-        a = a->next;
-    }
-    if (!srv_count) {
-        return;
-    }
-    mdns_srv_item_t *services[srv_count];
-    size_t i = 0;
-    a = _mdns_server->services;
-    while (a) {
-        if (!a->service->instance) {
-            services[i++] = a;
-        }
-        a = a->next;
+{
+    size_t srv_count;
+    mdns_srv_item_t **services = _mdns_collect_services(true, &srv_count);
+    if (!services) {
+        return;
     }
     _mdns_probe_all_pcbs(services, srv_count, false, true);
+    mdns_mem_free(services);
 }
 
 /**
@@ -2609,26 +4223,23 @@ static void _mdns_restart_all_pcbs_no_instance(void)
  */
 static void _mdns_restart_all_pcbs(void)
 {
-    _mdns_clear_tx_queue_head();
-    size_t srv_count = 0;
-    mdns_srv_item_t *a = _mdns_server->services;
-    while (a) {
-        srv_count++;
-        a = a->next;
+    uint8_t i, j;
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_clear_pcb_tx_queue_head((mdns_if_t)i, (mdns_ip_protocol_t)j, true);
+        }
     }
+    size_t srv_count;
+    mdns_srv_item_t **services = _mdns_collect_services(false, &srv_count);
     if (srv_count == 0) {
         _mdns_probe_all_pcbs(NULL, 0, true, true);
         return;
     }
-    mdns_srv_item_t *services[srv_count];
-    size_t l = 0;
-    a = _mdns_server->services;
-    while (a) {
-        services[l++] = a;
-        a = a->next;
+    if (!services) {
+        return;
     }
-
     _mdns_probe_all_pcbs(services, srv_count, true, true);
+    mdns_mem_free(services);
 }
 
 
@@ -2719,6 +4330,7 @@ static mdns_service_t *_mdns_create_service(const char *service, const char *pro
     s->txt = new_txt;
     s->port = port;
     s->subtype = NULL;
+    s->wire = NULL;
 
     if (hostname) {
         s->hostname = mdns_mem_strndup(hostname, MDNS_NAME_BUF_LEN - 1);
@@ -2762,6 +4374,7 @@ static void _mdns_dealloc_scheduled_service_answers(mdns_out_answer_t **destinat
     }
     while (d && d->service == service) {
         *destination = d->next;
+        _mdns_tx_unindex_answer(d);
         mdns_mem_free(d);
         d = *destination;
     }
@@ -2769,6 +4382,7 @@ static void _mdns_dealloc_scheduled_service_answers(mdns_out_answer_t **destinat
         mdns_out_answer_t *a = d->next;
         if (a->service == service) {
             d->next = a->next;
+            _mdns_tx_unindex_answer(a);
             mdns_mem_free(a);
         } else {
             d = d->next;
@@ -2777,15 +4391,12 @@ static void _mdns_dealloc_scheduled_service_answers(mdns_out_answer_t **destinat
 }
 
 /**
- * @brief  Find, remove and free answers and scheduled packets for service
+ * @brief  Find, remove and free answers and scheduled packets for service on a specific PCB
  */
-static void _mdns_remove_scheduled_service_packets(mdns_service_t *service)
+static void _mdns_remove_scheduled_pcb_service_packets(mdns_service_t *service, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
 {
-    if (!service) {
-        return;
-    }
     mdns_tx_packet_t *p = NULL;
-    mdns_tx_packet_t *q = _mdns_server->tx_queue_head;
+    mdns_tx_packet_t *q = _mdns_server->interfaces[tcpip_if].pcbs[ip_protocol].tx_packets;
     while (q) {
         bool had_answers = (q->answers != NULL);
 
@@ -2797,7 +4408,7 @@ static void _mdns_remove_scheduled_service_packets(mdns_service_t *service)
         mdns_pcb_t *_pcb = &_mdns_server->interfaces[q->tcpip_if].pcbs[q->ip_protocol];
         if (mdns_is_netif_ready(q->tcpip_if, q->ip_protocol)) {
             if (PCB_STATE_IS_PROBING(_pcb)) {
-                uint8_t i;
+                uint16_t i;
                 //check if we are probing this service
                 for (i = 0; i < _pcb->probe_services_len; i++) {
                     mdns_srv_item_t *s = _pcb->probe_services[i];
@@ -2807,7 +4418,7 @@ static void _mdns_remove_scheduled_service_packets(mdns_service_t *service)
                 }
                 if (i < _pcb->probe_services_len) {
                     if (_pcb->probe_services_len > 1) {
-                        uint8_t n;
+                        uint16_t n;
                         for (n = (i + 1); n < _pcb->probe_services_len; n++) {
                             _pcb->probe_services[n - 1] = _pcb->probe_services[n];
                         }
@@ -2822,25 +4433,19 @@ static void _mdns_remove_scheduled_service_packets(mdns_service_t *service)
                         }
                     }
 
-                    if (q->questions) {
-                        mdns_out_question_t *qsn = NULL;
-                        mdns_out_question_t *qs = q->questions;
-                        if (qs->type == MDNS_TYPE_ANY
-                                && qs->service && strcmp(qs->service, service->service) == 0
-                                && qs->proto && strcmp(qs->proto, service->proto) == 0) {
-                            q->questions = q->questions->next;
+                    // the probe questions refer to the strings of their service, other instances of the type
+                    // are kept, so is the question of our hostname
+                    mdns_out_question_t **link = &q->questions;
+                    while (*link) {
+                        mdns_out_question_t *qs = *link;
+                        if (qs->type == MDNS_TYPE_ANY && !qs->own_dynamic_memory
+                                && ((qs->service == service->service && qs->proto == service->proto)
+                                    || (!qs->service && qs->host == service->hostname && qs->host != _mdns_server->hostname))) {
+                            *link = qs->next;
                             mdns_mem_free(qs);
-                        } else while (qs->next) {
-                                qsn = qs->next;
-                                if (qsn->type == MDNS_TYPE_ANY
-                                        && qsn->service && strcmp(qsn->service, service->service) == 0
-                                        && qsn->proto && strcmp(qsn->proto, service->proto) == 0) {
-                                    qs->next = qsn->next;
-                                    mdns_mem_free(qsn);
-                                    break;
-                                }
-                                qs = qs->next;
-                            }
+                        } else {
+                            link = &qs->next;
+                        }
                     }
                 }
             } else if (PCB_STATE_IS_ANNOUNCING(_pcb)) {
@@ -2852,14 +4457,102 @@ static void _mdns_remove_scheduled_service_packets(mdns_service_t *service)
         }
 
         p = q;
-        q = q->next;
+        q = q->pcb_next;
         if (!p->questions && !p->answers && !p->additional && !p->servers) {
-            queueDetach(mdns_tx_packet_t, _mdns_server->tx_queue_head, p);
+            _mdns_tx_queue_remove(p);
             _mdns_free_tx_packet(p);
         }
     }
 }
 
+/**
+ * @brief  Find, remove and free answers and scheduled packets for service
+ */
+static void _mdns_remove_scheduled_service_packets(mdns_service_t *service)
+{
+    if (!service) {
+        return;
+    }
+    uint8_t i, j;
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_remove_scheduled_pcb_service_packets(service, (mdns_if_t)i, (mdns_ip_protocol_t)j);
+        }
+    }
+}
+
+/**
+ * @brief  Remove and free answers of the host from answer list (destination)
+ */
+static void _mdns_dealloc_scheduled_host_answers(mdns_out_answer_t **destination, mdns_host_item_t *host)
+{
+    while (*destination) {
+        mdns_out_answer_t *a = *destination;
+        if (a->host == host) {
+            *destination = a->next;
+            _mdns_tx_unindex_answer(a);
+            mdns_mem_free(a);
+        } else {
+            destination = &a->next;
+        }
+    }
+}
+
+/**
+ * @brief  Find, remove and free answers and questions of a delegated host on particular PCB and packets left empty
+ *
+ * @param  batches_only  only the probes and announcements of batches of delegated hosts
+ */
+static void _mdns_remove_scheduled_pcb_host_packets(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_host_item_t *host,
+                                                    bool batches_only)
+{
+    uint16_t len = _mdns_host_batch_len(host);
+    mdns_tx_packet_t *q = _mdns_server->interfaces[tcpip_if].pcbs[ip_protocol].tx_packets;
+    while (q) {
+        mdns_tx_packet_t *next = q->pcb_next;
+        if (batches_only && (q->host_state == PCB_OFF || q->host_state == PCB_RUNNING)) {
+            q = next;
+            continue;
+        }
+        _mdns_dealloc_scheduled_host_answers(&q->answers, host);
+        _mdns_dealloc_scheduled_host_answers(&q->servers, host);
+        _mdns_dealloc_scheduled_host_answers(&q->additional, host);
+        mdns_out_question_t **link = &q->questions;
+        while (*link) {
+            mdns_out_question_t *qs = *link;
+            if (!qs->own_dynamic_memory && qs->host == host->hostname) {
+                *link = qs->next;
+                mdns_mem_free(qs);
+            } else {
+                link = &qs->next;
+            }
+        }
+        if (q->host_state != PCB_OFF) {
+            q->host_batch_len = q->host_batch_len > len ? q->host_batch_len - len : 0;
+        }
+        if (!q->questions && !q->answers && !q->additional && !q->servers) {
+            _mdns_tx_queue_remove(q);
+            _mdns_free_tx_packet(q);
+        }
+        q = next;
+    }
+}
+
+/**
+ * @brief  Find, remove and free answers and questions of a delegated host and packets left empty
+ *
+ * Scheduled answers refer to the host item, so this has to run before the host is freed.
+ */
+static void _mdns_remove_scheduled_host_packets(mdns_host_item_t *host)
+{
+    uint8_t i, j;
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_remove_scheduled_pcb_host_packets((mdns_if_t)i, (mdns_ip_protocol_t)j, host, false);
+        }
+    }
+}
+
 static void _mdns_free_subtype(mdns_subtype_t *subtype)
 {
     while (subtype) {
@@ -2898,6 +4591,8 @@ static void _mdns_free_service(mdns_service_t *service)
         mdns_mem_free(s);
     }
     _mdns_free_service_subtype(service);
+    _mdns_service_wire_invalidate(service);
+    _mdns_multicast_stamps_forget(service);
     mdns_mem_free(service);
 }
 
@@ -2930,9 +4625,12 @@ static int _mdns_check_srv_collision(mdns_service_t *service, uint16_t priority,
 
     uint16_t our_index = 0;
     uint8_t our_data[our_len];
-    _mdns_append_u16(our_data, &our_index, service->priority);
-    _mdns_append_u16(our_data, &our_index, service->weight);
-    _mdns_append_u16(our_data, &our_index, service->port);
+    _mdns_set_u16(our_data, our_index, service->priority);
+    our_index += 2;
+    _mdns_set_u16(our_data, our_index, service->weight);
+    our_index += 2;
+    _mdns_set_u16(our_data, our_index, service->port);
+    our_index += 2;
     our_data[our_index++] = our_host_len;
     memcpy(our_data + our_index, _mdns_server->hostname, our_host_len);
     our_index += our_host_len;
@@ -2943,9 +4641,12 @@ static int _mdns_check_srv_collision(mdns_service_t *service, uint16_t priority,
 
     uint16_t their_index = 0;
     uint8_t their_data[their_len];
-    _mdns_append_u16(their_data, &their_index, priority);
-    _mdns_append_u16(their_data, &their_index, weight);
-    _mdns_append_u16(their_data, &their_index, port);
+    _mdns_set_u16(their_data, their_index, priority);
+    their_index += 2;
+    _mdns_set_u16(their_data, their_index, weight);
+    their_index += 2;
+    _mdns_set_u16(their_data, their_index, port);
+    their_index += 2;
     their_data[their_index++] = their_host_len;
     memcpy(their_data + their_index, host, their_host_len);
     their_index += their_host_len;
@@ -2963,6 +4664,16 @@ static int _mdns_check_srv_collision(mdns_service_t *service, uint16_t priority,
     return 0;//same
 }
 
+/**
+ * @brief  Compares a part of our TXT record with the received data at the offset, advances the offset
+ */
+static inline int _mdns_txt_compare_part(const uint8_t *data, size_t *offset, const void *ours, size_t len)
+{
+    int ret = memcmp(ours, data + *offset, len);
+    *offset += len;
+    return ret;
+}
+
 /**
  * @brief  Detect TXT collision
  */
@@ -2990,21 +4701,29 @@ static int _mdns_check_txt_collision(mdns_service_t *service, const uint8_t *dat
         return -1;//we win
     }
 
-    uint8_t ours[len];
-    uint16_t index = 0;
-
+    // compared entry by entry in place, the TXT of a service may not fit a packet of ours
+    size_t offset = 0;
     txt = service->txt;
     while (txt) {
-        append_one_txt_record_entry(ours, &index, txt);
+        size_t key_len = strlen(txt->key);
+        uint8_t entry_len = key_len + txt->value_len + (txt->value ? 1 : 0);
+        int ret = _mdns_txt_compare_part(data, &offset, &entry_len, 1);
+        if (!ret) {
+            ret = _mdns_txt_compare_part(data, &offset, txt->key, key_len);
+        }
+        if (!ret && txt->value) {
+            ret = _mdns_txt_compare_part(data, &offset, "=", 1);
+            if (!ret) {
+                ret = _mdns_txt_compare_part(data, &offset, txt->value, txt->value_len);
+            }
+        }
+        if (ret > 0) {
+            return -1;//we win
+        } else if (ret < 0) {
+            return 1;//they win
+        }
         txt = txt->next;
     }
-
-    int ret = memcmp(ours, data, len);
-    if (ret > 0) {
-        return -1;//we win
-    } else if (ret < 0) {
-        return 1;//they win
-    }
     return 0;//same
 }
 
@@ -3016,6 +4735,7 @@ static esp_err_t mdns_pcb_deinit_local(mdns_if_t tcpip_if, mdns_ip_protocol_t ip
         return err;
     }
     mdns_mem_free(_pcb->probe_services);
+    _mdns_cache_flush_pcb(tcpip_if, ip_proto);
     _pcb->state = PCB_OFF;
     _pcb->probe_ip = false;
     _pcb->probe_services = NULL;
@@ -3038,7 +4758,7 @@ static void _mdns_dup_interface(mdns_if_t tcpip_if)
         if (mdns_is_netif_ready(other_if, i)) {
             //stop this interface and mark as dup
             if (mdns_is_netif_ready(tcpip_if, i)) {
-                _mdns_clear_pcb_tx_queue_head(tcpip_if, i);
+                _mdns_clear_pcb_tx_queue_head(tcpip_if, i, false);
                 mdns_pcb_deinit_local(tcpip_if, i);
             }
             _mdns_server->interfaces[tcpip_if].pcbs[i].state = PCB_DUP;
@@ -3119,45 +4839,93 @@ static int _mdns_check_aaaa_collision(esp_ip6_addr_t *ip, mdns_if_t tcpip_if)
 }
 #endif /* CONFIG_LWIP_IPV6 */
 
+/**
+ * @brief  Detect collision of an address record with a delegated host (-1=won, 0=none, 1=lost)
+ *
+ * An answer with another address comes from a host already using the name,
+ * simultaneous probes are decided by comparing the addresses, like for our own hostname.
+ */
+static int _mdns_check_host_collision(mdns_host_item_t *host, const esp_ip_addr_t *ip, bool probe)
+{
+    size_t len = ip->type == ESP_IPADDR_TYPE_V6 ? _MDNS_SIZEOF_IP6_ADDR : sizeof(esp_ip4_addr_t);
+    const mdns_ip_addr_t *ours = NULL;
+    for (const mdns_ip_addr_t *addr = host->address_list; addr; addr = addr->next) {
+        if (addr->addr.type != ip->type) {
+            continue;
+        }
+        if (memcmp(&addr->addr.u_addr, &ip->u_addr, len) == 0) {
+            return 0;//same
+        }
+        if (!ours) {
+            ours = addr;
+        }
+    }
+    if (!probe || !ours) {
+        return 1;//they win
+    }
+    return memcmp(&ours->addr.u_addr, &ip->u_addr, len) > 0 ? -1 : 1;
+}
+
+/**
+ * @brief  Give up the name of a delegated host being probed if another host claims it (RFC 6762, section 9)
+ *
+ * The host stays registered, but it is not probed, announced nor answered until its addresses are set again.
+ */
+static void _mdns_check_host_probe_conflict(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_name_t *name,
+                                            const esp_ip_addr_t *ip, bool probe)
+{
+    if (!_str_null_or_empty(name->service) || !_str_null_or_empty(name->proto)) {
+        return;
+    }
+    mdns_host_item_t *host = _mdns_get_delegated_host(name->host);
+    if (!host || !_mdns_pcb_host_probing(tcpip_if, ip_protocol, host)
+            || _mdns_check_host_collision(host, ip, probe) <= 0) {
+        return;
+    }
+    ESP_LOGW(TAG, "Delegated hostname %s is used by another host, giving it up", host->hostname);
+    host->conflicted = true;
+    for (uint8_t i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (uint8_t j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_remove_scheduled_pcb_host_packets((mdns_if_t)i, (mdns_ip_protocol_t)j, host, true);
+        }
+    }
+}
+
 static bool _hostname_is_ours(const char *hostname)
 {
     if (!_str_null_or_empty(_mdns_server->hostname) &&
             strcasecmp(hostname, _mdns_server->hostname) == 0) {
         return true;
     }
-    mdns_host_item_t *host = _mdns_host_list;
-    while (host != NULL) {
-        if (strcasecmp(hostname, host->hostname) == 0) {
-            return true;
-        }
-        host = host->next;
-    }
-    return false;
+    return _mdns_get_delegated_host(hostname) != NULL;
 }
 
 /**
  * @brief Adds a delegated hostname to the linked list
  * @param hostname Host name pointer
  * @param address_list Address list
- * @return  true on success
- *          false if the host wasn't attached (this is our hostname, or alloc failure) so we have to free the structs
+ * @return  the added host on success
+ *          NULL if the host wasn't attached (this is our hostname, or alloc failure) so we have to free the structs
  */
-static bool _mdns_delegate_hostname_add(const char *hostname, mdns_ip_addr_t *address_list)
+static mdns_host_item_t *_mdns_delegate_hostname_add(const char *hostname, mdns_ip_addr_t *address_list)
 {
-    if (_hostname_is_ours(hostname)) {
-        return false;
+    if (_hostname_is_ours(hostname) || !_mdns_index_reserve(&_mdns_server->index.hosts)) {
+        return NULL;
     }
 
     mdns_host_item_t *host = (mdns_host_item_t *)mdns_mem_malloc(sizeof(mdns_host_item_t));
 
     if (host == NULL) {
-        return false;
+        return NULL;
     }
     host->address_list = address_list;
     host->hostname = hostname;
+    host->conflicted = false;
     host->next = _mdns_host_list;
     _mdns_host_list = host;
-    return true;
+    _mdns_index_insert(&_mdns_server->index.hosts, _mdns_name_suffix_hash(hostname, 0), host);
+    _mdns_snapshot_invalidate();
+    return host;
 }
 
 static void free_address_list(mdns_ip_addr_t *address_list)
@@ -3170,72 +4938,307 @@ static void free_address_list(mdns_ip_addr_t *address_list)
 }
 
 
-static bool _mdns_delegate_hostname_set_address(const char *hostname, mdns_ip_addr_t *address_list)
+static bool _mdns_delegate_hostname_set_address(const char *hostname, mdns_ip_addr_t *address_list)
+{
+    if (!_str_null_or_empty(_mdns_server->hostname) &&
+            strcasecmp(hostname, _mdns_server->hostname) == 0) {
+        return false;
+    }
+    mdns_host_item_t *host = _mdns_get_delegated_host(hostname);
+    if (host) {
+        // free previous address list
+        free_address_list(host->address_list);
+        // set current address list to the host
+        host->address_list = address_list;
+        _mdns_snapshot_invalidate();
+        if (host->conflicted) {
+            // claim the name again
+            host->conflicted = false;
+            _mdns_probe_host_all_pcbs(host);
+        } else {
+            _mdns_announce_host_all_pcbs(host);
+        }
+        return true;
+    }
+    return false;
+}
+
+static mdns_ip_addr_t *copy_address_list(const mdns_ip_addr_t *address_list)
+{
+    mdns_ip_addr_t *head = NULL;
+    mdns_ip_addr_t *tail = NULL;
+    while (address_list != NULL) {
+        mdns_ip_addr_t *addr = (mdns_ip_addr_t *)mdns_mem_malloc(sizeof(mdns_ip_addr_t));
+        if (addr == NULL) {
+            free_address_list(head);
+            return NULL;
+        }
+        addr->addr = address_list->addr;
+        addr->next = NULL;
+        if (head == NULL) {
+            head = addr;
+            tail = addr;
+        } else {
+            tail->next = addr;
+            tail = tail->next;
+        }
+        address_list = address_list->next;
+    }
+    return head;
+}
+
+static void free_delegated_hostnames(void)
+{
+    mdns_host_item_t *host = _mdns_host_list;
+    while (host != NULL) {
+        _mdns_remove_scheduled_host_packets(host);
+        free_address_list(host->address_list);
+        mdns_mem_free((char *)host->hostname);
+        mdns_host_item_t *item = host;
+        host = host->next;
+        mdns_mem_free(item);
+    }
+    _mdns_host_list = NULL;
+    _mdns_index_free(&_mdns_server->index.hosts);
+    _mdns_snapshot_invalidate();
+}
+
+static size_t _mdns_snapshot_str_size(const char *str)
+{
+    return str ? strlen(str) + 1 : 0;
+}
+
+static const char *_mdns_snapshot_str(char **strings, const char *str)
+{
+    if (!str) {
+        return NULL;
+    }
+    size_t len = strlen(str) + 1;
+    char *copy = *strings;
+    memcpy(copy, str, len);
+    *strings += len;
+    return copy;
+}
+
+/**
+ * @brief  copies the names, services and delegated hosts into one allocation
+ */
+static mdns_snapshot_t *_mdns_snapshot_build(void)
+{
+    const char *default_instance = _mdns_get_default_instance_name();
+    size_t services_len = 0, txt_len = 0, hosts_len = 0, addr_len = 0;
+    size_t strings_len = _mdns_snapshot_str_size(_mdns_server->hostname) + _mdns_snapshot_str_size(default_instance);
+    mdns_srv_item_t *s;
+    mdns_txt_linked_item_t *t;
+    mdns_host_item_t *h;
+    mdns_ip_addr_t *a;
+
+    for (s = _mdns_server->services; s; s = s->next) {
+        mdns_service_t *srv = s->service;
+        services_len++;
+        strings_len += _mdns_snapshot_str_size(srv->instance) + _mdns_snapshot_str_size(srv->service)
+                       + _mdns_snapshot_str_size(srv->proto) + _mdns_snapshot_str_size(srv->hostname);
+        for (t = srv->txt; t; t = t->next) {
+            txt_len++;
+            strings_len += _mdns_snapshot_str_size(t->key) + t->value_len + 1;
+        }
+    }
+    for (h = _mdns_host_list; h; h = h->next) {
+        hosts_len++;
+        strings_len += _mdns_snapshot_str_size(h->hostname);
+        for (a = h->address_list; a; a = a->next) {
+            addr_len++;
+        }
+    }
+
+    // the structures first, all of them are pointer aligned, the strings after them
+    mdns_snapshot_t *snap = (mdns_snapshot_t *)mdns_mem_calloc(1, sizeof(mdns_snapshot_t) + services_len * sizeof(mdns_service_t)
+                                                               + txt_len * sizeof(mdns_txt_linked_item_t) + hosts_len * sizeof(mdns_host_item_t)
+                                                               + addr_len * sizeof(mdns_ip_addr_t) + strings_len);
+    if (!snap) {
+        HOOK_MALLOC_FAILED;
+        return NULL;
+    }
+    mdns_service_t *services = (mdns_service_t *)(snap + 1);
+    mdns_txt_linked_item_t *txt = (mdns_txt_linked_item_t *)(services + services_len);
+    mdns_host_item_t *hosts = (mdns_host_item_t *)(txt + txt_len);
+    mdns_ip_addr_t *addrs = (mdns_ip_addr_t *)(hosts + hosts_len);
+    char *strings = (char *)(addrs + addr_len);
+
+    snap->hostname = _mdns_snapshot_str(&strings, _mdns_server->hostname);
+    snap->default_instance = _mdns_snapshot_str(&strings, default_instance);
+    snap->services = services;
+    snap->services_len = services_len;
+    for (s = _mdns_server->services; s; s = s->next, services++) {
+        mdns_service_t *srv = s->service;
+        services->instance = _mdns_snapshot_str(&strings, srv->instance);
+        services->service = _mdns_snapshot_str(&strings, srv->service);
+        services->proto = _mdns_snapshot_str(&strings, srv->proto);
+        services->hostname = _mdns_snapshot_str(&strings, srv->hostname);
+        services->priority = srv->priority;
+        services->weight = srv->weight;
+        services->port = srv->port;
+        mdns_txt_linked_item_t **txt_link = &services->txt;
+        for (t = srv->txt; t; t = t->next, txt++) {
+            txt->key = _mdns_snapshot_str(&strings, t->key);
+            if (t->value) {
+                memcpy(strings, t->value, t->value_len);
+                txt->value = strings;
+            }
+            strings[t->value_len] = 0;
+            strings += t->value_len + 1;
+            txt->value_len = t->value_len;
+            *txt_link = txt;
+            txt_link = &txt->next;
+        }
+    }
+    mdns_host_item_t **host_link = &snap->hosts;
+    for (h = _mdns_host_list; h; h = h->next, hosts++) {
+        hosts->hostname = _mdns_snapshot_str(&strings, h->hostname);
+        mdns_ip_addr_t **addr_link = &hosts->address_list;
+        for (a = h->address_list; a; a = a->next, addrs++) {
+            addrs->addr = a->addr;
+            *addr_link = addrs;
+            addr_link = &addrs->next;
+        }
+        *host_link = hosts;
+        host_link = &hosts->next;
+    }
+    return snap;
+}
+
+static void _mdns_snapshot_free_list(mdns_snapshot_t *snap)
+{
+    while (snap) {
+        mdns_snapshot_t *next = snap->retired_next;
+        mdns_mem_free(snap);
+        snap = next;
+    }
+}
+
+/**
+ * @brief  pushes a list of replaced snapshots to the retired ones
+ */
+static void _mdns_snapshot_retire(mdns_snapshot_t *list)
+{
+    mdns_snapshot_t *tail = list;
+    while (tail->retired_next) {
+        tail = tail->retired_next;
+    }
+    mdns_snapshot_t *head = atomic_load(&s_snapshot_retired);
+    do {
+        tail->retired_next = head;
+    } while (!atomic_compare_exchange_weak(&s_snapshot_retired, &head, list));
+}
+
+/**
+ * @brief  frees the retired snapshots if no reader is left, otherwise puts them back
+ *
+ * Snapshots are retired only after they were replaced, so a reader which registers after the
+ * retired list was taken gets a newer one. A reader registered before is seen in the reader count.
+ */
+static void _mdns_snapshot_reclaim(void)
+{
+    mdns_snapshot_t *list = atomic_exchange(&s_snapshot_retired, NULL);
+    if (!list) {
+        return;
+    }
+    if (atomic_load(&s_snapshot_readers) == 0) {
+        _mdns_snapshot_free_list(list);
+    } else {
+        _mdns_snapshot_retire(list);
+    }
+}
+
+/**
+ * @brief  publishes a new snapshot if anything changed and frees the replaced ones
+ *
+ * Called with the service lock held, so there is only one writer. The last reader to
+ * release its snapshot frees the retired ones as well, so they do not pile up while
+ * readers keep overlapping with the writer.
+ */
+static void _mdns_snapshot_sync(void)
+{
+    if (_mdns_server && s_snapshot_dirty) {
+        mdns_snapshot_t *snap = _mdns_snapshot_build();
+        // on failure the readers keep the previous snapshot and the next unlock retries
+        if (snap) {
+            mdns_snapshot_t *old = atomic_exchange(&s_snapshot, snap);
+            if (old) {
+                old->retired_next = NULL;
+                _mdns_snapshot_retire(old);
+            }
+            s_snapshot_dirty = false;
+        }
+    }
+    _mdns_snapshot_reclaim();
+}
+
+static void _mdns_snapshot_free_all(void)
+{
+    _mdns_snapshot_free_list(atomic_exchange(&s_snapshot, NULL));
+    _mdns_snapshot_free_list(atomic_exchange(&s_snapshot_retired, NULL));
+}
+
+/**
+ * @brief  returns the current snapshot (NULL before the first one is published), to be read until _mdns_snapshot_release()
+ */
+static const mdns_snapshot_t *_mdns_snapshot_acquire(void)
+{
+    atomic_fetch_add(&s_snapshot_readers, 1);
+    return atomic_load(&s_snapshot);
+}
+
+static inline void _mdns_snapshot_release(void)
+{
+    if (atomic_fetch_sub(&s_snapshot_readers, 1) == 1) {
+        _mdns_snapshot_reclaim();
+    }
+}
+
+static bool _mdns_snapshot_instance_match(const mdns_snapshot_t *snap, const char *lhs, const char *rhs)
+{
+    lhs = lhs ? lhs : snap->default_instance;
+    rhs = rhs ? rhs : snap->default_instance;
+    return lhs && rhs && !strcasecmp(lhs, rhs);
+}
+
+static bool _mdns_snapshot_service_match(const mdns_snapshot_t *snap, const mdns_service_t *srv, const char *instance,
+                                         const char *service, const char *proto, const char *hostname)
+{
+    return _mdns_service_match(srv, service, proto, hostname) && (!instance || _mdns_snapshot_instance_match(snap, srv->instance, instance));
+}
+
+static bool _mdns_snapshot_hostname_is_ours(const mdns_snapshot_t *snap, const char *hostname)
 {
-    if (!_str_null_or_empty(_mdns_server->hostname) &&
-            strcasecmp(hostname, _mdns_server->hostname) == 0) {
-        return false;
+    if (!_str_null_or_empty(snap->hostname) && strcasecmp(hostname, snap->hostname) == 0) {
+        return true;
     }
-    mdns_host_item_t *host = _mdns_host_list;
-    while (host != NULL) {
+    for (mdns_host_item_t *host = snap->hosts; host; host = host->next) {
         if (strcasecmp(hostname, host->hostname) == 0) {
-            // free previous address list
-            free_address_list(host->address_list);
-            // set current address list to the host
-            host->address_list = address_list;
             return true;
         }
-        host = host->next;
     }
     return false;
 }
 
-static mdns_ip_addr_t *copy_address_list(const mdns_ip_addr_t *address_list)
-{
-    mdns_ip_addr_t *head = NULL;
-    mdns_ip_addr_t *tail = NULL;
-    while (address_list != NULL) {
-        mdns_ip_addr_t *addr = (mdns_ip_addr_t *)mdns_mem_malloc(sizeof(mdns_ip_addr_t));
-        if (addr == NULL) {
-            free_address_list(head);
-            return NULL;
-        }
-        addr->addr = address_list->addr;
-        addr->next = NULL;
-        if (head == NULL) {
-            head = addr;
-            tail = addr;
-        } else {
-            tail->next = addr;
-            tail = tail->next;
-        }
-        address_list = address_list->next;
-    }
-    return head;
-}
-
-static void free_delegated_hostnames(void)
-{
-    mdns_host_item_t *host = _mdns_host_list;
-    while (host != NULL) {
-        free_address_list(host->address_list);
-        mdns_mem_free((char *)host->hostname);
-        mdns_host_item_t *item = host;
-        host = host->next;
-        mdns_mem_free(item);
-    }
-    _mdns_host_list = NULL;
-}
-
 static bool _mdns_delegate_hostname_remove(const char *hostname)
 {
+    mdns_host_item_t *host = _mdns_get_delegated_host(hostname);
+    if (host) {
+        _mdns_send_host_bye(host);
+        _mdns_remove_scheduled_host_packets(host);
+    }
     mdns_srv_item_t *srv = _mdns_server->services;
     mdns_srv_item_t *prev_srv = NULL;
     while (srv) {
         if (strcasecmp(srv->service->hostname, hostname) == 0) {
             mdns_srv_item_t *to_free = srv;
-            _mdns_send_bye(&srv, 1, false);
+            if (!host) {
+                _mdns_send_bye(&srv, 1, false);
+            }
             _mdns_remove_scheduled_service_packets(srv->service);
+            _mdns_service_index_remove(srv);
             if (prev_srv == NULL) {
                 _mdns_server->services = srv->next;
                 srv = srv->next;
@@ -3250,24 +5253,23 @@ static bool _mdns_delegate_hostname_remove(const char *hostname)
             srv = srv->next;
         }
     }
-    mdns_host_item_t *host = _mdns_host_list;
-    mdns_host_item_t *prev_host = NULL;
-    while (host != NULL) {
-        if (strcasecmp(hostname, host->hostname) == 0) {
-            if (prev_host == NULL) {
-                _mdns_host_list = host->next;
-            } else {
-                prev_host->next = host->next;
-            }
-            free_address_list(host->address_list);
-            mdns_mem_free((char *)host->hostname);
-            mdns_mem_free(host);
-            break;
-        } else {
-            prev_host = host;
-            host = host->next;
-        }
+    if (!host) {
+        return true;
+    }
+    mdns_index_slot_t *slot = _mdns_index_find(&_mdns_server->index.hosts, _mdns_name_suffix_hash(hostname, 0), _mdns_host_key_match, hostname);
+    if (slot) {
+        _mdns_index_remove(&_mdns_server->index.hosts, slot);
+    }
+    mdns_host_item_t **link = &_mdns_host_list;
+    while (*link != host) {
+        link = &(*link)->next;
     }
+    *link = host->next;
+    free_address_list(host->address_list);
+    mdns_mem_free((char *)host->hostname);
+    _mdns_multicast_stamps_forget(host);
+    mdns_mem_free(host);
+    _mdns_snapshot_invalidate();
     return true;
 }
 
@@ -3327,7 +5329,8 @@ static bool _mdns_name_is_ours(mdns_name_t *name)
         if (!_str_null_or_empty(name->host)
                 && !_str_null_or_empty(_mdns_server->hostname)
                 && _hostname_is_ours(name->host)) {
-            return true;
+            mdns_host_item_t *host = _mdns_get_delegated_host(name->host);
+            return !host || !host->conflicted;
         }
         return false;
     }
@@ -3413,9 +5416,7 @@ static const uint8_t *_mdns_parse_fqdn(const uint8_t *packet, const uint8_t *sta
     name->domain[0] = 0;
     name->invalid = false;
 
-    static char buf[MDNS_NAME_BUF_LEN];
-
-    const uint8_t *next_data = (uint8_t *)_mdns_read_fqdn(packet, start, name, buf, packet_len);
+    const uint8_t *next_data = _mdns_read_fqdn(packet, start, name, packet_len);
     if (!next_data) {
         return 0;
     }
@@ -3440,13 +5441,13 @@ static const uint8_t *_mdns_parse_fqdn(const uint8_t *packet, const uint8_t *sta
 /**
  * @brief  Called from parser to check if question matches particular service
  */
-static bool _mdns_question_matches(mdns_parsed_question_t *question, uint16_t type, mdns_srv_item_t *service)
+static bool _mdns_question_matches(mdns_parsed_question_t *question, uint16_t type, mdns_srv_item_t *service, const char *hostname)
 {
     if (question->type != type) {
         return false;
     }
     if (type == MDNS_TYPE_A || type == MDNS_TYPE_AAAA) {
-        return true;
+        return !hostname || (question->host && !strcasecmp(question->host, hostname));
     } else if (type == MDNS_TYPE_PTR || type == MDNS_TYPE_SDPTR) {
         if (question->service && question->proto && question->domain
                 && !strcasecmp(service->service->service, question->service)
@@ -3474,34 +5475,51 @@ static bool _mdns_question_matches(mdns_parsed_question_t *question, uint16_t ty
 
 /**
  * @brief  Removes saved question from parsed data
+ *
+ * @param  hostname   host of the address question, NULL to match any
+ *
+ * @return true if a question was removed
  */
-static void _mdns_remove_parsed_question(mdns_parsed_packet_t *parsed_packet, uint16_t type, mdns_srv_item_t *service)
+static bool _mdns_remove_parsed_question(mdns_parsed_packet_t *parsed_packet, uint16_t type, mdns_srv_item_t *service, const char *hostname)
 {
-    mdns_parsed_question_t *q = parsed_packet->questions;
+    mdns_parsed_question_t **link = &parsed_packet->questions;
 
-    if (_mdns_question_matches(q, type, service)) {
-        parsed_packet->questions = q->next;
-        mdns_mem_free(q->host);
-        mdns_mem_free(q->service);
-        mdns_mem_free(q->proto);
-        mdns_mem_free(q->domain);
-        mdns_mem_free(q);
-        return;
+    // questions live in the parse memory, released with the whole packet
+    while (*link) {
+        if (_mdns_question_matches(*link, type, service, hostname)) {
+            *link = (*link)->next;
+            return true;
+        }
+        link = &(*link)->next;
     }
+    return false;
+}
 
-    while (q->next) {
-        mdns_parsed_question_t *p = q->next;
-        if (_mdns_question_matches(p, type, service)) {
-            q->next = p->next;
-            mdns_mem_free(p->host);
-            mdns_mem_free(p->service);
-            mdns_mem_free(p->proto);
-            mdns_mem_free(p->domain);
-            mdns_mem_free(p);
-            return;
+/**
+ * @brief  Suppresses our answer which the querier listed as a known answer (RFC 6762, 7.1)
+ *
+ * Known answers of a query with the TC bit continue in packets without questions (RFC 6762, 7.2),
+ * those are removed from the response already scheduled for the query.
+ *
+ * @param  continuation   the packet continues the known-answer list of a truncated query
+ * @param  service        service of the record, NULL for address records
+ * @param  hostname       host of the address record
+ */
+static void _mdns_known_answer_suppress(mdns_parsed_packet_t *parsed_packet, bool continuation, uint16_t type, uint32_t ttl,
+                                        mdns_srv_item_t *service, const char *hostname)
+{
+    if (!_mdns_answer_ttl_fresh(type, ttl)) {
+        return;
+    }
+    if (!continuation) {
+        if (_mdns_remove_parsed_question(parsed_packet, type, service, hostname)) {
+            _mdns_server->stats.known_answers_suppressed++;
         }
-        q = q->next;
+        return;
     }
+    mdns_host_item_t *host = service ? NULL : mdns_get_host_item(hostname);
+    _mdns_server->stats.known_answers_suppressed +=
+        _mdns_remove_scheduled_answer(parsed_packet->tcpip_if, parsed_packet->ip_protocol, type, service, host, parsed_packet);
 }
 
 /**
@@ -3644,29 +5662,43 @@ handle_error :
 }
 
 /**
- * @brief  Duplicate string or return error
+ * @brief  Size of a part of the parsed name kept behind its parsed question or record, empty parts are not kept
  */
-static esp_err_t _mdns_strdup_check(char **out, char *in)
+static size_t _mdns_name_part_size(const char *part)
 {
-    if (in && in[0]) {
-        *out = mdns_mem_strdup(in);
-        if (!*out) {
-            return ESP_FAIL;
-        }
-        return ESP_OK;
+    return part[0] ? strlen(part) + 1 : 0;
+}
+
+/**
+ * @brief  Copies a part of the parsed name behind its parsed question or record
+ *
+ * @param  strings      the memory behind the question or record, advanced past the copy
+ *
+ * @return the copy, NULL for an empty part
+ */
+static char *_mdns_name_part_copy(char **strings, const char *part)
+{
+    size_t len = _mdns_name_part_size(part);
+    if (!len) {
+        return NULL;
     }
-    *out = NULL;
-    return ESP_OK;
+    char *copy = (char *)memcpy(*strings, part, len);
+    *strings += len;
+    return copy;
 }
 
 /**
  * @brief  main packet parser
  *
+ * Everything parsed from the packet is kept in the parser context, so parsers with their own
+ * contexts do not share any state. A question or record and its names are one allocation of the
+ * context's arena, typical packets are parsed without heap allocations.
+ *
+ * @param  ctx          the parser context
  * @param  packet       the packet
  */
-void mdns_parse_packet(mdns_rx_packet_t *packet)
+static void _mdns_parse_packet(mdns_parse_ctx_t *ctx, mdns_rx_packet_t *packet)
 {
-    static mdns_name_t n;
     mdns_header_t header;
     const uint8_t *data = _mdns_get_packet_data(packet);
     size_t len = _mdns_get_packet_len(packet);
@@ -3675,9 +5707,10 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
     mdns_search_once_t *search_result = NULL;
     mdns_browse_t *browse_result = NULL;
     char *browse_result_instance = NULL;
-    char *browse_result_service = NULL;
-    char *browse_result_proto = NULL;
-    mdns_browse_sync_t *out_sync_browse = NULL;
+    mdns_traffic_stats_t *traffic = &_mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol].traffic;
+
+    traffic->rx_packets++;
+    traffic->rx_bytes += len;
 
 #ifdef MDNS_ENABLE_DEBUG
     _mdns_dbg_printf("\nRX[%lu][%lu]: ", (unsigned long)packet->tcpip_if, (unsigned long)packet->ip_protocol);
@@ -3718,17 +5751,19 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
 
     // Check for the minimum size of mdns packet
     if (len <=  MDNS_HEAD_ADDITIONAL_OFFSET) {
+        _mdns_server->stats.parse_failures++;
         return;
     }
 
-    mdns_parsed_packet_t *parsed_packet = (mdns_parsed_packet_t *)mdns_mem_malloc(sizeof(mdns_parsed_packet_t));
+    // everything parsed from the packet is allocated from the parse memory and released at once at the end
+    mdns_parsed_packet_t *parsed_packet = (mdns_parsed_packet_t *)mdns_mem_parse_malloc(&ctx->arena, sizeof(mdns_parsed_packet_t));
     if (!parsed_packet) {
         HOOK_MALLOC_FAILED;
         return;
     }
     memset(parsed_packet, 0, sizeof(mdns_parsed_packet_t));
 
-    mdns_name_t *name = &n;
+    mdns_name_t *name = &ctx->name;
     memset(name, 0, sizeof(mdns_name_t));
 
     header.id = _mdns_read_u16(data, MDNS_HEAD_ID_OFFSET);
@@ -3739,13 +5774,13 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
     header.additional = _mdns_read_u16(data, MDNS_HEAD_ADDITIONAL_OFFSET);
 
     if (header.flags == MDNS_FLAGS_QR_AUTHORITATIVE && packet->src_port != MDNS_SERVICE_PORT) {
-        mdns_mem_free(parsed_packet);
+        mdns_mem_parse_free_all(&ctx->arena);
         return;
     }
 
     //if we have not set the hostname, we can not answer questions
     if (header.questions && !header.answers && _str_null_or_empty(_mdns_server->hostname)) {
-        mdns_mem_free(parsed_packet);
+        mdns_mem_parse_free_all(&ctx->arena);
         return;
     }
 
@@ -3754,6 +5789,9 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
     parsed_packet->multicast = packet->multicast;
     parsed_packet->authoritative = (header.flags == MDNS_FLAGS_QR_AUTHORITATIVE);
     parsed_packet->distributed = header.flags == MDNS_FLAGS_DISTRIBUTED;
+    if (parsed_packet->distributed) {
+        _mdns_server->stats.truncated_queries_received++;
+    }
     parsed_packet->id = header.id;
     esp_netif_ip_addr_copy(&parsed_packet->src, &packet->src);
     parsed_packet->src_port = packet->src_port;
@@ -3768,10 +5806,12 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 header.answers = 0;
                 header.additional = 0;
                 header.servers = 0;
+                _mdns_server->stats.parse_failures++;
                 goto clear_rx_packet;//error
             }
 
             if (content + MDNS_CLASS_OFFSET + 1 >= data + len) {
+                _mdns_server->stats.parse_failures++;
                 goto clear_rx_packet; // malformed packet, won't read behind it
             }
             uint16_t type = _mdns_read_u16(content, MDNS_TYPE_OFFSET);
@@ -3789,23 +5829,22 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 parsed_packet->discovery = true;
                 mdns_srv_item_t *a = _mdns_server->services;
                 while (a) {
-                    mdns_parsed_question_t *question = (mdns_parsed_question_t *)mdns_mem_calloc(1, sizeof(mdns_parsed_question_t));
+                    mdns_parsed_question_t *question = (mdns_parsed_question_t *)mdns_mem_parse_malloc(&ctx->arena, sizeof(mdns_parsed_question_t));
                     if (!question) {
                         HOOK_MALLOC_FAILED;
                         goto clear_rx_packet;
                     }
+                    memset(question, 0, sizeof(mdns_parsed_question_t));
                     question->next = parsed_packet->questions;
                     parsed_packet->questions = question;
 
+                    // the services do not change while the packet is processed, refer to their names
                     question->unicast = unicast;
                     question->type = MDNS_TYPE_SDPTR;
                     question->host = NULL;
-                    question->service = mdns_mem_strdup(a->service->service);
-                    question->proto = mdns_mem_strdup(a->service->proto);
-                    question->domain = mdns_mem_strdup(MDNS_DEFAULT_DOMAIN);
-                    if (!question->service || !question->proto || !question->domain) {
-                        goto clear_rx_packet;
-                    }
+                    question->service = (char *)a->service->service;
+                    question->proto = (char *)a->service->proto;
+                    question->domain = (char *)MDNS_DEFAULT_DOMAIN;
                     a = a->next;
                 }
                 continue;
@@ -3818,23 +5857,25 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 parsed_packet->probe = true;
             }
 
-            mdns_parsed_question_t *question = (mdns_parsed_question_t *)mdns_mem_calloc(1, sizeof(mdns_parsed_question_t));
+            mdns_parsed_question_t *question = (mdns_parsed_question_t *)mdns_mem_parse_malloc(&ctx->arena, sizeof(mdns_parsed_question_t)
+                                               + _mdns_name_part_size(name->host) + _mdns_name_part_size(name->service)
+                                               + _mdns_name_part_size(name->proto) + _mdns_name_part_size(name->domain));
             if (!question) {
                 HOOK_MALLOC_FAILED;
                 goto clear_rx_packet;
             }
+            memset(question, 0, sizeof(mdns_parsed_question_t));
             question->next = parsed_packet->questions;
             parsed_packet->questions = question;
 
             question->unicast = unicast;
             question->type = type;
             question->sub = name->sub;
-            if (_mdns_strdup_check(&(question->host), name->host)
-                    || _mdns_strdup_check(&(question->service), name->service)
-                    || _mdns_strdup_check(&(question->proto), name->proto)
-                    || _mdns_strdup_check(&(question->domain), name->domain)) {
-                goto clear_rx_packet;
-            }
+            char *strings = (char *)(question + 1);
+            question->host = _mdns_name_part_copy(&strings, name->host);
+            question->service = _mdns_name_part_copy(&strings, name->service);
+            question->proto = _mdns_name_part_copy(&strings, name->proto);
+            question->domain = _mdns_name_part_copy(&strings, name->domain);
         }
     }
 
@@ -3842,15 +5883,21 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
         goto clear_rx_packet;
     } else if (header.answers || header.servers || header.additional) {
         uint16_t recordIndex = 0;
+        // records of a query are the known answers of the querier, records of a response are answers of another responder
+        bool known_answers = !(header.flags & MDNS_FLAGS_QUERY_REPSONSE);
+        // known answers of a query with the TC bit continue in packets without questions (RFC 6762, 7.2)
+        bool continuation = known_answers && !header.questions;
 
         while (content < (data + len)) {
 
             content = _mdns_parse_fqdn(data, content, name, len);
             if (!content) {
+                _mdns_server->stats.parse_failures++;
                 goto clear_rx_packet;//error
             }
 
             if (content + MDNS_LEN_OFFSET + 1 >= data + len) {
+                _mdns_server->stats.parse_failures++;
                 goto clear_rx_packet; // malformed packet, won't read behind it
             }
             uint16_t type = _mdns_read_u16(content, MDNS_TYPE_OFFSET);
@@ -3858,10 +5905,12 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
             uint32_t ttl = _mdns_read_u32(content, MDNS_TTL_OFFSET);
             uint16_t data_len = _mdns_read_u16(content, MDNS_LEN_OFFSET);
             const uint8_t *data_ptr = content + MDNS_DATA_OFFSET;
+            bool cache_flush = mdns_class & 0x8000;
             mdns_class &= 0x7FFF;
 
             content = data_ptr + data_len;
             if (content > (data + len) || data_len == 0) {
+                _mdns_server->stats.parse_failures++;
                 goto clear_rx_packet;
             }
 
@@ -3869,6 +5918,14 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
             bool ours = false;
             mdns_srv_item_t *service = NULL;
             mdns_parsed_record_type_t record_type = MDNS_ANSWER;
+            // answers of other hosts are cached, see _mdns_cache_add()
+            mdns_cache_entry_t cache_record = {
+                .type = type,
+                .ttl = ttl,
+                .tcpip_if = packet->tcpip_if,
+                .ip_protocol = packet->ip_protocol,
+            };
+            bool cacheable = false;
 
             if (recordIndex >= (header.answers + header.servers)) {
                 record_type = MDNS_EXTRA;
@@ -3886,7 +5943,9 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 discovery = true;
             } else if (!name->sub && _mdns_name_is_ours(name)) {
                 ours = true;
-                if (name->service[0] && name->proto[0]) {
+                if (name->host[0] && name->service[0] && name->proto[0]) {
+                    service = _mdns_get_service_item_instance(name->host, name->service, name->proto, NULL);
+                } else if (name->service[0] && name->proto[0]) {
                     service = _mdns_get_service_item(name->service, name->proto, NULL);
                 }
             } else {
@@ -3894,38 +5953,16 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                     //skip this record
                     continue;
                 }
+                cacheable = !name->sub;
+                cache_record.host = name->host;
+                cache_record.service = name->service;
+                cache_record.proto = name->proto;
                 search_result = _mdns_search_find_from(_mdns_server->search_once, name, type, packet->tcpip_if, packet->ip_protocol);
                 browse_result = _mdns_browse_find_from(_mdns_server->browse, name, type, packet->tcpip_if, packet->ip_protocol);
                 if (browse_result) {
-                    if (!out_sync_browse) {
-                        // will be freed in function `_mdns_browse_sync`
-                        out_sync_browse = (mdns_browse_sync_t *)mdns_mem_malloc(sizeof(mdns_browse_sync_t));
-                        if (!out_sync_browse) {
-                            HOOK_MALLOC_FAILED;
-                            goto clear_rx_packet;
-                        }
-                        out_sync_browse->browse = browse_result;
-                        out_sync_browse->sync_result = NULL;
-                    }
-                    if (!browse_result_service) {
-                        browse_result_service = (char *)mdns_mem_malloc(MDNS_NAME_BUF_LEN);
-                        if (!browse_result_service) {
-                            HOOK_MALLOC_FAILED;
-                            goto clear_rx_packet;
-                        }
-                    }
-                    memcpy(browse_result_service, browse_result->service, MDNS_NAME_BUF_LEN);
-                    if (!browse_result_proto) {
-                        browse_result_proto = (char *)mdns_mem_malloc(MDNS_NAME_BUF_LEN);
-                        if (!browse_result_proto) {
-                            HOOK_MALLOC_FAILED;
-                            goto clear_rx_packet;
-                        }
-                    }
-                    memcpy(browse_result_proto, browse_result->proto, MDNS_NAME_BUF_LEN);
                     if (type == MDNS_TYPE_SRV || type == MDNS_TYPE_TXT) {
                         if (!browse_result_instance) {
-                            browse_result_instance = (char *)mdns_mem_malloc(MDNS_NAME_BUF_LEN);
+                            browse_result_instance = (char *)mdns_mem_parse_malloc(&ctx->arena, MDNS_NAME_BUF_LEN);
                             if (!browse_result_instance) {
                                 HOOK_MALLOC_FAILED;
                                 goto clear_rx_packet;
@@ -3940,6 +5977,12 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 if (!_mdns_parse_fqdn(data, data_ptr, name, len)) {
                     continue;//error
                 }
+                // the owner (service.proto) and the instance share the service and proto of the parsed name
+                if (cacheable && name->host[0] && name->service[0] && name->proto[0]) {
+                    cache_record.host = "";
+                    cache_record.target = name->host;
+                    _mdns_cache_add(&cache_record, cache_flush);
+                }
                 if (search_result) {
                     _mdns_search_result_add_ptr(search_result, name->host, name->service, name->proto,
                                                 packet->tcpip_if, packet->ip_protocol, ttl);
@@ -3949,68 +5992,39 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                     } else {
                         service = _mdns_get_service_item(name->service, name->proto, NULL);
                     }
-                    if (discovery && service) {
-                        _mdns_remove_parsed_question(parsed_packet, MDNS_TYPE_SDPTR, service);
-                    } else if (service && parsed_packet->questions && !parsed_packet->probe) {
-                        _mdns_remove_parsed_question(parsed_packet, type, service);
-                    } else if (service) {
-                        //check if TTL is more than half of the full TTL value (4500)
-                        if (ttl > (MDNS_ANSWER_PTR_TTL / 2)) {
-                            _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, service);
-                        }
+                    if (!service || !_mdns_answer_ttl_fresh(type, ttl)) {
+                        continue;
                     }
-                    if (service) {
-                        mdns_parsed_record_t *record = mdns_mem_malloc(sizeof(mdns_parsed_record_t));
+                    if (!known_answers) {
+                        _mdns_server->stats.duplicate_answers_suppressed +=
+                            _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, service, NULL, NULL);
+                    } else if (discovery || continuation) {
+                        _mdns_known_answer_suppress(parsed_packet, continuation, discovery ? MDNS_TYPE_SDPTR : type, ttl, service, NULL);
+                    } else if (!parsed_packet->probe) {
+                        // several services may answer the question, known answers are matched per service when answering
+                        mdns_parsed_record_t *record = mdns_mem_parse_malloc(&ctx->arena, sizeof(mdns_parsed_record_t)
+                                                                             + _mdns_name_part_size(name->host) + _mdns_name_part_size(name->service)
+                                                                             + _mdns_name_part_size(name->proto));
                         if (!record) {
                             HOOK_MALLOC_FAILED;
                             goto clear_rx_packet;
                         }
+                        memset(record, 0, sizeof(mdns_parsed_record_t));
                         record->next = parsed_packet->records;
                         parsed_packet->records = record;
                         record->type = MDNS_TYPE_PTR;
                         record->record_type = MDNS_ANSWER;
                         record->ttl = ttl;
-                        record->host = NULL;
-                        record->service = NULL;
-                        record->proto = NULL;
-                        if (name->host[0]) {
-                            record->host = mdns_mem_malloc(MDNS_NAME_BUF_LEN);
-                            if (!record->host) {
-                                HOOK_MALLOC_FAILED;
-                                goto clear_rx_packet;
-                            }
-                            memcpy(record->host, name->host, MDNS_NAME_BUF_LEN);
-                        }
-                        if (name->service[0]) {
-                            record->service = mdns_mem_malloc(MDNS_NAME_BUF_LEN);
-                            if (!record->service) {
-                                HOOK_MALLOC_FAILED;
-                                goto clear_rx_packet;
-                            }
-                            memcpy(record->service, name->service, MDNS_NAME_BUF_LEN);
-                        }
-                        if (name->proto[0]) {
-                            record->proto = mdns_mem_malloc(MDNS_NAME_BUF_LEN);
-                            if (!record->proto) {
-                                HOOK_MALLOC_FAILED;
-                                goto clear_rx_packet;
-                            }
-                            memcpy(record->proto, name->proto, MDNS_NAME_BUF_LEN);
-                        }
+                        char *strings = (char *)(record + 1);
+                        record->host = _mdns_name_part_copy(&strings, name->host);
+                        record->service = _mdns_name_part_copy(&strings, name->service);
+                        record->proto = _mdns_name_part_copy(&strings, name->proto);
                     }
                 }
             } else if (type == MDNS_TYPE_SRV) {
                 mdns_result_t *result = NULL;
                 if (search_result && search_result->type == MDNS_TYPE_PTR) {
-                    result = search_result->result;
-                    while (result) {
-                        if (_mdns_get_esp_netif(packet->tcpip_if) == result->esp_netif
-                                && packet->ip_protocol == result->ip_protocol
-                                && result->instance_name && !strcmp(name->host, result->instance_name)) {
-                            break;
-                        }
-                        result = result->next;
-                    }
+                    result = _mdns_result_find_instance(&search_result->index, name->host, _mdns_get_esp_netif(packet->tcpip_if), packet->ip_protocol);
                     if (!result) {
                         result = _mdns_search_result_add_ptr(search_result, name->host, name->service, name->proto,
                                                              packet->tcpip_if, packet->ip_protocol, ttl);
@@ -4020,35 +6034,42 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                     }
                 }
                 bool is_selfhosted = _mdns_name_is_selfhosted(name);
+                // the target is parsed into the same name, keep the owner
+                mdns_cache_entry_t *srv_record = cacheable ? _mdns_cache_record_dup(&ctx->arena, &cache_record) : NULL;
                 if (!_mdns_parse_fqdn(data, data_ptr + MDNS_SRV_FQDN_OFFSET, name, len)) {
                     continue;//error
                 }
                 if (data_ptr + MDNS_SRV_PORT_OFFSET + 1 >= data + len) {
+                    _mdns_server->stats.parse_failures++;
                     goto clear_rx_packet; // malformed packet, won't read behind it
                 }
                 uint16_t priority = _mdns_read_u16(data_ptr, MDNS_SRV_PRIORITY_OFFSET);
                 uint16_t weight = _mdns_read_u16(data_ptr, MDNS_SRV_WEIGHT_OFFSET);
                 uint16_t port = _mdns_read_u16(data_ptr, MDNS_SRV_PORT_OFFSET);
+                if (srv_record) {
+                    srv_record->target = name->host;
+                    srv_record->port = port;
+                    _mdns_cache_add(srv_record, cache_flush);
+                }
 
                 if (browse_result) {
-                    _mdns_browse_result_add_srv(browse_result, name->host, browse_result_instance, browse_result_service,
-                                                browse_result_proto, port, packet->tcpip_if, packet->ip_protocol, ttl, out_sync_browse);
+                    _mdns_browse_result_add_srv(browse_result, name->host, browse_result_instance, port,
+                                                packet->tcpip_if, packet->ip_protocol, ttl);
                 }
                 if (search_result) {
                     if (search_result->type == MDNS_TYPE_PTR) {
                         if (!result->hostname) { // assign host/port for this entry only if not previously set
                             result->port = port;
-                            result->hostname = mdns_mem_strdup(name->host);
+                            _mdns_result_hostname_set(&search_result->index, result, name->host);
                         }
                     } else {
                         _mdns_search_result_add_srv(search_result, name->host, port, packet->tcpip_if, packet->ip_protocol, ttl);
                     }
                 } else if (ours) {
-                    if (parsed_packet->questions && !parsed_packet->probe) {
-                        _mdns_remove_parsed_question(parsed_packet, type, service);
-                        continue;
-                    } else if (parsed_packet->distributed) {
-                        _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, service);
+                    if (known_answers && !parsed_packet->probe) {
+                        if (service) {
+                            _mdns_known_answer_suppress(parsed_packet, continuation, type, ttl, service, NULL);
+                        }
                         continue;
                     }
                     if (!is_selfhosted) {
@@ -4070,9 +6091,10 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                                 _mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol].failed_probes++;
                                 if (!_str_null_or_empty(service->service->instance)) {
                                     char *new_instance = _mdns_mangle_name((char *)service->service->instance);
-                                    if (new_instance) {
-                                        mdns_mem_free((char *)service->service->instance);
-                                        service->service->instance = new_instance;
+                                    if (new_instance && _mdns_service_instance_replace(service, new_instance)) {
+                                        _mdns_service_wire_invalidate(service->service);
+                                    } else {
+                                        mdns_mem_free(new_instance);
                                     }
                                     _mdns_probe_all_pcbs(&service, 1, false, false);
                                 } else if (!_str_null_or_empty(_mdns_server->instance)) {
@@ -4080,6 +6102,7 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                                     if (new_instance) {
                                         mdns_mem_free((char *)_mdns_server->instance);
                                         _mdns_server->instance = new_instance;
+                                        _mdns_service_wire_invalidate_all();
                                     }
                                     _mdns_restart_all_pcbs_no_instance();
                                 } else {
@@ -4097,8 +6120,9 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                                 _mdns_init_pcb_probe(packet->tcpip_if, packet->ip_protocol, &service, 1, false);
                             }
                         }
-                    } else if (ttl > 60 && !col && !parsed_packet->authoritative && !parsed_packet->probe && !parsed_packet->questions) {
-                        _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, service);
+                    } else if (service && !col && !known_answers && _mdns_answer_ttl_fresh(type, ttl)) {
+                        _mdns_server->stats.duplicate_answers_suppressed +=
+                            _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, service, NULL, NULL);
                     }
                 }
             } else if (type == MDNS_TYPE_TXT) {
@@ -4106,23 +6130,21 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 uint8_t *txt_value_len = NULL;
                 size_t txt_count = 0;
 
+                if (cacheable) {
+                    cache_record.txt = data_ptr;
+                    cache_record.txt_len = data_len;
+                    _mdns_cache_add(&cache_record, cache_flush);
+                }
+
                 mdns_result_t *result = NULL;
                 if (browse_result) {
                     _mdns_result_txt_create(data_ptr, data_len, &txt, &txt_value_len, &txt_count);
-                    _mdns_browse_result_add_txt(browse_result, browse_result_instance, browse_result_service, browse_result_proto,
-                                                txt, txt_value_len, txt_count, packet->tcpip_if, packet->ip_protocol, ttl, out_sync_browse);
+                    _mdns_browse_result_add_txt(browse_result, browse_result_instance, txt, txt_value_len, txt_count,
+                                                packet->tcpip_if, packet->ip_protocol, ttl);
                 }
                 if (search_result) {
                     if (search_result->type == MDNS_TYPE_PTR) {
-                        result = search_result->result;
-                        while (result) {
-                            if (_mdns_get_esp_netif(packet->tcpip_if) == result->esp_netif
-                                    && packet->ip_protocol == result->ip_protocol
-                                    && result->instance_name && !strcmp(name->host, result->instance_name)) {
-                                break;
-                            }
-                            result = result->next;
-                        }
+                        result = _mdns_result_find_instance(&search_result->index, name->host, _mdns_get_esp_netif(packet->tcpip_if), packet->ip_protocol);
                         if (!result) {
                             result = _mdns_search_result_add_ptr(search_result, name->host, name->service, name->proto,
                                                                  packet->tcpip_if, packet->ip_protocol, ttl);
@@ -4145,8 +6167,10 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                         }
                     }
                 } else if (ours) {
-                    if (parsed_packet->questions && !parsed_packet->probe && service) {
-                        _mdns_remove_parsed_question(parsed_packet, type, service);
+                    if (known_answers && !parsed_packet->probe) {
+                        if (service) {
+                            _mdns_known_answer_suppress(parsed_packet, continuation, type, ttl, service, NULL);
+                        }
                         continue;
                     }
                     if (!_mdns_name_is_selfhosted(name)) {
@@ -4164,8 +6188,9 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                     if (col && !_mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol].probe_running && service) {
                         do_not_reply = true;
                         _mdns_init_pcb_probe(packet->tcpip_if, packet->ip_protocol, &service, 1, true);
-                    } else if (ttl > (MDNS_ANSWER_TXT_TTL / 2) && !col && !parsed_packet->authoritative && !parsed_packet->probe && !parsed_packet->questions && !_mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol].probe_running) {
-                        _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, service);
+                    } else if (service && !col && !known_answers && _mdns_answer_ttl_fresh(type, ttl) && !_mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol].probe_running) {
+                        _mdns_server->stats.duplicate_answers_suppressed +=
+                            _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, service, NULL, NULL);
                     }
                 }
 
@@ -4175,8 +6200,12 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 esp_ip_addr_t ip6;
                 ip6.type = ESP_IPADDR_TYPE_V6;
                 memcpy(ip6.u_addr.ip6.addr, data_ptr, MDNS_ANSWER_AAAA_SIZE);
+                if (cacheable) {
+                    cache_record.addr = ip6;
+                    _mdns_cache_add(&cache_record, cache_flush);
+                }
                 if (browse_result) {
-                    _mdns_browse_result_add_ip(browse_result, name->host, &ip6, packet->tcpip_if, packet->ip_protocol, ttl, out_sync_browse);
+                    _mdns_browse_result_add_ip(browse_result, name->host, &ip6, packet->tcpip_if, packet->ip_protocol, ttl);
                 }
                 if (search_result) {
                     //check for more applicable searches (PTR & A/AAAA at the same time)
@@ -4185,11 +6214,14 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                         search_result = _mdns_search_find_from(search_result->next, name, type, packet->tcpip_if, packet->ip_protocol);
                     }
                 } else if (ours) {
-                    if (parsed_packet->questions && !parsed_packet->probe) {
-                        _mdns_remove_parsed_question(parsed_packet, type, NULL);
+                    if (known_answers && !parsed_packet->probe) {
+                        _mdns_known_answer_suppress(parsed_packet, continuation, type, ttl, NULL, name->host);
                         continue;
                     }
                     if (!_mdns_name_is_selfhosted(name)) {
+                        if (mdns_class == MDNS_CLASS_IN && (parsed_packet->probe || parsed_packet->authoritative)) {
+                            _mdns_check_host_probe_conflict(packet->tcpip_if, packet->ip_protocol, name, &ip6, parsed_packet->probe);
+                        }
                         continue;
                     }
                     //detect collision (-1=won, 0=none, 1=lost)
@@ -4220,8 +6252,9 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                         } else {
                             _mdns_init_pcb_probe(packet->tcpip_if, packet->ip_protocol, NULL, 0, true);
                         }
-                    } else if (ttl > 60 && !col && !parsed_packet->authoritative && !parsed_packet->probe && !parsed_packet->questions && !_mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol].probe_running) {
-                        _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, NULL);
+                    } else if (!col && !known_answers && _mdns_answer_ttl_fresh(type, ttl) && !_mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol].probe_running) {
+                        _mdns_server->stats.duplicate_answers_suppressed +=
+                            _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, NULL, &_mdns_self_host, NULL);
                     }
                 }
 
@@ -4232,8 +6265,12 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                 esp_ip_addr_t ip;
                 ip.type = ESP_IPADDR_TYPE_V4;
                 memcpy(&(ip.u_addr.ip4.addr), data_ptr, 4);
+                if (cacheable) {
+                    cache_record.addr = ip;
+                    _mdns_cache_add(&cache_record, cache_flush);
+                }
                 if (browse_result) {
-                    _mdns_browse_result_add_ip(browse_result, name->host, &ip, packet->tcpip_if, packet->ip_protocol, ttl, out_sync_browse);
+                    _mdns_browse_result_add_ip(browse_result, name->host, &ip, packet->tcpip_if, packet->ip_protocol, ttl);
                 }
                 if (search_result) {
                     //check for more applicable searches (PTR & A/AAAA at the same time)
@@ -4242,11 +6279,14 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                         search_result = _mdns_search_find_from(search_result->next, name, type, packet->tcpip_if, packet->ip_protocol);
                     }
                 } else if (ours) {
-                    if (parsed_packet->questions && !parsed_packet->probe) {
-                        _mdns_remove_parsed_question(parsed_packet, type, NULL);
+                    if (known_answers && !parsed_packet->probe) {
+                        _mdns_known_answer_suppress(parsed_packet, continuation, type, ttl, NULL, name->host);
                         continue;
                     }
                     if (!_mdns_name_is_selfhosted(name)) {
+                        if (mdns_class == MDNS_CLASS_IN && (parsed_packet->probe || parsed_packet->authoritative)) {
+                            _mdns_check_host_probe_conflict(packet->tcpip_if, packet->ip_protocol, name, &ip, parsed_packet->probe);
+                        }
                         continue;
                     }
                     //detect collision (-1=won, 0=none, 1=lost)
@@ -4277,8 +6317,9 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
                         } else {
                             _mdns_init_pcb_probe(packet->tcpip_if, packet->ip_protocol, NULL, 0, true);
                         }
-                    } else if (ttl > 60 && !col && !parsed_packet->authoritative && !parsed_packet->probe && !parsed_packet->questions && !_mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol].probe_running) {
-                        _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, NULL);
+                    } else if (!col && !known_answers && _mdns_answer_ttl_fresh(type, ttl) && !_mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol].probe_running) {
+                        _mdns_server->stats.duplicate_answers_suppressed +=
+                            _mdns_remove_scheduled_answer(packet->tcpip_if, packet->ip_protocol, type, NULL, &_mdns_self_host, NULL);
                     }
                 }
 
@@ -4294,61 +6335,21 @@ void mdns_parse_packet(mdns_rx_packet_t *packet)
     if (!do_not_reply && _mdns_server->interfaces[packet->tcpip_if].pcbs[packet->ip_protocol].state > PCB_PROBE_3 && (parsed_packet->questions || parsed_packet->discovery)) {
         _mdns_create_answer_from_parsed_packet(parsed_packet);
     }
-    if (out_sync_browse) {
-#ifdef MDNS_ENABLE_DEBUG
-        _mdns_dbg_printf("Browse %s%s total result:", out_sync_browse->browse->service, out_sync_browse->browse->proto);
-        debug_printf_browse_result_all(out_sync_browse->browse->result);
-#endif // MDNS_ENABLE_DEBUG
-        if (out_sync_browse->sync_result) {
-#ifdef MDNS_ENABLE_DEBUG
-            _mdns_dbg_printf("Changed result:");
-            debug_printf_browse_result_all(out_sync_browse->sync_result->result);
-#endif // MDNS_ENABLE_DEBUG
-            _mdns_sync_browse_action(ACTION_BROWSE_SYNC, out_sync_browse);
-        } else {
-            mdns_mem_free(out_sync_browse);
-        }
-        out_sync_browse = NULL;
-    }
 
 clear_rx_packet:
-    while (parsed_packet->questions) {
-        mdns_parsed_question_t *question = parsed_packet->questions;
-        parsed_packet->questions = parsed_packet->questions->next;
-        if (question->host) {
-            mdns_mem_free(question->host);
-        }
-        if (question->service) {
-            mdns_mem_free(question->service);
-        }
-        if (question->proto) {
-            mdns_mem_free(question->proto);
-        }
-        if (question->domain) {
-            mdns_mem_free(question->domain);
-        }
-        mdns_mem_free(question);
-    }
-    while (parsed_packet->records) {
-        mdns_parsed_record_t *record = parsed_packet->records;
-        parsed_packet->records = parsed_packet->records->next;
-        if (record->host) {
-            mdns_mem_free(record->host);
-        }
-        if (record->service) {
-            mdns_mem_free(record->service);
-        }
-        if (record->proto) {
-            mdns_mem_free(record->proto);
-        }
-        record->next = NULL;
-        mdns_mem_free(record);
-    }
-    mdns_mem_free(parsed_packet);
-    mdns_mem_free(browse_result_instance);
-    mdns_mem_free(browse_result_service);
-    mdns_mem_free(browse_result_proto);
-    mdns_mem_free(out_sync_browse);
+    mdns_mem_parse_free_all(&ctx->arena);
+    // browses collecting changes for no window are notified after every packet
+    _mdns_browse_notify_due(xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+/**
+ * @brief  parses a packet received by the service task
+ *
+ * @param  packet       the packet
+ */
+void mdns_parse_packet(mdns_rx_packet_t *packet)
+{
+    _mdns_parse_packet(&_mdns_server->rx.parse, packet);
 }
 
 /**
@@ -4373,7 +6374,7 @@ void _mdns_disable_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
     _mdns_clean_netif_ptr(tcpip_if);
 
     if (mdns_is_netif_ready(tcpip_if, ip_protocol)) {
-        _mdns_clear_pcb_tx_queue_head(tcpip_if, ip_protocol);
+        _mdns_clear_pcb_tx_queue_head(tcpip_if, ip_protocol, false);
         mdns_pcb_deinit_local(tcpip_if, ip_protocol);
         mdns_if_t other_if = _mdns_get_other_if(tcpip_if);
         if (other_if != MDNS_MAX_INTERFACES && _mdns_server->interfaces[other_if].pcbs[ip_protocol].state == PCB_DUP) {
@@ -4579,6 +6580,7 @@ static void _mdns_search_free(mdns_search_once_t *search)
     mdns_mem_free(search->instance);
     mdns_mem_free(search->service);
     mdns_mem_free(search->proto);
+    _mdns_result_index_free(&search->index);
     vSemaphoreDelete(search->done_semaphore);
     mdns_mem_free(search);
 }
@@ -4659,8 +6661,13 @@ static void _mdns_search_finish(mdns_search_once_t *search)
  */
 static void _mdns_search_add(mdns_search_once_t *search)
 {
+    if (_mdns_cache_search(search)) {
+        _mdns_search_finish(search);
+        return;
+    }
     search->next = _mdns_server->search_once;
     _mdns_server->search_once = search;
+    _mdns_timer_arm(xTaskGetTickCount() * portTICK_PERIOD_MS);
 }
 
 /**
@@ -4699,38 +6706,172 @@ static mdns_ip_addr_t *_mdns_result_addr_create_ip(esp_ip_addr_t *ip)
     return a;
 }
 
-static inline void _mdns_result_update_ttl(mdns_result_t *r, uint32_t ttl)
+static inline void _mdns_result_update_ttl(mdns_result_t *r, uint32_t ttl)
+{
+    r->ttl = r->ttl < ttl ? r->ttl : ttl;
+}
+
+/**
+ * @brief  Chain new IP to search result
+ */
+static void _mdns_result_add_ip(mdns_result_t *r, esp_ip_addr_t *ip)
+{
+    mdns_ip_addr_t *a = r->addr;
+    while (a) {
+        if (a->addr.type == ip->type) {
+#ifdef CONFIG_LWIP_IPV4
+            if (a->addr.type == ESP_IPADDR_TYPE_V4 && a->addr.u_addr.ip4.addr == ip->u_addr.ip4.addr) {
+                return;
+            }
+#endif
+#ifdef CONFIG_LWIP_IPV6
+            if (a->addr.type == ESP_IPADDR_TYPE_V6 && !memcmp(a->addr.u_addr.ip6.addr, ip->u_addr.ip6.addr, 16)) {
+                return;
+            }
+#endif
+        }
+        a = a->next;
+    }
+    a = _mdns_result_addr_create_ip(ip);
+    if (!a) {
+        return;
+    }
+    a->next = r->addr;
+    r->addr = a;
+}
+
+/*
+ * Result indices
+ *
+ * A search or a browse for a busy service type matches every received record against its results,
+ * so the results are indexed by instance name and by hostname on the interface and IP protocol they
+ * were received on. Several instances may live on one host, the hostname index holds one slot per
+ * result and the lookups walk all slots of the hostname.
+ */
+
+typedef struct {
+    esp_netif_t *esp_netif;
+    mdns_ip_protocol_t ip_protocol;
+    const char *name;
+} mdns_result_key_t;
+
+static inline uint32_t _mdns_result_hash(const mdns_result_key_t *key)
+{
+    return _mdns_name_suffix_hash(key->name, (uint32_t)(uintptr_t)key->esp_netif ^ key->ip_protocol);
+}
+
+static bool _mdns_result_instance_match(const void *head, const void *key)
+{
+    const mdns_result_t *r = (const mdns_result_t *)head;
+    const mdns_result_key_t *k = (const mdns_result_key_t *)key;
+    return r->esp_netif == k->esp_netif && r->ip_protocol == k->ip_protocol && !strcasecmp(r->instance_name, k->name);
+}
+
+static bool _mdns_result_host_match(const void *head, const void *key)
+{
+    const mdns_result_t *r = (const mdns_result_t *)head;
+    const mdns_result_key_t *k = (const mdns_result_key_t *)key;
+    return r->esp_netif == k->esp_netif && r->ip_protocol == k->ip_protocol && !strcasecmp(r->hostname, k->name);
+}
+
+static bool _mdns_result_is(const void *head, const void *key)
+{
+    return head == key;
+}
+
+static mdns_result_t *_mdns_result_find_instance(const mdns_result_index_t *index, const char *instance,
+                                                 esp_netif_t *esp_netif, mdns_ip_protocol_t ip_protocol)
+{
+    mdns_result_key_t key = { esp_netif, ip_protocol, instance };
+    mdns_index_slot_t *slot = _mdns_index_find(&index->instances, _mdns_result_hash(&key), _mdns_result_instance_match, &key);
+    return slot ? (mdns_result_t *)slot->head : NULL;
+}
+
+/**
+ * @brief  finds the first result with the hostname, or the next one after the slot
+ */
+static mdns_result_t *_mdns_result_find_host(const mdns_result_index_t *index, const mdns_result_key_t *key, mdns_index_slot_t **slot)
+{
+    uint32_t hash = _mdns_result_hash(key);
+    if (*slot) {
+        *slot = _mdns_index_find_next(&index->hosts, *slot, hash, _mdns_result_host_match, key);
+    } else {
+        *slot = _mdns_index_find(&index->hosts, hash, _mdns_result_host_match, key);
+    }
+    return *slot ? (mdns_result_t *)(*slot)->head : NULL;
+}
+
+static void _mdns_result_index_link(mdns_index_t *index, const char *name, mdns_result_t *r)
+{
+    mdns_result_key_t key = { r->esp_netif, r->ip_protocol, name };
+    _mdns_index_insert(index, _mdns_result_hash(&key), r);
+}
+
+static void _mdns_result_index_unlink(mdns_index_t *index, const char *name, mdns_result_t *r)
+{
+    if (_str_null_or_empty(name)) {
+        return;
+    }
+    mdns_result_key_t key = { r->esp_netif, r->ip_protocol, name };
+    mdns_index_slot_t *slot = _mdns_index_find(index, _mdns_result_hash(&key), _mdns_result_is, r);
+    if (slot) {
+        _mdns_index_remove(index, slot);
+    }
+}
+
+/**
+ * @brief  indexes a new result by its instance name and hostname (if set)
+ *
+ * @return false if the indices could not grow
+ */
+static bool _mdns_result_index_add(mdns_result_index_t *index, mdns_result_t *r)
+{
+    bool instance = !_str_null_or_empty(r->instance_name);
+    bool host = !_str_null_or_empty(r->hostname);
+    if ((instance && !_mdns_index_reserve(&index->instances)) || (host && !_mdns_index_reserve(&index->hosts))) {
+        return false;
+    }
+    if (instance) {
+        _mdns_result_index_link(&index->instances, r->instance_name, r);
+    }
+    if (host) {
+        _mdns_result_index_link(&index->hosts, r->hostname, r);
+    }
+    return true;
+}
+
+static void _mdns_result_index_remove(mdns_result_index_t *index, mdns_result_t *r)
+{
+    _mdns_result_index_unlink(&index->instances, r->instance_name, r);
+    _mdns_result_index_unlink(&index->hosts, r->hostname, r);
+}
+
+static void _mdns_result_index_free(mdns_result_index_t *index)
 {
-    r->ttl = r->ttl < ttl ? r->ttl : ttl;
+    _mdns_index_free(&index->instances);
+    _mdns_index_free(&index->hosts);
 }
 
 /**
- * @brief  Chain new IP to search result
+ * @brief  sets a copy of the hostname to the result, the old one is freed
+ *
+ * @return false if out of memory, the result is unchanged then
  */
-static void _mdns_result_add_ip(mdns_result_t *r, esp_ip_addr_t *ip)
+static bool _mdns_result_hostname_set(mdns_result_index_t *index, mdns_result_t *r, const char *hostname)
 {
-    mdns_ip_addr_t *a = r->addr;
-    while (a) {
-        if (a->addr.type == ip->type) {
-#ifdef CONFIG_LWIP_IPV4
-            if (a->addr.type == ESP_IPADDR_TYPE_V4 && a->addr.u_addr.ip4.addr == ip->u_addr.ip4.addr) {
-                return;
-            }
-#endif
-#ifdef CONFIG_LWIP_IPV6
-            if (a->addr.type == ESP_IPADDR_TYPE_V6 && !memcmp(a->addr.u_addr.ip6.addr, ip->u_addr.ip6.addr, 16)) {
-                return;
-            }
-#endif
-        }
-        a = a->next;
+    char *copy = mdns_mem_strdup(hostname);
+    if (!copy || !_mdns_index_reserve(&index->hosts)) {
+        HOOK_MALLOC_FAILED;
+        mdns_mem_free(copy);
+        return false;
     }
-    a = _mdns_result_addr_create_ip(ip);
-    if (!a) {
-        return;
+    _mdns_result_index_unlink(&index->hosts, r->hostname, r);
+    mdns_mem_free(r->hostname);
+    r->hostname = copy;
+    if (copy[0]) {
+        _mdns_result_index_link(&index->hosts, copy, r);
     }
-    a->next = r->addr;
-    r->addr = a;
+    return true;
 }
 
 /**
@@ -4779,14 +6920,12 @@ static void _mdns_search_result_add_ip(mdns_search_once_t *search, const char *h
             search->num_results++;
         }
     } else if (search->type == MDNS_TYPE_PTR || search->type == MDNS_TYPE_SRV) {
-        r = search->result;
-        while (r) {
-            if (r->esp_netif == _mdns_get_esp_netif(tcpip_if) && r->ip_protocol == ip_protocol && !_str_null_or_empty(r->hostname) && !strcasecmp(hostname, r->hostname)) {
-                _mdns_result_add_ip(r, ip);
-                _mdns_result_update_ttl(r, ttl);
-                break;
-            }
-            r = r->next;
+        mdns_result_key_t key = { _mdns_get_esp_netif(tcpip_if), ip_protocol, hostname };
+        mdns_index_slot_t *slot = NULL;
+        r = _mdns_result_find_host(&search->index, &key, &slot);
+        if (r) {
+            _mdns_result_add_ip(r, ip);
+            _mdns_result_update_ttl(r, ttl);
         }
     }
 }
@@ -4798,13 +6937,10 @@ static mdns_result_t *_mdns_search_result_add_ptr(mdns_search_once_t *search, co
                                                   const char *service_type, const char *proto, mdns_if_t tcpip_if,
                                                   mdns_ip_protocol_t ip_protocol, uint32_t ttl)
 {
-    mdns_result_t *r = search->result;
-    while (r) {
-        if (r->esp_netif == _mdns_get_esp_netif(tcpip_if) && r->ip_protocol == ip_protocol && !_str_null_or_empty(r->instance_name) && !strcasecmp(instance, r->instance_name)) {
-            _mdns_result_update_ttl(r, ttl);
-            return r;
-        }
-        r = r->next;
+    mdns_result_t *r = _mdns_result_find_instance(&search->index, instance, _mdns_get_esp_netif(tcpip_if), ip_protocol);
+    if (r) {
+        _mdns_result_update_ttl(r, ttl);
+        return r;
     }
     if (!search->max_results || search->num_results < search->max_results) {
         r = (mdns_result_t *)mdns_mem_malloc(sizeof(mdns_result_t));
@@ -4817,13 +6953,12 @@ static mdns_result_t *_mdns_search_result_add_ptr(mdns_search_once_t *search, co
         r->instance_name = mdns_mem_strdup(instance);
         r->service_type = mdns_mem_strdup(service_type);
         r->proto = mdns_mem_strdup(proto);
-        if (!r->instance_name) {
-            mdns_mem_free(r);
-            return NULL;
-        }
-
         r->esp_netif = _mdns_get_esp_netif(tcpip_if);
         r->ip_protocol = ip_protocol;
+        if (!r->instance_name || !_mdns_result_index_add(&search->index, r)) {
+            _mdns_query_results_free(r);
+            return NULL;
+        }
         r->ttl = ttl;
         r->next = search->result;
         search->result = r;
@@ -4839,13 +6974,12 @@ static mdns_result_t *_mdns_search_result_add_ptr(mdns_search_once_t *search, co
 static void _mdns_search_result_add_srv(mdns_search_once_t *search, const char *hostname, uint16_t port,
                                         mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint32_t ttl)
 {
-    mdns_result_t *r = search->result;
-    while (r) {
-        if (r->esp_netif == _mdns_get_esp_netif(tcpip_if) && r->ip_protocol == ip_protocol && !_str_null_or_empty(r->hostname) && !strcasecmp(hostname, r->hostname)) {
-            _mdns_result_update_ttl(r, ttl);
-            return;
-        }
-        r = r->next;
+    mdns_result_key_t key = { _mdns_get_esp_netif(tcpip_if), ip_protocol, hostname };
+    mdns_index_slot_t *slot = NULL;
+    mdns_result_t *r = _mdns_result_find_host(&search->index, &key, &slot);
+    if (r) {
+        _mdns_result_update_ttl(r, ttl);
+        return;
     }
     if (!search->max_results || search->num_results < search->max_results) {
         r = (mdns_result_t *)mdns_mem_malloc(sizeof(mdns_result_t));
@@ -4868,61 +7002,456 @@ static void _mdns_search_result_add_srv(mdns_search_once_t *search, const char *
         r->port = port;
         r->esp_netif = _mdns_get_esp_netif(tcpip_if);
         r->ip_protocol = ip_protocol;
+        if (!_mdns_result_index_add(&search->index, r)) {
+            _mdns_query_results_free(r);
+            return;
+        }
+        r->ttl = ttl;
+        r->next = search->result;
+        search->result = r;
+        search->num_results++;
+    }
+}
+
+/**
+ * @brief  Called from parser to add TXT data to search result
+ */
+static void _mdns_search_result_add_txt(mdns_search_once_t *search, mdns_txt_item_t *txt, uint8_t *txt_value_len,
+                                        size_t txt_count, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol,
+                                        uint32_t ttl)
+{
+    mdns_result_t *r = search->result;
+    while (r) {
+        if (r->esp_netif == _mdns_get_esp_netif(tcpip_if) && r->ip_protocol == ip_protocol) {
+            if (r->txt) {
+                goto free_txt;
+            }
+            r->txt = txt;
+            r->txt_value_len = txt_value_len;
+            r->txt_count = txt_count;
+            _mdns_result_update_ttl(r, ttl);
+            return;
+        }
+        r = r->next;
+    }
+    if (!search->max_results || search->num_results < search->max_results) {
+        r = (mdns_result_t *)mdns_mem_malloc(sizeof(mdns_result_t));
+        if (!r) {
+            HOOK_MALLOC_FAILED;
+            goto free_txt;
+        }
+
+        memset(r, 0, sizeof(mdns_result_t));
+        r->txt = txt;
+        r->txt_value_len = txt_value_len;
+        r->txt_count = txt_count;
+        r->esp_netif = _mdns_get_esp_netif(tcpip_if);
+        r->ip_protocol = ip_protocol;
         r->ttl = ttl;
         r->next = search->result;
         search->result = r;
         search->num_results++;
     }
+    return;
+
+free_txt:
+    for (size_t i = 0; i < txt_count; i++) {
+        mdns_mem_free((char *)(txt[i].key));
+        mdns_mem_free((char *)(txt[i].value));
+    }
+    mdns_mem_free(txt);
+    mdns_mem_free(txt_value_len);
+}
+
+/*
+ * Record cache
+ *
+ * Records received from other hosts are kept until their TTL expires. Entries are found by the hash
+ * of their owner name and the least recently used one is evicted when the cache is full.
+ */
+
+static inline uint32_t _mdns_cache_now(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static inline uint32_t _mdns_cache_hash(const char *host, const char *service, const char *proto)
+{
+    return _mdns_name_suffix_hash(host, _mdns_name_suffix_hash(service, _mdns_name_suffix_hash(proto, 0)));
+}
+
+static inline mdns_cache_entry_t *_mdns_cache_bucket(uint32_t hash)
+{
+    return _mdns_server->cache.index[hash & (MDNS_CACHE_BUCKETS - 1)];
+}
+
+/**
+ * @brief  remaining TTL (s) of the cached record, 0 if it has expired
+ */
+static uint32_t _mdns_cache_ttl_left(const mdns_cache_entry_t *e, uint32_t now)
+{
+    uint32_t age = (now - e->received_at) / 1000;
+    return age < e->ttl ? e->ttl - age : 0;
+}
+
+static void _mdns_cache_lru_unlink(mdns_cache_entry_t *e)
+{
+    if (e->lru_prev) {
+        e->lru_prev->lru_next = e->lru_next;
+    } else {
+        _mdns_server->cache.lru_head = e->lru_next;
+    }
+    if (e->lru_next) {
+        e->lru_next->lru_prev = e->lru_prev;
+    } else {
+        _mdns_server->cache.lru_tail = e->lru_prev;
+    }
+    e->lru_prev = e->lru_next = NULL;
+}
+
+static void _mdns_cache_lru_push(mdns_cache_entry_t *e)
+{
+    e->lru_prev = NULL;
+    e->lru_next = _mdns_server->cache.lru_head;
+    if (e->lru_next) {
+        e->lru_next->lru_prev = e;
+    } else {
+        _mdns_server->cache.lru_tail = e;
+    }
+    _mdns_server->cache.lru_head = e;
+}
+
+static void _mdns_cache_touch(mdns_cache_entry_t *e)
+{
+    if (_mdns_server->cache.lru_head != e) {
+        _mdns_cache_lru_unlink(e);
+        _mdns_cache_lru_push(e);
+    }
+}
+
+static void _mdns_cache_remove(mdns_cache_entry_t *e)
+{
+    mdns_cache_entry_t **link = &_mdns_server->cache.index[e->hash & (MDNS_CACHE_BUCKETS - 1)];
+    while (*link != e) {
+        link = &(*link)->hash_next;
+    }
+    *link = e->hash_next;
+    _mdns_cache_lru_unlink(e);
+    mdns_mem_free((char *)e->host);
+    e->host = NULL;
+    e->hash_next = _mdns_server->cache.free;
+    _mdns_server->cache.free = e;
+    _mdns_server->cache.len--;
+}
+
+#if CONFIG_MDNS_RECORD_CACHE_SIZE
+/**
+ * @brief  Takes an unused entry, evicts an expired or the least recently used one if the cache is full
+ */
+static mdns_cache_entry_t *_mdns_cache_entry_alloc(uint32_t now)
+{
+    if (!_mdns_server->cache.entries) {
+        mdns_cache_entry_t *entries = (mdns_cache_entry_t *)mdns_mem_calloc(CONFIG_MDNS_RECORD_CACHE_SIZE, sizeof(mdns_cache_entry_t));
+        if (!entries) {
+            HOOK_MALLOC_FAILED;
+            return NULL;
+        }
+        for (int i = CONFIG_MDNS_RECORD_CACHE_SIZE - 1; i >= 0; i--) {
+            entries[i].hash_next = _mdns_server->cache.free;
+            _mdns_server->cache.free = &entries[i];
+        }
+        _mdns_server->cache.entries = entries;
+    }
+    if (!_mdns_server->cache.free) {
+        mdns_cache_entry_t *victim = _mdns_server->cache.lru_tail;
+        for (mdns_cache_entry_t *e = victim; e; e = e->lru_prev) {
+            if (!_mdns_cache_ttl_left(e, now)) {
+                victim = e;
+                break;
+            }
+        }
+        _mdns_cache_remove(victim);
+    }
+    mdns_cache_entry_t *e = _mdns_server->cache.free;
+    _mdns_server->cache.free = e->hash_next;
+    return e;
+}
+
+static bool _mdns_cache_owner_equal(const mdns_cache_entry_t *e, const mdns_cache_entry_t *record)
+{
+    return e->hash == record->hash && e->type == record->type
+           && e->tcpip_if == record->tcpip_if && e->ip_protocol == record->ip_protocol
+           && !strcasecmp(e->host, record->host) && !strcasecmp(e->service, record->service)
+           && !strcasecmp(e->proto, record->proto);
+}
+
+static bool _mdns_cache_rdata_equal(const mdns_cache_entry_t *e, const mdns_cache_entry_t *record)
+{
+    switch (e->type) {
+    case MDNS_TYPE_PTR:
+        return !strcasecmp(e->target, record->target);
+    case MDNS_TYPE_SRV:
+        return e->port == record->port && !strcasecmp(e->target, record->target);
+    case MDNS_TYPE_TXT:
+        return e->txt_len == record->txt_len && !memcmp(e->txt, record->txt, e->txt_len);
+    default:
+        return e->addr.type == record->addr.type && (e->addr.type == ESP_IPADDR_TYPE_V6
+                ? !memcmp(e->addr.u_addr.ip6.addr, record->addr.u_addr.ip6.addr, 16)
+                : e->addr.u_addr.ip4.addr == record->addr.u_addr.ip4.addr);
+    }
+}
+#endif /* CONFIG_MDNS_RECORD_CACHE_SIZE */
+
+/**
+ * @brief  Adds a received record to the cache or refreshes the cached one
+ *
+ * PTR and address records can hold several values for one name, SRV and TXT values replace the cached one.
+ * The cache-flush bit drops the values of the name received more than a second ago (RFC 6762, 10.2)
+ * and TTL 0 removes the record.
+ *
+ * @param  record   view of the received record, its strings are copied to the cache
+ * @param  flush    the cache-flush bit of the record
+ */
+static void _mdns_cache_add(mdns_cache_entry_t *record, bool flush)
+{
+#if CONFIG_MDNS_RECORD_CACHE_SIZE
+    uint32_t now = _mdns_cache_now();
+    bool unique = record->type == MDNS_TYPE_SRV || record->type == MDNS_TYPE_TXT;
+    mdns_cache_entry_t *same = NULL;
+
+    record->hash = _mdns_cache_hash(record->host, record->service, record->proto);
+    mdns_cache_entry_t *e = _mdns_cache_bucket(record->hash);
+    while (e) {
+        mdns_cache_entry_t *next = e->hash_next;
+        if (_mdns_cache_owner_equal(e, record)) {
+            if (_mdns_cache_rdata_equal(e, record)) {
+                same = e;
+            } else if (unique || (flush && now - e->received_at > 1000)) {
+                _mdns_cache_remove(e);
+            }
+        }
+        e = next;
+    }
+    if (!record->ttl) {
+        if (same) {
+            _mdns_cache_remove(same);
+        }
+        return;
+    }
+    uint32_t ttl = record->ttl < MDNS_CACHE_MAX_TTL ? record->ttl : MDNS_CACHE_MAX_TTL;
+    if (same) {
+        same->received_at = now;
+        same->ttl = ttl;
+        _mdns_cache_touch(same);
+        return;
+    }
+
+    size_t host_len = strlen(record->host) + 1;
+    size_t service_len = strlen(record->service) + 1;
+    size_t proto_len = strlen(record->proto) + 1;
+    size_t target_len = record->target ? strlen(record->target) + 1 : 0;
+    char *strings = (char *)mdns_mem_malloc(host_len + service_len + proto_len + target_len + record->txt_len);
+    if (!strings) {
+        HOOK_MALLOC_FAILED;
+        return;
+    }
+    e = _mdns_cache_entry_alloc(now);
+    if (!e) {
+        mdns_mem_free(strings);
+        return;
+    }
+    *e = *record;
+    e->received_at = now;
+    e->ttl = ttl;
+    e->host = memcpy(strings, record->host, host_len);
+    e->service = memcpy(strings + host_len, record->service, service_len);
+    e->proto = memcpy(strings + host_len + service_len, record->proto, proto_len);
+    strings += host_len + service_len + proto_len;
+    if (record->target) {
+        e->target = memcpy(strings, record->target, target_len);
+    }
+    if (record->txt_len) {
+        e->txt = memcpy(strings + target_len, record->txt, record->txt_len);
+    }
+    mdns_cache_entry_t **bucket = &_mdns_server->cache.index[e->hash & (MDNS_CACHE_BUCKETS - 1)];
+    e->hash_next = *bucket;
+    *bucket = e;
+    _mdns_cache_lru_push(e);
+    _mdns_server->cache.len++;
+#endif /* CONFIG_MDNS_RECORD_CACHE_SIZE */
+}
+
+/**
+ * @brief  Finds the next live cached record of the name, starting at the given entry of its bucket
+ */
+static mdns_cache_entry_t *_mdns_cache_find_from(mdns_cache_entry_t *e, uint32_t hash, uint16_t type, const char *host,
+                                                 const char *service, const char *proto, uint32_t now)
+{
+    for (; e; e = e->hash_next) {
+        if (e->hash == hash && e->type == type && _mdns_cache_ttl_left(e, now)
+                && !strcasecmp(e->host, host) && !strcasecmp(e->service, service) && !strcasecmp(e->proto, proto)) {
+            _mdns_cache_touch(e);
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief  Removes all records received on the interface
+ */
+static void _mdns_cache_flush_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    for (int i = 0; _mdns_server->cache.entries && i < CONFIG_MDNS_RECORD_CACHE_SIZE; i++) {
+        mdns_cache_entry_t *e = &_mdns_server->cache.entries[i];
+        if (e->host && e->tcpip_if == tcpip_if && e->ip_protocol == ip_protocol) {
+            _mdns_cache_remove(e);
+        }
+    }
+}
+
+static void _mdns_cache_free(void)
+{
+    for (int i = 0; _mdns_server->cache.entries && i < CONFIG_MDNS_RECORD_CACHE_SIZE; i++) {
+        mdns_mem_free((char *)_mdns_server->cache.entries[i].host);
+    }
+    mdns_mem_free(_mdns_server->cache.entries);
+    memset(&_mdns_server->cache, 0, sizeof(_mdns_server->cache));
+}
+
+/**
+ * @brief  Copies the owner name of a received record to the parse memory, for records whose data overwrite the parsed name
+ */
+static mdns_cache_entry_t *_mdns_cache_record_dup(mdns_mem_arena_t *arena, const mdns_cache_entry_t *record)
+{
+    size_t host_len = strlen(record->host) + 1;
+    size_t service_len = strlen(record->service) + 1;
+    size_t proto_len = strlen(record->proto) + 1;
+    mdns_cache_entry_t *copy = (mdns_cache_entry_t *)mdns_mem_parse_malloc(arena, sizeof(mdns_cache_entry_t) + host_len + service_len + proto_len);
+    if (!copy) {
+        HOOK_MALLOC_FAILED;
+        return NULL;
+    }
+    char *strings = (char *)(copy + 1);
+    *copy = *record;
+    copy->host = memcpy(strings, record->host, host_len);
+    copy->service = memcpy(strings + host_len, record->service, service_len);
+    copy->proto = memcpy(strings + host_len + service_len, record->proto, proto_len);
+    return copy;
+}
+
+/**
+ * @brief  Adds the cached addresses of the host to the search results
+ */
+static void _mdns_cache_search_addresses(mdns_search_once_t *search, const char *hostname, uint32_t now)
+{
+    static const uint16_t types[] = { MDNS_TYPE_A, MDNS_TYPE_AAAA };
+    uint32_t hash = _mdns_cache_hash(hostname, "", "");
+    for (int i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        mdns_cache_entry_t *e = _mdns_cache_find_from(_mdns_cache_bucket(hash), hash, types[i], hostname, "", "", now);
+        for (; e; e = _mdns_cache_find_from(e->hash_next, hash, types[i], hostname, "", "", now)) {
+            _mdns_search_result_add_ip(search, e->host, &e->addr, e->tcpip_if, e->ip_protocol, _mdns_cache_ttl_left(e, now));
+        }
+    }
+}
+
+/**
+ * @brief  Fills the results of a new search from the cache
+ *
+ * @return true if the search is answered and doesn't have to query the network
+ */
+static bool _mdns_cache_search(mdns_search_once_t *search)
+{
+    if (!_mdns_server->cache.len) {
+        return false;
+    }
+    uint32_t now = _mdns_cache_now();
+    uint32_t hash;
+    mdns_cache_entry_t *e;
+
+    switch (search->type) {
+    case MDNS_TYPE_A:
+    case MDNS_TYPE_AAAA:
+        if (!search->instance || search->service) {
+            return false;
+        }
+        _mdns_cache_search_addresses(search, search->instance, now);
+        return search->num_results > 0;
+    case MDNS_TYPE_SRV:
+    case MDNS_TYPE_TXT:
+        if (!search->instance || !search->service || !search->proto) {
+            return false;
+        }
+        hash = _mdns_cache_hash(search->instance, search->service, search->proto);
+        e = _mdns_cache_find_from(_mdns_cache_bucket(hash), hash, search->type, search->instance, search->service, search->proto, now);
+        for (; e; e = _mdns_cache_find_from(e->hash_next, hash, search->type, search->instance, search->service, search->proto, now)) {
+            if (search->type == MDNS_TYPE_SRV) {
+                _mdns_search_result_add_srv(search, e->target, e->port, e->tcpip_if, e->ip_protocol, _mdns_cache_ttl_left(e, now));
+                _mdns_cache_search_addresses(search, e->target, now);
+            } else {
+                mdns_txt_item_t *txt = NULL;
+                uint8_t *txt_value_len = NULL;
+                size_t txt_count = 0;
+                _mdns_result_txt_create(e->txt, e->txt_len, &txt, &txt_value_len, &txt_count);
+                if (txt_count) {
+                    _mdns_search_result_add_txt(search, txt, txt_value_len, txt_count, e->tcpip_if, e->ip_protocol, _mdns_cache_ttl_left(e, now));
+                }
+            }
+        }
+        return search->num_results > 0;
+    case MDNS_TYPE_PTR:
+        // other instances may answer, so the network is still queried, the cached ones are sent as known answers
+        hash = _mdns_cache_hash("", search->service, search->proto);
+        e = _mdns_cache_find_from(_mdns_cache_bucket(hash), hash, MDNS_TYPE_PTR, "", search->service, search->proto, now);
+        for (; e; e = _mdns_cache_find_from(e->hash_next, hash, MDNS_TYPE_PTR, "", search->service, search->proto, now)) {
+            mdns_result_t *r = _mdns_search_result_add_ptr(search, e->target, search->service, search->proto,
+                                                           e->tcpip_if, e->ip_protocol, _mdns_cache_ttl_left(e, now));
+            if (!r) {
+                continue;
+            }
+            uint32_t instance_hash = _mdns_cache_hash(e->target, search->service, search->proto);
+            mdns_cache_entry_t *d = _mdns_cache_bucket(instance_hash);
+            while ((d = _mdns_cache_find_from(d, instance_hash, MDNS_TYPE_SRV, e->target, search->service, search->proto, now)) != NULL) {
+                if (d->tcpip_if == e->tcpip_if && d->ip_protocol == e->ip_protocol && !r->hostname) {
+                    _mdns_result_hostname_set(&search->index, r, d->target);
+                    r->port = d->port;
+                    _mdns_result_update_ttl(r, _mdns_cache_ttl_left(d, now));
+                }
+                d = d->hash_next;
+            }
+            d = _mdns_cache_bucket(instance_hash);
+            while ((d = _mdns_cache_find_from(d, instance_hash, MDNS_TYPE_TXT, e->target, search->service, search->proto, now)) != NULL) {
+                if (d->tcpip_if == e->tcpip_if && d->ip_protocol == e->ip_protocol && !r->txt) {
+                    _mdns_result_txt_create(d->txt, d->txt_len, &r->txt, &r->txt_value_len, &r->txt_count);
+                }
+                d = d->hash_next;
+            }
+            if (r->hostname) {
+                _mdns_cache_search_addresses(search, r->hostname, now);
+            }
+        }
+        return false;
+    default:
+        return false;
+    }
 }
 
 /**
- * @brief  Called from parser to add TXT data to search result
+ * @brief  Checks that the querier holds the PTR record with at least half of its TTL left (RFC 6762, 7.1)
  */
-static void _mdns_search_result_add_txt(mdns_search_once_t *search, mdns_txt_item_t *txt, uint8_t *txt_value_len,
-                                        size_t txt_count, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol,
-                                        uint32_t ttl)
+static bool _mdns_cache_is_known_answer(const char *instance, const char *service, const char *proto,
+                                        mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
 {
-    mdns_result_t *r = search->result;
-    while (r) {
-        if (r->esp_netif == _mdns_get_esp_netif(tcpip_if) && r->ip_protocol == ip_protocol) {
-            if (r->txt) {
-                goto free_txt;
-            }
-            r->txt = txt;
-            r->txt_value_len = txt_value_len;
-            r->txt_count = txt_count;
-            _mdns_result_update_ttl(r, ttl);
-            return;
-        }
-        r = r->next;
-    }
-    if (!search->max_results || search->num_results < search->max_results) {
-        r = (mdns_result_t *)mdns_mem_malloc(sizeof(mdns_result_t));
-        if (!r) {
-            HOOK_MALLOC_FAILED;
-            goto free_txt;
+    uint32_t now = _mdns_cache_now();
+    uint32_t hash = _mdns_cache_hash("", service, proto);
+    mdns_cache_entry_t *e = _mdns_cache_bucket(hash);
+    while ((e = _mdns_cache_find_from(e, hash, MDNS_TYPE_PTR, "", service, proto, now)) != NULL) {
+        if (e->tcpip_if == tcpip_if && e->ip_protocol == ip_protocol && !strcasecmp(e->target, instance)) {
+            return _mdns_cache_ttl_left(e, now) * 2 > e->ttl;
         }
-
-        memset(r, 0, sizeof(mdns_result_t));
-        r->txt = txt;
-        r->txt_value_len = txt_value_len;
-        r->txt_count = txt_count;
-        r->esp_netif = _mdns_get_esp_netif(tcpip_if);
-        r->ip_protocol = ip_protocol;
-        r->ttl = ttl;
-        r->next = search->result;
-        search->result = r;
-        search->num_results++;
-    }
-    return;
-
-free_txt:
-    for (size_t i = 0; i < txt_count; i++) {
-        mdns_mem_free((char *)(txt[i].key));
-        mdns_mem_free((char *)(txt[i].value));
+        e = e->hash_next;
     }
-    mdns_mem_free(txt);
-    mdns_mem_free(txt_value_len);
+    return false;
 }
 
 /**
@@ -4930,7 +7459,6 @@ free_txt:
  */
 static mdns_search_once_t *_mdns_search_find_from(mdns_search_once_t *s, mdns_name_t *name, uint16_t type, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
 {
-    mdns_result_t *r = NULL;
     while (s) {
         if (s->state == SEARCH_OFF) {
             s = s->next;
@@ -4950,12 +7478,10 @@ static mdns_search_once_t *_mdns_search_find_from(mdns_search_once_t *s, mdns_na
                 s = s->next;
                 continue;
             }
-            r = s->result;
-            while (r) {
-                if (r->esp_netif == _mdns_get_esp_netif(tcpip_if) && r->ip_protocol == ip_protocol && !_str_null_or_empty(r->hostname) && !strcasecmp(name->host, r->hostname)) {
-                    return s;
-                }
-                r = r->next;
+            mdns_result_key_t key = { _mdns_get_esp_netif(tcpip_if), ip_protocol, name->host };
+            mdns_index_slot_t *slot = NULL;
+            if (_mdns_result_find_host(&s->index, &key, &slot)) {
+                return s;
             }
             s = s->next;
             continue;
@@ -5003,7 +7529,7 @@ static mdns_tx_packet_t *_mdns_create_search_packet(mdns_search_once_t *search,
         return NULL;
     }
 
-    mdns_out_question_t *q = (mdns_out_question_t *)mdns_mem_malloc(sizeof(mdns_out_question_t));
+    mdns_out_question_t *q = (mdns_out_question_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_QUESTION, sizeof(mdns_out_question_t));
     if (!q) {
         HOOK_MALLOC_FAILED;
         _mdns_free_tx_packet(packet);
@@ -5027,7 +7553,13 @@ static mdns_tx_packet_t *_mdns_create_search_packet(mdns_search_once_t *search,
                 r = r->next;
                 continue;
             }
-            mdns_out_answer_t *a = (mdns_out_answer_t *)mdns_mem_malloc(sizeof(mdns_out_answer_t));
+#if CONFIG_MDNS_RECORD_CACHE_SIZE
+            if (!_mdns_cache_is_known_answer(r->instance_name, search->service, search->proto, tcpip_if, ip_protocol)) {
+                r = r->next;
+                continue;
+            }
+#endif
+            mdns_out_answer_t *a = (mdns_out_answer_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ANSWER, sizeof(mdns_out_answer_t));
             if (!a) {
                 HOOK_MALLOC_FAILED;
                 _mdns_free_tx_packet(packet);
@@ -5035,12 +7567,16 @@ static mdns_tx_packet_t *_mdns_create_search_packet(mdns_search_once_t *search,
             }
             a->type = MDNS_TYPE_PTR;
             a->service = NULL;
+            a->host = NULL;
             a->custom_instance = r->instance_name;
             a->custom_service = search->service;
             a->custom_proto = search->proto;
             a->bye = false;
             a->flush = false;
             a->next = NULL;
+            a->index_next = NULL;
+            a->index_link = NULL;
+            a->packet = NULL;
             queueToEnd(mdns_out_answer_t, packet->answers, a);
             r = r->next;
         }
@@ -5107,6 +7643,11 @@ static void _mdns_tx_handle_packet(mdns_tx_packet_t *p)
     }
     _mdns_dispatch_tx_packet(p);
 
+    if (p->host_state != PCB_OFF) {
+        _mdns_host_batch_next(p);
+        return;
+    }
+
     switch (pcb->state) {
     case PCB_PROBE_1:
         q = p->questions;
@@ -5155,6 +7696,9 @@ static void _mdns_remap_self_service_hostname(const char *old_hostname, const ch
 {
     mdns_srv_item_t *service = _mdns_server->services;
 
+    // services without own hostname (and with default instance name) depend on the server hostname
+    _mdns_service_wire_invalidate_all();
+
     while (service) {
         if (service->service->hostname &&
                 strcmp(service->service->hostname, old_hostname) == 0) {
@@ -5165,18 +7709,6 @@ static void _mdns_remap_self_service_hostname(const char *old_hostname, const ch
     }
 }
 
-static void _mdns_sync_browse_result_link_free(mdns_browse_sync_t *browse_sync)
-{
-    mdns_browse_result_sync_t *current = browse_sync->sync_result;
-    mdns_browse_result_sync_t *need_free;
-    while (current) {
-        need_free = current;
-        current = current->next;
-        mdns_mem_free(need_free);
-    }
-    mdns_mem_free(browse_sync);
-}
-
 /**
  * @brief  Free action data
  */
@@ -5197,19 +7729,14 @@ static void _mdns_free_action(mdns_action_t *action)
         _mdns_search_free(action->data.search_add.search);
         break;
     case ACTION_BROWSE_ADD:
-    //fallthrough
-    case ACTION_BROWSE_END:
-        _mdns_browse_item_free(action->data.browse_add.browse);
+        // the browse is owned by the browse list, or by the ACTION_BROWSE_END which detached it
         break;
-    case ACTION_BROWSE_SYNC:
-        _mdns_sync_browse_result_link_free(action->data.browse_sync.browse_sync);
+    case ACTION_BROWSE_END:
+        _mdns_browse_finish(action->data.browse_add.browse);
         break;
     case ACTION_TX_HANDLE:
         _mdns_free_tx_packet(action->data.tx_handle.packet);
         break;
-    case ACTION_RX_HANDLE:
-        _mdns_packet_free(action->data.rx_handle.packet);
-        break;
     case ACTION_DELEGATE_HOSTNAME_SET_ADDR:
     case ACTION_DELEGATE_HOSTNAME_ADD:
         mdns_mem_free((char *)action->data.delegate_hostname.hostname);
@@ -5233,19 +7760,28 @@ static void _mdns_execute_action(mdns_action_t *action)
     case ACTION_SYSTEM_EVENT:
         perform_event_action(action->data.sys_event.interface, action->data.sys_event.event_action);
         break;
-    case ACTION_HOSTNAME_SET:
+    case ACTION_HOSTNAME_SET: {
+        // delegated hosts are probed once there is a hostname, they are not affected by its changes
+        bool probe_hosts = _str_null_or_empty(_mdns_server->hostname);
         _mdns_send_bye_all_pcbs_no_instance(true);
         _mdns_remap_self_service_hostname(_mdns_server->hostname, action->data.hostname_set.hostname);
         mdns_mem_free((char *)_mdns_server->hostname);
         _mdns_server->hostname = action->data.hostname_set.hostname;
         _mdns_self_host.hostname = action->data.hostname_set.hostname;
         _mdns_restart_all_pcbs();
+        if (probe_hosts) {
+            _mdns_probe_hosts_all_pcbs();
+        }
+        // the caller may read the hostname without the lock as soon as it returns
+        _mdns_snapshot_sync();
         xSemaphoreGive(_mdns_server->action_sema);
-        break;
+    }
+    break;
     case ACTION_INSTANCE_SET:
         _mdns_send_bye_all_pcbs_no_instance(false);
         mdns_mem_free((char *)_mdns_server->instance);
         _mdns_server->instance = action->data.instance;
+        _mdns_service_wire_invalidate_all();
         _mdns_restart_all_pcbs_no_instance();
 
         break;
@@ -5262,38 +7798,55 @@ static void _mdns_execute_action(mdns_action_t *action)
     case ACTION_BROWSE_ADD:
         _mdns_browse_add(action->data.browse_add.browse);
         break;
-    case ACTION_BROWSE_SYNC:
-        _mdns_browse_sync(action->data.browse_sync.browse_sync);
-        _mdns_sync_browse_result_link_free(action->data.browse_sync.browse_sync);
-        break;
+    case ACTION_BROWSE_SYNC: {
+        uint32_t deadline = 0;
+        _mdns_server->browse_notify_signalled = false;
+        _mdns_browse_notify_due(xTaskGetTickCount() * portTICK_PERIOD_MS);
+        if (_mdns_browse_next_notify(&deadline)) {
+            _mdns_timer_arm(deadline);
+        }
+    }
+    break;
     case ACTION_BROWSE_END:
         _mdns_browse_finish(action->data.browse_add.browse);
         break;
 
     case ACTION_TX_HANDLE: {
-        mdns_tx_packet_t *p = _mdns_server->tx_queue_head;
-        // packet to be handled should be at tx head, but must be consistent with the one pushed to action queue
+        mdns_tx_packet_t *p = _mdns_server->tx.ready_head;
+        // packet to be handled should be at ready head, but must be consistent with the one pushed to action queue
         if (p && p == action->data.tx_handle.packet && p->queued) {
-            p->queued = false; // clearing, as the packet might be reused (pushed and transmitted again)
-            _mdns_server->tx_queue_head = p->next;
+            _mdns_tx_queue_remove(p); // clears queued, as the packet might be reused (pushed and transmitted again)
             _mdns_tx_handle_packet(p);
         } else {
             ESP_LOGD(TAG, "Skipping transmit of an unexpected packet!");
         }
     }
     break;
-    case ACTION_RX_HANDLE:
-        mdns_parse_packet(action->data.rx_handle.packet);
-        _mdns_packet_free(action->data.rx_handle.packet);
-        break;
-    case ACTION_DELEGATE_HOSTNAME_ADD:
-        if (!_mdns_delegate_hostname_add(action->data.delegate_hostname.hostname,
-                                         action->data.delegate_hostname.address_list)) {
+    case ACTION_RX_HANDLE: {
+        mdns_rx_packet_t *packet = _mdns_rx_queue_take();
+        int64_t started = esp_timer_get_time();
+        while (packet) {
+            mdns_rx_packet_t *next = packet->next;
+            mdns_parse_packet(packet);
+            _mdns_packet_free(packet);
+            packet = next;
+        }
+        _mdns_server->stats.parse_time_us += esp_timer_get_time() - started;
+    }
+    break;
+    case ACTION_DELEGATE_HOSTNAME_ADD: {
+        mdns_host_item_t *host = _mdns_delegate_hostname_add(action->data.delegate_hostname.hostname,
+                                                             action->data.delegate_hostname.address_list);
+        if (host) {
+            _mdns_probe_host_all_pcbs(host);
+        } else {
             mdns_mem_free((char *)action->data.delegate_hostname.hostname);
             free_address_list(action->data.delegate_hostname.address_list);
         }
+        _mdns_snapshot_sync();
         xSemaphoreGive(_mdns_server->action_sema);
-        break;
+    }
+    break;
     case ACTION_DELEGATE_HOSTNAME_SET_ADDR:
         if (!_mdns_delegate_hostname_set_address(action->data.delegate_hostname.hostname,
                                                  action->data.delegate_hostname.address_list)) {
@@ -5318,7 +7871,7 @@ static esp_err_t _mdns_send_search_action(mdns_action_type_t type, mdns_search_o
 {
     mdns_action_t *action = NULL;
 
-    action = (mdns_action_t *)mdns_mem_malloc(sizeof(mdns_action_t));
+    action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
     if (!action) {
         HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
@@ -5326,7 +7879,7 @@ static esp_err_t _mdns_send_search_action(mdns_action_type_t type, mdns_search_o
 
     action->type = type;
     action->data.search_add.search = search;
-    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
+    if (!_mdns_action_post(action)) {
         mdns_mem_free(action);
         return ESP_ERR_NO_MEM;
     }
@@ -5336,40 +7889,45 @@ static esp_err_t _mdns_send_search_action(mdns_action_type_t type, mdns_search_o
 /**
  * @brief  Called from timer task to run mDNS responder
  *
- * periodically checks first unqueued packet (from tx head).
- * if it is scheduled to be transmitted, then pushes the packet to action queue to be handled.
+ * pops packets which are due for transmission from the TX heap, moves them to the ready list
+ * and pushes them to action queue to be handled. Received packets left without an action
+ * (the action queue was full) are signalled again.
  *
  */
 static void _mdns_scheduler_run(void)
 {
     MDNS_SERVICE_LOCK();
-    mdns_tx_packet_t *p = _mdns_server->tx_queue_head;
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
     mdns_action_t *action = NULL;
 
-    // find first unqueued packet
-    while (p && p->queued) {
-        p = p->next;
-    }
-    if (!p) {
-        MDNS_SERVICE_UNLOCK();
-        return;
-    }
-    while (p && (int32_t)(p->send_at - (xTaskGetTickCount() * portTICK_PERIOD_MS)) < 0) {
-        action = (mdns_action_t *)mdns_mem_malloc(sizeof(mdns_action_t));
-        if (action) {
-            action->type = ACTION_TX_HANDLE;
-            action->data.tx_handle.packet = p;
-            p->queued = true;
-            if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
-                mdns_mem_free(action);
-                p->queued = false;
-            }
-        } else {
+    while (_mdns_server->tx.heap.len) {
+        if ((int32_t)(_mdns_server->tx.heap.entries[0].send_at - now) > 0) {
+            break;
+        }
+        mdns_tx_packet_t *p = _mdns_server->tx.heap.entries[0].packet;
+        action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
+        if (!action) {
             HOOK_MALLOC_FAILED;
             break;
         }
-        //Find the next unqued packet
-        p = p->next;
+        action->type = ACTION_TX_HANDLE;
+        action->data.tx_handle.packet = p;
+        if (!_mdns_action_post(action)) {
+            mdns_mem_free(action);
+            break;
+        }
+        _mdns_tx_heap_remove(&_mdns_server->tx.heap, p);
+        p->queued = true;
+        p->next = NULL;
+        if (_mdns_server->tx.ready_tail) {
+            _mdns_server->tx.ready_tail->next = p;
+        } else {
+            _mdns_server->tx.ready_head = p;
+        }
+        _mdns_server->tx.ready_tail = p;
+    }
+    if (_mdns_rx_stalled(true)) {
+        _mdns_rx_signal();
     }
     MDNS_SERVICE_UNLOCK();
 }
@@ -5406,6 +7964,32 @@ static void _mdns_search_run(void)
     MDNS_SERVICE_UNLOCK();
 }
 
+/**
+ * @brief  Called from timer task to deliver the browse changes whose window ended
+ */
+static void _mdns_browse_run(void)
+{
+    MDNS_SERVICE_LOCK();
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t deadline = 0;
+    if (_mdns_server->browse_notify_signalled || !_mdns_browse_next_notify(&deadline) || (int32_t)(deadline - now) > 0) {
+        MDNS_SERVICE_UNLOCK();
+        return;
+    }
+    mdns_action_t *action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
+    if (!action) {
+        HOOK_MALLOC_FAILED;
+    } else {
+        action->type = ACTION_BROWSE_SYNC;
+        if (_mdns_action_post(action)) {
+            _mdns_server->browse_notify_signalled = true;
+        } else {
+            mdns_mem_free(action);
+        }
+    }
+    MDNS_SERVICE_UNLOCK();
+}
+
 /**
  * @brief  the main MDNS service task. Packets are received and parsed here
  */
@@ -5431,10 +8015,106 @@ static void _mdns_service_task(void *pvParameters)
     vTaskDelay(portMAX_DELAY);
 }
 
+/**
+ * @brief  Returns the earliest time (in ms) the timer has some work to do
+ *
+ * @return false if there are no scheduled packets, stalled received packets, active searches
+ *         nor pending browse changes
+ */
+static bool _mdns_timer_next_deadline(uint32_t now, uint32_t *deadline)
+{
+    bool found = false;
+    mdns_search_once_t *s = _mdns_server->search_once;
+    if (_mdns_server->tx.heap.len) {
+        *deadline = _mdns_server->tx.heap.entries[0].send_at;
+        found = true;
+    }
+    if (_mdns_rx_stalled(false)) {
+        *deadline = now;
+        found = true;
+    }
+    while (s) {
+        if (s->state != SEARCH_OFF) {
+            uint32_t next = now;
+            if (s->state != SEARCH_INIT) {
+                uint32_t timeout_at = s->started_at + s->timeout + 1;
+                uint32_t resend_at = s->sent_at + 1001;
+                next = ((int32_t)(timeout_at - resend_at) < 0) ? timeout_at : resend_at;
+            }
+            if (!found || (int32_t)(next - *deadline) < 0) {
+                *deadline = next;
+                found = true;
+            }
+        }
+        s = s->next;
+    }
+    uint32_t notify_at = 0;
+    if (!_mdns_server->browse_notify_signalled && _mdns_browse_next_notify(&notify_at)) {
+        if (!found || (int32_t)(notify_at - *deadline) < 0) {
+            *deadline = notify_at;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief  Arms the one-shot timer for the given deadline (in ms), unless it is already armed for an earlier one
+ *
+ * Must be called with the service lock held
+ */
+static void _mdns_timer_arm(uint32_t deadline)
+{
+    if (!_mdns_server->timer_handle) {
+        return;
+    }
+    if (_mdns_server->timer_armed && (int32_t)(deadline - _mdns_server->timer_deadline) >= 0) {
+        return;
+    }
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    int32_t delay_ms = (int32_t)(deadline - now);
+    if (delay_ms < 0) {
+        delay_ms = 0;
+    }
+    // stopped even if not armed here, the RX path may have started it for stalled packets
+    esp_timer_stop(_mdns_server->timer_handle);
+    if (esp_timer_start_once(_mdns_server->timer_handle, (uint64_t)delay_ms * 1000) == ESP_OK) {
+        _mdns_server->timer_armed = true;
+        _mdns_server->timer_deadline = deadline;
+    } else {
+        _mdns_server->timer_armed = false;
+    }
+}
+
+/**
+ * @brief  Re-arms the timer for the next deadline after a timer run; an idle responder leaves it stopped
+ */
+static void _mdns_timer_rearm(void)
+{
+    MDNS_SERVICE_LOCK();
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t deadline;
+    _mdns_server->timer_armed = false;
+    if (_mdns_timer_next_deadline(now, &deadline)) {
+        int32_t delay_ms = (int32_t)(deadline - now);
+        if (delay_ms <= 0) {
+            // work is still pending after this run (action queue full), retry later
+            deadline = now + CONFIG_MDNS_TIMER_PERIOD_MS;
+        } else if (delay_ms < portTICK_PERIOD_MS) {
+            // deadlines are kept in ticks, do not wake up before the next one
+            deadline = now + portTICK_PERIOD_MS;
+        }
+        _mdns_timer_arm(deadline);
+    }
+    MDNS_SERVICE_UNLOCK();
+}
+
 static void _mdns_timer_cb(void *arg)
 {
     _mdns_scheduler_run();
     _mdns_search_run();
+    _mdns_browse_run();
+    _mdns_timer_rearm();
 }
 
 static esp_err_t _mdns_start_timer(void)
@@ -5449,7 +8129,12 @@ static esp_err_t _mdns_start_timer(void)
     if (err) {
         return err;
     }
-    return esp_timer_start_periodic(_mdns_server->timer_handle, MDNS_TIMER_PERIOD_US);
+    _mdns_server->timer_armed = false;
+    uint32_t deadline;
+    if (_mdns_timer_next_deadline(xTaskGetTickCount() * portTICK_PERIOD_MS, &deadline)) {
+        _mdns_timer_arm(deadline);
+    }
+    return ESP_OK;
 }
 
 static esp_err_t _mdns_stop_timer(void)
@@ -5457,10 +8142,13 @@ static esp_err_t _mdns_stop_timer(void)
     esp_err_t err = ESP_OK;
     if (_mdns_server->timer_handle) {
         err = esp_timer_stop(_mdns_server->timer_handle);
-        if (err) {
+        // the one-shot timer is not running while the responder is idle
+        if (err && err != ESP_ERR_INVALID_STATE) {
             return err;
         }
         err = esp_timer_delete(_mdns_server->timer_handle);
+        _mdns_server->timer_handle = NULL;
+        _mdns_server->timer_armed = false;
     }
     return err;
 }
@@ -5537,7 +8225,7 @@ static esp_err_t _mdns_service_task_stop(void)
         mdns_action_t action;
         mdns_action_t *a = &action;
         action.type = ACTION_TASK_STOP;
-        if (xQueueSend(_mdns_server->action_queue, &a, (TickType_t)0) != pdPASS) {
+        if (!_mdns_action_post(a)) {
             _mdns_service_task_handle = NULL;
         }
         while (_mdns_service_task_handle) {
@@ -5556,16 +8244,17 @@ static esp_err_t mdns_post_custom_action_tcpip_if(mdns_if_t mdns_if, mdns_event_
         return ESP_ERR_INVALID_STATE;
     }
 
-    mdns_action_t *action = (mdns_action_t *)mdns_mem_calloc(1, sizeof(mdns_action_t));
+    mdns_action_t *action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
     if (!action) {
         HOOK_MALLOC_FAILED;
         return ESP_ERR_NO_MEM;
     }
+    memset(action, 0, sizeof(mdns_action_t));
     action->type = ACTION_SYSTEM_EVENT;
     action->data.sys_event.event_action = event_action;
     action->data.sys_event.interface = mdns_if;
 
-    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
+    if (!_mdns_action_post(action)) {
         mdns_mem_free(action);
     }
     return ESP_OK;
@@ -5671,6 +8360,10 @@ esp_err_t mdns_init(void)
         return ESP_ERR_NO_MEM;
     }
     memset((uint8_t *)_mdns_server, 0, sizeof(mdns_server_t));
+    _mdns_server->rx.query_budget = MDNS_QUERY_BUDGET;
+    _mdns_server->multicast_interval = MDNS_MULTICAST_INTERVAL;
+    _mdns_server->browse_notify_window = MDNS_BROWSE_NOTIFY_WINDOW;
+    _mdns_snapshot_invalidate();
     // zero-out local copy of netifs to initiate a fresh search by interface key whenever a netif ptr is needed
     for (mdns_if_t i = 0; i < MDNS_MAX_INTERFACES; ++i) {
         s_esp_netifs[i].netif = NULL;
@@ -5750,6 +8443,7 @@ free_event_handlers:
 free_queue:
     vQueueDelete(_mdns_server->action_queue);
 free_server:
+    mdns_mem_parse_arena_free(&_mdns_server->rx.parse.arena);
     mdns_mem_free(_mdns_server);
     _mdns_server = NULL;
     return err;
@@ -5766,7 +8460,9 @@ void mdns_free(void)
     unregister_predefined_handlers();
 
     mdns_service_remove_all();
+    MDNS_SERVICE_LOCK();
     free_delegated_hostnames();
+    MDNS_SERVICE_UNLOCK();
     _mdns_service_task_stop();
     // at this point, the service task is deleted, so we can destroy the stack size
     mdns_mem_task_free(_mdns_stack_buffer);
@@ -5784,7 +8480,19 @@ void mdns_free(void)
         }
         vQueueDelete(_mdns_server->action_queue);
     }
+    mdns_rx_packet_t *packet = _mdns_rx_queue_take();
+    while (packet) {
+        mdns_rx_packet_t *next = packet->next;
+        _mdns_packet_free(packet);
+        packet = next;
+    }
     _mdns_clear_tx_queue_head();
+    mdns_mem_free(_mdns_server->tx.heap.entries);
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            mdns_mem_free(_mdns_server->interfaces[i].pcbs[j].tx_heap.entries);
+        }
+    }
     while (_mdns_server->search_once) {
         mdns_search_once_t *h = _mdns_server->search_once;
         _mdns_server->search_once = h->next;
@@ -5803,9 +8511,14 @@ void mdns_free(void)
         _mdns_browse_item_free(b);
 
     }
+    _mdns_cache_free();
+    _mdns_snapshot_free_all();
+    _mdns_service_index_clear();
+    mdns_mem_parse_arena_free(&_mdns_server->rx.parse.arena);
     vSemaphoreDelete(_mdns_server->action_sema);
     mdns_mem_free(_mdns_server);
     _mdns_server = NULL;
+    mdns_mem_pool_deinit();
 }
 
 esp_err_t mdns_hostname_set(const char *hostname)
@@ -5821,7 +8534,7 @@ esp_err_t mdns_hostname_set(const char *hostname)
         return ESP_ERR_NO_MEM;
     }
 
-    mdns_action_t *action = (mdns_action_t *)mdns_mem_malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
     if (!action) {
         HOOK_MALLOC_FAILED;
         mdns_mem_free(new_hostname);
@@ -5829,7 +8542,7 @@ esp_err_t mdns_hostname_set(const char *hostname)
     }
     action->type = ACTION_HOSTNAME_SET;
     action->data.hostname_set.hostname = new_hostname;
-    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
+    if (!_mdns_action_post(action)) {
         mdns_mem_free(new_hostname);
         mdns_mem_free(action);
         return ESP_ERR_NO_MEM;
@@ -5844,14 +8557,81 @@ esp_err_t mdns_hostname_get(char *hostname)
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (!_mdns_server || !_mdns_server->hostname) {
+    if (!_mdns_server) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    MDNS_SERVICE_LOCK();
-    size_t len = strnlen(_mdns_server->hostname, MDNS_NAME_BUF_LEN - 1);
-    strncpy(hostname, _mdns_server->hostname, len);
+    const mdns_snapshot_t *snap = _mdns_snapshot_acquire();
+    if (!snap || !snap->hostname) {
+        _mdns_snapshot_release();
+        return ESP_ERR_INVALID_STATE;
+    }
+    size_t len = strnlen(snap->hostname, MDNS_NAME_BUF_LEN - 1);
+    strncpy(hostname, snap->hostname, len);
     hostname[len] = 0;
+    _mdns_snapshot_release();
+    return ESP_OK;
+}
+
+void _mdns_count_alloc_failure(void)
+{
+    atomic_fetch_add(&s_alloc_failures, 1);
+}
+
+esp_err_t mdns_get_stats(mdns_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!_mdns_server) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(stats, 0, sizeof(mdns_stats_t));
+    MDNS_SERVICE_LOCK();
+    for (mdns_if_t i = 0; i < MDNS_MAX_INTERFACES && i < CONFIG_MDNS_MAX_INTERFACES; i++) {
+        stats->interfaces[i].netif = _mdns_get_esp_netif(i);
+        for (int p = 0; p < MDNS_IP_PROTOCOL_MAX; p++) {
+            stats->interfaces[i].traffic[p] = _mdns_server->interfaces[i].pcbs[p].traffic;
+        }
+    }
+    stats->parse_failures = _mdns_server->stats.parse_failures;
+    stats->answers_built = _mdns_server->stats.answers_built;
+    stats->known_answers_suppressed = _mdns_server->stats.known_answers_suppressed;
+    stats->duplicate_answers_suppressed = _mdns_server->stats.duplicate_answers_suppressed;
+    stats->answers_rate_limited = _mdns_server->stats.answers_rate_limited;
+    stats->responses_split = _mdns_server->stats.responses_split;
+    stats->records_dropped = _mdns_server->stats.records_dropped;
+    stats->tx_queue_len = _mdns_server->tx.heap.len;
+    stats->tx_queue_max = _mdns_server->stats.tx_queue_max;
+    stats->parse_time_us = _mdns_server->stats.parse_time_us;
+    stats->dispatch_time_us = _mdns_server->stats.dispatch_time_us;
+    // updated by the networking layer and the API callers, outside the service lock
+    portENTER_CRITICAL(&s_rx_lock);
+    stats->rx_dropped = _mdns_server->stats.rx_dropped;
+    stats->queries_throttled = _mdns_server->stats.queries_throttled;
+    stats->action_queue_full = _mdns_server->stats.action_queue_full + _mdns_server->stats.rx_action_queue_full;
+    portEXIT_CRITICAL(&s_rx_lock);
+    stats->alloc_failures = atomic_load(&s_alloc_failures);
+    MDNS_SERVICE_UNLOCK();
+    return ESP_OK;
+}
+
+esp_err_t mdns_reset_stats(void)
+{
+    if (!_mdns_server) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    MDNS_SERVICE_LOCK();
+    for (mdns_if_t i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (int p = 0; p < MDNS_IP_PROTOCOL_MAX; p++) {
+            memset(&_mdns_server->interfaces[i].pcbs[p].traffic, 0, sizeof(mdns_traffic_stats_t));
+        }
+    }
+    portENTER_CRITICAL(&s_rx_lock);
+    memset(&_mdns_server->stats, 0, sizeof(_mdns_server->stats));
+    portEXIT_CRITICAL(&s_rx_lock);
+    _mdns_server->stats.tx_queue_max = _mdns_server->tx.heap.len;
+    atomic_store(&s_alloc_failures, 0);
     MDNS_SERVICE_UNLOCK();
     return ESP_OK;
 }
@@ -5869,7 +8649,7 @@ esp_err_t mdns_delegate_hostname_add(const char *hostname, const mdns_ip_addr_t
         return ESP_ERR_NO_MEM;
     }
 
-    mdns_action_t *action = (mdns_action_t *)mdns_mem_malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
     if (!action) {
         HOOK_MALLOC_FAILED;
         mdns_mem_free(new_hostname);
@@ -5878,7 +8658,7 @@ esp_err_t mdns_delegate_hostname_add(const char *hostname, const mdns_ip_addr_t
     action->type = ACTION_DELEGATE_HOSTNAME_ADD;
     action->data.delegate_hostname.hostname = new_hostname;
     action->data.delegate_hostname.address_list = copy_address_list(address_list);
-    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
+    if (!_mdns_action_post(action)) {
         mdns_mem_free(new_hostname);
         mdns_mem_free(action);
         return ESP_ERR_NO_MEM;
@@ -5900,7 +8680,7 @@ esp_err_t mdns_delegate_hostname_remove(const char *hostname)
         return ESP_ERR_NO_MEM;
     }
 
-    mdns_action_t *action = (mdns_action_t *)mdns_mem_malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
     if (!action) {
         HOOK_MALLOC_FAILED;
         mdns_mem_free(new_hostname);
@@ -5908,7 +8688,7 @@ esp_err_t mdns_delegate_hostname_remove(const char *hostname)
     }
     action->type = ACTION_DELEGATE_HOSTNAME_REMOVE;
     action->data.delegate_hostname.hostname = new_hostname;
-    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
+    if (!_mdns_action_post(action)) {
         mdns_mem_free(new_hostname);
         mdns_mem_free(action);
         return ESP_ERR_NO_MEM;
@@ -5929,7 +8709,7 @@ esp_err_t mdns_delegate_hostname_set_address(const char *hostname, const mdns_ip
         return ESP_ERR_NO_MEM;
     }
 
-    mdns_action_t *action = (mdns_action_t *)mdns_mem_malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
     if (!action) {
         HOOK_MALLOC_FAILED;
         mdns_mem_free(new_hostname);
@@ -5938,7 +8718,7 @@ esp_err_t mdns_delegate_hostname_set_address(const char *hostname, const mdns_ip
     action->type = ACTION_DELEGATE_HOSTNAME_SET_ADDR;
     action->data.delegate_hostname.hostname = new_hostname;
     action->data.delegate_hostname.address_list = copy_address_list(address_list);
-    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
+    if (!_mdns_action_post(action)) {
         mdns_mem_free(new_hostname);
         mdns_mem_free(action);
         return ESP_ERR_NO_MEM;
@@ -5949,9 +8729,11 @@ esp_err_t mdns_delegate_hostname_set_address(const char *hostname, const mdns_ip
 bool mdns_hostname_exists(const char *hostname)
 {
     bool ret = false;
-    MDNS_SERVICE_LOCK();
-    ret = _hostname_is_ours(hostname);
-    MDNS_SERVICE_UNLOCK();
+    const mdns_snapshot_t *snap = _mdns_snapshot_acquire();
+    if (snap) {
+        ret = _mdns_snapshot_hostname_is_ours(snap, hostname);
+    }
+    _mdns_snapshot_release();
     return ret;
 }
 
@@ -5968,7 +8750,7 @@ esp_err_t mdns_instance_name_set(const char *instance)
         return ESP_ERR_NO_MEM;
     }
 
-    mdns_action_t *action = (mdns_action_t *)mdns_mem_malloc(sizeof(mdns_action_t));
+    mdns_action_t *action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
     if (!action) {
         HOOK_MALLOC_FAILED;
         mdns_mem_free(new_instance);
@@ -5976,7 +8758,7 @@ esp_err_t mdns_instance_name_set(const char *instance)
     }
     action->type = ACTION_INSTANCE_SET;
     action->data.instance = new_instance;
-    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
+    if (!_mdns_action_post(action)) {
         mdns_mem_free(new_instance);
         mdns_mem_free(action);
         return ESP_ERR_NO_MEM;
@@ -6014,9 +8796,15 @@ esp_err_t mdns_service_add_for_host(const char *instance, const char *service, c
 
     item->service = s;
     item->next = NULL;
+    bool indexed = _mdns_service_index_add(item);
+    if (!indexed) {
+        mdns_mem_free(item);
+    }
+    ESP_GOTO_ON_FALSE(indexed, ESP_ERR_NO_MEM, err, TAG, "Cannot create service: Out of memory");
 
     item->next = _mdns_server->services;
     _mdns_server->services = item;
+    _mdns_snapshot_invalidate();
     _mdns_probe_all_pcbs(&item, 1, false, false);
     MDNS_SERVICE_UNLOCK();
     return ESP_OK;
@@ -6041,20 +8829,18 @@ esp_err_t mdns_service_add(const char *instance, const char *service, const char
 
 bool mdns_service_exists(const char *service_type, const char *proto, const char *hostname)
 {
-    bool ret = false;
-    MDNS_SERVICE_LOCK();
-    ret = _mdns_get_service_item(service_type, proto, hostname) != NULL;
-    MDNS_SERVICE_UNLOCK();
-    return ret;
+    return mdns_service_exists_with_instance(NULL, service_type, proto, hostname);
 }
 
 bool mdns_service_exists_with_instance(const char *instance, const char *service_type, const char *proto,
                                        const char *hostname)
 {
     bool ret = false;
-    MDNS_SERVICE_LOCK();
-    ret = _mdns_get_service_item_instance(instance, service_type, proto, hostname) != NULL;
-    MDNS_SERVICE_UNLOCK();
+    const mdns_snapshot_t *snap = _mdns_snapshot_acquire();
+    for (size_t i = 0; snap && i < snap->services_len && !ret; i++) {
+        ret = _mdns_snapshot_service_match(snap, &snap->services[i], instance, service_type, proto, hostname);
+    }
+    _mdns_snapshot_release();
     return ret;
 }
 
@@ -6111,37 +8897,34 @@ handle_error:
     return NULL;
 }
 
-static mdns_ip_addr_t *_copy_delegated_host_address_list(char *hostname)
+static mdns_ip_addr_t *_copy_delegated_host_address_list(const mdns_snapshot_t *snap, const char *hostname)
 {
-    mdns_host_item_t *host = _mdns_host_list;
-    while (host) {
+    for (mdns_host_item_t *host = snap->hosts; host; host = host->next) {
         if (strcasecmp(host->hostname, hostname) == 0) {
             return copy_address_list(host->address_list);
         }
-        host = host->next;
     }
     return NULL;
 }
 
-static mdns_result_t *_mdns_lookup_service(const char *instance, const char *service, const char *proto, size_t max_results, bool selfhost)
+static mdns_result_t *_mdns_lookup_service(const mdns_snapshot_t *snap, const char *instance, const char *service, const char *proto,
+                                           size_t max_results, bool selfhost)
 {
     if (_str_null_or_empty(service) || _str_null_or_empty(proto)) {
         return NULL;
     }
     mdns_result_t *results = NULL;
     size_t num_results = 0;
-    mdns_srv_item_t *s = _mdns_server->services;
-    while (s) {
-        mdns_service_t *srv = s->service;
-        if (!srv || !srv->hostname) {
-            s = s->next;
+    for (size_t i = 0; i < snap->services_len; i++) {
+        const mdns_service_t *srv = &snap->services[i];
+        if (!srv->hostname) {
             continue;
         }
-        bool is_service_selfhosted = !_str_null_or_empty(_mdns_server->hostname) && !strcasecmp(_mdns_server->hostname, srv->hostname);
-        bool is_service_delegated = _str_null_or_empty(_mdns_server->hostname) || strcasecmp(_mdns_server->hostname, srv->hostname);
+        bool is_service_selfhosted = !_str_null_or_empty(snap->hostname) && !strcasecmp(snap->hostname, srv->hostname);
+        bool is_service_delegated = _str_null_or_empty(snap->hostname) || strcasecmp(snap->hostname, srv->hostname);
         if ((selfhost && is_service_selfhosted) || (!selfhost && is_service_delegated)) {
             if (!strcasecmp(srv->service, service) && !strcasecmp(srv->proto, proto) &&
-                    (_str_null_or_empty(instance) || _mdns_instance_name_match(srv->instance, instance))) {
+                    (_str_null_or_empty(instance) || _mdns_snapshot_instance_match(snap, srv->instance, instance))) {
                 mdns_result_t *item = (mdns_result_t *)mdns_mem_malloc(sizeof(mdns_result_t));
                 if (!item) {
                     HOOK_MALLOC_FAILED;
@@ -6182,7 +8965,7 @@ static mdns_result_t *_mdns_lookup_service(const char *instance, const char *ser
                 if (selfhost) {
                     item->addr = NULL;
                 } else {
-                    item->addr = _copy_delegated_host_address_list(item->hostname);
+                    item->addr = _copy_delegated_host_address_list(snap, item->hostname);
                     if (!item->addr) {
                         goto handle_error;
                     }
@@ -6195,7 +8978,6 @@ static mdns_result_t *_mdns_lookup_service(const char *instance, const char *ser
                 }
             }
         }
-        s = s->next;
     }
     return results;
 handle_error:
@@ -6214,6 +8996,7 @@ esp_err_t mdns_service_port_set_for_host(const char *instance, const char *servi
     ESP_GOTO_ON_FALSE(s, ESP_ERR_NOT_FOUND, err, TAG, "Service doesn't exist");
 
     s->service->port = port;
+    _mdns_snapshot_invalidate();
     _mdns_announce_all_pcbs(&s, 1, true);
 
 err:
@@ -6252,6 +9035,7 @@ esp_err_t mdns_service_txt_set_for_host(const char *instance, const char *servic
     srv->txt = NULL;
     _mdns_free_linked_txt(txt);
     srv->txt = new_txt;
+    _mdns_service_wire_invalidate(srv);
     _mdns_announce_all_pcbs(&s, 1, false);
 
 err:
@@ -6309,6 +9093,7 @@ esp_err_t mdns_service_txt_item_set_for_host_with_explicit_value_len(const char
         new_txt->next = srv->txt;
         srv->txt = new_txt;
     }
+    _mdns_service_wire_invalidate(srv);
 
     _mdns_announce_all_pcbs(&s, 1, false);
 
@@ -6385,6 +9170,7 @@ esp_err_t mdns_service_txt_item_remove_for_host(const char *instance, const char
             }
         }
     }
+    _mdns_service_wire_invalidate(srv);
 
     _mdns_announce_all_pcbs(&s, 1, false);
 
@@ -6645,12 +9431,18 @@ esp_err_t mdns_service_instance_name_set_for_host(const char *instance_old, cons
     mdns_srv_item_t *s = _mdns_get_service_item_instance(instance_old, service, proto, hostname);
     ESP_GOTO_ON_FALSE(s, ESP_ERR_NOT_FOUND, err, TAG, "Service doesn't exist");
 
+    // the index room is reserved first, so that the rename cannot fail after the goodbye
+    char *new_instance = mdns_mem_strndup(instance, MDNS_NAME_BUF_LEN - 1);
+    bool reserved = new_instance && _mdns_index_reserve(&_mdns_server->index.instances);
+    if (!reserved) {
+        mdns_mem_free(new_instance);
+    }
+    ESP_GOTO_ON_FALSE(reserved, ESP_ERR_NO_MEM, err, TAG, "Out of memory");
     if (s->service->instance) {
         _mdns_send_bye(&s, 1, false);
-        mdns_mem_free((char *)s->service->instance);
     }
-    s->service->instance = mdns_mem_strndup(instance, MDNS_NAME_BUF_LEN - 1);
-    ESP_GOTO_ON_FALSE(s->service->instance, ESP_ERR_NO_MEM, err, TAG, "Out of memory");
+    _mdns_service_instance_replace(s, new_instance);
+    _mdns_service_wire_invalidate(s->service);
     _mdns_probe_all_pcbs(&s, 1, false, false);
 
 err:
@@ -6688,6 +9480,7 @@ esp_err_t mdns_service_remove_for_host(const char *instance, const char *service
                 }
                 _mdns_send_bye(&a, 1, false);
                 _mdns_remove_scheduled_service_packets(a->service);
+                _mdns_service_index_remove(a);
                 _mdns_free_service(a->service);
                 mdns_mem_free(a);
                 break;
@@ -6705,6 +9498,7 @@ esp_err_t mdns_service_remove_for_host(const char *instance, const char *service
                 }
                 _mdns_send_bye(&a, 1, false);
                 _mdns_remove_scheduled_service_packets(a->service);
+                _mdns_service_index_remove(a);
                 _mdns_free_service(a->service);
                 mdns_mem_free(a);
                 break;
@@ -6739,6 +9533,7 @@ esp_err_t mdns_service_remove_all(void)
     _mdns_send_final_bye(false);
     mdns_srv_item_t *services = _mdns_server->services;
     _mdns_server->services = NULL;
+    _mdns_service_index_clear();
     while (services) {
         mdns_srv_item_t *s = services;
         services = services->next;
@@ -6917,9 +9712,9 @@ esp_err_t mdns_lookup_delegated_service(const char *instance, const char *servic
     if (!result || _str_null_or_empty(service) || _str_null_or_empty(proto)) {
         return ESP_ERR_INVALID_ARG;
     }
-    MDNS_SERVICE_LOCK();
-    *result = _mdns_lookup_service(instance, service, proto, max_results, false);
-    MDNS_SERVICE_UNLOCK();
+    const mdns_snapshot_t *snap = _mdns_snapshot_acquire();
+    *result = snap ? _mdns_lookup_service(snap, instance, service, proto, max_results, false) : NULL;
+    _mdns_snapshot_release();
     return ESP_OK;
 }
 
@@ -6932,9 +9727,9 @@ esp_err_t mdns_lookup_selfhosted_service(const char *instance, const char *servi
     if (!result || _str_null_or_empty(service) || _str_null_or_empty(proto)) {
         return ESP_ERR_INVALID_ARG;
     }
-    MDNS_SERVICE_LOCK();
-    *result = _mdns_lookup_service(instance, service, proto, max_results, true);
-    MDNS_SERVICE_UNLOCK();
+    const mdns_snapshot_t *snap = _mdns_snapshot_acquire();
+    *result = snap ? _mdns_lookup_service(snap, instance, service, proto, max_results, true) : NULL;
+    _mdns_snapshot_release();
     return ESP_OK;
 }
 
@@ -7020,7 +9815,7 @@ esp_err_t mdns_query_aaaa(const char *name, uint32_t timeout, esp_ip6_addr_t *ad
 
 void mdns_debug_packet(const uint8_t *data, size_t len)
 {
-    static mdns_name_t n;
+    mdns_name_t n;
     mdns_header_t header;
     const uint8_t *content = data + MDNS_HEAD_LEN;
     uint32_t t = xTaskGetTickCount() * portTICK_PERIOD_MS;
@@ -7248,25 +10043,6 @@ void mdns_debug_packet(const uint8_t *data, size_t len)
 /**
  * @brief  Browse sync result action
  */
-static esp_err_t _mdns_sync_browse_action(mdns_action_type_t type, mdns_browse_sync_t *browse_sync)
-{
-    mdns_action_t *action = NULL;
-
-    action = (mdns_action_t *)mdns_mem_malloc(sizeof(mdns_action_t));
-    if (!action) {
-        HOOK_MALLOC_FAILED;
-        return ESP_ERR_NO_MEM;
-    }
-
-    action->type = type;
-    action->data.browse_sync.browse_sync = browse_sync;
-    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
-        mdns_mem_free(action);
-        return ESP_ERR_NO_MEM;
-    }
-    return ESP_OK;
-}
-
 /**
  * @brief  Browse action
  */
@@ -7274,7 +10050,7 @@ static esp_err_t _mdns_send_browse_action(mdns_action_type_t type, mdns_browse_t
 {
     mdns_action_t *action = NULL;
 
-    action = (mdns_action_t *)mdns_mem_malloc(sizeof(mdns_action_t));
+    action = (mdns_action_t *)mdns_mem_pool_alloc(MDNS_MEM_POOL_ACTION, sizeof(mdns_action_t));
 
     if (!action) {
         HOOK_MALLOC_FAILED;
@@ -7283,7 +10059,7 @@ static esp_err_t _mdns_send_browse_action(mdns_action_type_t type, mdns_browse_t
 
     action->type = type;
     action->data.browse_add.browse = browse;
-    if (xQueueSend(_mdns_server->action_queue, &action, (TickType_t)0) != pdPASS) {
+    if (!_mdns_action_post(action)) {
         mdns_mem_free(action);
         return ESP_ERR_NO_MEM;
     }
@@ -7293,13 +10069,25 @@ static esp_err_t _mdns_send_browse_action(mdns_action_type_t type, mdns_browse_t
 /**
  * @brief  Free a browse item (Not free the list).
  */
+/**
+ * @brief  Frees browse results, their service and proto are the strings of the browse
+ */
+static void _mdns_browse_results_free(mdns_result_t *results)
+{
+    for (mdns_result_t *r = results; r; r = r->next) {
+        r->service_type = NULL;
+        r->proto = NULL;
+    }
+    _mdns_query_results_free(results);
+}
+
 static void _mdns_browse_item_free(mdns_browse_t *browse)
 {
+    _mdns_browse_results_free(browse->result);
+    _mdns_result_index_free(&browse->index);
+    mdns_mem_free(browse->changes.list);
     mdns_mem_free(browse->service);
     mdns_mem_free(browse->proto);
-    if (browse->result) {
-        _mdns_query_results_free(browse->result);
-    }
     mdns_mem_free(browse);
 }
 
@@ -7333,11 +10121,52 @@ static mdns_browse_t *_mdns_browse_init(const char *service, const char *proto,
         }
     }
 
-    browse->notifier = notifier;
-    return browse;
+    browse->type_hash = _mdns_service_type_hash(browse->service ? browse->service : "", browse->proto ? browse->proto : "");
+    browse->notifier = notifier;
+    return browse;
+}
+
+static inline bool _mdns_browse_same_type(const mdns_browse_t *a, const mdns_browse_t *b)
+{
+    return a->type_hash == b->type_hash && !strcmp(a->service, b->service) && !strcmp(a->proto, b->proto);
+}
+
+/**
+ * @brief  Returns the browse of the same type from the browse chain
+ */
+static mdns_browse_t *_mdns_browse_find_type(const mdns_browse_t *browse)
+{
+    for (mdns_browse_t *b = _mdns_server->browse; b; b = b->next) {
+        if (_mdns_browse_same_type(b, browse)) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief  Adds the notifier of a duplicate browse to the running one
+ *
+ * @return false if the running browse has another notifier of the same kind
+ */
+static bool _mdns_browse_merge_notifier(mdns_browse_t *browse, mdns_browse_notify_t notifier,
+                                        mdns_browse_batch_notify_t batch_notifier)
+{
+    if ((notifier && browse->notifier && browse->notifier != notifier)
+            || (batch_notifier && browse->batch_notifier && browse->batch_notifier != batch_notifier)) {
+        return false;
+    }
+    if (notifier) {
+        browse->notifier = notifier;
+    }
+    if (batch_notifier) {
+        browse->batch_notifier = batch_notifier;
+    }
+    return true;
 }
 
-mdns_browse_t *mdns_browse_new(const char *service, const char *proto, mdns_browse_notify_t notifier)
+static mdns_browse_t *_mdns_browse_new(const char *service, const char *proto, mdns_browse_notify_t notifier,
+                                        mdns_browse_batch_notify_t batch_notifier)
 {
     mdns_browse_t *browse = NULL;
 
@@ -7349,15 +10178,43 @@ mdns_browse_t *mdns_browse_new(const char *service, const char *proto, mdns_brow
     if (!browse) {
         return NULL;
     }
+    browse->batch_notifier = batch_notifier;
 
-    if (_mdns_send_browse_action(ACTION_BROWSE_ADD, browse)) {
+    MDNS_SERVICE_LOCK();
+    mdns_browse_t *running = _mdns_browse_find_type(browse);
+    if (running) {
         _mdns_browse_item_free(browse);
-        return NULL;
+        browse = NULL;
+        if (_mdns_browse_merge_notifier(running, notifier, batch_notifier)) {
+            browse = running;
+            // queried again, as a new browse would be
+            _mdns_send_browse_action(ACTION_BROWSE_ADD, running);
+        }
+    } else if (_mdns_send_browse_action(ACTION_BROWSE_ADD, browse)) {
+        _mdns_browse_item_free(browse);
+        browse = NULL;
+    } else {
+        // listed right away, a browse of the same type started before the action runs finds it
+        browse->next = _mdns_server->browse;
+        _mdns_server->browse = browse;
     }
-
+    MDNS_SERVICE_UNLOCK();
     return browse;
 }
 
+mdns_browse_t *mdns_browse_new(const char *service, const char *proto, mdns_browse_notify_t notifier)
+{
+    return _mdns_browse_new(service, proto, notifier, NULL);
+}
+
+mdns_browse_t *mdns_browse_new_batched(const char *service, const char *proto, mdns_browse_batch_notify_t notifier)
+{
+    if (!notifier) {
+        return NULL;
+    }
+    return _mdns_browse_new(service, proto, NULL, notifier);
+}
+
 esp_err_t mdns_browse_delete(const char *service, const char *proto)
 {
     mdns_browse_t *browse = NULL;
@@ -7371,62 +10228,53 @@ esp_err_t mdns_browse_delete(const char *service, const char *proto)
         return ESP_ERR_NO_MEM;
     }
 
+    MDNS_SERVICE_LOCK();
     if (_mdns_send_browse_action(ACTION_BROWSE_END, browse)) {
+        MDNS_SERVICE_UNLOCK();
         _mdns_browse_item_free(browse);
         return ESP_ERR_NO_MEM;
     }
+    // detached right away, the action frees them once the actions queued before it ran
+    mdns_browse_t *b = _mdns_server->browse;
+    while (b) {
+        mdns_browse_t *next = b->next;
+        if (_mdns_browse_same_type(b, browse)) {
+            queueDetach(mdns_browse_t, _mdns_server->browse, b);
+            b->state = BROWSE_OFF;
+            b->next = browse->next;
+            browse->next = b;
+        }
+        b = next;
+    }
+    MDNS_SERVICE_UNLOCK();
     return ESP_OK;
 }
 
 /**
- * @brief  Mark browse as finished, remove and free it from browse chain
+ * @brief  Frees the browse of an ACTION_BROWSE_END with the browses it detached from the browse chain
  */
 static void _mdns_browse_finish(mdns_browse_t *browse)
 {
-    browse->state = BROWSE_OFF;
-    mdns_browse_t *b = _mdns_server->browse;
-    mdns_browse_t *target_free = NULL;
-    while (b) {
-        if (strlen(b->service) == strlen(browse->service) && memcmp(b->service, browse->service, strlen(b->service)) == 0 &&
-                strlen(b->proto) == strlen(browse->proto) && memcmp(b->proto, browse->proto, strlen(b->proto)) == 0) {
-            target_free = b;
-            b = b->next;
-            queueDetach(mdns_browse_t, _mdns_server->browse, target_free);
-            _mdns_browse_item_free(target_free);
-        } else {
-            b = b->next;
-        }
+    while (browse) {
+        mdns_browse_t *next = browse->next;
+        _mdns_browse_item_free(browse);
+        browse = next;
     }
-    _mdns_browse_item_free(browse);
 }
 
 /**
- * @brief  Add new browse to the browse chain
+ * @brief  Starts a browse listed by mdns_browse_new(), sending its PTR query
  */
 static void _mdns_browse_add(mdns_browse_t *browse)
 {
-    browse->state = BROWSE_RUNNING;
-    mdns_browse_t *queue = _mdns_server->browse;
-    bool found = false;
-    // looking for this browse in active browses
-    while (queue) {
-        if (strlen(queue->service) == strlen(browse->service) && memcmp(queue->service, browse->service, strlen(queue->service)) == 0 &&
-                strlen(queue->proto) == strlen(browse->proto) && memcmp(queue->proto, browse->proto, strlen(queue->proto)) == 0) {
-            found = true;
-            break;
-        }
-        queue = queue->next;
-    }
-    if (!found) {
-        browse->next = _mdns_server->browse;
-        _mdns_server->browse = browse;
+    // deleted before the action ran, the following ACTION_BROWSE_END frees it
+    if (browse->state == BROWSE_OFF) {
+        return;
     }
+    browse->state = BROWSE_RUNNING;
     for (uint8_t interface_idx = 0; interface_idx < MDNS_MAX_INTERFACES; interface_idx++) {
         _mdns_browse_send(browse, (mdns_if_t)interface_idx);
     }
-    if (found) {
-        _mdns_browse_item_free(browse);
-    }
 }
 
 /**
@@ -7442,7 +10290,8 @@ static void _mdns_browse_send(mdns_browse_t *browse, mdns_if_t interface)
     search.proto = browse->proto;
     search.type = MDNS_TYPE_PTR;
     search.unicast = false;
-    search.result = NULL;
+    // the instances found so far are sent as known answers
+    search.result = browse->result;
     search.next = NULL;
 
     for (uint8_t protocol_idx = 0; protocol_idx < MDNS_IP_PROTOCOL_MAX; protocol_idx++) {
@@ -7450,93 +10299,211 @@ static void _mdns_browse_send(mdns_browse_t *browse, mdns_if_t interface)
     }
 }
 
+/*
+ * Browse notifications
+ *
+ * A burst of announcements would call the notifier for every packet. The results changed by
+ * the received packets are collected per browse instead, and delivered together once the
+ * notification window of the first change ends, or as soon as MDNS_BROWSE_MAX_CHANGES are
+ * pending. Results with TTL 0 are removed after they were notified.
+ */
+
 /**
- * @brief  Add result to browse, only add when the result is a new one.
+ * @brief  Delivers the pending changes of the browse and frees the removed results
  */
-static esp_err_t _mdns_add_browse_result(mdns_browse_sync_t *sync_browse, mdns_result_t *r)
+static void _mdns_browse_notify(mdns_browse_t *browse)
 {
-    mdns_browse_result_sync_t *sync_r = sync_browse->sync_result;
-    while (sync_r) {
-        if (sync_r->result == r) {
-            break;
+    mdns_browse_change_t *list = browse->changes.list;
+    mdns_result_t **batch = browse->changes.batch;
+    uint16_t len = browse->changes.len;
+    size_t added = 0, updated = 0, removed = 0;
+    uint16_t i;
+
+    // a result added and removed within the window is not reported
+    for (i = 0; i < len; i++) {
+        if (list[i].added && list[i].result->ttl) {
+            batch[added++] = list[i].result;
+        }
+    }
+    for (i = 0; i < len; i++) {
+        if (!list[i].added && list[i].result->ttl) {
+            batch[added + updated++] = list[i].result;
+        }
+    }
+    for (i = 0; i < len; i++) {
+        if (!list[i].added && !list[i].result->ttl) {
+            batch[added + updated + removed++] = list[i].result;
+        }
+    }
+    browse->changes.len = 0;
+#ifdef MDNS_ENABLE_DEBUG
+    _mdns_dbg_printf("Browse %s%s changed: %u added, %u updated, %u removed\n", browse->service, browse->proto,
+                     (unsigned)added, (unsigned)updated, (unsigned)removed);
+#endif // MDNS_ENABLE_DEBUG
+    if (browse->batch_notifier) {
+        if (added + updated + removed) {
+            mdns_browse_changes_t changes = {
+                .added = batch, .added_count = added,
+                .updated = batch + added, .updated_count = updated,
+                .removed = batch + added + updated, .removed_count = removed,
+            };
+            browse->batch_notifier(browse, &changes);
+            _mdns_server->stats.browse_notifications++;
+        }
+    }
+    // set as well if a duplicate mdns_browse_new() was merged into a batched browse
+    if (browse->notifier) {
+        for (i = 0; i < added + updated + removed; i++) {
+            browse->notifier(batch[i]);
+            _mdns_server->stats.browse_notifications++;
+        }
+    }
+    for (i = 0; i < len; i++) {
+        mdns_result_t *r = list[i].result;
+        if (!r->ttl) {
+            queueDetach(mdns_result_t, browse->result, r);
+            _mdns_result_index_remove(&browse->index, r);
+            r->next = NULL;
+            _mdns_browse_results_free(r);
         }
-        sync_r = sync_r->next;
     }
-    if (!sync_r) {
-        // Do not find, need to add the result to the list
-        mdns_browse_result_sync_t *new = (mdns_browse_result_sync_t *)mdns_mem_malloc(sizeof(mdns_browse_result_sync_t));
+}
 
-        if (!new) {
-            HOOK_MALLOC_FAILED;
-            return ESP_ERR_NO_MEM;
+/**
+ * @brief  Delivers the changes of all browses whose notification window ended
+ */
+static void _mdns_browse_notify_due(uint32_t now)
+{
+    for (mdns_browse_t *b = _mdns_server->browse; b; b = b->next) {
+        if (b->changes.len && (int32_t)(now - b->changes.notify_at) >= 0) {
+            _mdns_browse_notify(b);
         }
-        new->result = r;
-        new->next = sync_browse->sync_result;
-        sync_browse->sync_result = new;
     }
-    return ESP_OK;
+}
+
+/**
+ * @brief  Returns the earliest time (in ms) changes of a browse are to be delivered
+ *
+ * @return false if no browse has pending changes
+ */
+static bool _mdns_browse_next_notify(uint32_t *deadline)
+{
+    bool found = false;
+    for (mdns_browse_t *b = _mdns_server->browse; b; b = b->next) {
+        if (b->changes.len && (!found || (int32_t)(b->changes.notify_at - *deadline) < 0)) {
+            *deadline = b->changes.notify_at;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief  Makes room for the change of one result, to be called before the result is modified
+ *
+ * Once MDNS_BROWSE_MAX_CHANGES are pending, they are delivered first.
+ *
+ * @return false if out of memory
+ */
+static bool _mdns_browse_changes_reserve(mdns_browse_t *browse)
+{
+    if (browse->changes.len >= MDNS_BROWSE_MAX_CHANGES) {
+        _mdns_server->stats.browse_changes_flushed++;
+        _mdns_browse_notify(browse);
+    }
+    if (browse->changes.len < browse->changes.size) {
+        return true;
+    }
+    uint16_t size = browse->changes.size ? browse->changes.size * 2 : 8;
+    if (size > MDNS_BROWSE_MAX_CHANGES) {
+        size = MDNS_BROWSE_MAX_CHANGES;
+    }
+    // the batch array follows the list in the same allocation
+    mdns_browse_change_t *list = (mdns_browse_change_t *)mdns_mem_malloc(size * (sizeof(mdns_browse_change_t) + sizeof(mdns_result_t *)));
+    if (!list) {
+        HOOK_MALLOC_FAILED;
+        return false;
+    }
+    if (browse->changes.len) {
+        memcpy(list, browse->changes.list, browse->changes.len * sizeof(mdns_browse_change_t));
+    }
+    mdns_mem_free(browse->changes.list);
+    browse->changes.list = list;
+    browse->changes.batch = (mdns_result_t **)(list + size);
+    browse->changes.size = size;
+    return true;
+}
+
+/**
+ * @brief  Records the change of a result, room has to be reserved first
+ */
+static void _mdns_browse_result_changed(mdns_browse_t *browse, mdns_result_t *r, bool added)
+{
+    // a packet changes the same result several times, look at the latest changes first
+    for (uint16_t i = browse->changes.len; i > 0; i--) {
+        if (browse->changes.list[i - 1].result == r) {
+            return;
+        }
+    }
+    if (!browse->changes.len) {
+        browse->changes.notify_at = xTaskGetTickCount() * portTICK_PERIOD_MS + _mdns_server->browse_notify_window;
+        if (_mdns_server->browse_notify_window) {
+            _mdns_timer_arm(browse->changes.notify_at);
+        }
+    }
+    browse->changes.list[browse->changes.len].result = r;
+    browse->changes.list[browse->changes.len].added = added;
+    browse->changes.len++;
 }
 
 /**
  * @brief  Called from parser to add A/AAAA data to search result
  */
 static void _mdns_browse_result_add_ip(mdns_browse_t *browse, const char *hostname, esp_ip_addr_t *ip,
-                                       mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint32_t ttl, mdns_browse_sync_t *out_sync_browse)
+                                       mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint32_t ttl)
 {
-    if (out_sync_browse->browse == NULL) {
+    if (!_mdns_browse_changes_reserve(browse)) {
         return;
-    } else {
-        if (out_sync_browse->browse != browse) {
-            return;
-        }
     }
     mdns_result_t *r = NULL;
     mdns_ip_addr_t *r_a = NULL;
-    if (browse) {
-        r = browse->result;
-        while (r) {
-            if (r->ip_protocol == ip_protocol) {
-                // Find the target result in browse result.
-                if (r->esp_netif == _mdns_get_esp_netif(tcpip_if) && !_str_null_or_empty(r->hostname) && !strcasecmp(hostname, r->hostname)) {
-                    r_a = r->addr;
-                    // Check if the address has already added in result.
-                    while (r_a) {
+    mdns_result_key_t key = { _mdns_get_esp_netif(tcpip_if), ip_protocol, hostname };
+    mdns_index_slot_t *slot = NULL;
+    // Find the target results in browse result.
+    while ((r = _mdns_result_find_host(&browse->index, &key, &slot)) != NULL) {
+        r_a = r->addr;
+        // Check if the address has already added in result.
+        while (r_a) {
 #ifdef CONFIG_LWIP_IPV4
-                        if (r_a->addr.type == ip->type && r_a->addr.type == ESP_IPADDR_TYPE_V4 && r_a->addr.u_addr.ip4.addr == ip->u_addr.ip4.addr) {
-                            break;
-                        }
+            if (r_a->addr.type == ip->type && r_a->addr.type == ESP_IPADDR_TYPE_V4 && r_a->addr.u_addr.ip4.addr == ip->u_addr.ip4.addr) {
+                break;
+            }
 #endif
 #ifdef CONFIG_LWIP_IPV6
-                        if (r_a->addr.type == ip->type && r_a->addr.type == ESP_IPADDR_TYPE_V6 && !memcmp(r_a->addr.u_addr.ip6.addr, ip->u_addr.ip6.addr, 16)) {
-                            break;
-                        }
+            if (r_a->addr.type == ip->type && r_a->addr.type == ESP_IPADDR_TYPE_V6 && !memcmp(r_a->addr.u_addr.ip6.addr, ip->u_addr.ip6.addr, 16)) {
+                break;
+            }
 #endif
-                        r_a = r_a->next;
-                    }
-                    if (!r_a) {
-                        // The current IP is a new one, add it to the link list.
-                        mdns_ip_addr_t *a = NULL;
-                        a = _mdns_result_addr_create_ip(ip);
-                        if (!a) {
-                            return;
-                        }
-                        a->next = r->addr;
-                        r->addr = a;
-                        if (r->ttl != ttl) {
-                            if (r->ttl == 0) {
-                                r->ttl = ttl;
-                            } else {
-                                _mdns_result_update_ttl(r, ttl);
-                            }
-                        }
-                        if (_mdns_add_browse_result(out_sync_browse, r) != ESP_OK) {
-                            return;
-                        }
-                        break;
-                    }
+            r_a = r_a->next;
+        }
+        if (!r_a) {
+            // The current IP is a new one, add it to the link list.
+            mdns_ip_addr_t *a = NULL;
+            a = _mdns_result_addr_create_ip(ip);
+            if (!a) {
+                return;
+            }
+            a->next = r->addr;
+            r->addr = a;
+            if (r->ttl != ttl) {
+                if (r->ttl == 0) {
+                    r->ttl = ttl;
+                } else {
+                    _mdns_result_update_ttl(r, ttl);
                 }
             }
-            r = r->next;
+            _mdns_browse_result_changed(browse, r, false);
+            break;
         }
     }
     return;
@@ -7551,7 +10518,7 @@ static mdns_browse_t *_mdns_browse_find_from(mdns_browse_t *b, mdns_name_t *name
     if (type != MDNS_TYPE_SRV && type != MDNS_TYPE_A && type != MDNS_TYPE_AAAA && type != MDNS_TYPE_TXT) {
         return NULL;
     }
-    mdns_result_t *r = NULL;
+    mdns_result_key_t key = { _mdns_get_esp_netif(tcpip_if), ip_protocol, name->host };
     while (b) {
         if (type == MDNS_TYPE_SRV || type == MDNS_TYPE_TXT) {
             if (strcasecmp(name->service, b->service)
@@ -7561,12 +10528,9 @@ static mdns_browse_t *_mdns_browse_find_from(mdns_browse_t *b, mdns_name_t *name
             }
             return b;
         } else if (type == MDNS_TYPE_A || type == MDNS_TYPE_AAAA) {
-            r = b->result;
-            while (r) {
-                if (r->esp_netif == _mdns_get_esp_netif(tcpip_if) && r->ip_protocol == ip_protocol && !_str_null_or_empty(r->hostname) && !strcasecmp(name->host, r->hostname)) {
-                    return b;
-                }
-                r = r->next;
+            mdns_index_slot_t *slot = NULL;
+            if (_mdns_result_find_host(&b->index, &key, &slot)) {
+                return b;
             }
             b = b->next;
             continue;
@@ -7593,66 +10557,55 @@ static bool is_txt_item_in_list(mdns_txt_item_t txt, uint8_t txt_value_len, mdns
 /**
  * @brief  Called from parser to add TXT data to search result
  */
-static void _mdns_browse_result_add_txt(mdns_browse_t *browse, const char *instance, const char *service, const char *proto,
+static void _mdns_browse_result_add_txt(mdns_browse_t *browse, const char *instance,
                                         mdns_txt_item_t *txt, uint8_t *txt_value_len, size_t txt_count, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol,
-                                        uint32_t ttl, mdns_browse_sync_t *out_sync_browse)
+                                        uint32_t ttl)
 {
-    if (out_sync_browse->browse == NULL) {
-        return;
-    } else {
-        if (out_sync_browse->browse != browse) {
-            return;
-        }
+    if (!_mdns_browse_changes_reserve(browse)) {
+        goto free_txt;
     }
-    mdns_result_t *r = browse->result;
-    while (r) {
-        if (r->esp_netif == _mdns_get_esp_netif(tcpip_if) && r->ip_protocol == ip_protocol &&
-                !_str_null_or_empty(r->instance_name) && !strcasecmp(instance, r->instance_name) &&
-                !_str_null_or_empty(r->service_type) && !strcasecmp(service, r->service_type) &&
-                !_str_null_or_empty(r->proto) && !strcasecmp(proto, r->proto)) {
-            bool should_update = false;
-            if (r->txt) {
-                // Check if txt changed
-                if (txt_count != r->txt_count) {
-                    should_update = true;
-                } else {
-                    for (size_t txt_index = 0; txt_index < txt_count; txt_index++) {
-                        if (!is_txt_item_in_list(txt[txt_index], txt_value_len[txt_index], r->txt, r->txt_value_len, r->txt_count)) {
-                            should_update = true;
-                            break;
-                        }
+    // all results of the browse are of its service type
+    mdns_result_t *r = _mdns_result_find_instance(&browse->index, instance, _mdns_get_esp_netif(tcpip_if), ip_protocol);
+    if (r) {
+        bool should_update = false;
+        if (r->txt) {
+            // Check if txt changed
+            if (txt_count != r->txt_count) {
+                should_update = true;
+            } else {
+                for (size_t txt_index = 0; txt_index < txt_count; txt_index++) {
+                    if (!is_txt_item_in_list(txt[txt_index], txt_value_len[txt_index], r->txt, r->txt_value_len, r->txt_count)) {
+                        should_update = true;
+                        break;
                     }
                 }
-                // If the result has a previous txt entry, we delete it and re-add.
-                for (size_t i = 0; i < r->txt_count; i++) {
-                    mdns_mem_free((char *)(r->txt[i].key));
-                    mdns_mem_free((char *)(r->txt[i].value));
-                }
-                mdns_mem_free(r->txt);
-                mdns_mem_free(r->txt_value_len);
             }
-            r->txt = txt;
-            r->txt_value_len = txt_value_len;
-            r->txt_count = txt_count;
-            if (r->ttl != ttl) {
-                uint32_t previous_ttl = r->ttl;
-                if (r->ttl == 0) {
-                    r->ttl = ttl;
-                } else {
-                    _mdns_result_update_ttl(r, ttl);
-                }
-                if (previous_ttl != r->ttl) {
-                    should_update = true;
-                }
+            // If the result has a previous txt entry, we delete it and re-add.
+            for (size_t i = 0; i < r->txt_count; i++) {
+                mdns_mem_free((char *)(r->txt[i].key));
+                mdns_mem_free((char *)(r->txt[i].value));
             }
-            if (should_update) {
-                if (_mdns_add_browse_result(out_sync_browse, r) != ESP_OK) {
-                    return;
-                }
+            mdns_mem_free(r->txt);
+            mdns_mem_free(r->txt_value_len);
+        }
+        r->txt = txt;
+        r->txt_value_len = txt_value_len;
+        r->txt_count = txt_count;
+        if (r->ttl != ttl) {
+            uint32_t previous_ttl = r->ttl;
+            if (r->ttl == 0) {
+                r->ttl = ttl;
+            } else {
+                _mdns_result_update_ttl(r, ttl);
+            }
+            if (previous_ttl != r->ttl) {
+                should_update = true;
             }
-            return;
         }
-        r = r->next;
+        if (should_update) {
+            _mdns_browse_result_changed(browse, r, false);
+        }
+        return;
     }
     r = (mdns_result_t *)mdns_mem_malloc(sizeof(mdns_result_t));
     if (!r) {
@@ -7661,24 +10614,23 @@ static void _mdns_browse_result_add_txt(mdns_browse_t *browse, const char *insta
     }
     memset(r, 0, sizeof(mdns_result_t));
     r->instance_name = mdns_mem_strdup(instance);
-    r->service_type = mdns_mem_strdup(service);
-    r->proto = mdns_mem_strdup(proto);
-    if (!r->instance_name || !r->service_type || !r->proto) {
+    r->service_type = browse->service;
+    r->proto = browse->proto;
+    r->esp_netif = _mdns_get_esp_netif(tcpip_if);
+    r->ip_protocol = ip_protocol;
+    if (!r->instance_name || !_mdns_result_index_add(&browse->index, r)) {
+        HOOK_MALLOC_FAILED;
         mdns_mem_free(r->instance_name);
-        mdns_mem_free(r->service_type);
-        mdns_mem_free(r->proto);
         mdns_mem_free(r);
-        return;
+        goto free_txt;
     }
     r->txt = txt;
     r->txt_value_len = txt_value_len;
     r->txt_count = txt_count;
-    r->esp_netif = _mdns_get_esp_netif(tcpip_if);
-    r->ip_protocol = ip_protocol;
     r->ttl = ttl;
     r->next = browse->result;
     browse->result = r;
-    _mdns_add_browse_result(out_sync_browse, r);
+    _mdns_browse_result_changed(browse, r, true);
     return;
 
 free_txt:
@@ -7712,55 +10664,40 @@ static esp_err_t _mdns_copy_address_in_previous_result(mdns_result_t *result_lis
 /**
  * @brief  Called from parser to add SRV data to search result
  */
-static void _mdns_browse_result_add_srv(mdns_browse_t *browse, const char *hostname, const char *instance, const char *service, const char *proto,
-                                        uint16_t port, mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint32_t ttl, mdns_browse_sync_t *out_sync_browse)
+static void _mdns_browse_result_add_srv(mdns_browse_t *browse, const char *hostname, const char *instance, uint16_t port,
+                                        mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint32_t ttl)
 {
-    if (out_sync_browse->browse == NULL) {
+    if (!_mdns_browse_changes_reserve(browse)) {
         return;
-    } else {
-        if (out_sync_browse->browse != browse) {
-            return;
-        }
     }
-    mdns_result_t *r = browse->result;
-    while (r) {
-        if (r->esp_netif == _mdns_get_esp_netif(tcpip_if) && r->ip_protocol == ip_protocol &&
-                !_str_null_or_empty(r->instance_name) && !strcasecmp(instance, r->instance_name) &&
-                !_str_null_or_empty(r->service_type) && !strcasecmp(service, r->service_type) &&
-                !_str_null_or_empty(r->proto) && !strcasecmp(proto, r->proto)) {
-            if (_str_null_or_empty(r->hostname) || strcasecmp(hostname, r->hostname)) {
-                r->hostname = mdns_mem_strdup(hostname);
-                r->port = port;
-                if (!r->hostname) {
-                    HOOK_MALLOC_FAILED;
-                    return;
-                }
-                if (!r->addr) {
-                    esp_err_t err = _mdns_copy_address_in_previous_result(browse->result, r);
-                    if (err == ESP_ERR_NO_MEM) {
-                        return;
-                    }
-                }
-                if (_mdns_add_browse_result(out_sync_browse, r) != ESP_OK) {
+    // all results of the browse are of its service type
+    mdns_result_t *r = _mdns_result_find_instance(&browse->index, instance, _mdns_get_esp_netif(tcpip_if), ip_protocol);
+    if (r) {
+        if (_str_null_or_empty(r->hostname) || strcasecmp(hostname, r->hostname)) {
+            r->port = port;
+            if (!_mdns_result_hostname_set(&browse->index, r, hostname)) {
+                return;
+            }
+            if (!r->addr) {
+                esp_err_t err = _mdns_copy_address_in_previous_result(browse->result, r);
+                if (err == ESP_ERR_NO_MEM) {
                     return;
                 }
             }
-            if (r->ttl != ttl) {
-                uint32_t previous_ttl = r->ttl;
-                if (r->ttl == 0) {
-                    r->ttl = ttl;
-                } else {
-                    _mdns_result_update_ttl(r, ttl);
-                }
-                if (previous_ttl != r->ttl) {
-                    if (_mdns_add_browse_result(out_sync_browse, r) != ESP_OK) {
-                        return;
-                    }
-                }
+            _mdns_browse_result_changed(browse, r, false);
+        }
+        if (r->ttl != ttl) {
+            uint32_t previous_ttl = r->ttl;
+            if (r->ttl == 0) {
+                r->ttl = ttl;
+            } else {
+                _mdns_result_update_ttl(r, ttl);
+            }
+            if (previous_ttl != r->ttl) {
+                _mdns_browse_result_changed(browse, r, false);
             }
-            return;
         }
-        r = r->next;
+        return;
     }
     r = (mdns_result_t *)mdns_mem_malloc(sizeof(mdns_result_t));
     if (!r) {
@@ -7771,47 +10708,25 @@ static void _mdns_browse_result_add_srv(mdns_browse_t *browse, const char *hostn
     memset(r, 0, sizeof(mdns_result_t));
     r->hostname = mdns_mem_strdup(hostname);
     r->instance_name = mdns_mem_strdup(instance);
-    r->service_type = mdns_mem_strdup(service);
-    r->proto = mdns_mem_strdup(proto);
-    if (!r->hostname || !r->instance_name || !r->service_type || !r->proto) {
+    r->service_type = browse->service;
+    r->proto = browse->proto;
+    r->esp_netif = _mdns_get_esp_netif(tcpip_if);
+    r->ip_protocol = ip_protocol;
+    if (!r->hostname || !r->instance_name || !_mdns_result_index_add(&browse->index, r)) {
         HOOK_MALLOC_FAILED;
         mdns_mem_free(r->hostname);
         mdns_mem_free(r->instance_name);
-        mdns_mem_free(r->service_type);
-        mdns_mem_free(r->proto);
         mdns_mem_free(r);
         return;
     }
     r->port = port;
-    r->esp_netif = _mdns_get_esp_netif(tcpip_if);
-    r->ip_protocol = ip_protocol;
     r->ttl = ttl;
     r->next = browse->result;
     browse->result = r;
-    _mdns_add_browse_result(out_sync_browse, r);
+    _mdns_browse_result_changed(browse, r, true);
     return;
 }
 
-static void _mdns_browse_sync(mdns_browse_sync_t *browse_sync)
-{
-    mdns_browse_t *browse = browse_sync->browse;
-    mdns_browse_result_sync_t *sync_result = browse_sync->sync_result;
-    while (sync_result) {
-        mdns_result_t *result = sync_result->result;
-#ifdef MDNS_ENABLE_DEBUG
-        debug_printf_browse_result(result, browse_sync->browse);
-#endif
-        browse->notifier(result);
-        if (result->ttl == 0) {
-            queueDetach(mdns_result_t, browse->result, result);
-            // Just free current result
-            result->next = NULL;
-            mdns_query_results_free(result);
-        }
-        sync_result = sync_result->next;
-    }
-}
-
 #ifdef MDNS_ENABLE_DEBUG
 void _debug_printf_result(mdns_result_t *r_t)
 {
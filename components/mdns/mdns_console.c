@@ -1414,6 +1414,69 @@ static void register_mdns_browse_del(void)
     ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_browse_del));
 }
 
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} mdns_stats_args;
+
+static int cmd_mdns_stats(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **) &mdns_stats_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, mdns_stats_args.end, argv[0]);
+        return 1;
+    }
+
+    mdns_stats_t stats;
+    esp_err_t err = mdns_get_stats(&stats);
+    if (err) {
+        printf("ERROR: Getting stats failed: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+    for (int i = 0; i < CONFIG_MDNS_MAX_INTERFACES; i++) {
+        if (!stats.interfaces[i].netif) {
+            continue;
+        }
+        for (int p = 0; p < MDNS_IP_PROTOCOL_MAX; p++) {
+            const mdns_traffic_stats_t *t = &stats.interfaces[i].traffic[p];
+            printf("Interface: %s, Type: %s, RX: %" PRIu32 " packets, %" PRIu32 " bytes, TX: %" PRIu32 " packets, %" PRIu32 " bytes\n",
+                   esp_netif_get_ifkey(stats.interfaces[i].netif), ip_protocol_str[p],
+                   t->rx_packets, t->rx_bytes, t->tx_packets, t->tx_bytes);
+        }
+    }
+    printf("Parse failures: %" PRIu32 "\n", stats.parse_failures);
+    printf("Answers built: %" PRIu32 "\n", stats.answers_built);
+    printf("Answers suppressed: %" PRIu32 " known, %" PRIu32 " duplicate, %" PRIu32 " rate limited\n",
+           stats.known_answers_suppressed, stats.duplicate_answers_suppressed, stats.answers_rate_limited);
+    printf("Queries throttled: %" PRIu32 "\n", stats.queries_throttled);
+    printf("Responses split: %" PRIu32 ", records dropped: %" PRIu32 "\n", stats.responses_split, stats.records_dropped);
+    printf("TX queue: %u, max: %u\n", stats.tx_queue_len, stats.tx_queue_max);
+    printf("RX dropped: %" PRIu32 ", action queue full: %" PRIu32 ", alloc failures: %" PRIu32 "\n",
+           stats.rx_dropped, stats.action_queue_full, stats.alloc_failures);
+    printf("Time: parse %" PRIu64 " us, dispatch %" PRIu64 " us\n", stats.parse_time_us, stats.dispatch_time_us);
+
+    if (mdns_stats_args.reset->count) {
+        ESP_ERROR_CHECK(mdns_reset_stats());
+    }
+    return 0;
+}
+
+static void register_mdns_stats(void)
+{
+    mdns_stats_args.reset = arg_lit0("r", "reset", "Reset the statistics once printed");
+    mdns_stats_args.end = arg_end(1);
+
+    const esp_console_cmd_t cmd_stats = {
+        .command = "mdns_stats",
+        .help = "Print the responder statistics",
+        .hint = NULL,
+        .func = &cmd_mdns_stats,
+        .argtable = &mdns_stats_args
+    };
+
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_stats));
+}
+
 void mdns_console_register(void)
 {
     register_mdns_init();
@@ -1437,6 +1500,8 @@ void mdns_console_register(void)
     register_mdns_browse();
     register_mdns_browse_del();
 
+    register_mdns_stats();
+
 #ifdef CONFIG_LWIP_IPV4
     register_mdns_query_a();
 #endif
@@ -0,0 +1,327 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "mdns_private.h"
+#include "mdns_mem_caps.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#if CONFIG_MDNS_MEMORY_CUSTOM_IMPL
+#define ALLOW_WEAK __attribute__((weak))
+#else
+#define ALLOW_WEAK
+#endif
+
+#if CONFIG_MDNS_TASK_CREATE_FROM_SPIRAM
+#define MDNS_TASK_MEMORY_CAPS (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define MDNS_TASK_MEMORY_LOG "SPIRAM"
+#endif
+#if CONFIG_MDNS_TASK_CREATE_FROM_INTERNAL
+#define MDNS_TASK_MEMORY_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define MDNS_TASK_MEMORY_LOG "internal RAM"
+#endif
+
+#if CONFIG_MDNS_MEMORY_ALLOC_SPIRAM
+#define MDNS_MEMORY_CAPS (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#endif
+#if CONFIG_MDNS_MEMORY_ALLOC_INTERNAL
+#define MDNS_MEMORY_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#endif
+
+// Allocate memory from internal heap as default.
+#ifndef MDNS_MEMORY_CAPS
+#warning "No memory allocation method defined, using internal memory"
+#define MDNS_MEMORY_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#endif
+#ifndef MDNS_TASK_MEMORY_CAPS
+#define MDNS_TASK_MEMORY_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define MDNS_TASK_MEMORY_LOG "internal RAM"
+#endif
+
+#define MDNS_MEM_ALIGN          8
+#define MDNS_MEM_ALIGN_UP(size) (((size) + MDNS_MEM_ALIGN - 1) & ~(size_t)(MDNS_MEM_ALIGN - 1))
+
+#if CONFIG_MDNS_MEMORY_POOLS
+typedef struct mdns_mem_block_s {
+    struct mdns_mem_block_s *next;
+} mdns_mem_block_t;
+
+typedef struct {
+    size_t block_size;
+    size_t stride;
+    uint16_t capacity;
+    uint16_t used;
+    uint16_t high_water;
+    uint32_t fallbacks;
+    uint8_t *slab;                      // allocated on first use and kept
+    mdns_mem_block_t *free_list;
+} mdns_mem_pool_t;
+
+#define MDNS_MEM_POOL(type, count) { .block_size = sizeof(type), .stride = MDNS_MEM_ALIGN_UP(sizeof(type)), .capacity = (count) }
+
+// Only the objects requested through mdns_mem_pool_alloc() are taken from the pools
+static mdns_mem_pool_t s_pools[MDNS_MEM_POOL_MAX] = {
+    [MDNS_MEM_POOL_ACTION] = MDNS_MEM_POOL(mdns_action_t, CONFIG_MDNS_POOL_ACTIONS),
+    [MDNS_MEM_POOL_TX_PACKET] = MDNS_MEM_POOL(mdns_tx_packet_t, CONFIG_MDNS_POOL_TX_PACKETS),
+    [MDNS_MEM_POOL_ANSWER] = MDNS_MEM_POOL(mdns_out_answer_t, CONFIG_MDNS_POOL_ANSWERS),
+    [MDNS_MEM_POOL_QUESTION] = MDNS_MEM_POOL(mdns_out_question_t, CONFIG_MDNS_POOL_QUESTIONS),
+};
+static portMUX_TYPE s_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void mdns_mem_pool_init(mdns_mem_pool_t *pool)
+{
+    // the slab is allocated outside of the critical section, the loser of a race frees its copy
+    uint8_t *slab = (uint8_t *)heap_caps_malloc(pool->stride * pool->capacity, MDNS_MEMORY_CAPS);
+    if (!slab) {
+        return;
+    }
+    portENTER_CRITICAL(&s_pool_lock);
+    if (!pool->slab) {
+        for (uint16_t i = pool->capacity; i > 0; i--) {
+            mdns_mem_block_t *block = (mdns_mem_block_t *)(slab + (i - 1) * pool->stride);
+            block->next = pool->free_list;
+            pool->free_list = block;
+        }
+        pool->slab = slab;
+        slab = NULL;
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+    heap_caps_free(slab);
+}
+
+/**
+ * Takes an object from the pool, returns NULL if the pool is exhausted
+ */
+static void *mdns_mem_pool_take(mdns_mem_pool_t *pool)
+{
+    if (!pool->slab) {
+        mdns_mem_pool_init(pool);
+    }
+    portENTER_CRITICAL(&s_pool_lock);
+    mdns_mem_block_t *block = pool->free_list;
+    if (block) {
+        pool->free_list = block->next;
+        if (++pool->used > pool->high_water) {
+            pool->high_water = pool->used;
+        }
+    } else {
+        pool->fallbacks++;
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+    return block;
+}
+
+static bool mdns_mem_pool_free(void *ptr)
+{
+    uint8_t *p = (uint8_t *)ptr;
+    for (int i = 0; i < MDNS_MEM_POOL_MAX; i++) {
+        mdns_mem_pool_t *pool = &s_pools[i];
+        if (pool->slab && p >= pool->slab && p < pool->slab + pool->stride * pool->capacity) {
+            mdns_mem_block_t *block = (mdns_mem_block_t *)ptr;
+            portENTER_CRITICAL(&s_pool_lock);
+            block->next = pool->free_list;
+            pool->free_list = block;
+            pool->used--;
+            portEXIT_CRITICAL(&s_pool_lock);
+            return true;
+        }
+    }
+    return false;
+}
+#endif /* CONFIG_MDNS_MEMORY_POOLS */
+
+void ALLOW_WEAK *mdns_mem_malloc(size_t size)
+{
+    return heap_caps_malloc(size, MDNS_MEMORY_CAPS);
+}
+
+void ALLOW_WEAK *mdns_mem_calloc(size_t num, size_t size)
+{
+    return heap_caps_calloc(num, size, MDNS_MEMORY_CAPS);
+}
+
+void ALLOW_WEAK *mdns_mem_pool_alloc(mdns_mem_pool_id_t pool, size_t size)
+{
+#if CONFIG_MDNS_MEMORY_POOLS
+    if (pool < MDNS_MEM_POOL_MAX && s_pools[pool].block_size == size) {
+        void *ptr = mdns_mem_pool_take(&s_pools[pool]);
+        if (ptr) {
+            return ptr;
+        }
+    }
+#endif
+    return mdns_mem_malloc(size);
+}
+
+void ALLOW_WEAK mdns_mem_pool_deinit(void)
+{
+#if CONFIG_MDNS_MEMORY_POOLS
+    for (int i = 0; i < MDNS_MEM_POOL_MAX; i++) {
+        mdns_mem_pool_t *pool = &s_pools[i];
+        uint8_t *slab = NULL;
+        portENTER_CRITICAL(&s_pool_lock);
+        // a block still taken would be passed to heap_caps_free() once the slab is gone
+        if (pool->slab && !pool->used) {
+            slab = pool->slab;
+            pool->slab = NULL;
+            pool->free_list = NULL;
+        }
+        portEXIT_CRITICAL(&s_pool_lock);
+        heap_caps_free(slab);
+    }
+#endif
+}
+
+void ALLOW_WEAK mdns_mem_free(void *ptr)
+{
+#if CONFIG_MDNS_MEMORY_POOLS
+    if (ptr && mdns_mem_pool_free(ptr)) {
+        return;
+    }
+#endif
+    heap_caps_free(ptr);
+}
+
+char ALLOW_WEAK *mdns_mem_strdup(const char *s)
+{
+    if (!s) {
+        return NULL;
+    }
+    size_t len = strlen(s) + 1;
+    char *copy = (char *)heap_caps_malloc(len, MDNS_MEMORY_CAPS);
+    if (copy) {
+        memcpy(copy, s, len);
+    }
+    return copy;
+}
+
+char ALLOW_WEAK *mdns_mem_strndup(const char *s, size_t n)
+{
+    if (!s) {
+        return NULL;
+    }
+    size_t len = strnlen(s, n);
+    char *copy = (char *)heap_caps_malloc(len + 1, MDNS_MEMORY_CAPS);
+    if (copy) {
+        memcpy(copy, s, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+void ALLOW_WEAK *mdns_mem_task_malloc(size_t size)
+{
+    ESP_LOGI("mdns_mem", "mDNS task will be created from %s", MDNS_TASK_MEMORY_LOG);
+    return heap_caps_malloc(size, MDNS_TASK_MEMORY_CAPS);
+}
+
+void ALLOW_WEAK mdns_mem_task_free(void *ptr)
+{
+    heap_caps_free(ptr);
+}
+
+/*
+ * Parse arena: memory of one received packet is taken linearly from a fixed buffer
+ * and released at once, allocations which do not fit are chained on the heap.
+ * Each parser owns its arena, only the shared counters are taken under a lock.
+ */
+typedef union mdns_mem_chunk_u {
+    union mdns_mem_chunk_u *next;
+    uint8_t align[MDNS_MEM_ALIGN];
+} mdns_mem_chunk_t;
+
+static portMUX_TYPE s_arena_lock = portMUX_INITIALIZER_UNLOCKED;
+static size_t s_arena_high_water;
+static uint32_t s_arena_fallbacks;
+
+void ALLOW_WEAK *mdns_mem_parse_malloc(mdns_mem_arena_t *arena, size_t size)
+{
+#if CONFIG_MDNS_PARSE_ARENA_SIZE > 0
+    size_t aligned = MDNS_MEM_ALIGN_UP(size);
+    if (!arena->buf) {
+        arena->buf = (uint8_t *)heap_caps_malloc(CONFIG_MDNS_PARSE_ARENA_SIZE, MDNS_MEMORY_CAPS);
+    }
+    if (arena->buf && aligned <= CONFIG_MDNS_PARSE_ARENA_SIZE - arena->used) {
+        void *ptr = arena->buf + arena->used;
+        arena->used += aligned;
+        return ptr;
+    }
+    portENTER_CRITICAL(&s_arena_lock);
+    s_arena_fallbacks++;
+    portEXIT_CRITICAL(&s_arena_lock);
+#endif
+    mdns_mem_chunk_t *chunk = (mdns_mem_chunk_t *)heap_caps_malloc(sizeof(mdns_mem_chunk_t) + size, MDNS_MEMORY_CAPS);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = (mdns_mem_chunk_t *)arena->chunks;
+    arena->chunks = chunk;
+    return chunk + 1;
+}
+
+void ALLOW_WEAK mdns_mem_parse_free_all(mdns_mem_arena_t *arena)
+{
+    // the arena only grows while a packet is parsed, so its use now is the peak of the packet
+    if (arena->used > s_arena_high_water) {
+        portENTER_CRITICAL(&s_arena_lock);
+        if (arena->used > s_arena_high_water) {
+            s_arena_high_water = arena->used;
+        }
+        portEXIT_CRITICAL(&s_arena_lock);
+    }
+    arena->used = 0;
+    while (arena->chunks) {
+        mdns_mem_chunk_t *chunk = (mdns_mem_chunk_t *)arena->chunks;
+        arena->chunks = chunk->next;
+        heap_caps_free(chunk);
+    }
+}
+
+void ALLOW_WEAK mdns_mem_parse_arena_free(mdns_mem_arena_t *arena)
+{
+    mdns_mem_parse_free_all(arena);
+    heap_caps_free(arena->buf);
+    arena->buf = NULL;
+}
+
+void ALLOW_WEAK mdns_mem_get_stats(mdns_mem_stats_t *stats)
+{
+    memset(stats, 0, sizeof(mdns_mem_stats_t));
+#if CONFIG_MDNS_MEMORY_POOLS
+    portENTER_CRITICAL(&s_pool_lock);
+    for (int i = 0; i < MDNS_MEM_POOL_MAX; i++) {
+        stats->pools[i].block_size = s_pools[i].block_size;
+        stats->pools[i].capacity = s_pools[i].capacity;
+        stats->pools[i].used = s_pools[i].used;
+        stats->pools[i].high_water = s_pools[i].high_water;
+        stats->pools[i].fallbacks = s_pools[i].fallbacks;
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+#endif
+    stats->arena_size = CONFIG_MDNS_PARSE_ARENA_SIZE;
+    portENTER_CRITICAL(&s_arena_lock);
+    stats->arena_high_water = s_arena_high_water;
+    stats->arena_fallbacks = s_arena_fallbacks;
+    portEXIT_CRITICAL(&s_arena_lock);
+}
+
+void ALLOW_WEAK mdns_mem_reset_stats(void)
+{
+#if CONFIG_MDNS_MEMORY_POOLS
+    portENTER_CRITICAL(&s_pool_lock);
+    for (int i = 0; i < MDNS_MEM_POOL_MAX; i++) {
+        s_pools[i].high_water = s_pools[i].used;
+        s_pools[i].fallbacks = 0;
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+#endif
+    portENTER_CRITICAL(&s_arena_lock);
+    s_arena_high_water = 0;
+    s_arena_fallbacks = 0;
+    portEXIT_CRITICAL(&s_arena_lock);
+}
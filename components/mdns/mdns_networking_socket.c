@@ -8,6 +8,10 @@
  * @brief MDNS Server Networking module implemented using BSD sockets
  */
 
+#include "sdkconfig.h"
+#if defined(CONFIG_IDF_TARGET_LINUX) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // recvmmsg()
+#endif
 #include <string.h>
 #include "esp_event.h"
 #include "mdns_networking.h"
@@ -25,6 +29,7 @@
 
 #if defined(CONFIG_IDF_TARGET_LINUX)
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
 #include <net/if.h>
 #endif
 
@@ -53,11 +58,34 @@ struct pbuf  {
     size_t tot_len;
     size_t len;
 };
+// Sockets are polled with epoll and read with recvmmsg() on linux
+static int s_epoll_fd = -1;
+#define SOCK_RX_BATCH   8
 #else
 // Compatibility define to access sock-addr struct the same way for lwip and linux
 #define s6_addr32 un.u32_addr
+#define SOCK_RX_BATCH   4
 #endif // CONFIG_IDF_TARGET_LINUX
 
+// Number of packet buffers kept for reuse once the packets are processed
+#define SOCK_RX_CACHED_BUFFERS SOCK_RX_BATCH
+
+/**
+ * @brief  Received packet with its payload in one allocation, the datagram is received directly into the payload
+ */
+typedef struct sock_rx_buf {
+    mdns_rx_packet_t packet;            // must be the first member, _mdns_packet_free() gets its address
+    struct pbuf pb;
+    struct sock_rx_buf *next;           // link in the cache of free buffers
+    uint8_t payload[MDNS_MAX_PACKET_SIZE];
+} sock_rx_buf_t;
+
+static sock_rx_buf_t *s_rx_cache;
+static size_t s_rx_cached;
+static portMUX_TYPE s_rx_cache_lock = portMUX_INITIALIZER_UNLOCKED;
+// Buffers taken by the receive task which have not been filled yet
+static sock_rx_buf_t *s_rx_spare[SOCK_RX_BATCH];
+
 static void __attribute__((constructor)) ctor_networking_socket(void)
 {
     for (int i = 0; i < sizeof(s_interfaces) / sizeof(s_interfaces[0]); ++i) {
@@ -68,9 +96,55 @@ static void __attribute__((constructor)) ctor_networking_socket(void)
 
 static void delete_socket(int sock)
 {
+#if defined(CONFIG_IDF_TARGET_LINUX)
+    epoll_ctl(s_epoll_fd, EPOLL_CTL_DEL, sock, NULL);
+#endif
     close(sock);
 }
 
+static sock_rx_buf_t *sock_rx_buf_get(void)
+{
+    portENTER_CRITICAL(&s_rx_cache_lock);
+    sock_rx_buf_t *buf = s_rx_cache;
+    if (buf) {
+        s_rx_cache = buf->next;
+        s_rx_cached--;
+    }
+    portEXIT_CRITICAL(&s_rx_cache_lock);
+    if (!buf) {
+        buf = (sock_rx_buf_t *)mdns_mem_malloc(sizeof(sock_rx_buf_t));
+    }
+    return buf;
+}
+
+static void sock_rx_buf_put(sock_rx_buf_t *buf)
+{
+    portENTER_CRITICAL(&s_rx_cache_lock);
+    // packets processed after the receive task stopped are not cached, nothing would free them
+    if (s_run_sock_recv_task && s_rx_cached < SOCK_RX_CACHED_BUFFERS) {
+        buf->next = s_rx_cache;
+        s_rx_cache = buf;
+        s_rx_cached++;
+        buf = NULL;
+    }
+    portEXIT_CRITICAL(&s_rx_cache_lock);
+    mdns_mem_free(buf);
+}
+
+static void sock_rx_cache_free(void)
+{
+    portENTER_CRITICAL(&s_rx_cache_lock);
+    sock_rx_buf_t *buf = s_rx_cache;
+    s_rx_cache = NULL;
+    s_rx_cached = 0;
+    portEXIT_CRITICAL(&s_rx_cache_lock);
+    while (buf) {
+        sock_rx_buf_t *next = buf->next;
+        mdns_mem_free(buf);
+        buf = next;
+    }
+}
+
 bool mdns_is_netif_ready(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
 {
     return s_interfaces[tcpip_if].proto & (ip_protocol == MDNS_IP_PROTOCOL_V4 ? PROTO_IPV4 : PROTO_IPV6);
@@ -88,9 +162,7 @@ size_t _mdns_get_packet_len(mdns_rx_packet_t *packet)
 
 void _mdns_packet_free(mdns_rx_packet_t *packet)
 {
-    mdns_mem_free(packet->pb->payload);
-    mdns_mem_free(packet->pb);
-    mdns_mem_free(packet);
+    sock_rx_buf_put((sock_rx_buf_t *)packet);
 }
 
 esp_err_t _mdns_pcb_deinit(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
@@ -100,6 +172,7 @@ esp_err_t _mdns_pcb_deinit(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
         // if the interface for both protocols uninitialized, close the interface socket
         if (s_interfaces[tcpip_if].sock >= 0) {
             delete_socket(s_interfaces[tcpip_if].sock);
+            s_interfaces[tcpip_if].sock = -1;
         }
     }
 
@@ -113,6 +186,13 @@ esp_err_t _mdns_pcb_deinit(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
     // no interface alive, stop the rx task
     s_run_sock_recv_task = false;
     vTaskDelay(pdMS_TO_TICKS(500));
+#if defined(CONFIG_IDF_TARGET_LINUX)
+    if (s_epoll_fd >= 0) {
+        close(s_epoll_fd);
+        s_epoll_fd = -1;
+    }
+#endif
+    sock_rx_cache_free();
     return ESP_OK;
 }
 
@@ -247,6 +327,179 @@ static inline void inet_to_espaddr(const struct sockaddr_storage *in_addr, esp_i
 #endif // CONFIG_LWIP_IPV6
 }
 
+/**
+ * @brief  Takes buffers into the first `count` spare slots, returns the number of consecutive slots filled
+ */
+static size_t sock_rx_spare_fill(size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (!s_rx_spare[i] && (s_rx_spare[i] = sock_rx_buf_get()) == NULL) {
+            break;
+        }
+    }
+    return i;
+}
+
+static void sock_rx_spare_free(void)
+{
+    for (int i = 0; i < SOCK_RX_BATCH; i++) {
+        mdns_mem_free(s_rx_spare[i]);
+        s_rx_spare[i] = NULL;
+    }
+}
+
+/**
+ * @brief  Drops one datagram, so that a socket we have no buffer for is not reported readable forever
+ */
+static void sock_rx_drop(int sock)
+{
+    uint8_t byte;
+    recv(sock, &byte, sizeof(byte), MSG_DONTWAIT);
+    HOOK_MALLOC_FAILED;
+    ESP_LOGE(TAG, "Failed to allocate the mdns packet");
+}
+
+/**
+ * @brief  Passes the received spare buffer to the mdns main engine
+ */
+static void sock_rx_dispatch(int slot, mdns_if_t tcpip_if, size_t len, struct sockaddr_storage *raddr)
+{
+    sock_rx_buf_t *buf = s_rx_spare[slot];
+    mdns_rx_packet_t *packet = &buf->packet;
+    uint16_t port = 0;
+
+    s_rx_spare[slot] = NULL;
+    ESP_LOGD(TAG, "[sock=%d]: Received from IP:%s", s_interfaces[tcpip_if].sock, get_string_address(raddr));
+    ESP_LOG_BUFFER_HEXDUMP(TAG, buf->payload, len, ESP_LOG_VERBOSE);
+    memset(packet, 0, sizeof(mdns_rx_packet_t));
+    memset(&buf->pb, 0, sizeof(struct pbuf));
+    buf->pb.payload = buf->payload;
+    buf->pb.tot_len = len;
+    buf->pb.len = len;
+    inet_to_espaddr(raddr, &packet->src, &port);
+    packet->tcpip_if = tcpip_if;
+    packet->pb = &buf->pb;
+    packet->src_port = ntohs(port);
+    // TODO(IDF-3651): Add the correct dest addr -- for mdns to decide multicast/unicast
+    // Currently it's enough to assume the packet is multicast and mdns to check the source port of the packet
+    packet->multicast = 1;
+    packet->dest.type = packet->src.type;
+    packet->ip_protocol =
+        packet->src.type == ESP_IPADDR_TYPE_V4 ? MDNS_IP_PROTOCOL_V4 : MDNS_IP_PROTOCOL_V6;
+    if (_mdns_send_rx_action(packet) != ESP_OK) {
+        ESP_LOGE(TAG, "_mdns_send_rx_action failed!");
+        sock_rx_buf_put(buf);
+    }
+}
+
+#if defined(CONFIG_IDF_TARGET_LINUX)
+static void sock_poll_add(mdns_if_t tcpip_if, int sock)
+{
+    if (s_epoll_fd < 0) {
+        s_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (s_epoll_fd < 0) {
+            ESP_LOGE(TAG, "epoll_create1() failed. errno=%d: %s", errno, strerror(errno));
+            return;
+        }
+    }
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.u32 = tcpip_if,
+    };
+    if (epoll_ctl(s_epoll_fd, EPOLL_CTL_ADD, sock, &event) < 0) {
+        ESP_LOGE(TAG, "[sock=%d]: epoll_ctl() failed. errno=%d: %s", sock, errno, strerror(errno));
+    }
+}
+
+/**
+ * @brief  Receives up to SOCK_RX_BATCH queued datagrams with one recvmmsg() call
+ */
+static void sock_recv_packets(mdns_if_t tcpip_if, int sock)
+{
+    static struct mmsghdr msgs[SOCK_RX_BATCH];
+    static struct iovec iov[SOCK_RX_BATCH];
+    static struct sockaddr_storage raddr[SOCK_RX_BATCH]; // Large enough for both IPv4 or IPv6
+    size_t count = sock_rx_spare_fill(SOCK_RX_BATCH);
+    if (count == 0) {
+        sock_rx_drop(sock);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        iov[i].iov_base = s_rx_spare[i]->payload;
+        iov[i].iov_len = MDNS_MAX_PACKET_SIZE;
+        memset(&msgs[i], 0, sizeof(struct mmsghdr));
+        msgs[i].msg_hdr.msg_name = &raddr[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int received = recvmmsg(sock, msgs, count, MSG_DONTWAIT, NULL);
+    if (received < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            ESP_LOGE(TAG, "multicast recvmmsg failed. errno=%d: %s", errno, strerror(errno));
+        }
+        return;
+    }
+    for (int i = 0; i < received; i++) {
+        sock_rx_dispatch(i, tcpip_if, msgs[i].msg_len, &raddr[i]);
+    }
+}
+
+void sock_recv_task(void *arg)
+{
+    struct epoll_event events[MDNS_MAX_INTERFACES];
+    while (s_run_sock_recv_task) {
+        if (s_epoll_fd < 0) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            ESP_LOGI(TAG, "No sock!");
+            continue;
+        }
+        int ready = epoll_wait(s_epoll_fd, events, MDNS_MAX_INTERFACES, 1000);
+        if (ready < 0) {
+            // the descriptor is closed by _mdns_pcb_deinit() once the task is asked to stop
+            if (errno == EINTR || !s_run_sock_recv_task) {
+                continue;
+            }
+            ESP_LOGE(TAG, "epoll_wait failed. errno=%d: %s", errno, strerror(errno));
+            break;
+        }
+        for (int i = 0; i < ready; i++) {
+            mdns_if_t tcpip_if = events[i].data.u32;
+            int sock = s_interfaces[tcpip_if].sock;
+            if (sock >= 0) {
+                sock_recv_packets(tcpip_if, sock);
+            }
+        }
+    }
+    sock_rx_spare_free();
+    vTaskDelete(NULL);
+}
+#else
+/**
+ * @brief  Drains up to SOCK_RX_BATCH queued datagrams, each one directly into its packet buffer
+ */
+static void sock_recv_packets(mdns_if_t tcpip_if, int sock)
+{
+    for (int i = 0; i < SOCK_RX_BATCH; i++) {
+        if (sock_rx_spare_fill(1) == 0) {
+            sock_rx_drop(sock);
+            return;
+        }
+        struct sockaddr_storage raddr; // Large enough for both IPv4 or IPv6
+        socklen_t socklen = sizeof(struct sockaddr_storage);
+        int len = recvfrom(sock, s_rx_spare[0]->payload, MDNS_MAX_PACKET_SIZE, MSG_DONTWAIT,
+                           (struct sockaddr *) &raddr, &socklen);
+        if (len < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ESP_LOGE(TAG, "multicast recvfrom failed. errno=%d: %s", errno, strerror(errno));
+            }
+            return;
+        }
+        sock_rx_dispatch(0, tcpip_if, len, &raddr);
+    }
+}
+
 void sock_recv_task(void *arg)
 {
     while (s_run_sock_recv_task) {
@@ -277,66 +530,16 @@ void sock_recv_task(void *arg)
         } else if (s > 0) {
             for (int tcpip_if = 0; tcpip_if < MDNS_MAX_INTERFACES; tcpip_if++) {
                 int sock = s_interfaces[tcpip_if].sock;
-                if (sock < 0) {
-                    continue;
-                }
-                if (FD_ISSET(sock, &rfds)) {
-                    static char recvbuf[MDNS_MAX_PACKET_SIZE];
-                    uint16_t port = 0;
-
-                    struct sockaddr_storage raddr; // Large enough for both IPv4 or IPv6
-                    socklen_t socklen = sizeof(struct sockaddr_storage);
-                    esp_ip_addr_t addr = {0};
-                    int len = recvfrom(sock, recvbuf, sizeof(recvbuf), 0,
-                                       (struct sockaddr *) &raddr, &socklen);
-                    if (len < 0) {
-                        ESP_LOGE(TAG, "multicast recvfrom failed. errno=%d: %s", errno, strerror(errno));
-                        break;
-                    }
-                    ESP_LOGD(TAG, "[sock=%d]: Received from IP:%s", sock, get_string_address(&raddr));
-                    ESP_LOG_BUFFER_HEXDUMP(TAG, recvbuf, len, ESP_LOG_VERBOSE);
-                    inet_to_espaddr(&raddr, &addr, &port);
-
-                    // Allocate the packet structure and pass it to the mdns main engine
-                    mdns_rx_packet_t *packet = (mdns_rx_packet_t *) mdns_mem_calloc(1, sizeof(mdns_rx_packet_t));
-                    struct pbuf *packet_pbuf = mdns_mem_calloc(1, sizeof(struct pbuf));
-                    uint8_t *buf = mdns_mem_malloc(len);
-                    if (packet == NULL || packet_pbuf == NULL || buf == NULL) {
-                        mdns_mem_free(buf);
-                        mdns_mem_free(packet_pbuf);
-                        mdns_mem_free(packet);
-                        HOOK_MALLOC_FAILED;
-                        ESP_LOGE(TAG, "Failed to allocate the mdns packet");
-                        continue;
-                    }
-                    memcpy(buf, recvbuf, len);
-                    packet_pbuf->next = NULL;
-                    packet_pbuf->payload = buf;
-                    packet_pbuf->tot_len = len;
-                    packet_pbuf->len = len;
-                    packet->tcpip_if = tcpip_if;
-                    packet->pb = packet_pbuf;
-                    packet->src_port = ntohs(port);
-                    memcpy(&packet->src, &addr, sizeof(esp_ip_addr_t));
-                    // TODO(IDF-3651): Add the correct dest addr -- for mdns to decide multicast/unicast
-                    // Currently it's enough to assume the packet is multicast and mdns to check the source port of the packet
-                    memset(&packet->dest, 0, sizeof(esp_ip_addr_t));
-                    packet->multicast = 1;
-                    packet->dest.type = packet->src.type;
-                    packet->ip_protocol =
-                        packet->src.type == ESP_IPADDR_TYPE_V4 ? MDNS_IP_PROTOCOL_V4 : MDNS_IP_PROTOCOL_V6;
-                    if (_mdns_send_rx_action(packet) != ESP_OK) {
-                        ESP_LOGE(TAG, "_mdns_send_rx_action failed!");
-                        mdns_mem_free(packet->pb->payload);
-                        mdns_mem_free(packet->pb);
-                        mdns_mem_free(packet);
-                    }
+                if (sock >= 0 && FD_ISSET(sock, &rfds)) {
+                    sock_recv_packets(tcpip_if, sock);
                 }
             }
         }
     }
+    sock_rx_spare_free();
     vTaskDelete(NULL);
 }
+#endif // CONFIG_IDF_TARGET_LINUX
 
 static void mdns_networking_init(void)
 {
@@ -355,10 +558,13 @@ static bool create_pcb(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
     esp_netif_t *netif = _mdns_get_esp_netif(tcpip_if);
     if (sock < 0) {
         sock = create_socket(netif);
-    }
-    if (sock < 0) {
-        ESP_LOGE(TAG, "Failed to create the socket!");
-        return false;
+        if (sock < 0) {
+            ESP_LOGE(TAG, "Failed to create the socket!");
+            return false;
+        }
+#if defined(CONFIG_IDF_TARGET_LINUX)
+        sock_poll_add(tcpip_if, sock);
+#endif
     }
     int err = join_mdns_multicast_group(sock, netif, ip_protocol);
     if (err < 0) {
@@ -0,0 +1,152 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Allocate memory.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to allocated memory, or NULL on failure.
+ */
+void *mdns_mem_malloc(size_t size);
+
+/**
+ * @brief Allocate and zero memory.
+ * @param num Number of elements.
+ * @param size Size of each element.
+ * @return Pointer to allocated memory, or NULL on failure.
+ */
+void *mdns_mem_calloc(size_t num, size_t size);
+
+/**
+ * @brief Free allocated memory.
+ * @param ptr Pointer to memory to free.
+ */
+void mdns_mem_free(void *ptr);
+
+/**
+ * @brief Object pools of the small objects the responder allocates for every packet.
+ */
+typedef enum {
+    MDNS_MEM_POOL_ACTION,
+    MDNS_MEM_POOL_TX_PACKET,
+    MDNS_MEM_POOL_ANSWER,
+    MDNS_MEM_POOL_QUESTION,
+    MDNS_MEM_POOL_MAX
+} mdns_mem_pool_id_t;
+
+/**
+ * @brief Allocate an object from its pool, or from the heap when the pool is exhausted.
+ *
+ * Objects are released by mdns_mem_free(), so a custom mdns_mem_free() has to be paired
+ * with a custom mdns_mem_pool_alloc().
+ *
+ * @param pool Pool of the object type.
+ * @param size Size of the object, sizeof() of the pooled type.
+ * @return Pointer to allocated memory, or NULL on failure.
+ */
+void *mdns_mem_pool_alloc(mdns_mem_pool_id_t pool, size_t size);
+
+/**
+ * @brief Release the pool slabs, pools still holding objects are kept.
+ */
+void mdns_mem_pool_deinit(void);
+
+/**
+ * @brief Duplicate a string.
+ * @param s String to duplicate.
+ * @return Pointer to duplicated string, or NULL on failure.
+ */
+char *mdns_mem_strdup(const char *s);
+
+/**
+ * @brief Duplicate a string with length limit.
+ * @param s String to duplicate.
+ * @param n Maximum number of characters to copy.
+ * @return Pointer to duplicated string, or NULL on failure.
+ */
+char *mdns_mem_strndup(const char *s, size_t n);
+
+/**
+ * @brief Allocate memory for mDNS task.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to allocated memory, or NULL on failure.
+ */
+void *mdns_mem_task_malloc(size_t size);
+
+/**
+ * @brief Free allocated memory for mDNS task.
+ * @param ptr Pointer to memory to free.
+ */
+void mdns_mem_task_free(void *ptr);
+
+/**
+ * @brief Memory of the received packet being parsed, taken linearly from a fixed buffer and released at once.
+ *
+ * Every parser owns its arena, so that packets may be parsed concurrently.
+ */
+typedef struct {
+    uint8_t *buf;               /*!< fixed buffer, allocated on first use and kept */
+    size_t used;                /*!< bytes of the buffer taken by the current packet */
+    void *chunks;               /*!< allocations which did not fit, chained on the heap */
+} mdns_mem_arena_t;
+
+/**
+ * @brief Allocate memory which lives until the received packet is processed.
+ * @param arena Arena of the parser.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to allocated memory, or NULL on failure.
+ */
+void *mdns_mem_parse_malloc(mdns_mem_arena_t *arena, size_t size);
+
+/**
+ * @brief Release all memory taken by mdns_mem_parse_malloc(), the fixed buffer is kept for the next packet.
+ * @param arena Arena of the parser.
+ */
+void mdns_mem_parse_free_all(mdns_mem_arena_t *arena);
+
+/**
+ * @brief Release all memory of the arena, including its fixed buffer.
+ * @param arena Arena of the parser.
+ */
+void mdns_mem_parse_arena_free(mdns_mem_arena_t *arena);
+
+/**
+ * @brief Memory usage counters.
+ */
+typedef struct {
+    struct {
+        size_t block_size;      /*!< size of the pooled object */
+        uint16_t capacity;      /*!< number of objects in the pool (0 if pools are disabled) */
+        uint16_t used;          /*!< objects currently taken from the pool */
+        uint16_t high_water;    /*!< maximum of used objects */
+        uint32_t fallbacks;     /*!< objects allocated from the heap because the pool was exhausted */
+    } pools[MDNS_MEM_POOL_MAX];
+    size_t arena_size;          /*!< size of the parse arena */
+    size_t arena_high_water;    /*!< maximum of arena bytes used by one packet */
+    uint32_t arena_fallbacks;   /*!< parse allocations taken from the heap because the arena was full */
+} mdns_mem_stats_t;
+
+/**
+ * @brief Get memory usage counters.
+ * @param stats Output counters.
+ */
+void mdns_mem_get_stats(mdns_mem_stats_t *stats);
+
+/**
+ * @brief Reset the fallback counters and restart the high-water marks from the current use.
+ */
+void mdns_mem_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -16,6 +16,8 @@
 
 /**
  * @brief  Queue RX packet action
+ *
+ * @return ESP_OK if the packet was taken over, it may have been dropped by the query budget of its source
  */
 esp_err_t _mdns_send_rx_action(mdns_rx_packet_t *packet);
 
@@ -0,0 +1,726 @@
+/*
+ * SPDX-FileCopyrightText: 2015-2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef MDNS_PRIVATE_H_
+#define MDNS_PRIVATE_H_
+
+#include "sdkconfig.h"
+#include "mdns.h"
+#include "esp_task.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "mdns_mem_caps.h"
+
+#ifdef CONFIG_MDNS_ENABLE_DEBUG_PRINTS
+#define MDNS_ENABLE_DEBUG
+#define _mdns_dbg_printf(...) printf(__VA_ARGS__)
+#endif
+
+/** Number of predefined interfaces */
+#ifndef CONFIG_MDNS_PREDEF_NETIF_STA
+#define CONFIG_MDNS_PREDEF_NETIF_STA 0
+#endif
+#ifndef CONFIG_MDNS_PREDEF_NETIF_AP
+#define CONFIG_MDNS_PREDEF_NETIF_AP 0
+#endif
+#ifndef CONFIG_MDNS_PREDEF_NETIF_ETH
+#define CONFIG_MDNS_PREDEF_NETIF_ETH 0
+#endif
+#define MDNS_MAX_PREDEF_INTERFACES (CONFIG_MDNS_PREDEF_NETIF_STA + CONFIG_MDNS_PREDEF_NETIF_AP + CONFIG_MDNS_PREDEF_NETIF_ETH)
+
+#ifdef CONFIG_LWIP_IPV6_NUM_ADDRESSES
+#define NETIF_IPV6_MAX_NUMS CONFIG_LWIP_IPV6_NUM_ADDRESSES
+#else
+#define NETIF_IPV6_MAX_NUMS 3
+#endif
+
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 1, 0)
+/* CONFIG_LWIP_IPV4 was introduced in IDF v5.1 */
+/* For IDF v5.0, set CONFIG_LWIP_IPV4 to 1 by default */
+#ifndef CONFIG_LWIP_IPV4
+#define CONFIG_LWIP_IPV4 1
+#endif // CONFIG_LWIP_IPV4
+#endif // ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 1, 0)
+
+/** Number of configured interfaces */
+#if MDNS_MAX_PREDEF_INTERFACES > CONFIG_MDNS_MAX_INTERFACES
+#warning Number of configured interfaces is less then number of predefined interfaces. Please update CONFIG_MDNS_MAX_INTERFACES.
+#define MDNS_MAX_INTERFACES (MDNS_MAX_PREDEF_INTERFACES)
+#else
+#define MDNS_MAX_INTERFACES (CONFIG_MDNS_MAX_INTERFACES)
+#endif
+
+/** The maximum number of services */
+#define MDNS_MAX_SERVICES           CONFIG_MDNS_MAX_SERVICES
+
+/** Initial capacity of the TX scheduler heap (grows by doubling) */
+#define MDNS_TX_HEAP_INITIAL_SIZE   16
+/** Heap index of a packet that is not waiting in the TX scheduler heap */
+#define MDNS_TX_HEAP_NONE           UINT16_MAX
+
+#define MDNS_ANSWER_PTR_TTL         4500
+#define MDNS_ANSWER_TXT_TTL         4500
+#define MDNS_ANSWER_SRV_TTL         120
+#define MDNS_ANSWER_A_TTL           120
+#define MDNS_ANSWER_AAAA_TTL        120
+
+#define MDNS_FLAGS_QUERY_REPSONSE   0x8000
+#define MDNS_FLAGS_AUTHORITATIVE    0x0400
+#define MDNS_FLAGS_QR_AUTHORITATIVE (MDNS_FLAGS_QUERY_REPSONSE | MDNS_FLAGS_AUTHORITATIVE)
+#define MDNS_FLAGS_DISTRIBUTED      0x0200  // TC: the known-answer list continues in the next packet
+
+/** Delay (ms) of the response to a query with the TC bit set, while the rest of its known answers arrive */
+#define MDNS_TRUNCATED_QUERY_DELAY  400
+/** Least time (ms) between two multicasts of a record on one PCB (RFC 6762, 6) */
+#define MDNS_MULTICAST_INTERVAL     1000
+/** Least time (ms) between two multicasts of a record defending it against a probe (RFC 6762, 6) */
+#define MDNS_PROBE_DEFENSE_INTERVAL 250
+
+#define MDNS_NAME_REF               0xC000
+
+//custom type! only used by this implementation
+//to help manage service discovery handling
+#define MDNS_TYPE_SDPTR             0x0032
+
+#define MDNS_CLASS_IN               0x0001
+#define MDNS_CLASS_ANY              0x00FF
+#define MDNS_CLASS_IN_FLUSH_CACHE   0x8001
+
+#define MDNS_ANSWER_ALL             0x3F
+#define MDNS_ANSWER_PTR             0x08
+#define MDNS_ANSWER_TXT             0x04
+#define MDNS_ANSWER_SRV             0x02
+#define MDNS_ANSWER_A               0x01
+#define MDNS_ANSWER_AAAA            0x10
+#define MDNS_ANSWER_NSEC            0x20
+#define MDNS_ANSWER_SDPTR           0x80
+#define MDNS_ANSWER_AAAA_SIZE       16
+
+#define MDNS_SERVICE_PORT           5353                    // UDP port that the server runs on
+#define MDNS_SERVICE_STACK_DEPTH    CONFIG_MDNS_TASK_STACK_SIZE
+#define MDNS_TASK_PRIORITY          CONFIG_MDNS_TASK_PRIORITY
+#if (MDNS_TASK_PRIORITY > ESP_TASK_PRIO_MAX)
+#error "mDNS task priority is higher than ESP_TASK_PRIO_MAX"
+#elif (MDNS_TASK_PRIORITY > ESP_TASKD_EVENT_PRIO)
+#warning "mDNS task priority is higher than ESP_TASKD_EVENT_PRIO, mDNS library might not work correctly"
+#endif
+#define MDNS_TASK_AFFINITY          CONFIG_MDNS_TASK_AFFINITY
+#define MDNS_SERVICE_ADD_TIMEOUT_MS CONFIG_MDNS_SERVICE_ADD_TIMEOUT_MS
+
+#define MDNS_PACKET_QUEUE_LEN       CONFIG_MDNS_RX_QUEUE_LEN  // Maximum packets that can be queued for parsing
+#define MDNS_QUERY_BUDGET           CONFIG_MDNS_QUERY_BUDGET  // Queries accepted per second from one source
+#define MDNS_QUERY_SOURCES          8                       // Sources whose query budget is tracked
+#define MDNS_MULTICAST_STAMPS       16                      // Recently multicast records remembered per PCB
+#define MDNS_BROWSE_NOTIFY_WINDOW   CONFIG_MDNS_BROWSE_NOTIFY_WINDOW_MS  // Time (ms) browse changes are collected before notifying
+#define MDNS_BROWSE_MAX_CHANGES     CONFIG_MDNS_BROWSE_MAX_CHANGES  // Changes a browse collects at most before notifying
+#define MDNS_ACTION_QUEUE_LEN       CONFIG_MDNS_ACTION_QUEUE_LEN  // Maximum actions pending to the server
+#define MDNS_TXT_MAX_LEN            1024                    // Maximum string length of text data in TXT record
+#define MDNS_MAX_PACKET_SIZE        1460                    // Maximum size of mDNS  outgoing packet
+#define MDNS_CACHE_BUCKETS          64                      // Buckets of the record cache name index (power of 2)
+#define MDNS_TX_ANSWER_BUCKETS      64                      // Buckets of the scheduled answer index (power of 2)
+#define MDNS_CACHE_MAX_TTL          86400                   // Longer TTLs of cached records are clamped (s)
+#define MDNS_NAME_DICT_SIZE         128                     // Name compression dictionary slots per outgoing packet (power of 2)
+#define MDNS_INDEX_MIN_SIZE         16                      // Initial slots of the service and host name indices (power of 2)
+
+#define MDNS_HEAD_LEN               12
+#define MDNS_HEAD_ID_OFFSET         0
+#define MDNS_HEAD_FLAGS_OFFSET      2
+#define MDNS_HEAD_QUESTIONS_OFFSET  4
+#define MDNS_HEAD_ANSWERS_OFFSET    6
+#define MDNS_HEAD_SERVERS_OFFSET    8
+#define MDNS_HEAD_ADDITIONAL_OFFSET 10
+
+#define MDNS_TYPE_OFFSET            0
+#define MDNS_CLASS_OFFSET           2
+#define MDNS_TTL_OFFSET             4
+#define MDNS_LEN_OFFSET             8
+#define MDNS_DATA_OFFSET            10
+
+#define MDNS_SRV_PRIORITY_OFFSET    0
+#define MDNS_SRV_WEIGHT_OFFSET      2
+#define MDNS_SRV_PORT_OFFSET        4
+#define MDNS_SRV_FQDN_OFFSET        6
+
+
+#define MDNS_SERVICE_LOCK()     xSemaphoreTake(_mdns_service_semaphore, portMAX_DELAY)
+// changes made under the lock are published to the lock-free readers before it is released
+#define MDNS_SERVICE_UNLOCK()   do { _mdns_snapshot_sync(); xSemaphoreGive(_mdns_service_semaphore); } while (0)
+
+#define queueToEnd(type, queue, item)       \
+    if (!queue) {                           \
+        queue = item;                       \
+    } else {                                \
+        type * _q = queue;                  \
+        while (_q->next) { _q = _q->next; } \
+        _q->next = item;                    \
+    }
+
+#define queueDetach(type, queue, item)              \
+    if (queue) {                                    \
+        if (queue == item) {                        \
+            queue = queue->next;                    \
+        } else {                                    \
+            type * _q = queue;                      \
+            while (_q->next && _q->next != item) {  \
+                _q = _q->next;                      \
+            }                                       \
+            if (_q->next == item) {                 \
+                _q->next = item->next;              \
+                item->next = NULL;                  \
+            }                                       \
+        }                                           \
+    }
+
+#define queueFree(type, queue)  while (queue) { type * _q = queue; queue = queue->next; mdns_mem_free(_q); }
+
+#define PCB_STATE_IS_PROBING(s) (s->state > PCB_OFF && s->state < PCB_ANNOUNCE_1)
+#define PCB_STATE_IS_ANNOUNCING(s) (s->state > PCB_PROBE_3 && s->state < PCB_RUNNING)
+#define PCB_STATE_IS_RUNNING(s) (s->state == PCB_RUNNING)
+
+void _mdns_count_alloc_failure(void);
+
+#ifndef HOOK_MALLOC_FAILED
+#define HOOK_MALLOC_FAILED  do { _mdns_count_alloc_failure(); ESP_LOGE(TAG, "Cannot allocate memory (line: %d, free heap: %" PRIu32 " bytes)", __LINE__, esp_get_free_heap_size()); } while (0)
+#endif
+
+typedef size_t mdns_if_t;
+
+typedef enum {
+    PCB_OFF, PCB_DUP, PCB_INIT,
+    PCB_PROBE_1, PCB_PROBE_2, PCB_PROBE_3,
+    PCB_ANNOUNCE_1, PCB_ANNOUNCE_2, PCB_ANNOUNCE_3,
+    PCB_RUNNING
+} mdns_pcb_state_t;
+
+typedef enum {
+    MDNS_ANSWER, MDNS_NS, MDNS_EXTRA
+} mdns_parsed_record_type_t;
+
+typedef enum {
+    ACTION_SYSTEM_EVENT,
+    ACTION_HOSTNAME_SET,
+    ACTION_INSTANCE_SET,
+    ACTION_SEARCH_ADD,
+    ACTION_SEARCH_SEND,
+    ACTION_SEARCH_END,
+    ACTION_BROWSE_ADD,
+    ACTION_BROWSE_SYNC,
+    ACTION_BROWSE_END,
+    ACTION_TX_HANDLE,
+    ACTION_RX_HANDLE,
+    ACTION_TASK_STOP,
+    ACTION_DELEGATE_HOSTNAME_ADD,
+    ACTION_DELEGATE_HOSTNAME_REMOVE,
+    ACTION_DELEGATE_HOSTNAME_SET_ADDR,
+    ACTION_MAX
+} mdns_action_type_t;
+
+
+typedef struct {
+    uint16_t id;
+    uint16_t flags;
+    uint16_t questions; //QDCOUNT
+    uint16_t answers;   //ANCOUNT
+    uint16_t servers;   //NSCOUNT
+    uint16_t additional;//ARCOUNT
+} mdns_header_t;
+
+typedef struct {
+    char host[MDNS_NAME_BUF_LEN]; // hostname for A/AAAA records, instance name for SRV records
+    char service[MDNS_NAME_BUF_LEN];
+    char proto[MDNS_NAME_BUF_LEN];
+    char domain[MDNS_NAME_BUF_LEN];
+    uint8_t parts;
+    uint8_t sub;
+    bool    invalid;
+} mdns_name_t;
+
+/**
+ * @brief  State of a packet parser, nothing else is shared between parsed packets
+ */
+typedef struct {
+    mdns_mem_arena_t arena;     /*!< the parsed questions and records and their names */
+    mdns_name_t name;           /*!< the name being decoded */
+} mdns_parse_ctx_t;
+
+typedef struct mdns_parsed_question_s {
+    struct mdns_parsed_question_s *next;
+    uint16_t type;
+    bool sub;
+    bool unicast;
+    char *host;
+    char *service;
+    char *proto;
+    char *domain;
+} mdns_parsed_question_t;
+
+typedef struct mdns_parsed_record_s {
+    struct mdns_parsed_record_s *next;
+    mdns_parsed_record_type_t record_type;
+    uint16_t type;
+    uint16_t clas;
+    uint8_t flush;
+    uint32_t ttl;
+    char *host;
+    char *service;
+    char *proto;
+    char *domain;
+    uint16_t data_len;
+    uint8_t *data;
+} mdns_parsed_record_t;
+
+typedef struct {
+    mdns_if_t tcpip_if;
+    mdns_ip_protocol_t ip_protocol;
+    esp_ip_addr_t src;
+    uint16_t src_port;
+    uint8_t multicast;
+    uint8_t authoritative;
+    uint8_t probe;
+    uint8_t discovery;
+    uint8_t distributed;
+    mdns_parsed_question_t *questions;
+    mdns_parsed_record_t *records;
+    uint16_t id;
+} mdns_parsed_packet_t;
+
+typedef struct mdns_rx_packet_s {
+    struct mdns_rx_packet_s *next;          /*!< next packet in the RX queue */
+    mdns_if_t tcpip_if;
+    mdns_ip_protocol_t ip_protocol;
+    struct pbuf *pb;
+    esp_ip_addr_t src;
+    esp_ip_addr_t dest;
+    uint16_t src_port;
+    uint8_t multicast;
+} mdns_rx_packet_t;
+
+typedef struct mdns_txt_linked_item_s {
+    const char *key;                        /*!< item key name */
+    char *value;                            /*!< item value string */
+    uint8_t value_len;                      /*!< item value length */
+    struct mdns_txt_linked_item_s *next;    /*!< next result, or NULL for the last result in the list */
+} mdns_txt_linked_item_t;
+
+typedef struct mdns_subtype_s {
+    const char *subtype;                    /*!< subtype */
+    struct mdns_subtype_s *next;            /*!< next result, or NULL for the last result in the list */
+} mdns_subtype_t;
+
+/**
+ * @brief  Parts of the service answers which do not change between responses
+ *
+ * Built on first use and dropped whenever the service (or the server name it depends on) changes
+ */
+typedef struct {
+    uint32_t gen;                           /*!< server name generation this cache was built for */
+    uint32_t instance_hashes[4];            /*!< suffix hashes of <instance>.<service>.<proto>.local */
+    uint32_t host_hashes[2];                /*!< suffix hashes of <hostname>.local */
+    uint16_t txt_len;                       /*!< length of the TXT record data */
+    uint8_t txt[];                          /*!< TXT record data in wire format */
+} mdns_service_wire_t;
+
+typedef struct {
+    const char *instance;
+    const char *service;
+    const char *proto;
+    const char *hostname;
+    uint16_t priority;
+    uint16_t weight;
+    uint16_t port;
+    mdns_txt_linked_item_t *txt;
+    mdns_subtype_t *subtype;
+    mdns_service_wire_t *wire;
+} mdns_service_t;
+
+typedef struct mdns_srv_item_s {
+    struct mdns_srv_item_s *next;
+    mdns_service_t *service;
+    struct mdns_srv_item_s *type_next;      /*!< older service of the same (service, proto) index key */
+    struct mdns_srv_item_s *instance_next;  /*!< older service of the same (instance, service, proto) index key */
+    uint32_t seq;                           /*!< order of adding, the services list is newest first */
+} mdns_srv_item_t;
+
+typedef struct mdns_out_question_s {
+    struct mdns_out_question_s *next;
+    uint16_t type;
+    bool unicast;
+    const char *host;
+    const char *service;
+    const char *proto;
+    const char *domain;
+    bool own_dynamic_memory;
+} mdns_out_question_t;
+
+typedef struct mdns_host_item_t {
+    const char *hostname;
+    mdns_ip_addr_t *address_list;
+    bool conflicted; // another host won the name while probing, not answered until the addresses are set again
+    struct mdns_host_item_t *next;
+} mdns_host_item_t;
+
+/**
+ * @brief  Slot of a name index, an open-addressing hash table with linear probing
+ *
+ * The hash is computed from the case-folded key, the head is the newest item with the key
+ * (the services with the same key are chained to it, newest first). Empty slots have no head.
+ */
+typedef struct {
+    uint32_t hash;
+    void *head;
+} mdns_index_slot_t;
+
+typedef struct {
+    mdns_index_slot_t *slots;
+    uint16_t size;                          /*!< power of 2, 0 until the first key is added */
+    uint16_t used;                          /*!< kept at most 3/4 of the size */
+} mdns_index_t;
+
+/**
+ * @brief  Read-only copy of the names, services and delegated hosts
+ *
+ * The API calls which only look them up read it without the service lock. A new copy is built
+ * and published by pointer swap when the service lock is released after a change, the replaced
+ * one is freed once no reader holds any copy. Everything lives in the one allocation.
+ */
+typedef struct mdns_snapshot_s {
+    struct mdns_snapshot_s *retired_next;   /*!< replaced copies waiting for their readers to finish */
+    const char *hostname;
+    const char *default_instance;           /*!< instance name of the services without their own */
+    mdns_service_t *services;               /*!< only the names, port and TXT items are set */
+    size_t services_len;
+    mdns_host_item_t *hosts;                /*!< delegated hosts, linked */
+} mdns_snapshot_t;
+
+typedef struct mdns_out_answer_s {
+    struct mdns_out_answer_s *next;
+    uint16_t type;
+    uint8_t bye;
+    uint8_t flush;
+    mdns_service_t *service;
+    mdns_host_item_t *host;
+    const char *custom_instance;
+    const char *custom_service;
+    const char *custom_proto;
+    struct mdns_out_answer_s *index_next;   /*!< chain of the scheduled answer index */
+    struct mdns_out_answer_s **index_link;  /*!< link to this answer in its chain, NULL if not indexed */
+    struct mdns_tx_packet_s *packet;        /*!< scheduled packet of an indexed answer */
+} mdns_out_answer_t;
+
+typedef struct mdns_tx_packet_s {
+    struct mdns_tx_packet_s *next;          /*!< next packet in the ready list (pushed to action queue) */
+    struct mdns_tx_packet_s *pcb_next;      /*!< intrusive list of all packets scheduled on the same PCB */
+    struct mdns_tx_packet_s *pcb_prev;
+    uint32_t send_at;
+    uint32_t seq;                           /*!< scheduling order, keeps packets with equal send_at FIFO */
+    uint16_t heap_index;                    /*!< position in the TX heap or MDNS_TX_HEAP_NONE */
+    uint16_t pcb_heap_index;                /*!< position in the TX heap of the PCB or MDNS_TX_HEAP_NONE */
+    mdns_if_t tcpip_if;
+    mdns_ip_protocol_t ip_protocol;
+    esp_ip_addr_t dst;
+    uint16_t port;
+    uint16_t flags;
+    uint8_t distributed;                    /*!< response to a query with the TC bit set */
+    esp_ip_addr_t querier;                  /*!< source of the query with the TC bit, only its continuation suppresses answers */
+    uint16_t querier_port;
+    uint8_t suppressible;                   /*!< response to a query, known and duplicate answers are removed from it */
+    uint8_t probe_defense;                  /*!< response to a probe, multicast regardless of MDNS_MULTICAST_INTERVAL */
+    mdns_pcb_state_t host_state;            /*!< round of a batch of delegated hosts (PCB_PROBE_1 to PCB_ANNOUNCE_3, PCB_RUNNING for goodbyes), PCB_OFF for other packets */
+    uint16_t host_batch_len;                /*!< estimated size of the questions and records of the hosts in the batch */
+    mdns_host_item_t *bye_hosts;            /*!< copies of the removed hosts a batch of goodbyes refers to, freed with the packet */
+    mdns_out_question_t *questions;
+    mdns_out_answer_t *answers;
+    mdns_out_answer_t *servers;
+    mdns_out_answer_t *additional;
+    bool queued;
+    uint16_t id;
+} mdns_tx_packet_t;
+
+/**
+ * @brief  Name compression dictionary of an outgoing packet, maps hashes of (case-folded) name suffixes
+ *         to their offsets in the packet
+ */
+typedef struct {
+    uint32_t hash;
+    uint16_t offset;                        /*!< 0 marks an empty slot (offset 0 is the packet header) */
+} mdns_name_dict_entry_t;
+
+typedef struct {
+    uint16_t used;
+    mdns_name_dict_entry_t entries[MDNS_NAME_DICT_SIZE];
+} mdns_name_dict_t;
+
+/**
+ * @brief  State of a packet writer, nothing else is shared between written packets
+ */
+typedef struct {
+    uint8_t packet[MDNS_MAX_PACKET_SIZE];   /*!< the datagram being written */
+    mdns_name_dict_t names;                 /*!< names already in the datagram, for compression */
+    bool full;                              /*!< set when data did not fit, the dispatcher continues in the next datagram */
+} mdns_tx_writer_t;
+
+/**
+ * @brief  TX heap entry, keeps the ordering key next to the packet to avoid dereferencing packets while sifting
+ */
+typedef struct {
+    uint32_t send_at;
+    uint32_t seq;
+    mdns_tx_packet_t *packet;
+} mdns_tx_heap_entry_t;
+
+/**
+ * @brief  Binary min-heap of scheduled packets ordered by (send_at, seq)
+ */
+typedef struct {
+    mdns_tx_heap_entry_t *entries;
+    uint16_t len;
+    uint16_t size;
+} mdns_tx_heap_t;
+
+/**
+ * @brief  Record recently multicast on a PCB, keyed by its owner (service or host) and type
+ */
+typedef struct {
+    const void *owner;                      /*!< NULL marks an unused stamp */
+    uint16_t type;
+    uint32_t sent_at;                       /*!< time (ms) the record was last multicast */
+} mdns_multicast_stamp_t;
+
+typedef struct {
+    mdns_pcb_state_t state;
+    mdns_srv_item_t **probe_services;
+    uint16_t probe_services_len;
+    uint8_t probe_ip;
+    uint8_t probe_running;
+    uint16_t failed_probes;
+    mdns_tx_packet_t *tx_packets;           /*!< packets scheduled for sending on this PCB */
+    mdns_tx_heap_t tx_heap;                 /*!< the same packets except batches of delegated hosts, pushed ones included */
+    mdns_multicast_stamp_t multicast_stamps[MDNS_MULTICAST_STAMPS];
+    mdns_traffic_stats_t traffic;
+} mdns_pcb_t;
+
+typedef enum {
+    SEARCH_OFF,
+    SEARCH_INIT,
+    SEARCH_RUNNING,
+    SEARCH_MAX
+} mdns_search_once_state_t;
+
+typedef enum {
+    BROWSE_OFF,
+    BROWSE_INIT,
+    BROWSE_RUNNING,
+    BROWSE_MAX
+} mdns_browse_state_t;
+
+/**
+ * @brief  Results of a search or a browse, indexed by instance name and by hostname on their interface
+ */
+typedef struct {
+    mdns_index_t instances;                 /*!< results by (interface, instance) */
+    mdns_index_t hosts;                     /*!< results by (interface, hostname), several results may share a hostname */
+} mdns_result_index_t;
+
+typedef struct mdns_search_once_s {
+    struct mdns_search_once_s *next;
+
+    mdns_search_once_state_t state;
+    uint32_t started_at;
+    uint32_t sent_at;
+    uint32_t timeout;
+    mdns_query_notify_t notifier;
+    SemaphoreHandle_t done_semaphore;
+    uint16_t type;
+    bool unicast;
+    uint8_t max_results;
+    uint8_t num_results;
+    char *instance;
+    char *service;
+    char *proto;
+    mdns_result_t *result;
+    mdns_result_index_t index;
+} mdns_search_once_t;
+
+/**
+ * @brief  Browse result changed since the last notification
+ */
+typedef struct {
+    mdns_result_t *result;
+    bool added;                             /*!< the result was found since the last notification */
+} mdns_browse_change_t;
+
+typedef struct mdns_browse_s {
+    struct mdns_browse_s *next;
+
+    mdns_browse_state_t state;
+    mdns_browse_notify_t notifier;
+    mdns_browse_batch_notify_t batch_notifier;
+
+    char *service;
+    char *proto;
+    uint32_t type_hash;                     /*!< hash of service and proto */
+    mdns_result_t *result;                  /*!< the results share service and proto of the browse */
+    mdns_result_index_t index;
+    struct {
+        mdns_browse_change_t *list;         /*!< one entry per changed result, in the order of the first change */
+        mdns_result_t **batch;              /*!< the results sorted into added, updated and removed, same size as list */
+        uint16_t len;
+        uint16_t size;
+        uint32_t notify_at;                 /*!< time (ms) the changes are delivered, valid if len > 0 */
+    } changes;
+} mdns_browse_t;
+
+/**
+ * @brief  Record received from another host, kept in the record cache until its TTL expires
+ *
+ * Also used as a view of a received record, the strings then point into the parsed packet.
+ */
+typedef struct mdns_cache_entry_s {
+    struct mdns_cache_entry_s *hash_next;   /*!< next entry in the same bucket of the name index */
+    struct mdns_cache_entry_s *lru_prev;    /*!< towards the most recently used entry */
+    struct mdns_cache_entry_s *lru_next;    /*!< towards the least recently used entry */
+    uint32_t hash;                          /*!< hash of the owner name */
+    uint32_t received_at;                   /*!< time (ms) the record was last received */
+    uint32_t ttl;                           /*!< TTL (s) the record was last received with */
+    uint16_t type;
+    uint16_t txt_len;
+    mdns_if_t tcpip_if;
+    mdns_ip_protocol_t ip_protocol;
+    const char *host;                       /*!< owner name, the cached strings and TXT data share one allocation */
+    const char *service;
+    const char *proto;
+    const char *target;                     /*!< PTR instance or SRV host */
+    const uint8_t *txt;                     /*!< TXT data in wire format */
+    esp_ip_addr_t addr;                     /*!< A or AAAA address */
+    uint16_t port;                          /*!< SRV port */
+} mdns_cache_entry_t;
+
+/**
+ * @brief  Query budget of a source, a token bucket refilled at MDNS_QUERY_BUDGET queries per second
+ */
+typedef struct {
+    esp_ip_addr_t addr;
+    uint32_t refilled_at;                   /*!< time (ms) the tokens were last topped up */
+    uint16_t tokens;                        /*!< queries the source may still send */
+    bool used;
+} mdns_query_source_t;
+
+typedef struct mdns_server_s {
+    struct {
+        mdns_pcb_t pcbs[MDNS_IP_PROTOCOL_MAX];
+    } interfaces[MDNS_MAX_INTERFACES];
+    const char *hostname;
+    const char *instance;
+    mdns_srv_item_t *services;
+    QueueHandle_t action_queue;
+    SemaphoreHandle_t action_sema;
+    struct {
+        mdns_tx_heap_t heap;                /*!< packets waiting for their send time */
+        uint32_t seq;
+        mdns_tx_packet_t *ready_head;       /*!< due packets already pushed to the action queue */
+        mdns_tx_packet_t *ready_tail;
+        mdns_out_answer_t *answers[MDNS_TX_ANSWER_BUCKETS]; /*!< answers of scheduled responses by (PCB, type, owner) */
+        mdns_tx_writer_t writer;            /*!< writer of the service task */
+    } tx;
+    struct {
+        mdns_rx_packet_t *head;             /*!< received packets waiting for the service task, oldest first */
+        mdns_rx_packet_t *tail;
+        uint16_t len;
+        bool signalled;                     /*!< an ACTION_RX_HANDLE is pending in the action queue */
+        uint16_t query_budget;              /*!< queries per second accepted from one source, 0 for no limit */
+        mdns_query_source_t sources[MDNS_QUERY_SOURCES];
+        mdns_parse_ctx_t parse;             /*!< parser of the service task */
+    } rx;
+    uint16_t multicast_interval;            /*!< least time (ms) between multicasts of a record, 0 for no limit */
+    mdns_search_once_t *search_once;
+    esp_timer_handle_t timer_handle;
+    uint32_t timer_deadline;                /*!< time (ms) the one-shot timer is armed for */
+    bool timer_armed;
+    uint32_t wire_gen;                      /*!< bumped when the server hostname or instance changes */
+    mdns_browse_t *browse;
+    uint16_t browse_notify_window;          /*!< time (ms) browse changes are collected, 0 to notify after every packet */
+    bool browse_notify_signalled;           /*!< an ACTION_BROWSE_SYNC is pending in the action queue */
+    struct {
+        mdns_index_t types;                 /*!< services by (service, proto) */
+        mdns_index_t instances;             /*!< services by (instance, service, proto), "" for the default instance */
+        mdns_index_t hosts;                 /*!< delegated hosts by hostname */
+        uint32_t seq;
+        uint16_t services;                  /*!< number of services */
+    } index;
+    struct {
+        mdns_cache_entry_t *entries;        /*!< CONFIG_MDNS_RECORD_CACHE_SIZE entries, allocated on first use */
+        mdns_cache_entry_t *free;           /*!< unused entries linked by hash_next */
+        mdns_cache_entry_t *lru_head;       /*!< most recently used entry */
+        mdns_cache_entry_t *lru_tail;       /*!< least recently used entry, evicted first */
+        mdns_cache_entry_t *index[MDNS_CACHE_BUCKETS];
+        uint16_t len;
+    } cache;
+    struct {
+        uint32_t known_answers_suppressed;      /*!< answers not sent as the querier listed them (RFC 6762, 7.1) */
+        uint32_t duplicate_answers_suppressed;  /*!< scheduled answers dropped as another responder sent them (RFC 6762, 7.4) */
+        uint32_t known_answers_sent;            /*!< known answers listed in our queries */
+        uint32_t truncated_queries_sent;        /*!< query packets sent with the TC bit, the known answers continued */
+        uint32_t truncated_queries_received;
+        uint32_t responses_split;               /*!< extra datagrams sent as a response did not fit MDNS_MAX_PACKET_SIZE */
+        uint32_t records_dropped;               /*!< records which do not fit even an empty datagram */
+        uint32_t rx_dropped;                    /*!< received packets dropped from a full RX queue, oldest first */
+        uint32_t rx_action_queue_full;          /*!< received packets left waiting as the action queue was full */
+        uint32_t queries_throttled;             /*!< queries dropped as their source exceeded its query budget */
+        uint32_t answers_rate_limited;          /*!< answers not multicast as the record was multicast just before */
+        uint32_t browse_notifications;          /*!< browse notifier calls, one per batch or per result */
+        uint32_t browse_changes_flushed;        /*!< browse notifications sent early as MDNS_BROWSE_MAX_CHANGES were pending */
+        uint32_t parse_failures;                /*!< received packets dropped as malformed */
+        uint32_t answers_built;                 /*!< records written to the sent responses */
+        uint32_t action_queue_full;             /*!< actions other than ACTION_RX_HANDLE refused by the full action queue */
+        uint16_t tx_queue_max;                  /*!< most packets in the TX heap at once */
+        uint64_t parse_time_us;                 /*!< time spent in mdns_parse_packet() */
+        uint64_t dispatch_time_us;              /*!< time spent building and sending the due TX packets */
+    } stats;
+} mdns_server_t;
+
+typedef struct {
+    mdns_action_type_t type;
+    union {
+        struct {
+            char *hostname;
+        } hostname_set;
+        char *instance;
+        struct {
+            mdns_if_t interface;
+            mdns_event_actions_t event_action;
+        } sys_event;
+        struct {
+            mdns_search_once_t *search;
+        } search_add;
+        struct {
+            mdns_tx_packet_t *packet;
+        } tx_handle;
+        struct {
+            const char *hostname;
+            mdns_ip_addr_t *address_list;
+        } delegate_hostname;
+        struct {
+            mdns_browse_t *browse;
+        } browse_add;
+    } data;
+} mdns_action_t;
+
+/*
+ * @brief  Convert mnds if to esp-netif handle
+ *
+ * @param  tcpip_if     mdns supported interface as internal enum
+ *
+ * @return
+ *     - ptr to esp-netif on success
+ *     - NULL if no available netif for current interface index
+ */
+esp_netif_t *_mdns_get_esp_netif(mdns_if_t tcpip_if);
+
+
+#endif /* MDNS_PRIVATE_H_ */
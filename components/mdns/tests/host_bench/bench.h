@@ -0,0 +1,139 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include "esp32_mock.h"
+#include "mdns.h"
+#include "mdns_private.h"
+
+/**
+ * @brief  One benchmark case, reports results with bench_report()
+ */
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} bench_case_t;
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief  Selects JSON lines instead of text lines for the results
+ */
+void bench_report_json(bool json);
+
+/**
+ * @brief  Prints one result line: "<case> <metric> <value> <unit>"
+ */
+void bench_report_value(const char *bench, const char *metric, double value, const char *unit);
+
+/**
+ * @brief  Reports average time of n operations in ns/op
+ */
+void bench_report(const char *bench, const char *metric, uint32_t n, uint64_t total_ns);
+
+/**
+ * @brief  FNV-1a of a packet, reported to compare the produced bytes between builds
+ */
+uint32_t bench_checksum(const uint8_t *data, size_t len);
+
+/**
+ * @brief  A packet of a peer, as received from the network (bench_packet.c)
+ */
+typedef struct {
+    uint8_t data[9000];     // the largest mDNS packet
+    size_t len;
+    uint16_t questions;
+    uint16_t records;
+} bench_packet_t;
+
+/**
+ * @brief  Starts the packet with its header, bench_packet_end() writes the question and record counts
+ */
+void bench_packet_begin(bench_packet_t *p, uint16_t flags);
+void bench_packet_end(bench_packet_t *p);
+void bench_packet_put_u16(bench_packet_t *p, uint16_t value);
+void bench_packet_put_data(bench_packet_t *p, const void *data, size_t len);
+void bench_packet_put_name(bench_packet_t *p, const char *labels[], size_t count);
+void bench_packet_put_question(bench_packet_t *p, const char *labels[], size_t count, uint16_t type);
+
+/**
+ * @brief  Starts a record, the caller appends the rdata and sets its length with bench_packet_end_record()
+ *
+ * @return the offset of the rdata
+ */
+size_t bench_packet_begin_record(bench_packet_t *p, const char *labels[], size_t count, uint16_t type, uint16_t mdns_class, uint32_t ttl);
+void bench_packet_end_record(bench_packet_t *p, size_t rdata);
+
+/**
+ * @brief  Builds a query with one question
+ */
+void bench_packet_query(bench_packet_t *p, const char *labels[], size_t count, uint16_t type);
+
+// Mock environment (bench_mock.c)
+void bench_clock_set(uint32_t ms);
+void bench_clock_advance(uint32_t ms);
+uint32_t bench_run_service_queue(void);
+bool bench_timer_next(uint32_t *expiry_ms);
+const uint8_t *bench_last_tx(size_t *len);
+uint32_t bench_tx_count(void);
+uint32_t bench_tx_records(void);
+uint32_t bench_heap_allocs(void);
+size_t bench_heap_in_use(void);
+size_t bench_heap_peak(void);
+void bench_heap_peak_reset(void);
+bool bench_timer_fire(void);
+void bench_rx_enqueue(const uint8_t *data, size_t len, uint32_t src_ip);
+void bench_rx_packet(const uint8_t *data, size_t len, uint32_t src_ip);
+
+/**
+ * @brief  Called for every packet passed to the networking layer
+ */
+typedef void (*bench_tx_hook_t)(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, const esp_ip_addr_t *ip, uint16_t port,
+                                const uint8_t *data, size_t len);
+void bench_tx_set_hook(bench_tx_hook_t hook);
+
+// Receive path of mdns.c, declared here as the mocks replace mdns_networking.h
+esp_err_t _mdns_send_rx_action(mdns_rx_packet_t *packet);
+
+// Internal mdns functions exposed by mdns_bench_di.h
+void mdns_bench_execute_action(mdns_action_t *action);
+void mdns_bench_scheduler_run(void);
+mdns_tx_packet_t *mdns_bench_alloc_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
+bool mdns_bench_alloc_answer(mdns_out_answer_t **destination, uint16_t type, mdns_service_t *service);
+void mdns_bench_schedule_tx_packet(mdns_tx_packet_t *packet, uint32_t ms_after);
+mdns_tx_packet_t *mdns_bench_get_next_pcb_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
+uint32_t mdns_bench_remove_scheduled_answer(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint16_t type, mdns_srv_item_t *service);
+void mdns_bench_clear_pcb_tx_queue_head(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
+void mdns_bench_clear_tx_queue_head(void);
+mdns_tx_packet_t *mdns_bench_create_announce_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t *services[], size_t len, bool include_ip);
+void mdns_bench_dispatch_tx_packet(mdns_tx_packet_t *p);
+void mdns_bench_free_tx_packet(mdns_tx_packet_t *p);
+mdns_srv_item_t *mdns_bench_get_service_item(const char *instance, const char *service, const char *proto);
+bool mdns_bench_service_exists_locked(const char *service_type, const char *proto, const char *hostname);
+void mdns_bench_parse_packet(mdns_rx_packet_t *packet);
+uint32_t mdns_bench_dispatch_due(void);
+
+// Benchmark cases
+void bench_tx_scheduler(void);
+void bench_timer(void);
+void bench_compression(void);
+void bench_answers(void);
+void bench_memory(void);
+void bench_cache(void);
+void bench_suppression(void);
+void bench_contention(void);
+void bench_index(void);
+void bench_flood(void);
+void bench_browse(void);
+void bench_throughput(void);
+void bench_hosts(void);
@@ -0,0 +1,132 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Answer building benchmark -- serializes typical responses of a device with a few
+ * services: PTR/SRV/TXT of one service and of all services, with the host address
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define BENCH_ANSWERS_SERVICES   8
+#define BENCH_ANSWERS_ITERATIONS 2000
+
+extern mdns_server_t *_mdns_server;
+
+static mdns_tx_packet_t *create_response(mdns_srv_item_t *services[], size_t count)
+{
+    size_t i;
+    mdns_tx_packet_t *p = mdns_bench_alloc_packet(0, MDNS_IP_PROTOCOL_V4);
+    if (!p) {
+        abort();
+    }
+    p->flags = MDNS_FLAGS_QR_AUTHORITATIVE;
+    for (i = 0; i < count; i++) {
+        if (!mdns_bench_alloc_answer(&p->answers, MDNS_TYPE_PTR, services[i]->service)
+                || !mdns_bench_alloc_answer(&p->additional, MDNS_TYPE_SRV, services[i]->service)
+                || !mdns_bench_alloc_answer(&p->additional, MDNS_TYPE_TXT, services[i]->service)) {
+            abort();
+        }
+    }
+    if (!mdns_bench_alloc_answer(&p->additional, MDNS_TYPE_A, NULL)) {
+        abort();
+    }
+    return p;
+}
+
+static void run_response(const char *metric, mdns_srv_item_t *services[], size_t count)
+{
+    uint32_t i;
+    mdns_tx_packet_t *p = create_response(services, count);
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_ANSWERS_ITERATIONS; i++) {
+        mdns_bench_dispatch_tx_packet(p);
+    }
+    bench_report("answers", metric, BENCH_ANSWERS_ITERATIONS, bench_now_ns() - start);
+    mdns_bench_free_tx_packet(p);
+}
+
+static void report_checksum(const char *metric, mdns_srv_item_t *services[], size_t count)
+{
+    size_t len;
+    mdns_tx_packet_t *p = create_response(services, count);
+    mdns_bench_dispatch_tx_packet(p);
+    mdns_bench_free_tx_packet(p);
+    const uint8_t *data = bench_last_tx(&len);
+    bench_report_value("answers", metric, bench_checksum(data, len), "fnv1a");
+}
+
+/**
+ * @brief  Updates one TXT item before every response, as a sensor publishing its value would
+ */
+static void run_txt_update(mdns_srv_item_t *service)
+{
+    char value[16];
+    uint32_t i;
+    mdns_tx_packet_t *p = create_response(&service, 1);
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_ANSWERS_ITERATIONS; i++) {
+        snprintf(value, sizeof(value), "%u", i);
+        if (mdns_service_txt_item_set_for_host(service->service->instance, service->service->service,
+                                               service->service->proto, NULL, "value", value)) {
+            abort();
+        }
+        mdns_bench_dispatch_tx_packet(p);
+    }
+    bench_report("answers", "txt_update_response", BENCH_ANSWERS_ITERATIONS, bench_now_ns() - start);
+    mdns_bench_free_tx_packet(p);
+    bench_run_service_queue();
+}
+
+void bench_answers(void)
+{
+    char instance[32];
+    char service[16];
+    uint32_t i;
+    mdns_txt_item_t txt[4] = {
+        { "board", "esp32s3" },
+        { "fw", "1.4.2" },
+        { "path", "/api/v1" },
+        { "id", "3f9c0a1e" },
+    };
+    mdns_srv_item_t *services[BENCH_ANSWERS_SERVICES];
+
+    for (i = 0; i < BENCH_ANSWERS_SERVICES; i++) {
+        snprintf(instance, sizeof(instance), "Sensor node %u", i);
+        snprintf(service, sizeof(service), "_svc%u", i);
+        if (mdns_service_add(instance, service, "_tcp", 8000 + i, txt, 4)) {
+            abort();
+        }
+    }
+    bench_run_service_queue();
+    mdns_srv_item_t *s = _mdns_server->services;
+    for (i = 0; i < BENCH_ANSWERS_SERVICES && s; i++, s = s->next) {
+        services[i] = s;
+    }
+
+    run_response("one_service_response", services, 1);
+    run_response("all_services_response", services, BENCH_ANSWERS_SERVICES);
+    report_checksum("response_checksum", services, BENCH_ANSWERS_SERVICES);
+
+    // responses must follow changes of the services and of the host
+    run_txt_update(services[0]);
+    report_checksum("txt_update_checksum", services, BENCH_ANSWERS_SERVICES);
+    if (mdns_service_port_set("_svc1", "_tcp", 9001)
+            || mdns_service_instance_name_set("_svc2", "_tcp", "Renamed node")
+            || mdns_service_txt_item_remove("_svc3", "_tcp", "fw")
+            || mdns_hostname_set("bench-host-2")) {
+        abort();
+    }
+    bench_run_service_queue();
+    report_checksum("rename_checksum", services, BENCH_ANSWERS_SERVICES);
+    if (mdns_hostname_set("bench-host")) {
+        abort();
+    }
+    bench_run_service_queue();
+
+    mdns_service_remove_all();
+    bench_run_service_queue();
+}
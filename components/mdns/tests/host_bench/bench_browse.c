@@ -0,0 +1,191 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Browse benchmark -- a browse for _http._tcp receives the announcements of 500 instances,
+ * each on its own host, then their refreshes and their goodbyes, one packet per millisecond
+ * on the virtual clock. The changes are notified per packet and batched in windows.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define BENCH_BROWSE_INSTANCES  500
+#define BENCH_BROWSE_PEER_IP    0x0704A8C0  // 192.168.4.7
+#define BENCH_BROWSE_HOST_IP    0x0000A8C0  // 192.168.0.0, the instances are on 192.168.1.0 and up
+
+extern mdns_server_t *_mdns_server;
+
+static uint32_t s_notifications;
+static uint32_t s_callbacks;
+
+/**
+ * @brief  Builds the announcement of one instance: PTR, SRV, TXT and the A record of its host (goodbye if ttl is 0)
+ */
+static void build_announce(bench_packet_t *p, uint32_t i, uint32_t ttl)
+{
+    char instance[32], host[32];
+    snprintf(instance, sizeof(instance), "node-%03u", (unsigned)i);
+    snprintf(host, sizeof(host), "host-%03u", (unsigned)i);
+    const char *service[] = { "_http", "_tcp", "local" };
+    const char *instance_name[] = { instance, "_http", "_tcp", "local" };
+    const char *host_name[] = { host, "local" };
+    uint32_t ip = BENCH_BROWSE_HOST_IP | ((1 + i / 250) << 16) | ((1 + i % 250) << 24);
+    size_t rdata;
+
+    bench_packet_begin(p, MDNS_FLAGS_QR_AUTHORITATIVE);
+
+    rdata = bench_packet_begin_record(p, service, 3, MDNS_TYPE_PTR, MDNS_CLASS_IN, ttl);
+    bench_packet_put_name(p, instance_name, 4);
+    bench_packet_end_record(p, rdata);
+
+    rdata = bench_packet_begin_record(p, instance_name, 4, MDNS_TYPE_SRV, MDNS_CLASS_IN_FLUSH_CACHE, ttl);
+    bench_packet_put_u16(p, 0);
+    bench_packet_put_u16(p, 0);
+    bench_packet_put_u16(p, 80);
+    bench_packet_put_name(p, host_name, 2);
+    bench_packet_end_record(p, rdata);
+
+    rdata = bench_packet_begin_record(p, instance_name, 4, MDNS_TYPE_TXT, MDNS_CLASS_IN_FLUSH_CACHE, ttl);
+    bench_packet_put_data(p, "\x06path=/", 7);
+    bench_packet_end_record(p, rdata);
+
+    rdata = bench_packet_begin_record(p, host_name, 2, MDNS_TYPE_A, MDNS_CLASS_IN_FLUSH_CACHE, ttl);
+    bench_packet_put_data(p, &ip, 4);
+    bench_packet_end_record(p, rdata);
+
+    bench_packet_end(p);
+}
+
+static void notifier(mdns_result_t *result)
+{
+    s_notifications++;
+    s_callbacks++;
+}
+
+static void batch_notifier(mdns_browse_t *browse, const mdns_browse_changes_t *changes)
+{
+    s_notifications += changes->added_count + changes->updated_count + changes->removed_count;
+    s_callbacks++;
+}
+
+static uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+/**
+ * @brief  Fires the timers due until the given time and leaves the clock there
+ */
+static void run_until(uint32_t ms)
+{
+    uint32_t expiry;
+    while (bench_timer_next(&expiry) && (int32_t)(expiry - ms) <= 0) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+    bench_clock_set(ms);
+}
+
+static uint32_t count_results(const mdns_browse_t *browse)
+{
+    uint32_t n = 0;
+    for (const mdns_result_t *r = browse->result; r; r = r->next) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief  Replays the packets of all instances and reports the time per packet
+ */
+static void run_pass(const char *metric, const mdns_browse_t *browse, uint32_t ttl)
+{
+    static bench_packet_t packets[BENCH_BROWSE_INSTANCES];
+    uint32_t i;
+    for (i = 0; i < BENCH_BROWSE_INSTANCES; i++) {
+        build_announce(&packets[i], i, ttl);
+    }
+    uint32_t notifications = s_notifications;
+    uint32_t callbacks = s_callbacks;
+    uint32_t allocs = bench_heap_allocs();
+    uint32_t begin = now_ms();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_BROWSE_INSTANCES; i++) {
+        run_until(begin + i);
+        bench_rx_packet(packets[i].data, packets[i].len, BENCH_BROWSE_PEER_IP);
+    }
+    // the changes of the last window are notified
+    run_until(begin + BENCH_BROWSE_INSTANCES + 1000);
+    uint64_t elapsed = bench_now_ns() - start;
+
+    char label[48];
+    bench_report("browse", metric, BENCH_BROWSE_INSTANCES, elapsed);
+    snprintf(label, sizeof(label), "%s_results", metric);
+    bench_report_value("browse", label, count_results(browse), "results");
+    snprintf(label, sizeof(label), "%s_notifications", metric);
+    bench_report_value("browse", label, s_notifications - notifications, "results");
+    snprintf(label, sizeof(label), "%s_callbacks", metric);
+    bench_report_value("browse", label, s_callbacks - callbacks, "callbacks");
+    snprintf(label, sizeof(label), "%s_heap_allocs", metric);
+    bench_report_value("browse", label, (double)(bench_heap_allocs() - allocs) / BENCH_BROWSE_INSTANCES, "allocs/packet");
+}
+
+/**
+ * @brief  Runs the passes on a new browse
+ */
+static void run_browse(const char *prefix, mdns_browse_t *browse)
+{
+    char metric[32];
+    if (!browse) {
+        abort();
+    }
+    bench_run_service_queue();
+    // the browse queries are sent
+    run_until(now_ms() + 5000);
+
+    snprintf(metric, sizeof(metric), "%sannounce", prefix);
+    run_pass(metric, browse, MDNS_ANSWER_PTR_TTL);
+    snprintf(metric, sizeof(metric), "%srefresh", prefix);
+    run_pass(metric, browse, MDNS_ANSWER_PTR_TTL);
+    snprintf(metric, sizeof(metric), "%sgoodbye", prefix);
+    run_pass(metric, browse, 0);
+
+    if (mdns_browse_delete("_http", "_tcp")) {
+        abort();
+    }
+    bench_run_service_queue();
+}
+
+void bench_browse(void)
+{
+    mdns_pcb_state_t states[MDNS_MAX_INTERFACES][MDNS_IP_PROTOCOL_MAX];
+    uint16_t window = _mdns_server->browse_notify_window;
+    uint32_t i, j;
+
+    // receive on one interface only
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            states[i][j] = _mdns_server->interfaces[i].pcbs[j].state;
+            _mdns_server->interfaces[i].pcbs[j].state = PCB_OFF;
+        }
+    }
+    _mdns_server->interfaces[0].pcbs[MDNS_IP_PROTOCOL_V4].state = PCB_RUNNING;
+
+    // every packet is notified on its own
+    _mdns_server->browse_notify_window = 0;
+    run_browse("", mdns_browse_new("_http", "_tcp", notifier));
+
+    _mdns_server->browse_notify_window = MDNS_BROWSE_NOTIFY_WINDOW;
+    run_browse("batched_", mdns_browse_new_batched("_http", "_tcp", batch_notifier));
+
+    _mdns_server->browse_notify_window = window;
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_server->interfaces[i].pcbs[j].state = states[i][j];
+        }
+    }
+}
@@ -0,0 +1,145 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Record cache benchmark -- a peer announces its service, then the peer is resolved
+ * by queries which are answered from the cache
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define BENCH_CACHE_ITERATIONS  2000
+#define BENCH_CACHE_PEER_IP     0x0304A8C0  // 192.168.4.3
+
+extern mdns_server_t *_mdns_server;
+
+static void build_announce(bench_packet_t *p, uint32_t ttl)
+{
+    const char *service[] = { "_http", "_tcp", "local" };
+    const char *instance[] = { "peer", "_http", "_tcp", "local" };
+    const char *host[] = { "peerhost", "local" };
+    const uint32_t ip = BENCH_CACHE_PEER_IP;
+    size_t rdata;
+
+    bench_packet_begin(p, MDNS_FLAGS_QR_AUTHORITATIVE);
+    rdata = bench_packet_begin_record(p, service, 3, MDNS_TYPE_PTR, MDNS_CLASS_IN, ttl);
+    bench_packet_put_name(p, instance, 4);
+    bench_packet_end_record(p, rdata);
+    rdata = bench_packet_begin_record(p, instance, 4, MDNS_TYPE_SRV, MDNS_CLASS_IN_FLUSH_CACHE, ttl);
+    bench_packet_put_u16(p, 0);
+    bench_packet_put_u16(p, 0);
+    bench_packet_put_u16(p, 80);
+    bench_packet_put_name(p, host, 2);
+    bench_packet_end_record(p, rdata);
+    rdata = bench_packet_begin_record(p, instance, 4, MDNS_TYPE_TXT, MDNS_CLASS_IN_FLUSH_CACHE, ttl);
+    bench_packet_put_data(p, "\x06path=/", 7);
+    bench_packet_end_record(p, rdata);
+    rdata = bench_packet_begin_record(p, host, 2, MDNS_TYPE_A, MDNS_CLASS_IN_FLUSH_CACHE, ttl);
+    bench_packet_put_data(p, &ip, 4);
+    bench_packet_end_record(p, rdata);
+    bench_packet_end(p);
+}
+
+/**
+ * @brief  Runs the search until it is finished, returns the number of results
+ */
+static uint8_t run_search(mdns_search_once_t *search)
+{
+    uint32_t expiry;
+    bench_run_service_queue();
+    while (search->state != SEARCH_OFF && bench_timer_next(&expiry)) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+    return search->num_results;
+}
+
+static void run_query_case(const char *metric, const char *name, const char *service, const char *proto, uint16_t type)
+{
+    uint32_t i;
+    uint32_t found = 0;
+    uint32_t tx = bench_tx_count();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_CACHE_ITERATIONS; i++) {
+        mdns_search_once_t *search = mdns_query_async_new(name, service, proto, type, 1000, 1, NULL);
+        if (!search) {
+            abort();
+        }
+        found += run_search(search);
+        mdns_query_results_free(search->result);
+        mdns_query_async_delete(search);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    bench_report("cache", metric, BENCH_CACHE_ITERATIONS, elapsed);
+    char label[48];
+    snprintf(label, sizeof(label), "%s_hit_ratio", metric);
+    bench_report_value("cache", label, (double)found / BENCH_CACHE_ITERATIONS, "results");
+    snprintf(label, sizeof(label), "%s_tx", metric);
+    bench_report_value("cache", label, (double)(bench_tx_count() - tx) / BENCH_CACHE_ITERATIONS, "packets");
+}
+
+void bench_cache(void)
+{
+    mdns_pcb_state_t states[MDNS_MAX_INTERFACES][MDNS_IP_PROTOCOL_MAX];
+    bench_packet_t announce;
+    uint32_t i, j;
+
+    // the peer is seen on one interface only, so that the query sent there is the last one
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            states[i][j] = _mdns_server->interfaces[i].pcbs[j].state;
+            _mdns_server->interfaces[i].pcbs[j].state = PCB_OFF;
+        }
+    }
+    _mdns_server->interfaces[0].pcbs[MDNS_IP_PROTOCOL_V4].state = PCB_RUNNING;
+    build_announce(&announce, 120);
+
+    uint32_t allocs = bench_heap_allocs();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_CACHE_ITERATIONS; i++) {
+        bench_rx_packet(announce.data, announce.len, BENCH_CACHE_PEER_IP);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    bench_report("cache", "announce_refresh", BENCH_CACHE_ITERATIONS, elapsed);
+    bench_report_value("cache", "heap_allocs_per_refresh", (double)(bench_heap_allocs() - allocs) / BENCH_CACHE_ITERATIONS, "allocs");
+    bench_report_value("cache", "cached_records", _mdns_server->cache.len, "records");
+
+    run_query_case("query_a", "peerhost", NULL, NULL, MDNS_TYPE_A);
+    run_query_case("query_srv", "peer", "_http", "_tcp", MDNS_TYPE_SRV);
+    run_query_case("query_txt", "peer", "_http", "_tcp", MDNS_TYPE_TXT);
+
+    // a browse still queries the network, with the cached instance reported and sent as a known answer
+    mdns_search_once_t *search = mdns_query_async_new(NULL, "_http", "_tcp", MDNS_TYPE_PTR, 100, 0, NULL);
+    if (!search) {
+        abort();
+    }
+    bench_run_service_queue();
+    bench_report_value("cache", "ptr_cached_instances", search->num_results, "results");
+    uint32_t expiry;
+    size_t len = 0;
+    if (bench_timer_next(&expiry)) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+    const uint8_t *query = bench_last_tx(&len);
+    bench_report_value("cache", "ptr_known_answers", len > MDNS_HEAD_LEN ? query[MDNS_HEAD_ANSWERS_OFFSET + 1] : 0, "records");
+    run_search(search);
+    mdns_query_results_free(search->result);
+    mdns_query_async_delete(search);
+
+    // goodbye removes the records
+    build_announce(&announce, 0);
+    bench_rx_packet(announce.data, announce.len, BENCH_CACHE_PEER_IP);
+    bench_report_value("cache", "cached_records_after_bye", _mdns_server->cache.len, "records");
+
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_server->interfaces[i].pcbs[j].state = states[i][j];
+        }
+    }
+}
@@ -0,0 +1,85 @@
+# SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+"""
+Compares two outputs of mdns_bench (text or --json lines) and reports the metrics which changed.
+
+Times and allocations which grew, and packet rates which dropped, by more than the threshold are
+regressions. Checksums which differ mean the produced packets changed. The exit code is 1 if any
+regression or checksum change was found.
+
+    ./mdns_bench --json > base.json
+    ./mdns_bench --json > new.json
+    python bench_compare.py base.json new.json --threshold 10
+"""
+import argparse
+import json
+import re
+import sys
+
+# units of metrics which should not grow, or not drop
+LOWER_IS_BETTER = ('ns/op', 'allocs', 'allocs/packet', 'allocs/query')
+HIGHER_IS_BETTER = ('pps',)
+
+# "<case> <metric> <value> <unit>", other lines (logs of the responder) are skipped
+METRIC_LINE = re.compile(r'^(\S+) (\S+) (-?\d+(?:\.\d*)?(?:[eE][-+]?\d+)?|-?inf|nan) (\S+)$')
+
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            if line.startswith('{'):
+                try:
+                    r = json.loads(line)
+                    results[(r['case'], r['metric'])] = (float(r['value']), r['unit'])
+                except (ValueError, KeyError, TypeError):
+                    continue
+            else:
+                m = METRIC_LINE.match(line)
+                if m:
+                    case, metric, value, unit = m.groups()
+                    results[(case, metric)] = (float(value), unit)
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare two mdns_bench outputs')
+    parser.add_argument('base')
+    parser.add_argument('new')
+    parser.add_argument('--threshold', type=float, default=10.0, help='change in percent reported as regression')
+    args = parser.parse_args()
+
+    base = load(args.base)
+    new = load(args.new)
+    failed = False
+    for key in sorted(base.keys() | new.keys()):
+        name = '{} {}'.format(*key)
+        if key not in new:
+            print('removed     {}'.format(name))
+            continue
+        if key not in base:
+            print('added       {} {} {}'.format(name, *new[key]))
+            continue
+        old_value, unit = base[key]
+        value = new[key][0]
+        if old_value == value:
+            continue
+        if unit == 'fnv1a':
+            print('CHECKSUM    {} {:.0f} -> {:.0f}'.format(name, old_value, value))
+            failed = True
+            continue
+        change = (value - old_value) * 100.0 / old_value if old_value else float('inf')
+        worse = (unit in LOWER_IS_BETTER and change > args.threshold) or \
+                (unit in HIGHER_IS_BETTER and change < -args.threshold)
+        if worse:
+            failed = True
+        print('{:11} {} {:.1f} -> {:.1f} {} ({:+.1f}%)'.format('REGRESSION' if worse else 'changed', name,
+                                                               old_value, value, unit, change))
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,77 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Name compression benchmark -- builds announce packets for 10 to 100 services
+ * and measures the time to serialize them (dominated by _mdns_append_fqdn),
+ * the larger ones are split into several datagrams
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define BENCH_COMPRESSION_ITERATIONS 200
+
+extern mdns_server_t *_mdns_server;
+
+static void bench_compression_run(uint32_t count)
+{
+    char name[32];
+    char instance[32];
+    char service[16];
+    uint32_t i;
+    mdns_txt_item_t txt[2] = {
+        { "board", "esp32" },
+        { "path", "/" },
+    };
+    mdns_srv_item_t *services[count];
+
+    snprintf(name, sizeof(name), "compression_%u", count);
+    for (i = 0; i < count; i++) {
+        snprintf(instance, sizeof(instance), "node-%03u", i);
+        snprintf(service, sizeof(service), "_svc%u", i % 10);
+        if (mdns_service_add(instance, service, (i & 1) ? "_udp" : "_tcp", 1000 + i, txt, 2)) {
+            abort();
+        }
+    }
+    bench_run_service_queue();
+    mdns_srv_item_t *s = _mdns_server->services;
+    for (i = 0; i < count && s; i++, s = s->next) {
+        services[i] = s;
+    }
+
+    mdns_tx_packet_t *p = mdns_bench_create_announce_packet(0, MDNS_IP_PROTOCOL_V4, services, count, true);
+    if (!p) {
+        abort();
+    }
+    uint32_t tx = bench_tx_count();
+    uint32_t records = bench_tx_records();
+    uint32_t split = _mdns_server->stats.responses_split;
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_COMPRESSION_ITERATIONS; i++) {
+        mdns_bench_dispatch_tx_packet(p);
+    }
+    bench_report(name, "announce_build", BENCH_COMPRESSION_ITERATIONS, bench_now_ns() - start);
+    mdns_bench_free_tx_packet(p);
+    bench_report_value(name, "datagrams", (double)(bench_tx_count() - tx) / BENCH_COMPRESSION_ITERATIONS, "packets");
+    bench_report_value(name, "records", (double)(bench_tx_records() - records) / BENCH_COMPRESSION_ITERATIONS, "records");
+    bench_report_value(name, "responses_split", (double)(_mdns_server->stats.responses_split - split) / BENCH_COMPRESSION_ITERATIONS, "splits");
+
+    size_t len;
+    const uint8_t *data = bench_last_tx(&len);
+    bench_report_value(name, "packet_size", len, "bytes");
+    bench_report_value(name, "packet_checksum", bench_checksum(data, len), "fnv1a");
+
+    mdns_service_remove_all();
+    bench_run_service_queue();
+}
+
+void bench_compression(void)
+{
+    bench_compression_run(10);
+    bench_compression_run(25);
+    bench_compression_run(50);
+    bench_compression_run(100);
+}
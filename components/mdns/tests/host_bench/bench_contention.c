@@ -0,0 +1,150 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Lock contention benchmark -- one thread runs the service task on a flood of PTR queries
+ * (with a TXT update every few packets), while the API lookups are timed from another thread
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "bench.h"
+
+#define BENCH_CONTENTION_SERVICES   8
+#define BENCH_CONTENTION_CALLS      2000
+#define BENCH_CONTENTION_TXT_EVERY  16
+#define BENCH_CONTENTION_QUERIER_IP 0x0204A8C0  // 192.168.4.2
+
+static atomic_bool s_flood_run;
+static uint32_t s_flood_packets;
+static uint64_t s_samples[BENCH_CONTENTION_CALLS];
+
+/**
+ * @brief  The service task: handles the queries and sends the responses, the services change from time to time
+ */
+static void *flood_task(void *arg)
+{
+    const char *discovery[] = { "_services", "_dns-sd", "_udp", "local" };
+    bench_packet_t query;
+    char value[16];
+    uint32_t expiry;
+
+    bench_packet_query(&query, discovery, 4, MDNS_TYPE_PTR);
+    while (atomic_load(&s_flood_run)) {
+        bench_rx_packet(query.data, query.len, BENCH_CONTENTION_QUERIER_IP);
+        if (++s_flood_packets % BENCH_CONTENTION_TXT_EVERY == 0) {
+            snprintf(value, sizeof(value), "%u", s_flood_packets);
+            mdns_service_txt_item_set("_svc0", "_tcp", "seq", value);
+        }
+        bench_run_service_queue();
+        while (bench_timer_next(&expiry)) {
+            bench_clock_set(expiry);
+            bench_timer_fire();
+            bench_run_service_queue();
+        }
+    }
+    return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report_samples(const char *metric)
+{
+    char label[48];
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < BENCH_CONTENTION_CALLS; i++) {
+        total += s_samples[i];
+    }
+    qsort(s_samples, BENCH_CONTENTION_CALLS, sizeof(uint64_t), compare_u64);
+    bench_report("contention", metric, BENCH_CONTENTION_CALLS, total);
+    snprintf(label, sizeof(label), "%s_p99", metric);
+    bench_report_value("contention", label, s_samples[BENCH_CONTENTION_CALLS * 99 / 100], "ns");
+    snprintf(label, sizeof(label), "%s_max", metric);
+    bench_report_value("contention", label, s_samples[BENCH_CONTENTION_CALLS - 1], "ns");
+}
+
+static bool call_api(int api, uint32_t i)
+{
+    char hostname[MDNS_NAME_BUF_LEN];
+    char service[16];
+    mdns_result_t *results = NULL;
+
+    snprintf(service, sizeof(service), "_svc%u", i % BENCH_CONTENTION_SERVICES);
+    switch (api) {
+    case 0:
+        return mdns_bench_service_exists_locked(service, "_tcp", NULL);
+    case 1:
+        return mdns_service_exists(service, "_tcp", NULL);
+    case 2:
+        return mdns_service_exists_with_instance("Sensor node", service, "_tcp", NULL);
+    case 3:
+        return mdns_hostname_get(hostname) == ESP_OK;
+    default:
+        if (mdns_lookup_selfhosted_service(NULL, service, "_tcp", 1, &results) || !results) {
+            return false;
+        }
+        mdns_query_results_free(results);
+        return true;
+    }
+}
+
+void bench_contention(void)
+{
+    static const char *metrics[] = { "service_exists_locked", "service_exists", "service_exists_with_instance",
+                                     "hostname_get", "lookup_selfhosted_service"
+                                   };
+    mdns_txt_item_t txt[2] = {
+        { "board", "esp32s3" },
+        { "seq", "0" },
+    };
+    char service[16];
+    pthread_t flood;
+    uint32_t i;
+
+    for (i = 0; i < BENCH_CONTENTION_SERVICES; i++) {
+        snprintf(service, sizeof(service), "_svc%u", i);
+        if (mdns_service_add("Sensor node", service, "_tcp", 8000 + i, txt, 2)) {
+            abort();
+        }
+    }
+    bench_run_service_queue();
+    // the services are probed and announced before the flood
+    uint32_t expiry;
+    while (bench_timer_next(&expiry)) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+
+    atomic_store(&s_flood_run, true);
+    if (pthread_create(&flood, NULL, flood_task, NULL)) {
+        abort();
+    }
+    for (int api = 0; api < sizeof(metrics) / sizeof(metrics[0]); api++) {
+        for (i = 0; i < BENCH_CONTENTION_CALLS; i++) {
+            uint64_t start = bench_now_ns();
+            if (!call_api(api, i)) {
+                abort();
+            }
+            s_samples[i] = bench_now_ns() - start;
+            // let the service task run, so that the next call may find it in the middle of a packet
+            sched_yield();
+        }
+        report_samples(metrics[api]);
+    }
+    atomic_store(&s_flood_run, false);
+    pthread_join(flood, NULL);
+    bench_report_value("contention", "flood_packets", s_flood_packets, "packets");
+
+    mdns_service_remove_all();
+    bench_run_service_queue();
+}
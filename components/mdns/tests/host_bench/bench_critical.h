@@ -0,0 +1,18 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Preincluded to mdns_mem_caps.c -- the memory pools are used by the service task and the API
+ * callers at once in the contention benchmark, so their critical sections are a real mutex
+ */
+#pragma once
+
+void bench_critical_enter(void);
+void bench_critical_exit(void);
+
+#undef portENTER_CRITICAL
+#undef portEXIT_CRITICAL
+#define portENTER_CRITICAL(mux)     ((void)(mux), bench_critical_enter())
+#define portEXIT_CRITICAL(mux)      ((void)(mux), bench_critical_exit())
@@ -0,0 +1,135 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Query storm micro-benchmark -- PTR queries for our service arrive at a fixed rate on the virtual clock,
+ * from one or from many sources, with and without the query budget and the multicast rate limit.
+ * Only the budget and rate limit logic is measured here, the socket receive path under a real flood
+ * is covered by test_flood_receive_rate in tests/host_test.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define BENCH_FLOOD_SECONDS     10
+#define BENCH_FLOOD_RATE        1000        // queries per second
+#define BENCH_FLOOD_SOURCES     64
+#define BENCH_FLOOD_NETWORK     0x0004A8C0  // 192.168.4.0, the sources are 192.168.4.10 and up
+
+extern mdns_server_t *_mdns_server;
+
+static uint32_t source_ip(uint32_t i)
+{
+    return BENCH_FLOOD_NETWORK | ((10 + i) << 24);
+}
+
+static uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+/**
+ * @brief  Fires the timers due until the given time and leaves the clock there
+ */
+static void run_until(uint32_t ms)
+{
+    uint32_t expiry;
+    while (bench_timer_next(&expiry) && (int32_t)(expiry - ms) <= 0) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+    bench_clock_set(ms);
+}
+
+static void run_flood(const char *metric, const bench_packet_t *query, uint32_t sources)
+{
+    uint32_t i;
+    uint32_t n = BENCH_FLOOD_SECONDS * BENCH_FLOOD_RATE;
+    uint32_t begin = now_ms();
+    uint32_t tx = bench_tx_count();
+    uint32_t throttled = _mdns_server->stats.queries_throttled;
+    uint32_t rate_limited = _mdns_server->stats.answers_rate_limited;
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        run_until(begin + i * 1000 / BENCH_FLOOD_RATE);
+        bench_rx_packet(query->data, query->len, source_ip(i % sources));
+    }
+    // the responses still scheduled are sent
+    run_until(begin + BENCH_FLOOD_SECONDS * 1000 + 1000);
+    uint64_t elapsed = bench_now_ns() - start;
+
+    char label[48];
+    bench_report("flood", metric, n, elapsed);
+    snprintf(label, sizeof(label), "%s_tx", metric);
+    bench_report_value("flood", label, (double)(bench_tx_count() - tx) / BENCH_FLOOD_SECONDS, "packets/s");
+    snprintf(label, sizeof(label), "%s_throttled", metric);
+    bench_report_value("flood", label, _mdns_server->stats.queries_throttled - throttled, "queries");
+    snprintf(label, sizeof(label), "%s_rate_limited", metric);
+    bench_report_value("flood", label, _mdns_server->stats.answers_rate_limited - rate_limited, "answers");
+}
+
+/**
+ * @brief  Receives packets faster than the service task runs, the oldest ones are dropped
+ */
+static void run_rx_overflow(const bench_packet_t *query)
+{
+    uint32_t i;
+    uint32_t n = 4 * MDNS_PACKET_QUEUE_LEN;
+    uint32_t dropped = _mdns_server->stats.rx_dropped;
+    for (i = 0; i < n; i++) {
+        bench_rx_enqueue(query->data, query->len, source_ip(i % BENCH_FLOOD_SOURCES));
+    }
+    uint32_t actions = bench_run_service_queue();
+    bench_report_value("flood", "rx_overflow_dropped", _mdns_server->stats.rx_dropped - dropped, "packets");
+    bench_report_value("flood", "rx_overflow_actions", actions, "actions");
+    run_until(now_ms() + 1000);
+}
+
+void bench_flood(void)
+{
+    mdns_pcb_state_t states[MDNS_MAX_INTERFACES][MDNS_IP_PROTOCOL_MAX];
+    uint16_t query_budget = _mdns_server->rx.query_budget;
+    uint16_t multicast_interval = _mdns_server->multicast_interval;
+    const char *service[] = { "_http", "_tcp", "local" };
+    bench_packet_t query;
+    uint32_t i, j;
+
+    if (mdns_service_add("node", "_http", "_tcp", 80, NULL, 0)) {
+        abort();
+    }
+    bench_run_service_queue();
+    // probing and announcing finish first
+    run_until(now_ms() + 5000);
+    // answer on one interface only
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            states[i][j] = _mdns_server->interfaces[i].pcbs[j].state;
+            _mdns_server->interfaces[i].pcbs[j].state = PCB_OFF;
+        }
+    }
+    _mdns_server->interfaces[0].pcbs[MDNS_IP_PROTOCOL_V4].state = PCB_RUNNING;
+    bench_packet_query(&query, service, 3, MDNS_TYPE_PTR);
+
+    _mdns_server->rx.query_budget = 0;
+    _mdns_server->multicast_interval = 0;
+    run_flood("unlimited", &query, 1);
+
+    _mdns_server->rx.query_budget = MDNS_QUERY_BUDGET;
+    _mdns_server->multicast_interval = MDNS_MULTICAST_INTERVAL;
+    run_flood("one_source", &query, 1);
+    run_flood("many_sources", &query, BENCH_FLOOD_SOURCES);
+    run_rx_overflow(&query);
+
+    _mdns_server->rx.query_budget = query_budget;
+    _mdns_server->multicast_interval = multicast_interval;
+    mdns_service_remove_all();
+    bench_run_service_queue();
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_server->interfaces[i].pcbs[j].state = states[i][j];
+        }
+    }
+}
@@ -0,0 +1,178 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Delegated hosts benchmark -- N hosts (e.g. the sub-devices of a gateway) are added with
+ * mdns_delegate_hostname_add(), probed and announced, queried and removed again
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define BENCH_HOSTS_QUERIES     1000
+#define BENCH_HOSTS_NETWORK     0x0004A8C0  // 192.168.4.0, the hosts are 192.168.4.10 and up
+
+extern mdns_server_t *_mdns_server;
+
+static uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+/**
+ * @brief  Fires the timers due until the given time and leaves the clock there
+ */
+static void run_until(uint32_t ms)
+{
+    uint32_t expiry;
+    while (bench_timer_next(&expiry) && (int32_t)(expiry - ms) <= 0) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+    bench_clock_set(ms);
+}
+
+/**
+ * @brief  Query with one question for the host
+ */
+static void build_query(bench_packet_t *p, const char *host, uint16_t type)
+{
+    const char *labels[] = { host, "local" };
+    bench_packet_query(p, labels, 2, type);
+}
+
+static void parse(const bench_packet_t *p)
+{
+    struct pbuf pb = { 0 };
+    mdns_rx_packet_t packet = { 0 };
+    pb.payload = (void *)p->data;
+    pb.len = pb.tot_len = p->len;
+    packet.pb = &pb;
+    packet.tcpip_if = 0;
+    packet.ip_protocol = MDNS_IP_PROTOCOL_V4;
+    packet.src.type = ESP_IPADDR_TYPE_V4;
+    packet.src.u_addr.ip4.addr = BENCH_HOSTS_NETWORK | (9u << 24);
+    packet.src_port = MDNS_SERVICE_PORT;
+    packet.multicast = 1;
+    mdns_bench_parse_packet(&packet);
+}
+
+static void host_name(char *name, size_t size, uint32_t i)
+{
+    snprintf(name, size, "i2c-dev-%03u", (unsigned)i);
+}
+
+/**
+ * @brief  Query cycle for the first host, 150 ms apart so that every response is due
+ */
+static void run_queries(uint32_t n, const char *metric, uint16_t type)
+{
+    char name[32];
+    char label[48];
+    bench_packet_t query;
+    uint32_t i;
+
+    host_name(name, sizeof(name), 0);
+    build_query(&query, name, type);
+    uint32_t tx = bench_tx_count();
+    uint32_t records = bench_tx_records();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_HOSTS_QUERIES; i++) {
+        parse(&query);
+        bench_clock_advance(150);
+        mdns_bench_dispatch_due();
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    snprintf(label, sizeof(label), "hosts_%u", (unsigned)n);
+    bench_report(label, metric, BENCH_HOSTS_QUERIES, elapsed);
+    snprintf(name, sizeof(name), "%s_tx", metric);
+    bench_report_value(label, name, (double)(bench_tx_count() - tx) / BENCH_HOSTS_QUERIES, "packets");
+    snprintf(name, sizeof(name), "%s_records", metric);
+    bench_report_value(label, name, (double)(bench_tx_records() - records) / BENCH_HOSTS_QUERIES, "records");
+    run_until(now_ms() + 1000);
+}
+
+static void run_hosts(uint32_t n)
+{
+    char name[32];
+    char label[32];
+    mdns_ip_addr_t addr = { 0 };
+    uint32_t i;
+
+    snprintf(label, sizeof(label), "hosts_%u", (unsigned)n);
+    addr.addr.type = ESP_IPADDR_TYPE_V4;
+
+    uint32_t tx = bench_tx_count();
+    uint32_t records = bench_tx_records();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        host_name(name, sizeof(name), i);
+        addr.addr.u_addr.ip4.addr = BENCH_HOSTS_NETWORK | ((10 + i) << 24);
+        if (mdns_delegate_hostname_add(name, &addr)) {
+            abort();
+        }
+        bench_run_service_queue();
+    }
+    bench_report(label, "add", n, bench_now_ns() - start);
+    // the probes and announcements of the hosts
+    run_until(now_ms() + 5000);
+    bench_report_value(label, "add_tx", bench_tx_count() - tx, "packets");
+    bench_report_value(label, "add_records", bench_tx_records() - records, "records");
+
+    // one host changes its address
+    tx = bench_tx_count();
+    addr.addr.u_addr.ip4.addr = BENCH_HOSTS_NETWORK | (250u << 24);
+    host_name(name, sizeof(name), n / 2);
+    start = bench_now_ns();
+    if (mdns_delegate_hostname_set_address(name, &addr)) {
+        abort();
+    }
+    bench_run_service_queue();
+    bench_report(label, "set_address", 1, bench_now_ns() - start);
+    run_until(now_ms() + 5000);
+    bench_report_value(label, "set_address_tx", bench_tx_count() - tx, "packets");
+
+    run_queries(n, "query_a", MDNS_TYPE_A);
+    run_queries(n, "query_any", MDNS_TYPE_ANY);
+
+    tx = bench_tx_count();
+    start = bench_now_ns();
+    for (i = 0; i < n; i++) {
+        host_name(name, sizeof(name), i);
+        if (mdns_delegate_hostname_remove(name)) {
+            abort();
+        }
+        bench_run_service_queue();
+    }
+    bench_report(label, "remove", n, bench_now_ns() - start);
+    run_until(now_ms() + 5000);
+    bench_report_value(label, "remove_tx", bench_tx_count() - tx, "packets");
+}
+
+void bench_hosts(void)
+{
+    mdns_pcb_state_t states[MDNS_MAX_INTERFACES][MDNS_IP_PROTOCOL_MAX];
+    uint32_t i, j;
+
+    // probe, announce and answer on one interface only
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            states[i][j] = _mdns_server->interfaces[i].pcbs[j].state;
+            _mdns_server->interfaces[i].pcbs[j].state = PCB_OFF;
+        }
+    }
+    _mdns_server->interfaces[0].pcbs[MDNS_IP_PROTOCOL_V4].state = PCB_RUNNING;
+
+    run_hosts(10);
+    run_hosts(50);
+    run_hosts(100);
+
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_server->interfaces[i].pcbs[j].state = states[i][j];
+        }
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Service index benchmark -- looks up the services of a responder with 10 to 500 of them,
+ * by type, by instance and a type which is not ours, directly and as a question of a query
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "bench.h"
+
+#define BENCH_INDEX_ITERATIONS  20000
+#define BENCH_INDEX_TYPES       10
+
+extern mdns_server_t *_mdns_server;
+
+/**
+ * @brief  The services list scan which the index replaced, to compare the cost and the results
+ */
+static mdns_srv_item_t *scan_service(const char *instance, const char *service, const char *proto)
+{
+    for (mdns_srv_item_t *s = _mdns_server->services; s; s = s->next) {
+        const char *name = s->service->instance ? s->service->instance : _mdns_server->hostname;
+        if (!strcasecmp(s->service->service, service) && !strcasecmp(s->service->proto, proto)
+                && (!instance || !strcasecmp(name, instance))) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static void run_until_idle(void)
+{
+    uint32_t expiry;
+    while (bench_timer_next(&expiry)) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+}
+
+static void run_lookup(const char *name, const char *metric, const char *instance, const char *service, const char *proto, bool scan)
+{
+    uint32_t i;
+    uint32_t found = 0;
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_INDEX_ITERATIONS; i++) {
+        found += (scan ? scan_service(instance, service, proto) : mdns_bench_get_service_item(instance, service, proto)) != NULL;
+    }
+    bench_report(name, metric, BENCH_INDEX_ITERATIONS, bench_now_ns() - start);
+    if (found != (scan_service(instance, service, proto) ? BENCH_INDEX_ITERATIONS : 0)) {
+        abort();
+    }
+}
+
+static void bench_index_run(uint32_t count)
+{
+    char name[32];
+    char instance[32];
+    char service[16];
+    bench_packet_t query;
+    uint32_t i;
+    mdns_txt_item_t txt[1] = {
+        { "path", "/" },
+    };
+
+    snprintf(name, sizeof(name), "index_%u", count);
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < count; i++) {
+        snprintf(instance, sizeof(instance), "node-%03u", i);
+        snprintf(service, sizeof(service), "_svc%u", i % BENCH_INDEX_TYPES);
+        if (mdns_service_add(instance, service, "_tcp", 1000 + i, txt, 1)) {
+            abort();
+        }
+    }
+    bench_report(name, "service_add", count, bench_now_ns() - start);
+    bench_run_service_queue();
+    // all the services are probed and announced, so that the questions reach the running responder
+    run_until_idle();
+
+    // every service is found as the list scan finds it (the newest one of its type first)
+    for (i = 0; i < count; i++) {
+        snprintf(instance, sizeof(instance), "NODE-%03u", i);
+        snprintf(service, sizeof(service), "_SVC%u", i % BENCH_INDEX_TYPES);
+        if (mdns_bench_get_service_item(instance, service, "_tcp") != scan_service(instance, service, "_tcp")
+                || mdns_bench_get_service_item(NULL, service, "_tcp") != scan_service(NULL, service, "_tcp")) {
+            abort();
+        }
+    }
+
+    // the oldest service of the first type is the last one its list scan reaches
+    run_lookup(name, "lookup_type", NULL, "_svc0", "_tcp", false);
+    run_lookup(name, "lookup_instance", "node-000", "_svc0", "_tcp", false);
+    run_lookup(name, "lookup_miss", NULL, "_missing", "_tcp", false);
+    run_lookup(name, "scan_instance", "node-000", "_svc0", "_tcp", true);
+    run_lookup(name, "scan_miss", NULL, "_missing", "_tcp", true);
+
+    // the whole receive path of a question which is not ours, no response is built
+    const char *missing[] = { "_missing", "_tcp", "local" };
+    bench_packet_query(&query, missing, 3, MDNS_TYPE_PTR);
+    uint32_t tx = bench_tx_count();
+    start = bench_now_ns();
+    for (i = 0; i < BENCH_INDEX_ITERATIONS; i++) {
+        bench_rx_packet(query.data, query.len, 0x0204A8C0); // 192.168.4.2
+    }
+    bench_report(name, "question_miss", BENCH_INDEX_ITERATIONS, bench_now_ns() - start);
+    if (bench_tx_count() != tx) {
+        abort();
+    }
+
+    mdns_service_remove_all();
+    bench_run_service_queue();
+}
+
+void bench_index(void)
+{
+    bench_index_run(10);
+    bench_index_run(50);
+    bench_index_run(100);
+    bench_index_run(500);
+}
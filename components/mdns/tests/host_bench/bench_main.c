@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+
+extern mdns_server_t *_mdns_server;
+
+static const bench_case_t s_cases[] = {
+    { "tx_scheduler", bench_tx_scheduler },
+    { "timer", bench_timer },
+    { "compression", bench_compression },
+    { "answers", bench_answers },
+    { "memory", bench_memory },
+    { "cache", bench_cache },
+    { "suppression", bench_suppression },
+    { "contention", bench_contention },
+    { "index", bench_index },
+    { "flood", bench_flood },
+    { "browse", bench_browse },
+    { "throughput", bench_throughput },
+    { "hosts", bench_hosts },
+};
+
+int main(int argc, char **argv)
+{
+    size_t i;
+    int ran = 0;
+    const char *name = NULL;
+    for (i = 1; i < (size_t)argc; i++) {
+        if (strcmp(argv[i], "--json") == 0) {
+            bench_report_json(true);
+        } else {
+            name = argv[i];
+        }
+    }
+    // mdns_free() is not supported by the mocked task api, so the cases share one instance
+    if (mdns_init() || mdns_hostname_set("bench-host")) {
+        abort();
+    }
+    // the cases replay packets back to back on the virtual clock, only the flood case applies the RX limits
+    _mdns_server->rx.query_budget = 0;
+    _mdns_server->multicast_interval = 0;
+    bench_run_service_queue();
+    for (i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        if (name && strcmp(name, s_cases[i].name) != 0) {
+            continue;
+        }
+        s_cases[i].run();
+        bench_run_service_queue();
+        // the packets a case left scheduled go back to the pools, the next case starts with empty queues
+        mdns_bench_clear_tx_queue_head();
+        ran++;
+    }
+    if (!ran) {
+        fprintf(stderr, "unknown benchmark: %s\n", name);
+        return 1;
+    }
+    return 0;
+}
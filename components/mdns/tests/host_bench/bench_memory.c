@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Memory benchmark -- runs the whole query -> response cycle (RX action, parse,
+ * scheduled response, TX) and counts the heap allocations it takes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "mdns_mem_caps.h"
+
+#define BENCH_MEMORY_SERVICES   4
+#define BENCH_MEMORY_ITERATIONS 2000
+
+extern mdns_server_t *_mdns_server;
+
+/**
+ * @brief  Passes the query to the service task as the networking layer does and runs until the response is sent
+ */
+static void run_query(const uint8_t *query, size_t len)
+{
+    bench_rx_packet(query, len, 0x0204A8C0); // 192.168.4.2
+
+    uint32_t expiry;
+    while (bench_timer_next(&expiry)) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+}
+
+static void run_case(const char *name, const uint8_t *query, size_t len)
+{
+    uint32_t i;
+    uint32_t tx = bench_tx_count();
+    uint32_t allocs = bench_heap_allocs();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_MEMORY_ITERATIONS; i++) {
+        run_query(query, len);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    bench_report(name, "query_cycle", BENCH_MEMORY_ITERATIONS, elapsed);
+    bench_report_value(name, "heap_allocs_per_query", (double)(bench_heap_allocs() - allocs) / BENCH_MEMORY_ITERATIONS, "allocs");
+    bench_report_value(name, "tx_per_query", (double)(bench_tx_count() - tx) / BENCH_MEMORY_ITERATIONS, "packets");
+}
+
+void bench_memory(void)
+{
+    static const char *pool_names[MDNS_MEM_POOL_MAX] = { "action", "tx_packet", "answer", "question" };
+    const char *ptr_query[] = { "_svc0", "_tcp", "local" };
+    const char *discovery_query[] = { "_services", "_dns-sd", "_udp", "local" };
+    bench_packet_t query;
+    char instance[32];
+    char service[16];
+    char metric[48];
+    uint32_t i;
+    mdns_txt_item_t txt[2] = {
+        { "board", "esp32s3" },
+        { "path", "/" },
+    };
+
+    for (i = 0; i < BENCH_MEMORY_SERVICES; i++) {
+        snprintf(instance, sizeof(instance), "Sensor node %u", i);
+        snprintf(service, sizeof(service), "_svc%u", i);
+        if (mdns_service_add(instance, service, "_tcp", 8000 + i, txt, 2)) {
+            abort();
+        }
+    }
+    bench_run_service_queue();
+    // answer as a responder which has finished probing and announcing
+    _mdns_server->interfaces[0].pcbs[MDNS_IP_PROTOCOL_V4].state = PCB_RUNNING;
+    // the cases run before left nothing scheduled, the counters start with these queries
+    mdns_mem_reset_stats();
+
+    bench_packet_query(&query, ptr_query, 3, MDNS_TYPE_PTR);
+    run_case("memory_ptr_query", query.data, query.len);
+    bench_packet_query(&query, discovery_query, 4, MDNS_TYPE_PTR);
+    run_case("memory_discovery_query", query.data, query.len);
+
+    mdns_mem_stats_t stats;
+    mdns_mem_get_stats(&stats);
+    for (i = 0; i < MDNS_MEM_POOL_MAX; i++) {
+        snprintf(metric, sizeof(metric), "pool_%s_high_water", pool_names[i]);
+        bench_report_value("memory", metric, stats.pools[i].high_water, "objects");
+        snprintf(metric, sizeof(metric), "pool_%s_fallbacks", pool_names[i]);
+        bench_report_value("memory", metric, stats.pools[i].fallbacks, "allocs");
+    }
+    bench_report_value("memory", "arena_high_water", stats.arena_high_water, "bytes");
+    bench_report_value("memory", "arena_fallbacks", stats.arena_fallbacks, "allocs");
+
+    _mdns_server->interfaces[0].pcbs[MDNS_IP_PROTOCOL_V4].state = PCB_OFF;
+    mdns_service_remove_all();
+    bench_run_service_queue();
+}
@@ -0,0 +1,415 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Mock environment for the benchmarks -- same as the fuzzer mocks (esp32_mock.c),
+ * but with a real FIFO action queue and a virtual clock, so that the mdns
+ * scheduler and service task can be driven deterministically
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "bench.h"
+#include "esp_log.h"
+#include "mdns_mem_caps.h"
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#define bench_alloc_size(ptr)   malloc_size(ptr)
+#else
+#include <malloc.h>
+#define bench_alloc_size(ptr)   malloc_usable_size(ptr)
+#endif
+
+typedef struct {
+    uint32_t length;
+    uint32_t item_size;
+    uint32_t head;
+    uint32_t count;
+    uint8_t data[];
+} bench_queue_t;
+
+typedef struct {
+    esp_timer_cb_t cb;
+    void *arg;
+    bool armed;
+    uint32_t expiry_ms;
+    uint32_t period_ms;
+} bench_timer_t;
+
+static uint32_t s_now_ms;
+static bench_timer_t s_timer;
+static uint8_t s_last_tx[MDNS_MAX_PACKET_SIZE];
+static size_t s_last_tx_len;
+static bench_queue_t *s_action_queue;
+static uint32_t s_tx_count;
+static uint32_t s_tx_records;
+static uint32_t s_heap_allocs;
+static size_t s_heap_in_use;
+static size_t s_heap_peak;
+static bench_tx_hook_t s_tx_hook;
+static pthread_mutex_t s_service_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t s_critical = PTHREAD_MUTEX_INITIALIZER;
+
+const char *WIFI_EVENT = "wifi_event";
+const char *ETH_EVENT = "eth_event";
+
+void bench_clock_set(uint32_t ms)
+{
+    s_now_ms = ms;
+}
+
+void bench_clock_advance(uint32_t ms)
+{
+    s_now_ms += ms;
+}
+
+esp_err_t esp_event_handler_register(const char *event_base,
+                                     int32_t event_id,
+                                     void *event_handler,
+                                     void *event_handler_arg)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister(const char *event_base, int32_t event_id, void *event_handler)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    s_timer.armed = false;
+    s_timer.cb = NULL;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!s_timer.armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_timer.armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    s_timer.armed = true;
+    s_timer.period_ms = period / 1000;
+    s_timer.expiry_ms = s_now_ms + s_timer.period_ms;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (s_timer.armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_timer.armed = true;
+    s_timer.period_ms = 0;
+    s_timer.expiry_ms = s_now_ms + (uint32_t)((timeout_us + 999) / 1000);
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    // the responder measures its own cost with it, unlike its timers it runs on the real clock
+    return (int64_t)(bench_now_ns() / 1000);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args,
+                           esp_timer_handle_t *out_handle)
+{
+    s_timer.cb = create_args->callback;
+    s_timer.arg = create_args->arg;
+    s_timer.armed = false;
+    *out_handle = (esp_timer_handle_t)&s_timer;
+    return ESP_OK;
+}
+
+/**
+ * @brief  Returns the virtual time the mdns timer expires at
+ */
+bool bench_timer_next(uint32_t *expiry_ms)
+{
+    if (!s_timer.armed || !s_timer.cb) {
+        return false;
+    }
+    *expiry_ms = s_timer.expiry_ms;
+    return true;
+}
+
+/**
+ * @brief  Runs the mdns timer callback if it expired at the current virtual time
+ */
+bool bench_timer_fire(void)
+{
+    if (!s_timer.armed || !s_timer.cb || (int32_t)(s_timer.expiry_ms - s_now_ms) > 0) {
+        return false;
+    }
+    if (s_timer.period_ms) {
+        s_timer.expiry_ms += s_timer.period_ms;
+    } else {
+        s_timer.armed = false;
+    }
+    s_timer.cb(s_timer.arg);
+    return true;
+}
+
+uint32_t xTaskGetTickCount(void)
+{
+    return s_now_ms / portTICK_PERIOD_MS;
+}
+
+/// Queue mock
+QueueHandle_t xQueueCreate(uint32_t uxQueueLength, uint32_t uxItemSize)
+{
+    bench_queue_t *q = malloc(sizeof(bench_queue_t) + uxQueueLength * uxItemSize);
+    if (!q) {
+        return NULL;
+    }
+    q->length = uxQueueLength;
+    q->item_size = uxItemSize;
+    q->head = 0;
+    q->count = 0;
+    s_action_queue = q;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+    if (xQueue == s_action_queue) {
+        s_action_queue = NULL;
+    }
+    free(xQueue);
+}
+
+uint32_t xQueueSend(QueueHandle_t xQueue, const void *pvItemToQueue, TickType_t xTicksToWait)
+{
+    bench_queue_t *q = xQueue;
+    if (q->count == q->length) {
+        return pdFALSE;
+    }
+    memcpy(q->data + ((q->head + q->count) % q->length) * q->item_size, pvItemToQueue, q->item_size);
+    q->count++;
+    return pdPASS;
+}
+
+uint32_t xQueueReceive(QueueHandle_t xQueue, void *pvBuffer, TickType_t xTicksToWait)
+{
+    bench_queue_t *q = xQueue;
+    if (!q->count) {
+        return pdFALSE;
+    }
+    memcpy(pvBuffer, q->data + q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    return pdPASS;
+}
+
+/**
+ * @brief  Executes all pending actions, as the mdns service task would do
+ */
+uint32_t bench_run_service_queue(void)
+{
+    mdns_action_t *a = NULL;
+    uint32_t n = 0;
+    while (s_action_queue && xQueueReceive(s_action_queue, &a, 0) == pdPASS) {
+        mdns_bench_execute_action(a);
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief  Passes a received packet to the service task as the networking layer does
+ */
+void bench_rx_enqueue(const uint8_t *data, size_t len, uint32_t src_ip)
+{
+    mdns_rx_packet_t *packet = calloc(1, sizeof(mdns_rx_packet_t));
+    struct pbuf *pb = calloc(1, sizeof(struct pbuf) + len);
+    if (!packet || !pb) {
+        abort();
+    }
+    pb->payload = (uint8_t *)(pb + 1);
+    pb->len = pb->tot_len = len;
+    memcpy(pb->payload, data, len);
+    packet->pb = pb;
+    packet->tcpip_if = 0;
+    packet->ip_protocol = MDNS_IP_PROTOCOL_V4;
+    packet->src.type = ESP_IPADDR_TYPE_V4;
+    packet->src.u_addr.ip4.addr = src_ip;
+    packet->src_port = MDNS_SERVICE_PORT;
+    packet->multicast = 1;
+    if (_mdns_send_rx_action(packet) != ESP_OK) {
+        abort();
+    }
+}
+
+/**
+ * @brief  Passes a received packet to the service task and runs the task
+ */
+void bench_rx_packet(const uint8_t *data, size_t len, uint32_t src_ip)
+{
+    bench_rx_enqueue(data, len, src_ip);
+    bench_run_service_queue();
+}
+
+size_t bench_udp_write(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, const esp_ip_addr_t *ip, uint16_t port, uint8_t *data, size_t len)
+{
+    s_tx_count++;
+    if (len >= MDNS_HEAD_LEN) {
+        s_tx_records += ((data[MDNS_HEAD_ANSWERS_OFFSET] << 8) | data[MDNS_HEAD_ANSWERS_OFFSET + 1])
+                        + ((data[MDNS_HEAD_SERVERS_OFFSET] << 8) | data[MDNS_HEAD_SERVERS_OFFSET + 1])
+                        + ((data[MDNS_HEAD_ADDITIONAL_OFFSET] << 8) | data[MDNS_HEAD_ADDITIONAL_OFFSET + 1]);
+    }
+    s_last_tx_len = len < sizeof(s_last_tx) ? len : sizeof(s_last_tx);
+    memcpy(s_last_tx, data, s_last_tx_len);
+    if (s_tx_hook) {
+        s_tx_hook(tcpip_if, ip_protocol, ip, port, data, len);
+    }
+    return len;
+}
+
+void bench_tx_set_hook(bench_tx_hook_t hook)
+{
+    s_tx_hook = hook;
+}
+
+/**
+ * @brief  Returns the last packet passed to the networking layer
+ */
+const uint8_t *bench_last_tx(size_t *len)
+{
+    *len = s_last_tx_len;
+    return s_last_tx;
+}
+
+/**
+ * @brief  Returns the number of packets passed to the networking layer
+ */
+uint32_t bench_tx_count(void)
+{
+    return s_tx_count;
+}
+
+/**
+ * @brief  Returns the number of records (answer, authority and additional) in the packets passed to the networking layer
+ */
+uint32_t bench_tx_records(void)
+{
+    return s_tx_records;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return NULL;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    return;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t bits_entry_clear, uint32_t bits_exit_clear, uint32_t *value, TickType_t wait_time)
+{
+    return pdTRUE;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+}
+
+void esp_log(esp_log_config_t config, const char *tag, const char *format, ...)
+{
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return 0;
+}
+
+/// Locks, real mutexes as the API may be called from another thread (bench_contention.c)
+void bench_service_lock(void)
+{
+    pthread_mutex_lock(&s_service_lock);
+}
+
+void bench_service_unlock(void)
+{
+    pthread_mutex_unlock(&s_service_lock);
+}
+
+void bench_critical_enter(void)
+{
+    pthread_mutex_lock(&s_critical);
+}
+
+void bench_critical_exit(void)
+{
+    pthread_mutex_unlock(&s_critical);
+}
+
+/// Heap mock, the mdns memory functions (mdns_mem_caps.c) allocate through it
+static void *heap_account(void *ptr)
+{
+    if (ptr) {
+        size_t in_use = __atomic_add_fetch(&s_heap_in_use, bench_alloc_size(ptr), __ATOMIC_RELAXED);
+        size_t peak = __atomic_load_n(&s_heap_peak, __ATOMIC_RELAXED);
+        while (in_use > peak && !__atomic_compare_exchange_n(&s_heap_peak, &peak, in_use, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+    }
+    return ptr;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    __atomic_fetch_add(&s_heap_allocs, 1, __ATOMIC_RELAXED);
+    return heap_account(malloc(size));
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    __atomic_fetch_add(&s_heap_allocs, 1, __ATOMIC_RELAXED);
+    return heap_account(calloc(n, size));
+}
+
+void heap_caps_free(void *ptr)
+{
+    if (ptr) {
+        __atomic_fetch_sub(&s_heap_in_use, bench_alloc_size(ptr), __ATOMIC_RELAXED);
+    }
+    free(ptr);
+}
+
+/**
+ * @brief  Returns the number of heap allocations made so far
+ */
+uint32_t bench_heap_allocs(void)
+{
+    return __atomic_load_n(&s_heap_allocs, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief  Returns the bytes allocated through the heap mock and not freed yet
+ */
+size_t bench_heap_in_use(void)
+{
+    return __atomic_load_n(&s_heap_in_use, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief  Returns the most bytes in use since the last bench_heap_peak_reset()
+ */
+size_t bench_heap_peak(void)
+{
+    return __atomic_load_n(&s_heap_peak, __ATOMIC_RELAXED);
+}
+
+void bench_heap_peak_reset(void)
+{
+    __atomic_store_n(&s_heap_peak, bench_heap_in_use(), __ATOMIC_RELAXED);
+}
@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Packets of the peers, built by the benchmarks and passed to the service task as received
+ */
+#include <string.h>
+#include "bench.h"
+
+void bench_packet_begin(bench_packet_t *p, uint16_t flags)
+{
+    memset(p->data, 0, MDNS_HEAD_LEN);
+    p->len = MDNS_HEAD_LEN;
+    p->questions = 0;
+    p->records = 0;
+    p->data[MDNS_HEAD_FLAGS_OFFSET] = flags >> 8;
+    p->data[MDNS_HEAD_FLAGS_OFFSET + 1] = flags & 0xFF;
+}
+
+void bench_packet_end(bench_packet_t *p)
+{
+    p->data[MDNS_HEAD_QUESTIONS_OFFSET] = p->questions >> 8;
+    p->data[MDNS_HEAD_QUESTIONS_OFFSET + 1] = p->questions & 0xFF;
+    p->data[MDNS_HEAD_ANSWERS_OFFSET] = p->records >> 8;
+    p->data[MDNS_HEAD_ANSWERS_OFFSET + 1] = p->records & 0xFF;
+}
+
+void bench_packet_put_u16(bench_packet_t *p, uint16_t value)
+{
+    p->data[p->len++] = value >> 8;
+    p->data[p->len++] = value & 0xFF;
+}
+
+void bench_packet_put_data(bench_packet_t *p, const void *data, size_t len)
+{
+    memcpy(p->data + p->len, data, len);
+    p->len += len;
+}
+
+void bench_packet_put_name(bench_packet_t *p, const char *labels[], size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        size_t l = strlen(labels[i]);
+        p->data[p->len++] = l;
+        bench_packet_put_data(p, labels[i], l);
+    }
+    p->data[p->len++] = 0;
+}
+
+void bench_packet_put_question(bench_packet_t *p, const char *labels[], size_t count, uint16_t type)
+{
+    bench_packet_put_name(p, labels, count);
+    bench_packet_put_u16(p, type);
+    bench_packet_put_u16(p, MDNS_CLASS_IN);
+    p->questions++;
+}
+
+size_t bench_packet_begin_record(bench_packet_t *p, const char *labels[], size_t count, uint16_t type, uint16_t mdns_class, uint32_t ttl)
+{
+    bench_packet_put_name(p, labels, count);
+    bench_packet_put_u16(p, type);
+    bench_packet_put_u16(p, mdns_class);
+    bench_packet_put_u16(p, ttl >> 16);
+    bench_packet_put_u16(p, ttl & 0xFFFF);
+    bench_packet_put_u16(p, 0);
+    p->records++;
+    return p->len;
+}
+
+void bench_packet_end_record(bench_packet_t *p, size_t rdata)
+{
+    p->data[rdata - 2] = (p->len - rdata) >> 8;
+    p->data[rdata - 1] = (p->len - rdata) & 0xFF;
+}
+
+void bench_packet_query(bench_packet_t *p, const char *labels[], size_t count, uint16_t type)
+{
+    bench_packet_begin(p, 0);
+    bench_packet_put_question(p, labels, count, type);
+    bench_packet_end(p);
+}
@@ -0,0 +1,40 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Result output of the benchmarks and the replay tool
+ */
+#include <stdio.h>
+#include "bench.h"
+
+static bool s_json;
+
+void bench_report_json(bool json)
+{
+    s_json = json;
+}
+
+void bench_report(const char *bench, const char *metric, uint32_t n, uint64_t total_ns)
+{
+    bench_report_value(bench, metric, n ? (double)total_ns / n : 0.0, "ns/op");
+}
+
+void bench_report_value(const char *bench, const char *metric, double value, const char *unit)
+{
+    if (s_json) {
+        printf("{\"case\": \"%s\", \"metric\": \"%s\", \"value\": %.1f, \"unit\": \"%s\"}\n", bench, metric, value, unit);
+    } else {
+        printf("%s %s %.1f %s\n", bench, metric, value, unit);
+    }
+}
+
+uint32_t bench_checksum(const uint8_t *data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    while (len--) {
+        hash = (hash ^ *data++) * 16777619u;
+    }
+    return hash;
+}
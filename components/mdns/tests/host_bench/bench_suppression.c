@@ -0,0 +1,230 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Answer suppression benchmark -- queries with known answers, truncated queries continued
+ * in a second packet (by the querier or by another one), duplicate answers from another
+ * responder, a known-answer list which does not fit into one packet and our TXT record,
+ * larger than a packet of ours, sent back by another responder
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "bench.h"
+#include "mdns_mem_caps.h"
+
+#define BENCH_SUPPRESSION_ITERATIONS    2000
+#define BENCH_SUPPRESSION_QUERIER_IP    0x0204A8C0  // 192.168.4.2
+#define BENCH_SUPPRESSION_OTHER_IP      0x0304A8C0  // 192.168.4.3, another querier
+#define BENCH_SUPPRESSION_RESPONDER_IP  0x0504A8C0  // 192.168.4.5
+#define BENCH_SUPPRESSION_KNOWN_ANSWERS 40
+#define BENCH_SUPPRESSION_TXT_ITEMS     8
+#define BENCH_SUPPRESSION_TXT_VALUE_LEN 240         // 8 entries of 244 bytes, more than MDNS_MAX_PACKET_SIZE
+
+extern mdns_server_t *_mdns_server;
+
+static const char *s_service[] = { "_http", "_tcp", "local" };
+static const char *s_instance[] = { "node", "_http", "_tcp", "local" };
+
+/**
+ * @brief  Builds a packet with the PTR question of our service (if any) and our PTR record (if ttl is set)
+ */
+static void build_packet(bench_packet_t *p, uint16_t flags, bool question, uint32_t ttl)
+{
+    bench_packet_begin(p, flags);
+    if (question) {
+        bench_packet_put_question(p, s_service, 3, MDNS_TYPE_PTR);
+    }
+    if (ttl) {
+        size_t rdata = bench_packet_begin_record(p, s_service, 3, MDNS_TYPE_PTR, MDNS_CLASS_IN, ttl);
+        bench_packet_put_name(p, s_instance, 4);
+        bench_packet_end_record(p, rdata);
+    }
+    bench_packet_end(p);
+}
+
+static void run_until_idle(void)
+{
+    uint32_t expiry;
+    while (bench_timer_next(&expiry)) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+}
+
+/**
+ * @brief  Feeds the query and then the follow-up packet (a continuation or another responder's answer) before our response is sent
+ */
+static void run_case(const char *metric, const bench_packet_t *query, const bench_packet_t *follow_up, uint32_t follow_up_ip)
+{
+    uint32_t i;
+    uint32_t tx = bench_tx_count();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_SUPPRESSION_ITERATIONS; i++) {
+        bench_rx_packet(query->data, query->len, BENCH_SUPPRESSION_QUERIER_IP);
+        if (follow_up) {
+            bench_rx_packet(follow_up->data, follow_up->len, follow_up_ip);
+        }
+        run_until_idle();
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    bench_report("suppression", metric, BENCH_SUPPRESSION_ITERATIONS, elapsed);
+    char label[48];
+    snprintf(label, sizeof(label), "%s_tx", metric);
+    bench_report_value("suppression", label, (double)(bench_tx_count() - tx) / BENCH_SUPPRESSION_ITERATIONS, "packets");
+}
+
+/**
+ * @brief  Sends a PTR query with more known answers than fit into one packet
+ */
+static void run_known_answer_split(void)
+{
+    static char instances[BENCH_SUPPRESSION_KNOWN_ANSWERS][64];
+    uint32_t i;
+    mdns_tx_packet_t *p = mdns_bench_alloc_packet(0, MDNS_IP_PROTOCOL_V4);
+    mdns_out_question_t *q = mdns_mem_calloc(1, sizeof(mdns_out_question_t));
+    if (!p || !q) {
+        abort();
+    }
+    p->flags = 0;
+    q->type = MDNS_TYPE_PTR;
+    q->service = "_printer";
+    q->proto = "_tcp";
+    q->domain = "local";
+    p->questions = q;
+    for (i = 0; i < BENCH_SUPPRESSION_KNOWN_ANSWERS; i++) {
+        mdns_out_answer_t *a = mdns_mem_calloc(1, sizeof(mdns_out_answer_t));
+        if (!a) {
+            abort();
+        }
+        snprintf(instances[i], sizeof(instances[i]), "Shared office printer with a long instance name %02u", i);
+        a->type = MDNS_TYPE_PTR;
+        a->custom_instance = instances[i];
+        a->custom_service = "_printer";
+        a->custom_proto = "_tcp";
+        queueToEnd(mdns_out_answer_t, p->answers, a);
+    }
+
+    uint32_t tx = bench_tx_count();
+    uint32_t sent = _mdns_server->stats.known_answers_sent;
+    uint64_t start = bench_now_ns();
+    mdns_bench_dispatch_tx_packet(p);
+    bench_report("suppression", "known_answer_split", 1, bench_now_ns() - start);
+    bench_report_value("suppression", "known_answer_split_tx", bench_tx_count() - tx, "packets");
+    bench_report_value("suppression", "known_answer_split_sent", _mdns_server->stats.known_answers_sent - sent, "records");
+    mdns_bench_free_tx_packet(p);
+}
+
+/**
+ * @brief  Another responder sends our TXT record, larger than a packet of ours, with the same data
+ *
+ * The records are the same, no collision is detected and the service is not probed again
+ */
+static void run_large_txt_duplicate(void)
+{
+    static char values[BENCH_SUPPRESSION_TXT_ITEMS][BENCH_SUPPRESSION_TXT_VALUE_LEN + 1];
+    char keys[BENCH_SUPPRESSION_TXT_ITEMS][4];
+    mdns_txt_item_t txt[BENCH_SUPPRESSION_TXT_ITEMS];
+    bench_packet_t answer;
+    uint32_t i;
+
+    for (i = 0; i < BENCH_SUPPRESSION_TXT_ITEMS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "k%" PRIu32, i);
+        memset(values[i], 'a' + i, BENCH_SUPPRESSION_TXT_VALUE_LEN);
+        txt[i].key = keys[i];
+        txt[i].value = values[i];
+    }
+    if (mdns_service_txt_set("_http", "_tcp", txt, BENCH_SUPPRESSION_TXT_ITEMS)) {
+        abort();
+    }
+    bench_run_service_queue();
+    run_until_idle();
+
+    // the TXT record as we would send it, in the order of the service
+    mdns_srv_item_t *service = mdns_bench_get_service_item("node", "_http", "_tcp");
+    bench_packet_begin(&answer, MDNS_FLAGS_QR_AUTHORITATIVE);
+    size_t rdata = bench_packet_begin_record(&answer, s_instance, 4, MDNS_TYPE_TXT, MDNS_CLASS_IN_FLUSH_CACHE, MDNS_ANSWER_TXT_TTL);
+    for (mdns_txt_linked_item_t *item = service->service->txt; item; item = item->next) {
+        size_t key_len = strlen(item->key);
+        uint8_t len = key_len + 1 + item->value_len;
+        bench_packet_put_data(&answer, &len, 1);
+        bench_packet_put_data(&answer, item->key, key_len);
+        bench_packet_put_data(&answer, "=", 1);
+        bench_packet_put_data(&answer, item->value, item->value_len);
+    }
+    bench_packet_end_record(&answer, rdata);
+    bench_packet_end(&answer);
+
+    uint32_t tx = bench_tx_count();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_SUPPRESSION_ITERATIONS; i++) {
+        bench_rx_packet(answer.data, answer.len, BENCH_SUPPRESSION_RESPONDER_IP);
+        run_until_idle();
+    }
+    bench_report("suppression", "large_txt_duplicate", BENCH_SUPPRESSION_ITERATIONS, bench_now_ns() - start);
+    bench_report_value("suppression", "large_txt_duplicate_tx", (double)(bench_tx_count() - tx) / BENCH_SUPPRESSION_ITERATIONS, "packets");
+}
+
+void bench_suppression(void)
+{
+    mdns_pcb_state_t states[MDNS_MAX_INTERFACES][MDNS_IP_PROTOCOL_MAX];
+    bench_packet_t query, follow_up;
+    uint32_t i, j;
+    mdns_txt_item_t txt[1] = {
+        { "path", "/" },
+    };
+
+    if (mdns_service_add("node", "_http", "_tcp", 80, txt, 1)) {
+        abort();
+    }
+    bench_run_service_queue();
+    // probing and announcing finish first, the service must not be left in the probe lists of the PCBs turned off
+    run_until_idle();
+    // answer on one interface only
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            states[i][j] = _mdns_server->interfaces[i].pcbs[j].state;
+            _mdns_server->interfaces[i].pcbs[j].state = PCB_OFF;
+        }
+    }
+    _mdns_server->interfaces[0].pcbs[MDNS_IP_PROTOCOL_V4].state = PCB_RUNNING;
+
+    build_packet(&query, 0, true, 0);
+    run_case("ptr_query", &query, NULL, 0);
+    build_packet(&query, 0, true, MDNS_ANSWER_PTR_TTL);
+    run_case("fresh_known_answer", &query, NULL, 0);
+    build_packet(&query, 0, true, MDNS_ANSWER_PTR_TTL / 4);
+    run_case("stale_known_answer", &query, NULL, 0);
+
+    // the known answer arrives in the packet following a query with the TC bit
+    build_packet(&query, MDNS_FLAGS_DISTRIBUTED, true, 0);
+    build_packet(&follow_up, 0, false, MDNS_ANSWER_PTR_TTL);
+    run_case("truncated_query", &query, &follow_up, BENCH_SUPPRESSION_QUERIER_IP);
+    // known answers of another querier do not continue the truncated query, the answer is sent
+    run_case("truncated_query_other", &query, &follow_up, BENCH_SUPPRESSION_OTHER_IP);
+
+    // another responder sends our answer while our response waits for its shared-record delay
+    build_packet(&query, 0, true, 0);
+    build_packet(&follow_up, MDNS_FLAGS_QR_AUTHORITATIVE, false, MDNS_ANSWER_PTR_TTL);
+    run_case("duplicate_answer", &query, &follow_up, BENCH_SUPPRESSION_RESPONDER_IP);
+
+    run_known_answer_split();
+    run_large_txt_duplicate();
+
+    bench_report_value("suppression", "known_answers_suppressed", _mdns_server->stats.known_answers_suppressed, "answers");
+    bench_report_value("suppression", "duplicate_answers_suppressed", _mdns_server->stats.duplicate_answers_suppressed, "answers");
+    bench_report_value("suppression", "truncated_queries_received", _mdns_server->stats.truncated_queries_received, "packets");
+    bench_report_value("suppression", "truncated_queries_sent", _mdns_server->stats.truncated_queries_sent, "packets");
+
+    mdns_service_remove_all();
+    bench_run_service_queue();
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_server->interfaces[i].pcbs[j].state = states[i][j];
+        }
+    }
+}
@@ -0,0 +1,293 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Throughput benchmark -- packets are passed to mdns_parse_packet() directly and the responses
+ * are dispatched as soon as they are due, without the RX queue and the action queue: PTR query
+ * floods, queries with several questions, announcements of N services and a browse storm
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define BENCH_THROUGHPUT_SERVICES   8
+#define BENCH_THROUGHPUT_PACKETS    5000
+#define BENCH_THROUGHPUT_SOURCES    64
+#define BENCH_THROUGHPUT_NETWORK    0x0004A8C0  // 192.168.4.0, the sources are 192.168.4.10 and up
+#define BENCH_THROUGHPUT_BROWSES    16
+#define BENCH_THROUGHPUT_PEERS      200
+
+extern mdns_server_t *_mdns_server;
+
+static uint32_t s_notifications;
+
+/**
+ * @brief  Appends the PTR, SRV and TXT records of an instance, and the A record of its host if ip is set
+ */
+static void put_instance(bench_packet_t *p, const char *instance, const char *service, const char *host, uint32_t ip)
+{
+    const char *service_name[] = { service, "_tcp", "local" };
+    const char *instance_name[] = { instance, service, "_tcp", "local" };
+    const char *host_name[] = { host, "local" };
+    size_t rdata;
+
+    rdata = bench_packet_begin_record(p, service_name, 3, MDNS_TYPE_PTR, MDNS_CLASS_IN, MDNS_ANSWER_PTR_TTL);
+    bench_packet_put_name(p, instance_name, 4);
+    bench_packet_end_record(p, rdata);
+
+    rdata = bench_packet_begin_record(p, instance_name, 4, MDNS_TYPE_SRV, MDNS_CLASS_IN_FLUSH_CACHE, MDNS_ANSWER_SRV_TTL);
+    bench_packet_put_u16(p, 0);
+    bench_packet_put_u16(p, 0);
+    bench_packet_put_u16(p, 80);
+    bench_packet_put_name(p, host_name, 2);
+    bench_packet_end_record(p, rdata);
+
+    rdata = bench_packet_begin_record(p, instance_name, 4, MDNS_TYPE_TXT, MDNS_CLASS_IN_FLUSH_CACHE, MDNS_ANSWER_TXT_TTL);
+    bench_packet_put_data(p, "\x06path=/", 7);
+    bench_packet_end_record(p, rdata);
+
+    if (ip) {
+        rdata = bench_packet_begin_record(p, host_name, 2, MDNS_TYPE_A, MDNS_CLASS_IN_FLUSH_CACHE, MDNS_ANSWER_A_TTL);
+        bench_packet_put_data(p, &ip, 4);
+        bench_packet_end_record(p, rdata);
+    }
+}
+
+static uint32_t source_ip(uint32_t i)
+{
+    return BENCH_THROUGHPUT_NETWORK | ((10 + i % BENCH_THROUGHPUT_SOURCES) << 24);
+}
+
+static uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+/**
+ * @brief  Fires the timers due until the given time and leaves the clock there
+ */
+static void run_until(uint32_t ms)
+{
+    uint32_t expiry;
+    while (bench_timer_next(&expiry) && (int32_t)(expiry - ms) <= 0) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+    bench_clock_set(ms);
+}
+
+/**
+ * @brief  Parses the packet as received from the source on the first interface
+ */
+static void parse(const bench_packet_t *p, uint32_t src_ip)
+{
+    struct pbuf pb = { 0 };
+    mdns_rx_packet_t packet = { 0 };
+    pb.payload = (void *)p->data;
+    pb.len = pb.tot_len = p->len;
+    packet.pb = &pb;
+    packet.tcpip_if = 0;
+    packet.ip_protocol = MDNS_IP_PROTOCOL_V4;
+    packet.src.type = ESP_IPADDR_TYPE_V4;
+    packet.src.u_addr.ip4.addr = src_ip;
+    packet.src_port = MDNS_SERVICE_PORT;
+    packet.multicast = 1;
+    mdns_bench_parse_packet(&packet);
+}
+
+static void report_rates(const char *metric, uint32_t packets, uint32_t units, const char *unit, uint64_t elapsed,
+                         uint32_t allocs, uint32_t tx)
+{
+    char label[48];
+    bench_report("throughput", metric, packets, elapsed);
+    snprintf(label, sizeof(label), "%s_pps", metric);
+    bench_report_value("throughput", label, elapsed ? packets * 1e9 / elapsed : 0.0, "pps");
+    snprintf(label, sizeof(label), "%s_ns_per_%s", metric, unit);
+    bench_report_value("throughput", label, units ? (double)elapsed / units : 0.0, "ns/op");
+    snprintf(label, sizeof(label), "%s_heap_allocs", metric);
+    bench_report_value("throughput", label, (double)allocs / packets, "allocs/packet");
+    snprintf(label, sizeof(label), "%s_tx", metric);
+    bench_report_value("throughput", label, (double)tx / packets, "packets");
+}
+
+/**
+ * @brief  Parses the query from rotating sources and sends the responses, 150 ms apart so that every response is due
+ */
+static void run_queries(const char *metric, const bench_packet_t *query)
+{
+    uint32_t i;
+    uint32_t tx = bench_tx_count();
+    uint32_t allocs = bench_heap_allocs();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_THROUGHPUT_PACKETS; i++) {
+        parse(query, source_ip(i));
+        bench_clock_advance(150);
+        mdns_bench_dispatch_due();
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    report_rates(metric, BENCH_THROUGHPUT_PACKETS, BENCH_THROUGHPUT_PACKETS * query->questions, "question", elapsed,
+                 bench_heap_allocs() - allocs, bench_tx_count() - tx);
+    // the timers armed for the responses
+    run_until(now_ms() + 1000);
+}
+
+/**
+ * @brief  Parses the announcement of n services of a peer, the first one caches the records and the others refresh them
+ */
+static void run_announce(uint32_t n)
+{
+    static bench_packet_t announce;
+    char metric[32];
+    char instance[32], service[16];
+    uint32_t i;
+
+    bench_packet_begin(&announce, MDNS_FLAGS_QR_AUTHORITATIVE);
+    for (i = 0; i < n; i++) {
+        snprintf(instance, sizeof(instance), "peer-%02u", (unsigned)i);
+        snprintf(service, sizeof(service), "_peer%u", (unsigned)(i % 4));
+        put_instance(&announce, instance, service, "peer-host", i + 1 == n ? 0x0904A8C0 : 0);
+    }
+    bench_packet_end(&announce);
+    if (announce.len > sizeof(announce.data) - 512) {
+        abort();
+    }
+
+    snprintf(metric, sizeof(metric), "announce_%u", (unsigned)n);
+    uint32_t tx = bench_tx_count();
+    uint32_t allocs = bench_heap_allocs();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_THROUGHPUT_PACKETS; i++) {
+        parse(&announce, 0x0904A8C0);
+        bench_clock_advance(10);
+        mdns_bench_dispatch_due();
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    report_rates(metric, BENCH_THROUGHPUT_PACKETS, BENCH_THROUGHPUT_PACKETS * announce.records, "record", elapsed,
+                 bench_heap_allocs() - allocs, bench_tx_count() - tx);
+    run_until(now_ms() + 1000);
+}
+
+static void notifier(mdns_result_t *result)
+{
+    s_notifications++;
+}
+
+/**
+ * @brief  Browses 16 service types while peers answer for all of them, one packet per millisecond
+ */
+static void run_browse_storm(void)
+{
+    static bench_packet_t packets[BENCH_THROUGHPUT_PEERS];
+    char instance[32], service[16], host[32];
+    uint32_t i;
+
+    for (i = 0; i < BENCH_THROUGHPUT_BROWSES; i++) {
+        snprintf(service, sizeof(service), "_br%02u", (unsigned)i);
+        if (!mdns_browse_new(service, "_tcp", notifier)) {
+            abort();
+        }
+    }
+    bench_run_service_queue();
+    // the browse queries are sent
+    run_until(now_ms() + 5000);
+    for (i = 0; i < BENCH_THROUGHPUT_PEERS; i++) {
+        snprintf(instance, sizeof(instance), "peer-%03u", (unsigned)i);
+        snprintf(service, sizeof(service), "_br%02u", (unsigned)(i % BENCH_THROUGHPUT_BROWSES));
+        snprintf(host, sizeof(host), "peer-%03u", (unsigned)i);
+        bench_packet_begin(&packets[i], MDNS_FLAGS_QR_AUTHORITATIVE);
+        put_instance(&packets[i], instance, service, host, BENCH_THROUGHPUT_NETWORK | ((1 + i) << 24));
+        bench_packet_end(&packets[i]);
+    }
+
+    uint32_t notifications = s_notifications;
+    uint32_t tx = bench_tx_count();
+    uint32_t allocs = bench_heap_allocs();
+    uint32_t begin = now_ms();
+    uint64_t start = bench_now_ns();
+    for (i = 0; i < BENCH_THROUGHPUT_PACKETS; i++) {
+        run_until(begin + i);
+        parse(&packets[i % BENCH_THROUGHPUT_PEERS], BENCH_THROUGHPUT_NETWORK | ((1 + i % BENCH_THROUGHPUT_PEERS) << 24));
+    }
+    // the changes of the last window are notified
+    run_until(begin + BENCH_THROUGHPUT_PACKETS + 1000);
+    uint64_t elapsed = bench_now_ns() - start;
+    report_rates("browse_storm", BENCH_THROUGHPUT_PACKETS, BENCH_THROUGHPUT_PACKETS * packets[0].records, "record", elapsed,
+                 bench_heap_allocs() - allocs, bench_tx_count() - tx);
+    bench_report_value("throughput", "browse_storm_notifications", s_notifications - notifications, "results");
+
+    for (i = 0; i < BENCH_THROUGHPUT_BROWSES; i++) {
+        snprintf(service, sizeof(service), "_br%02u", (unsigned)i);
+        if (mdns_browse_delete(service, "_tcp")) {
+            abort();
+        }
+    }
+    bench_run_service_queue();
+}
+
+void bench_throughput(void)
+{
+    mdns_pcb_state_t states[MDNS_MAX_INTERFACES][MDNS_IP_PROTOCOL_MAX];
+    char instance[16], service[16];
+    bench_packet_t query;
+    uint32_t i, j;
+    mdns_txt_item_t txt[1] = {
+        { "path", "/" },
+    };
+
+    for (i = 0; i < BENCH_THROUGHPUT_SERVICES; i++) {
+        snprintf(instance, sizeof(instance), "node-%u", (unsigned)i);
+        snprintf(service, sizeof(service), "_svc%u", (unsigned)i);
+        if (mdns_service_add(instance, service, "_tcp", 8000 + i, txt, 1)) {
+            abort();
+        }
+    }
+    bench_run_service_queue();
+    // probing and announcing finish first
+    run_until(now_ms() + 5000);
+    // answer on one interface only
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            states[i][j] = _mdns_server->interfaces[i].pcbs[j].state;
+            _mdns_server->interfaces[i].pcbs[j].state = PCB_OFF;
+        }
+    }
+    _mdns_server->interfaces[0].pcbs[MDNS_IP_PROTOCOL_V4].state = PCB_RUNNING;
+
+    const char *ptr[] = { "_svc0", "_tcp", "local" };
+    bench_packet_query(&query, ptr, 3, MDNS_TYPE_PTR);
+    run_queries("ptr_flood", &query);
+
+    // the PTR questions of 4 of our service types and of 4 others, and our address
+    const char *host[] = { "bench-host", "local" };
+    bench_packet_begin(&query, 0);
+    for (i = 0; i < 8; i++) {
+        snprintf(service, sizeof(service), i < 4 ? "_svc%u" : "_other%u", (unsigned)i);
+        ptr[0] = service;
+        bench_packet_put_question(&query, ptr, 3, MDNS_TYPE_PTR);
+    }
+    bench_packet_put_question(&query, host, 2, MDNS_TYPE_A);
+    bench_packet_end(&query);
+    run_queries("multi_question", &query);
+
+    const char *discovery[] = { "_services", "_dns-sd", "_udp", "local" };
+    bench_packet_query(&query, discovery, 4, MDNS_TYPE_PTR);
+    run_queries("discovery", &query);
+
+    run_announce(1);
+    run_announce(8);
+    run_announce(32);
+
+    run_browse_storm();
+
+    mdns_service_remove_all();
+    bench_run_service_queue();
+    run_until(now_ms() + 5000);
+    for (i = 0; i < MDNS_MAX_INTERFACES; i++) {
+        for (j = 0; j < MDNS_IP_PROTOCOL_MAX; j++) {
+            _mdns_server->interfaces[i].pcbs[j].state = states[i][j];
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Timer benchmark -- drives the mdns timer on the virtual clock and counts
+ * wakeups of an idle responder, of a running search and the lateness
+ * of scheduled packets
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define BENCH_TIMER_PACKETS 100
+
+/**
+ * @brief  Advances the virtual clock from timer expiry to timer expiry until end_ms
+ *
+ * @return number of timer callbacks (wakeups)
+ */
+static uint32_t run_until(uint32_t end_ms, uint32_t *handled)
+{
+    uint32_t wakeups = 0;
+    uint32_t expiry;
+    bench_run_service_queue();
+    while (bench_timer_next(&expiry) && (int32_t)(expiry - end_ms) <= 0) {
+        bench_clock_set(expiry);
+        if (bench_timer_fire()) {
+            wakeups++;
+        }
+        uint32_t n = bench_run_service_queue();
+        if (handled) {
+            *handled += n;
+        }
+    }
+    bench_clock_set(end_ms);
+    return wakeups;
+}
+
+void bench_timer(void)
+{
+    uint32_t now = 10000;
+    uint32_t i, wakeups, handled;
+    uint64_t lateness = 0;
+
+    // catch up with the clock, so that only the measured interval counts
+    run_until(now, NULL);
+
+    wakeups = run_until(now + 60000, NULL);
+    now += 60000;
+    bench_report_value("timer", "idle_wakeups_per_min", wakeups, "wakeups");
+
+    mdns_search_once_t *search = mdns_query_async_new(NULL, "_http", "_tcp", MDNS_TYPE_PTR, 3000, 0, NULL);
+    if (!search) {
+        abort();
+    }
+    wakeups = run_until(now + 5000, NULL);
+    now += 5000;
+    bench_report_value("timer", "search_3s_wakeups", wakeups, "wakeups");
+    mdns_query_async_delete(search);
+
+    // schedule packets one at a time with odd delays and measure how late they are handled
+    for (i = 0; i < BENCH_TIMER_PACKETS; i++) {
+        uint32_t delay = 17 + (i * 37) % 450;
+        mdns_tx_packet_t *p = mdns_bench_alloc_packet(0, MDNS_IP_PROTOCOL_V4);
+        if (!p) {
+            abort();
+        }
+        mdns_bench_schedule_tx_packet(p, delay);
+        uint32_t expected = now + delay;
+        handled = 0;
+        while (!handled) {
+            uint32_t expiry;
+            if (!bench_timer_next(&expiry)) {
+                fprintf(stderr, "timer: packet scheduled but timer not armed\n");
+                abort();
+            }
+            run_until(expiry, &handled);
+            now = expiry;
+        }
+        lateness += now - expected;
+    }
+    bench_report_value("timer", "tx_lateness_avg", (double)lateness / BENCH_TIMER_PACKETS, "ms");
+}
@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * TX scheduler benchmark -- schedules packets with random delays on all PCBs,
+ * then measures per-PCB lookups, answer removal, draining through the action queue
+ * and clearing of the scheduled packets
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define BENCH_PCB_COUNT (MDNS_MAX_INTERFACES * MDNS_IP_PROTOCOL_MAX)
+
+static uint32_t schedule_packets(uint32_t count, uint64_t *elapsed)
+{
+    uint32_t i;
+    uint32_t scheduled = 0;
+    *elapsed = 0;
+    for (i = 0; i < count; i++) {
+        mdns_tx_packet_t *p = mdns_bench_alloc_packet((mdns_if_t)(i % MDNS_MAX_INTERFACES),
+                                                      (mdns_ip_protocol_t)((i / MDNS_MAX_INTERFACES) % MDNS_IP_PROTOCOL_MAX));
+        if (!p) {
+            abort();
+        }
+        p->distributed = i & 1;
+        p->suppressible = 1;
+        mdns_bench_alloc_answer(&p->answers, MDNS_TYPE_A, NULL);
+        uint32_t delay = (uint32_t)rand() % (count + 1);
+        uint64_t start = bench_now_ns();
+        mdns_bench_schedule_tx_packet(p, delay);
+        *elapsed += bench_now_ns() - start;
+        scheduled++;
+    }
+    return scheduled;
+}
+
+static void bench_tx_scheduler_run(uint32_t count)
+{
+    char name[32];
+    uint64_t start, elapsed;
+    uint32_t i, n;
+    mdns_if_t tcpip_if;
+    int ip_protocol;
+
+    snprintf(name, sizeof(name), "tx_scheduler_%u", count);
+    srand(count);
+    bench_clock_set(0);
+
+    n = schedule_packets(count, &elapsed);
+    bench_report(name, "schedule", n, elapsed);
+
+    start = bench_now_ns();
+    for (i = 0; i < count; i++) {
+        if (!mdns_bench_get_next_pcb_packet((mdns_if_t)(i % MDNS_MAX_INTERFACES), MDNS_IP_PROTOCOL_V4)) {
+            abort();
+        }
+    }
+    bench_report(name, "next_pcb_packet", count, bench_now_ns() - start);
+
+    start = bench_now_ns();
+    for (tcpip_if = 0; tcpip_if < MDNS_MAX_INTERFACES; tcpip_if++) {
+        for (ip_protocol = 0; ip_protocol < MDNS_IP_PROTOCOL_MAX; ip_protocol++) {
+            mdns_bench_remove_scheduled_answer(tcpip_if, (mdns_ip_protocol_t)ip_protocol, MDNS_TYPE_AAAA, NULL);
+        }
+    }
+    bench_report(name, "remove_answer", BENCH_PCB_COUNT, bench_now_ns() - start);
+
+    // drain everything through the timer -> action queue -> service task path
+    n = 0;
+    start = bench_now_ns();
+    for (i = 0; i <= count + 1 && n < count; i++) {
+        uint32_t handled;
+        bench_clock_advance(1);
+        do {
+            mdns_bench_scheduler_run();
+            handled = bench_run_service_queue();
+            n += handled;
+        } while (handled == MDNS_ACTION_QUEUE_LEN);
+    }
+    bench_report(name, "drain", n, bench_now_ns() - start);
+    if (n != count) {
+        fprintf(stderr, "%s: drained %u of %u packets\n", name, n, count);
+        abort();
+    }
+
+    n = schedule_packets(count, &elapsed);
+    start = bench_now_ns();
+    for (tcpip_if = 0; tcpip_if < MDNS_MAX_INTERFACES; tcpip_if++) {
+        for (ip_protocol = 0; ip_protocol < MDNS_IP_PROTOCOL_MAX; ip_protocol++) {
+            mdns_bench_clear_pcb_tx_queue_head(tcpip_if, (mdns_ip_protocol_t)ip_protocol);
+        }
+    }
+    bench_report(name, "clear_pcb", n, bench_now_ns() - start);
+}
+
+void bench_tx_scheduler(void)
+{
+    bench_tx_scheduler_run(100);
+    bench_tx_scheduler_run(1000);
+    bench_tx_scheduler_run(10000);
+}
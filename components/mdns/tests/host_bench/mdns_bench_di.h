@@ -0,0 +1,150 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * MDNS benchmark dependency injection -- preincluded to expose internal static functions to the benchmarks
+ *
+ */
+#pragma once
+#include "mdns.h"
+#include "mdns_private.h"
+
+// capture transmitted packets instead of dropping them in the mocked networking layer
+size_t bench_udp_write(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, const esp_ip_addr_t *ip, uint16_t port, uint8_t *data, size_t len);
+#undef _mdns_udp_pcb_write
+#define _mdns_udp_pcb_write(tcpip_if, ip_protocol, ip, port, data, len) bench_udp_write(tcpip_if, ip_protocol, ip, port, data, len)
+
+// the service lock is a real mutex, so that the contention benchmark can call the API from another thread
+void bench_service_lock(void);
+void bench_service_unlock(void);
+#undef MDNS_SERVICE_LOCK
+#undef MDNS_SERVICE_UNLOCK
+#define MDNS_SERVICE_LOCK()     bench_service_lock()
+#define MDNS_SERVICE_UNLOCK()   do { _mdns_snapshot_sync(); bench_service_unlock(); } while (0)
+
+static void _mdns_snapshot_sync(void);
+static void _mdns_execute_action(mdns_action_t *action);
+static void _mdns_scheduler_run(void);
+static mdns_tx_packet_t *_mdns_alloc_packet_default(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
+static bool _mdns_alloc_answer(mdns_out_answer_t **destination, uint16_t type, mdns_service_t *service,
+                               mdns_host_item_t *host, bool flush, bool bye);
+static void _mdns_schedule_tx_packet(mdns_tx_packet_t *packet, uint32_t ms_after);
+static mdns_tx_packet_t *_mdns_get_next_pcb_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol);
+static uint32_t _mdns_remove_scheduled_answer(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint16_t type,
+                                              mdns_srv_item_t *service, mdns_host_item_t *host, const mdns_parsed_packet_t *continuation);
+static void _mdns_clear_pcb_tx_queue_head(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, bool keep_host_batches);
+static void _mdns_clear_tx_queue_head(void);
+static mdns_tx_packet_t *_mdns_create_announce_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t *services[], size_t len, bool include_ip);
+static void _mdns_dispatch_tx_packet(mdns_tx_packet_t *p);
+static void _mdns_free_tx_packet(mdns_tx_packet_t *packet);
+static mdns_srv_item_t *_mdns_get_service_item(const char *service, const char *proto, const char *hostname);
+static mdns_srv_item_t *_mdns_get_service_item_instance(const char *instance, const char *service, const char *proto, const char *hostname);
+static void _mdns_tx_queue_remove(mdns_tx_packet_t *packet);
+static void _mdns_tx_handle_packet(mdns_tx_packet_t *p);
+void mdns_parse_packet(mdns_rx_packet_t *packet);
+extern mdns_server_t *_mdns_server;
+
+void mdns_bench_execute_action(mdns_action_t *action)
+{
+    // as the service task does
+    MDNS_SERVICE_LOCK();
+    _mdns_execute_action(action);
+    MDNS_SERVICE_UNLOCK();
+}
+
+void mdns_bench_scheduler_run(void)
+{
+    _mdns_scheduler_run();
+}
+
+mdns_tx_packet_t *mdns_bench_alloc_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    return _mdns_alloc_packet_default(tcpip_if, ip_protocol);
+}
+
+bool mdns_bench_alloc_answer(mdns_out_answer_t **destination, uint16_t type, mdns_service_t *service)
+{
+    return _mdns_alloc_answer(destination, type, service, NULL, false, false);
+}
+
+void mdns_bench_schedule_tx_packet(mdns_tx_packet_t *packet, uint32_t ms_after)
+{
+    _mdns_schedule_tx_packet(packet, ms_after);
+}
+
+mdns_tx_packet_t *mdns_bench_get_next_pcb_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    return _mdns_get_next_pcb_packet(tcpip_if, ip_protocol);
+}
+
+uint32_t mdns_bench_remove_scheduled_answer(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, uint16_t type, mdns_srv_item_t *service)
+{
+    // the responses scheduled by the benchmark have no querier, nor has this continuation
+    static const mdns_parsed_packet_t continuation = { 0 };
+    return _mdns_remove_scheduled_answer(tcpip_if, ip_protocol, type, service, NULL, &continuation);
+}
+
+void mdns_bench_clear_pcb_tx_queue_head(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol)
+{
+    _mdns_clear_pcb_tx_queue_head(tcpip_if, ip_protocol, false);
+}
+
+void mdns_bench_clear_tx_queue_head(void)
+{
+    _mdns_clear_tx_queue_head();
+}
+
+mdns_tx_packet_t *mdns_bench_create_announce_packet(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, mdns_srv_item_t *services[], size_t len, bool include_ip)
+{
+    return _mdns_create_announce_packet(tcpip_if, ip_protocol, services, len, include_ip);
+}
+
+void mdns_bench_dispatch_tx_packet(mdns_tx_packet_t *p)
+{
+    _mdns_dispatch_tx_packet(p);
+}
+
+void mdns_bench_free_tx_packet(mdns_tx_packet_t *p)
+{
+    _mdns_free_tx_packet(p);
+}
+
+mdns_srv_item_t *mdns_bench_get_service_item(const char *instance, const char *service, const char *proto)
+{
+    return _mdns_get_service_item_instance(instance, service, proto, NULL);
+}
+
+bool mdns_bench_service_exists_locked(const char *service_type, const char *proto, const char *hostname)
+{
+    // mdns_service_exists() before the lookups used the snapshot
+    MDNS_SERVICE_LOCK();
+    bool ret = _mdns_get_service_item(service_type, proto, hostname) != NULL;
+    MDNS_SERVICE_UNLOCK();
+    return ret;
+}
+
+void mdns_bench_parse_packet(mdns_rx_packet_t *packet)
+{
+    // as the RX action does, without the action and the RX queue
+    MDNS_SERVICE_LOCK();
+    mdns_parse_packet(packet);
+    MDNS_SERVICE_UNLOCK();
+}
+
+uint32_t mdns_bench_dispatch_due(void)
+{
+    // as the scheduler and the TX action do, without the action queue
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t n = 0;
+    MDNS_SERVICE_LOCK();
+    while (_mdns_server->tx.heap.len && (int32_t)(_mdns_server->tx.heap.entries[0].send_at - now) <= 0) {
+        mdns_tx_packet_t *p = _mdns_server->tx.heap.entries[0].packet;
+        _mdns_tx_queue_remove(p);
+        _mdns_tx_handle_packet(p);
+        n++;
+    }
+    MDNS_SERVICE_UNLOCK();
+    return n;
+}
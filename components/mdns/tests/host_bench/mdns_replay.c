@@ -0,0 +1,542 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Capture replay -- reads the mDNS traffic (UDP port 5353) of a pcap file and passes it to
+ * _mdns_send_rx_action() as the networking layer does, on the virtual clock of the benchmark
+ * mocks which drives _mdns_timer_cb(). The packets sent in response can be written to another
+ * pcap file. CPU time and heap usage are reported per phase of the capture.
+ *
+ *     mdns_replay [options] capture.pcap
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "bench.h"
+
+#define REPLAY_SNAPLEN      65535
+#define REPLAY_DRAIN_MS     5000
+
+// link types of the pcap format
+#define LINKTYPE_NULL       0
+#define LINKTYPE_ETHERNET   1
+#define LINKTYPE_RAW        101
+#define LINKTYPE_LINUX_SLL  113
+#define LINKTYPE_LINUX_SLL2 276
+
+extern mdns_server_t *_mdns_server;
+
+typedef struct {
+    FILE *file;
+    bool swapped;
+    bool nanoseconds;
+    uint32_t linktype;
+} pcap_reader_t;
+
+typedef struct {
+    uint64_t ts_us;
+    uint32_t len;
+    uint8_t data[REPLAY_SNAPLEN];
+} pcap_record_t;
+
+typedef struct {
+    const char *name;
+    uint32_t rx;
+    uint32_t rx_bytes;
+    uint32_t tx;
+    uint32_t allocs;
+    uint64_t cpu_ns;
+    uint32_t rx_dropped;
+} replay_phase_t;
+
+static struct {
+    double speed;
+    uint32_t max_gap_ms;
+    uint32_t phase_ms;
+    FILE *tx_file;
+    uint32_t skipped;
+} s_replay = {
+    .speed = 1.0,
+    .phase_ms = 10000,
+};
+
+static replay_phase_t s_phase;
+
+static uint64_t cpu_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t now_ms(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+/**
+ * @brief  Fires the timers due until the given time and leaves the clock there
+ */
+static void run_until(uint32_t ms)
+{
+    uint32_t expiry;
+    while (bench_timer_next(&expiry) && (int32_t)(expiry - ms) <= 0) {
+        bench_clock_set(expiry);
+        bench_timer_fire();
+        bench_run_service_queue();
+    }
+    bench_clock_set(ms);
+}
+
+static void phase_begin(const char *name)
+{
+    memset(&s_phase, 0, sizeof(s_phase));
+    s_phase.name = name;
+    s_phase.tx = bench_tx_count();
+    s_phase.allocs = bench_heap_allocs();
+    s_phase.rx_dropped = _mdns_server ? _mdns_server->stats.rx_dropped : 0;
+    bench_heap_peak_reset();
+    s_phase.cpu_ns = cpu_now_ns();
+}
+
+static void phase_end(void)
+{
+    char label[64];
+    uint64_t cpu_ns = cpu_now_ns() - s_phase.cpu_ns;
+
+#define REPORT(metric, value, unit)                                     \
+    snprintf(label, sizeof(label), "%s_" metric, s_phase.name);         \
+    bench_report_value("replay", label, value, unit)
+
+    REPORT("rx", s_phase.rx, "packets");
+    REPORT("rx_bytes", s_phase.rx_bytes, "bytes");
+    REPORT("rx_dropped", _mdns_server->stats.rx_dropped - s_phase.rx_dropped, "packets");
+    REPORT("tx", bench_tx_count() - s_phase.tx, "packets");
+    REPORT("cpu", cpu_ns, "ns");
+    REPORT("cpu_per_packet", s_phase.rx ? (double)cpu_ns / s_phase.rx : 0.0, "ns/op");
+    REPORT("heap_allocs", bench_heap_allocs() - s_phase.allocs, "allocs");
+    REPORT("heap_peak", bench_heap_peak(), "bytes");
+    REPORT("heap_in_use", bench_heap_in_use(), "bytes");
+#undef REPORT
+}
+
+/// pcap files
+
+static uint32_t pcap_u32(const pcap_reader_t *r, const uint8_t *p)
+{
+    if (r->swapped) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static uint16_t read_u16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static bool pcap_open(pcap_reader_t *r, const char *path)
+{
+    uint8_t header[24];
+    r->file = fopen(path, "rb");
+    if (!r->file || fread(header, 1, sizeof(header), r->file) != sizeof(header)) {
+        return false;
+    }
+    // the magic is written in the byte order of the capturing machine
+    uint32_t magic = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+    r->swapped = (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1);
+    magic = pcap_u32(r, header);
+    if (magic != 0xa1b2c3d4 && magic != 0xa1b23c4d) {
+        fprintf(stderr, "not a pcap file (pcapng is not supported): %s\n", path);
+        return false;
+    }
+    r->nanoseconds = (magic == 0xa1b23c4d);
+    r->linktype = pcap_u32(r, header + 20) & 0xFFFF;
+    return true;
+}
+
+static bool pcap_next(pcap_reader_t *r, pcap_record_t *record)
+{
+    uint8_t header[16];
+    if (fread(header, 1, sizeof(header), r->file) != sizeof(header)) {
+        return false;
+    }
+    uint32_t captured = pcap_u32(r, header + 8);
+    uint32_t frac = pcap_u32(r, header + 4);
+    record->ts_us = (uint64_t)pcap_u32(r, header) * 1000000 + (r->nanoseconds ? frac / 1000 : frac);
+    record->len = captured < sizeof(record->data) ? captured : sizeof(record->data);
+    if (fread(record->data, 1, record->len, r->file) != record->len) {
+        return false;
+    }
+    return captured == record->len || fseek(r->file, captured - record->len, SEEK_CUR) == 0;
+}
+
+static void pcap_write_header(FILE *f)
+{
+    struct {
+        uint32_t magic;
+        uint16_t version_major;
+        uint16_t version_minor;
+        int32_t thiszone;
+        uint32_t sigfigs;
+        uint32_t snaplen;
+        uint32_t linktype;
+    } header = { 0xa1b2c3d4, 2, 4, 0, 0, REPLAY_SNAPLEN, LINKTYPE_RAW };
+    fwrite(&header, sizeof(header), 1, f);
+}
+
+/**
+ * @brief  Checks the address family of a LINKTYPE_NULL frame, written in the byte order of the capturing machine
+ */
+static bool null_family_is_ip(const uint8_t *data)
+{
+    uint32_t family = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    if (family > 0xFFFF) {
+        family = __builtin_bswap32(family);
+    }
+    // AF_INET, AF_INET6 of Linux, OpenBSD/NetBSD, FreeBSD and Darwin
+    return family == 2 || family == 10 || family == 24 || family == 28 || family == 30;
+}
+
+/**
+ * @brief  Returns the offset of the IP header in the frame, or -1 if the frame does not carry IP
+ */
+static int ip_offset(uint32_t linktype, const uint8_t *data, uint32_t len)
+{
+    uint32_t offset;
+    uint16_t ethertype;
+    switch (linktype) {
+    case LINKTYPE_NULL:
+        return len > 4 && null_family_is_ip(data) ? 4 : -1;
+    case LINKTYPE_RAW:
+        return 0;
+    case LINKTYPE_ETHERNET:
+        if (len < 14) {
+            return -1;
+        }
+        offset = 14;
+        ethertype = read_u16(data + 12);
+        while (ethertype == 0x8100 && len >= offset + 4) {
+            ethertype = read_u16(data + offset + 2);
+            offset += 4;
+        }
+        break;
+    case LINKTYPE_LINUX_SLL:
+        if (len < 16) {
+            return -1;
+        }
+        offset = 16;
+        ethertype = read_u16(data + 14);
+        break;
+    case LINKTYPE_LINUX_SLL2:
+        if (len < 20) {
+            return -1;
+        }
+        offset = 20;
+        ethertype = read_u16(data);
+        break;
+    default:
+        return -1;
+    }
+    return (ethertype == 0x0800 || ethertype == 0x86DD) ? (int)offset : -1;
+}
+
+/// replay
+
+/**
+ * @brief  Passes the mDNS payload of the frame to the service task
+ *
+ * @return false if the frame is not a complete mDNS packet
+ */
+static bool replay_frame(uint32_t linktype, const uint8_t *data, uint32_t len)
+{
+    int offset = ip_offset(linktype, data, len);
+    if (offset < 0 || len <= (uint32_t)offset) {
+        return false;
+    }
+    const uint8_t *ip = data + offset;
+    uint32_t ip_len = len - offset;
+    const uint8_t *udp;
+    esp_ip_addr_t src = { 0 }, dest = { 0 };
+    mdns_ip_protocol_t ip_protocol;
+    bool multicast;
+
+    if ((ip[0] >> 4) == 4) {
+        uint32_t header_len = (ip[0] & 0x0F) * 4;
+        // fragments are not reassembled
+        if (header_len < 20 || ip_len < header_len + 8 || ip[9] != 17 || (read_u16(ip + 6) & 0x3FFF)) {
+            return false;
+        }
+        src.type = dest.type = ESP_IPADDR_TYPE_V4;
+        memcpy(&src.u_addr.ip4.addr, ip + 12, 4);
+        memcpy(&dest.u_addr.ip4.addr, ip + 16, 4);
+        multicast = ip[16] == 224 && ip[17] == 0 && ip[18] == 0 && ip[19] == 251;
+        ip_protocol = MDNS_IP_PROTOCOL_V4;
+        udp = ip + header_len;
+        ip_len -= header_len;
+    } else if ((ip[0] >> 4) == 6) {
+#ifdef CONFIG_LWIP_IPV6
+        static const uint8_t mdns_group[16] = { 0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xfb };
+        if (ip_len < 48 || ip[6] != 17) {
+            return false;
+        }
+        src.type = dest.type = ESP_IPADDR_TYPE_V6;
+        memcpy(src.u_addr.ip6.addr, ip + 8, 16);
+        memcpy(dest.u_addr.ip6.addr, ip + 24, 16);
+        multicast = memcmp(ip + 24, mdns_group, 16) == 0;
+        ip_protocol = MDNS_IP_PROTOCOL_V6;
+        udp = ip + 40;
+        ip_len -= 40;
+#else
+        return false;
+#endif
+    } else {
+        return false;
+    }
+
+    uint16_t src_port = read_u16(udp);
+    uint16_t udp_len = read_u16(udp + 4);
+    if ((src_port != MDNS_SERVICE_PORT && read_u16(udp + 2) != MDNS_SERVICE_PORT) || udp_len < 8 || udp_len > ip_len) {
+        return false;
+    }
+    size_t payload_len = udp_len - 8;
+
+    mdns_rx_packet_t *packet = calloc(1, sizeof(mdns_rx_packet_t));
+    struct pbuf *pb = calloc(1, sizeof(struct pbuf) + payload_len);
+    if (!packet || !pb) {
+        abort();
+    }
+    pb->payload = (uint8_t *)(pb + 1);
+    pb->len = pb->tot_len = payload_len;
+    memcpy(pb->payload, udp + 8, payload_len);
+    packet->pb = pb;
+    packet->tcpip_if = 0;
+    packet->ip_protocol = ip_protocol;
+    packet->src = src;
+    packet->dest = dest;
+    packet->src_port = src_port;
+    packet->multicast = multicast;
+    if (_mdns_send_rx_action(packet) != ESP_OK) {
+        free(pb);
+        free(packet);
+    }
+    bench_run_service_queue();
+    s_phase.rx++;
+    s_phase.rx_bytes += payload_len;
+    return true;
+}
+
+/**
+ * @brief  Writes a transmitted packet with IP and UDP headers to the TX capture
+ */
+static void record_tx(mdns_if_t tcpip_if, mdns_ip_protocol_t ip_protocol, const esp_ip_addr_t *ip, uint16_t port,
+                      const uint8_t *data, size_t len)
+{
+    uint8_t headers[48] = { 0 };
+    size_t header_len;
+    uint16_t udp_len = len + 8;
+    // the mocked interface has no address, the source is left unspecified
+    if (ip_protocol == MDNS_IP_PROTOCOL_V4) {
+        header_len = 28;
+        headers[0] = 0x45;
+        headers[2] = (header_len + len) >> 8;
+        headers[3] = (header_len + len) & 0xFF;
+        headers[8] = 255;
+        headers[9] = 17;
+        memcpy(headers + 16, &ip->u_addr.ip4.addr, 4);
+    } else {
+        header_len = 48;
+        headers[0] = 0x60;
+        headers[4] = udp_len >> 8;
+        headers[5] = udp_len & 0xFF;
+        headers[6] = 17;
+        headers[7] = 255;
+        memcpy(headers + 24, ip->u_addr.ip6.addr, 16);
+    }
+    uint8_t *udp = headers + header_len - 8;
+    udp[0] = MDNS_SERVICE_PORT >> 8;
+    udp[1] = MDNS_SERVICE_PORT & 0xFF;
+    udp[2] = port >> 8;
+    udp[3] = port & 0xFF;
+    udp[4] = udp_len >> 8;
+    udp[5] = udp_len & 0xFF;
+
+    uint32_t now = now_ms();
+    uint32_t record[4] = { now / 1000, (now % 1000) * 1000, header_len + len, header_len + len };
+    fwrite(record, sizeof(record), 1, s_replay.tx_file);
+    fwrite(headers, header_len, 1, s_replay.tx_file);
+    fwrite(data, len, 1, s_replay.tx_file);
+}
+
+/**
+ * @brief  Adds a service given as "instance:_service._proto:port"
+ */
+static bool add_service(const char *spec)
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    char *instance = strtok(buf, ":");
+    char *type = strtok(NULL, ":");
+    char *port = strtok(NULL, ":");
+    char *proto = type ? strchr(type, '.') : NULL;
+    if (!instance || !proto || !port) {
+        return false;
+    }
+    *proto++ = '\0';
+    return mdns_service_add(instance, type, proto, atoi(port), NULL, 0) == ESP_OK;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options] capture.pcap\n"
+            "  --speed <factor>     replay <factor> times faster than captured (default 1)\n"
+            "  --max-gap <ms>       shorten pauses longer than <ms> of the capture (default: keep)\n"
+            "  --phase <ms>         length of a reported phase of the capture (default 10000)\n"
+            "  --hostname <name>    hostname of the responder (default replay-host)\n"
+            "  --service <spec>     service of the responder, \"instance:_service._proto:port\"\n"
+            "  --tx <file.pcap>     write the transmitted packets to a pcap file\n"
+            "  --json               print the results as JSON lines\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        { "speed", required_argument, NULL, 's' },
+        { "max-gap", required_argument, NULL, 'g' },
+        { "phase", required_argument, NULL, 'p' },
+        { "hostname", required_argument, NULL, 'h' },
+        { "service", required_argument, NULL, 'S' },
+        { "tx", required_argument, NULL, 't' },
+        { "json", no_argument, NULL, 'j' },
+        { NULL, 0, NULL, 0 },
+    };
+    static pcap_record_t record;
+    const char *services[32];
+    size_t services_len = 0;
+    const char *hostname = "replay-host";
+    pcap_reader_t reader = { 0 };
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case 's':
+            s_replay.speed = atof(optarg);
+            break;
+        case 'g':
+            s_replay.max_gap_ms = atoi(optarg);
+            break;
+        case 'p':
+            s_replay.phase_ms = atoi(optarg);
+            break;
+        case 'h':
+            hostname = optarg;
+            break;
+        case 'S':
+            if (services_len < sizeof(services) / sizeof(services[0])) {
+                services[services_len++] = optarg;
+            }
+            break;
+        case 't':
+            s_replay.tx_file = fopen(optarg, "wb");
+            if (!s_replay.tx_file) {
+                perror(optarg);
+                return 1;
+            }
+            pcap_write_header(s_replay.tx_file);
+            break;
+        case 'j':
+            bench_report_json(true);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1 || s_replay.speed <= 0 || !s_replay.phase_ms) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!pcap_open(&reader, argv[optind])) {
+        return 1;
+    }
+    if (s_replay.tx_file) {
+        bench_tx_set_hook(record_tx);
+    }
+
+    // the responder probes and announces before the capture starts
+    phase_begin("startup");
+    if (mdns_init() || mdns_hostname_set(hostname)) {
+        abort();
+    }
+    bench_run_service_queue();
+    for (size_t i = 0; i < services_len; i++) {
+        if (!add_service(services[i])) {
+            fprintf(stderr, "invalid service: %s\n", services[i]);
+            return 1;
+        }
+    }
+    bench_run_service_queue();
+    run_until(now_ms() + REPLAY_DRAIN_MS);
+    phase_end();
+
+    uint64_t first_us = 0, last_us = 0;
+    uint32_t begin = now_ms(), phase = 0;
+    double replay_us = 0;
+    char phase_name[32];
+    bool started = false;
+    while (pcap_next(&reader, &record)) {
+        if (!started) {
+            first_us = last_us = record.ts_us;
+            started = true;
+            snprintf(phase_name, sizeof(phase_name), "phase_%u", (unsigned)phase);
+            phase_begin(phase_name);
+        }
+        // phases follow the time of the capture
+        uint32_t captured_ms = (record.ts_us - first_us) / 1000;
+        if (captured_ms / s_replay.phase_ms != phase) {
+            phase_end();
+            phase = captured_ms / s_replay.phase_ms;
+            snprintf(phase_name, sizeof(phase_name), "phase_%u", (unsigned)phase);
+            phase_begin(phase_name);
+        }
+        // the virtual clock follows the capture, compressed by the speed and the longest gap
+        uint64_t gap_us = record.ts_us > last_us ? record.ts_us - last_us : 0;
+        if (s_replay.max_gap_ms && gap_us > s_replay.max_gap_ms * 1000ULL) {
+            gap_us = s_replay.max_gap_ms * 1000ULL;
+        }
+        last_us = record.ts_us;
+        replay_us += gap_us / s_replay.speed;
+        run_until(begin + (uint32_t)(replay_us / 1000));
+        if (!replay_frame(reader.linktype, record.data, record.len)) {
+            s_replay.skipped++;
+        }
+    }
+    if (started) {
+        phase_end();
+    }
+
+    // the responses still scheduled are sent
+    phase_begin("drain");
+    run_until(now_ms() + REPLAY_DRAIN_MS);
+    phase_end();
+
+    bench_report_value("replay", "skipped", s_replay.skipped, "frames");
+    bench_report_value("replay", "duration", replay_us / 1000, "ms");
+    mdns_stats_t stats;
+    if (mdns_get_stats(&stats) == ESP_OK) {
+        bench_report_value("replay", "parse_failures", stats.parse_failures, "packets");
+        bench_report_value("replay", "answers_built", stats.answers_built, "records");
+        bench_report_value("replay", "tx_queue_max", stats.tx_queue_max, "packets");
+        bench_report_value("replay", "parse_time", stats.parse_time_us, "us");
+        bench_report_value("replay", "dispatch_time", stats.dispatch_time_us, "us");
+    }
+    fclose(reader.file);
+    if (s_replay.tx_file) {
+        fclose(s_replay.tx_file);
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * SPDX-FileCopyrightText: 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+/*
+ * Benchmarks use the fuzzer test configuration with room for more services
+ */
+#pragma once
+#include "../test_afl_fuzz_host/sdkconfig.h"
+
+#undef CONFIG_MDNS_MAX_SERVICES
+#define CONFIG_MDNS_MAX_SERVICES 512
+
+// memory configuration for mdns_mem_caps.c
+#define CONFIG_MDNS_MEMORY_ALLOC_INTERNAL 1
+#define CONFIG_MDNS_MEMORY_POOLS 1
+#define CONFIG_MDNS_POOL_ACTIONS 16
+#define CONFIG_MDNS_POOL_TX_PACKETS 16
+#define CONFIG_MDNS_POOL_ANSWERS 48
+#define CONFIG_MDNS_POOL_QUESTIONS 8
+#define CONFIG_MDNS_PARSE_ARENA_SIZE 1024
@@ -4,12 +4,15 @@ import logging
 import re
 import socket
 import sys
+import time
 
 import dns.message
+import dns.name
 import dns.query
 import dns.rdataclass
 import dns.rdatatype
 import dns.resolver
+import dns.rrset
 
 # Configure logging
 logging.basicConfig(level=logging.INFO)
@@ -85,6 +88,48 @@ class DnsPythonWrapper:
                         answers.append(full_answer)
         return answers
 
+    def flood(self, name, query_type='PTR', duration=10):
+        """Sends the same query back to back for `duration` seconds, returns the number of packets sent and of responses received"""
+        query_data = dns.message.make_query(name, dns.rdatatype.from_text(query_type), dns.rdataclass.IN).to_wire()
+        sent = 0
+        received = 0
+        with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+            sock.setblocking(False)
+            end = time.monotonic() + duration
+            while time.monotonic() < end:
+                for _ in range(100):
+                    sock.sendto(query_data, (self.server, self.port))
+                sent += 100
+                received += self._drain(sock)
+            # the responses still on their way
+            time.sleep(0.5)
+            received += self._drain(sock)
+        logger.info(f'Flooded {self.server}:{self.port} with {sent} queries ({sent / duration:.0f} packets/sec), '
+                    f'{received} responses ({received / duration:.1f} packets/sec)')
+        return sent, received
+
+    def probe(self, name, address, count=3, interval=0.15):
+        """Probes for the name with an A record of the address in the authority section, like another host claiming it"""
+        query = dns.message.make_query(name, dns.rdatatype.ANY, dns.rdataclass.IN)
+        query.flags = 0
+        query.authority.append(dns.rrset.from_text(dns.name.from_text(name), 120, dns.rdataclass.IN, dns.rdatatype.A, address))
+        query_data = query.to_wire()
+        with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+            for _ in range(count):
+                sock.sendto(query_data, (self.server, self.port))
+                time.sleep(interval)
+        logger.info(f'Probed {self.server}:{self.port} for {name} with {address}')
+
+    @staticmethod
+    def _drain(sock):
+        received = 0
+        while True:
+            try:
+                sock.recvfrom(1500)
+            except BlockingIOError:
+                return received
+            received += 1
+
     def check_record(self, name, query_type, expected=True, expect=None):
         output = self.run_query(name, query_type=query_type)
         answers = self.parse_answer_section(output, query_type)
@@ -99,11 +144,14 @@ class DnsPythonWrapper:
 
 if __name__ == '__main__':
     if len(sys.argv) < 3:
-        print('Usage: python dns_fixture.py <query_type> <name>')
+        print('Usage: python dns_fixture.py <query_type> <name> [--ip_only | --flood <seconds>]')
         sys.exit(1)
 
     query_type = sys.argv[1]
     name = sys.argv[2]
+    if len(sys.argv) > 4 and sys.argv[3] == '--flood':
+        DnsPythonWrapper().flood(name, query_type=query_type, duration=float(sys.argv[4]))
+        sys.exit(0)
     ip_only = len(sys.argv) > 3 and sys.argv[3] == '--ip_only'
     if ip_only:
         logger.setLevel(logging.WARNING)
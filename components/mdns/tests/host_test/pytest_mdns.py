@@ -1,6 +1,8 @@
 # SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
 # SPDX-License-Identifier: Unlicense OR CC0-1.0
 import logging
+import re
+import time
 
 import pexpect
 import pytest
@@ -82,6 +84,16 @@ def test_undelegate_host(mdns_console, dig_app):
     dig_app.check_record('delegated.local', query_type='A', expected=False)
 
 
+def test_delegate_host_conflict(mdns_console, dig_app):
+    # another host probing for the name with a higher address wins, the name is given up (RFC 6762, section 9)
+    mdns_console.send_input('mdns_delegate_host conflicting 1.2.3.4')
+    time.sleep(0.1)
+    dig_app.probe('conflicting.local', '254.0.0.1')
+    time.sleep(1)
+    dig_app.check_record('conflicting.local', query_type='A', expected=False)
+    mdns_console.send_input('mdns_undelegate_host conflicting')
+
+
 def test_add_delegated_service(mdns_console, dig_app):
     mdns_console.send_input('mdns_delegate_host delegated 1.2.3.4')
     dig_app.check_record('delegated.local', query_type='A', expected=True)
@@ -176,5 +188,50 @@ def test_service_remove_all(mdns_console, dig_app):
     dig_app.check_record('_test._tcp.local', query_type='PTR', expected=False)
 
 
+def test_query_flood(mdns_console, dig_app):
+    # queries over CONFIG_MDNS_QUERY_BUDGET (20 per second, as a burst at most) are dropped
+    duration = 3
+    sent, received = dig_app.flood('hostname.local', query_type='A', duration=duration)
+    assert sent > 20 * (duration + 1)
+    assert 0 < received <= 20 * (duration + 1)
+    # the budget is refilled once the flood is over
+    time.sleep(1)
+    dig_app.check_record('hostname.local', query_type='A', expected=True)
+
+
+def test_mdns_stats(mdns_console, dig_app):
+    # queries dropped by a flood are counted until reset
+    mdns_console.send_input('mdns_stats -r')
+    mdns_console.get_output('Queries throttled:')
+    duration = 2
+    sent, _ = dig_app.flood('hostname.local', query_type='A', duration=duration)
+    assert sent > 20 * (duration + 1)
+    mdns_console.send_input('mdns_stats -r')
+    mdns_console.get_output(r'Queries throttled: [1-9]')
+    mdns_console.send_input('mdns_stats')
+    mdns_console.get_output('Queries throttled: 0')
+
+
+def test_flood_receive_rate(mdns_console, dig_app):
+    # packets/sec taken by the socket receive path under a flood, compare it between builds
+    stats = r'RX: \d+ packets[\s\S]*?Queries throttled: \d+[\s\S]*?RX dropped: \d+'
+    mdns_console.send_input('mdns_stats -r')
+    mdns_console.get_output(stats)
+    duration = 5
+    sent, _ = dig_app.flood('_http._tcp.local', query_type='PTR', duration=duration)
+    mdns_console.send_input('mdns_stats')
+    mdns_console.get_output(stats)
+    output = mdns_console.process.match.group(0)
+    parsed = sum(int(rx) for rx in re.findall(r'RX: (\d+) packets', output))
+    throttled = int(re.search(r'Queries throttled: (\d+)', output).group(1))
+    dropped = int(re.search(r'RX dropped: (\d+)', output).group(1))
+    received = parsed + throttled + dropped
+    logger.info(f'Receive path: {received / duration:.0f} packets/sec of {sent / duration:.0f} sent '
+                f'({parsed} parsed, {throttled} throttled, {dropped} dropped)')
+    # the flood got past the budget of its source, it was received rather than lost before the socket
+    assert received > 20 * (duration + 1)
+    assert throttled > 0
+
+
 if __name__ == '__main__':
     pytest.main(['-s', 'test_mdns.py'])
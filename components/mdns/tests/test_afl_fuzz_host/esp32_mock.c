@@ -10,6 +10,7 @@
 #include <unistd.h>
 #include "esp32_mock.h"
 #include "esp_log.h"
+#include "mdns_mem_caps.h"
 
 void     *g_queue;
 int       g_queue_send_shall_fail = 0;
@@ -46,6 +47,16 @@ esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
     return ESP_OK;
 }
 
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return 0;
+}
+
 esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args,
                            esp_timer_handle_t *out_handle)
 {
@@ -141,9 +152,18 @@ void mdns_mem_free(void *ptr)
     free(ptr);
 }
 
+void *mdns_mem_pool_alloc(mdns_mem_pool_id_t pool, size_t size)
+{
+    return malloc(size);
+}
+
+void mdns_mem_pool_deinit(void)
+{
+}
+
 char *mdns_mem_strdup(const char *s)
 {
-    return strdup(s);
+    return s ? strdup(s) : NULL;
 }
 
 char *mdns_mem_strndup(const char *s, size_t n)
@@ -160,3 +180,29 @@ void mdns_mem_task_free(void *ptr)
 {
     free(ptr);
 }
+
+void *mdns_mem_parse_malloc(mdns_mem_arena_t *arena, size_t size)
+{
+    // two pointers keep the returned memory aligned as malloc's
+    void **chunk = malloc(2 * sizeof(void *) + size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk[0] = arena->chunks;
+    arena->chunks = chunk;
+    return chunk + 2;
+}
+
+void mdns_mem_parse_free_all(mdns_mem_arena_t *arena)
+{
+    while (arena->chunks) {
+        void **chunk = arena->chunks;
+        arena->chunks = chunk[0];
+        free(chunk);
+    }
+}
+
+void mdns_mem_parse_arena_free(mdns_mem_arena_t *arena)
+{
+    mdns_mem_parse_free_all(arena);
+}
@@ -64,6 +64,10 @@
 #define xSemaphoreCreateMutex()     malloc(1)
 #define xSemaphoreCreateBinary()    malloc(1)
 #define vSemaphoreDelete(s)         free(s)
+#define portMUX_TYPE                int
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux)     (void)(mux)
+#define portEXIT_CRITICAL(mux)      (void)(mux)
 #define queueQUEUE_TYPE_MUTEX       ( ( uint8_t ) 1U
 #define xTaskCreatePinnedToCore(a,b,c,d,e,f,g)     *(f) = malloc(1)
 #define xTaskCreateStaticPinnedToCore(a,b,c,d,e,f,g,h)     true
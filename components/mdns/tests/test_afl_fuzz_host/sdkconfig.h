@@ -292,11 +292,16 @@
 #define CONFIG_MDNS_MAX_INTERFACES 3
 #define CONFIG_MDNS_TASK_PRIORITY 1
 #define CONFIG_MDNS_ACTION_QUEUE_LEN 16
+#define CONFIG_MDNS_RX_QUEUE_LEN 16
+#define CONFIG_MDNS_QUERY_BUDGET 20
+#define CONFIG_MDNS_BROWSE_NOTIFY_WINDOW_MS 50
+#define CONFIG_MDNS_BROWSE_MAX_CHANGES 64
 #define CONFIG_MDNS_TASK_STACK_SIZE 4096
 #define CONFIG_MDNS_TASK_AFFINITY_CPU0 1
 #define CONFIG_MDNS_TASK_AFFINITY 0x0
 #define CONFIG_MDNS_SERVICE_ADD_TIMEOUT_MS 1
 #define CONFIG_MDNS_TIMER_PERIOD_MS 100
+#define CONFIG_MDNS_RECORD_CACHE_SIZE 32
 #define CONFIG_MQTT_PROTOCOL_311 1
 #define CONFIG_MQTT_TRANSPORT_SSL 1
 #define CONFIG_MQTT_TRANSPORT_WEBSOCKET 1
@@ -4,7 +4,10 @@
  * SPDX-License-Identifier: Unlicense OR CC0-1.0
  */
 
+#include <stdio.h>
 #include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "mdns.h"
 #include "esp_event.h"
 #include "unity.h"
@@ -79,7 +82,7 @@ TEST(mdns, api_fails_with_expected_err)
     TEST_ASSERT_EQUAL(ESP_OK, mdns_init());
     TEST_ASSERT_EQUAL(ESP_OK, mdns_hostname_set(MDNS_HOSTNAME));
     TEST_ASSERT_EQUAL(ESP_OK, mdns_delegate_hostname_add(MDNS_DELEGATE_HOSTNAME, &addr));
-    yield_to_all_priorities();  // Make sure that mdns task has executed to add the hostname
+    // published before the call returns
     TEST_ASSERT_TRUE(mdns_hostname_exists(MDNS_DELEGATE_HOSTNAME));
     TEST_ASSERT_EQUAL(ESP_OK, mdns_instance_name_set(MDNS_INSTANCE));
     TEST_ASSERT_EQUAL(ESP_OK, mdns_service_add(MDNS_INSTANCE, MDNS_SERVICE_NAME, MDNS_SERVICE_PROTO, MDNS_SERVICE_PORT, serviceTxtData, CONFIG_MDNS_MAX_SERVICES));
@@ -282,6 +285,106 @@ TEST(mdns, add_remove_deleg_service)
     mdns_free();
     esp_event_loop_delete_default();
 }
+
+TEST(mdns, many_services)
+{
+    char instance[32];
+    char service[16];
+    mdns_result_t *results = NULL;
+    test_case_uses_tcpip();
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_create_default());
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_init());
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_hostname_set(MDNS_HOSTNAME));
+
+    // two instances of each service type, until the limit is reached
+    for (int i = 0; i < CONFIG_MDNS_MAX_SERVICES; ++i) {
+        snprintf(instance, sizeof(instance), MDNS_INSTANCE "-%d", i);
+        snprintf(service, sizeof(service), "_svc%d", i / 2);
+        TEST_ASSERT_EQUAL(ESP_OK, mdns_service_add(instance, service, MDNS_SERVICE_PROTO, MDNS_SERVICE_PORT, NULL, 0));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, mdns_service_add(MDNS_INSTANCE, MDNS_SERVICE_NAME, MDNS_SERVICE_PROTO, MDNS_SERVICE_PORT, NULL, 0));
+    TEST_ASSERT_TRUE(mdns_service_exists_with_instance(MDNS_INSTANCE "-0", "_SVC0", MDNS_SERVICE_PROTO, NULL));
+    TEST_ASSERT_FALSE(mdns_service_exists_with_instance(MDNS_INSTANCE "-2", "_svc0", MDNS_SERVICE_PROTO, NULL));
+
+    // the renamed instance is found by its new name only
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_service_instance_name_set_for_host(MDNS_INSTANCE "-0", "_svc0", MDNS_SERVICE_PROTO, NULL, MDNS_INSTANCE "-renamed"));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, mdns_service_port_set_for_host(MDNS_INSTANCE "-0", "_svc0", MDNS_SERVICE_PROTO, NULL, MDNS_SERVICE_PORT + 1));
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_service_port_set_for_host(MDNS_INSTANCE "-renamed", "_svc0", MDNS_SERVICE_PROTO, NULL, MDNS_SERVICE_PORT + 1));
+    yield_to_all_priorities();  // Make sure that mdns task has executed to update the service
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_lookup_selfhosted_service(MDNS_INSTANCE "-renamed", "_svc0", MDNS_SERVICE_PROTO, 1, &results));
+    TEST_ASSERT_NOT_EQUAL(NULL, results);
+    TEST_ASSERT_EQUAL(MDNS_SERVICE_PORT + 1, results->port);
+    mdns_query_results_free(results);
+
+    // removing one instance keeps the other one of the same type
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_service_remove_for_host(MDNS_INSTANCE "-renamed", "_svc0", MDNS_SERVICE_PROTO, NULL));
+    TEST_ASSERT_TRUE(mdns_service_exists("_svc0", MDNS_SERVICE_PROTO, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_service_add(MDNS_INSTANCE, MDNS_SERVICE_NAME, MDNS_SERVICE_PROTO, MDNS_SERVICE_PORT, NULL, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_service_remove_all());
+    TEST_ASSERT_FALSE(mdns_service_exists("_svc0", MDNS_SERVICE_PROTO, NULL));
+
+    mdns_free();
+    esp_event_loop_delete_default();
+}
+static SemaphoreHandle_t s_browse_done;
+static mdns_browse_t *s_browse_notified;
+static size_t s_browse_added;
+static bool s_browse_found;
+
+static void browse_batch_notifier(mdns_browse_t *browse, const mdns_browse_changes_t *changes)
+{
+    s_browse_notified = browse;
+    s_browse_added += changes->added_count;
+    for (size_t i = 0; i < changes->added_count; ++i) {
+        const mdns_result_t *r = changes->added[i];
+        if (r->instance_name && strcmp(r->instance_name, MDNS_INSTANCE) == 0 && strcmp(r->service_type, MDNS_SERVICE_NAME) == 0
+                && strcmp(r->proto, MDNS_SERVICE_PROTO) == 0) {
+            s_browse_found = true;
+        }
+    }
+}
+
+static void browse_other_batch_notifier(mdns_browse_t *browse, const mdns_browse_changes_t *changes)
+{
+}
+
+static void browse_notifier(mdns_result_t *result)
+{
+    // called after the batch notifier of the same browse
+    xSemaphoreGive(s_browse_done);
+}
+
+TEST(mdns, browse_duplicate)
+{
+    test_case_uses_tcpip();
+    s_browse_done = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_EQUAL(NULL, s_browse_done);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_create_default());
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_init());
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_hostname_set(MDNS_HOSTNAME));
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_service_add(MDNS_INSTANCE, MDNS_SERVICE_NAME, MDNS_SERVICE_PROTO, MDNS_SERVICE_PORT, NULL, 0));
+
+    mdns_browse_t *browse = mdns_browse_new_batched(MDNS_SERVICE_NAME, MDNS_SERVICE_PROTO, browse_batch_notifier);
+    TEST_ASSERT_NOT_EQUAL(NULL, browse);
+    // a duplicate browse returns the running one, the per-result notifier is added to it
+    TEST_ASSERT_EQUAL_PTR(browse, mdns_browse_new_batched(MDNS_SERVICE_NAME, MDNS_SERVICE_PROTO, browse_batch_notifier));
+    TEST_ASSERT_EQUAL_PTR(browse, mdns_browse_new(MDNS_SERVICE_NAME, MDNS_SERVICE_PROTO, browse_notifier));
+    // but another batch notifier is refused
+    TEST_ASSERT_EQUAL(NULL, mdns_browse_new_batched(MDNS_SERVICE_NAME, MDNS_SERVICE_PROTO, browse_other_batch_notifier));
+
+    // the own service answers the browse query
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(s_browse_done, pdMS_TO_TICKS(3000)));
+    TEST_ASSERT_EQUAL_PTR(browse, s_browse_notified);
+    TEST_ASSERT_TRUE(s_browse_found);
+    TEST_ASSERT_NOT_EQUAL(0, s_browse_added);
+
+    TEST_ASSERT_EQUAL(ESP_OK, mdns_browse_delete(MDNS_SERVICE_NAME, MDNS_SERVICE_PROTO));
+    yield_to_all_priorities();  // Make sure that mdns task has executed to free the browse
+    mdns_free();
+    esp_event_loop_delete_default();
+    vSemaphoreDelete(s_browse_done);
+}
+
 TEST_GROUP_RUNNER(mdns)
 {
     RUN_TEST_CASE(mdns, api_fails_with_invalid_state)
@@ -290,6 +393,8 @@ TEST_GROUP_RUNNER(mdns)
     RUN_TEST_CASE(mdns, init_deinit)
     RUN_TEST_CASE(mdns, add_remove_service)
     RUN_TEST_CASE(mdns, add_remove_deleg_service)
+    RUN_TEST_CASE(mdns, many_services)
+    RUN_TEST_CASE(mdns, browse_duplicate)
 
 }
 
@@ -17,8 +17,26 @@ const sensorHistory = Array(8).fill().map(() => []);
 const sensorTimestamp = [];
 const maxHistory = 100;
 
+// Round trip of the last request and the power mode the device answered it in, sent with the next
+// request so the device can compare its power modes as seen from here
+let lastRtt = null;
+
+function timedFetch(url, options = {}) {
+    const headers = new Headers(options.headers || {});
+    if (lastRtt) {
+        headers.set('X-Power-RTT', lastRtt);
+        lastRtt = null;
+    }
+    const start = performance.now();
+    return fetch(url, { ...options, headers }).then(response => {
+        const mode = response.headers.get('X-Power-Mode');
+        if (mode) lastRtt = `${mode} ${Math.round((performance.now() - start) * 1000)}`;
+        return response;
+    });
+}
+
 function pollStatus() {
-    fetch('/status')
+    timedFetch('/status')
         .then(response => response.json())
         .then(data => {
             // Save button states
@@ -30,7 +48,7 @@ function pollStatus() {
 }
 
 function pollSensors() {
-    fetch('/sensor')
+    timedFetch('/sensor')
         .then(response => response.json())
         .then(data => {
             // Save sensor data to history with sensorTimestamps
@@ -69,7 +87,7 @@ function updateStatusUI(data) {
 }
 
 function setCmd() {
-    fetch('/set_cmd', {
+    timedFetch('/set_cmd', {
         method: 'POST',
         body: `door=${doorState}&fan=${fanLevel}&light=${lightLevel}`,
         headers: { 'Content-Type': 'application/x-www-form-urlencoded' }
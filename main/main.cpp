@@ -4,7 +4,11 @@
  * includes
  * defines
  * typedefs
+ * Latency Histograms
+ * Boot Profiler
+ * Config Store
  * mDNS
+ * WiFi Power Policy
  * WiFi Station
  * SPIFFS File Server
  * http server
@@ -13,6 +17,7 @@
  */
 
 // --- Required includes for RTOS and synchronization ---
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
@@ -21,8 +26,10 @@
 #include "driver/i2c_slave.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
+#include "esp_check.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_random.h"
 #include "nvs_flash.h"
 #include "sdkconfig.h"
 #include "esp_http_server.h"
@@ -50,11 +57,15 @@ This is necessary to prevent the I2C slave from blocking the master when it is n
 #define CMD_WIFI_PASS 0x32
 #define CMD_WIFI_START 0x33
 
-#define CMD_SENSOR_READ 0x40
-#define CMD_SENSOR_SETUP 0x41
+#define CMD_SENSOR_READ 0x40  // [cmd][channel][float32 value, little-endian]
+#define CMD_SENSOR_SETUP 0x41 // [cmd][channel][unit][name...], an empty name stops advertising the channel
 
 #define CMD_SEND_DATA 0x50
 
+#define SENSOR_CHANNELS 8
+
+#define HTTP_SERVER_PORT 80
+
 enum units
 {
     UNIT_CELSIUS,
@@ -65,6 +76,34 @@ enum units
     UNIT_NONE
 };
 
+// Timestamps (esp_timer_get_time, us) of the latest sample of one sensor channel
+typedef struct
+{
+    int64_t isr;     // arrival in i2c_slave_receive_cb
+    int64_t dequeue; // taken off cmd_queue by i2c_slave_task
+    int64_t commit;  // stored in sensor_data
+    bool pending;    // not yet served to any client
+} sensor_stamp_t;
+
+// Timestamps of the latest /set_cmd value on its way to the I2C master
+typedef struct
+{
+    int64_t http_rx; // /set_cmd handler entered
+    int64_t commit;  // stored in response_data
+    bool pending;    // not yet read by the master
+} cmd_stamp_t;
+
+// Last good association, used for a targeted reconnect without a full channel scan
+typedef struct
+{
+    uint32_t ip; // DHCP lease, network byte order
+    uint32_t netmask;
+    uint32_t gw;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t valid;
+} wifi_cache_t;
+
 typedef struct
 {
     i2c_slave_dev_handle_t slave_handle;
@@ -78,8 +117,12 @@ typedef struct
     SemaphoreHandle_t ret_cmd_mutex;
     SemaphoreHandle_t sensor_mutex;
     httpd_handle_t http_server;
-    float sensor_data[8];
-    char sensor_name[8][SENSOR_NAME_MAXLEN];
+    float sensor_data[SENSOR_CHANNELS];
+    char sensor_name[SENSOR_CHANNELS][SENSOR_NAME_MAXLEN];
+    uint8_t sensor_unit[SENSOR_CHANNELS];         // enum units, set with sensor_name
+    sensor_stamp_t sensor_stamp[SENSOR_CHANNELS]; // protected by sensor_mutex
+    cmd_stamp_t cmd_stamp;                        // protected by ret_cmd_mutex
+    wifi_cache_t wifi_cache;
 } i2c_slave_context_t;
 
 i2c_slave_context_t context = {
@@ -97,94 +140,1159 @@ i2c_slave_context_t context = {
     .sensor_data = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f},
 };
 
+// ===== Latency Histograms =====
+
+/*
+Log-linear histograms of end-to-end latency, in microseconds.
+Each power of two is split into LAT_SUB_BUCKETS linear buckets, so the relative error stays
+below 1/LAT_SUB_BUCKETS over the whole uint32 range while using a fixed, small amount of RAM.
+Samples are recorded from tasks and from the I2C ISR, hence the spinlock.
+*/
+
+#define LAT_SUB_BITS 2
+#define LAT_SUB_BUCKETS (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS ((32 - LAT_SUB_BITS + 1) * LAT_SUB_BUCKETS)
+
+typedef enum
+{
+    LAT_SENSOR_DEQUEUE,   // I2C ISR -> i2c_slave_task
+    LAT_SENSOR_COMMIT,    // I2C ISR -> sensor_data updated
+    LAT_SENSOR_SERIALIZE, // I2C ISR -> /sensor JSON built
+    LAT_SENSOR_SEND,      // I2C ISR -> /sensor response sent
+    LAT_CMD_COMMIT,       // /set_cmd received -> response_data updated
+    LAT_CMD_DELIVER,      // /set_cmd received -> read by I2C master
+    LAT_MAX
+} lat_stage_t;
+
+static const char *lat_stage_names[LAT_MAX] = {
+    "sensor_dequeue",
+    "sensor_commit",
+    "sensor_serialize",
+    "sensor_send",
+    "cmd_commit",
+    "cmd_deliver",
+};
+
+typedef struct
+{
+    uint32_t buckets[LAT_BUCKETS];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} lat_hist_t;
+
+static lat_hist_t lat_hist[LAT_MAX];
+static portMUX_TYPE lat_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t lat_bucket_index(uint32_t us)
+{
+    if (us < LAT_SUB_BUCKETS)
+        return us;
+    uint32_t shift = (31 - __builtin_clz(us)) - LAT_SUB_BITS;
+    return ((shift + 1) << LAT_SUB_BITS) | ((us >> shift) & (LAT_SUB_BUCKETS - 1));
+}
+
+static inline uint32_t lat_bucket_lower(uint32_t idx)
+{
+    if (idx < LAT_SUB_BUCKETS)
+        return idx;
+    uint32_t shift = (idx >> LAT_SUB_BITS) - 1;
+    return ((idx & (LAT_SUB_BUCKETS - 1)) | LAT_SUB_BUCKETS) << shift;
+}
+
+static inline uint32_t lat_bucket_upper(uint32_t idx)
+{
+    if (idx < LAT_SUB_BUCKETS)
+        return idx;
+    uint32_t shift = (idx >> LAT_SUB_BITS) - 1;
+    return lat_bucket_lower(idx) + ((1u << shift) - 1);
+}
+
+static inline void lat_hist_add(lat_hist_t *h, uint32_t us)
+{
+    h->buckets[lat_bucket_index(us)]++;
+    if (h->count == 0 || us < h->min)
+        h->min = us;
+    if (us > h->max)
+        h->max = us;
+    h->count++;
+    h->sum += us;
+}
+
+static inline uint32_t lat_elapsed(int64_t from, int64_t to)
+{
+    int64_t d = to - from;
+    if (d < 0)
+        return 0;
+    return d > UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+}
+
+// Record a latency sample from task context
+static void lat_record(lat_stage_t stage, int64_t from, int64_t to)
+{
+    uint32_t us = lat_elapsed(from, to);
+    taskENTER_CRITICAL(&lat_lock);
+    lat_hist_add(&lat_hist[stage], us);
+    taskEXIT_CRITICAL(&lat_lock);
+}
+
+// Record a latency sample from ISR context
+static void lat_record_from_isr(lat_stage_t stage, int64_t from, int64_t to)
+{
+    uint32_t us = lat_elapsed(from, to);
+    taskENTER_CRITICAL_ISR(&lat_lock);
+    lat_hist_add(&lat_hist[stage], us);
+    taskEXIT_CRITICAL_ISR(&lat_lock);
+}
+
+// Smallest bucket upper bound below which at least permille/1000 of the samples fall
+static uint32_t lat_hist_percentile(const lat_hist_t *h, uint32_t permille)
+{
+    if (h->count == 0)
+        return 0;
+    uint64_t target = ((uint64_t)h->count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LAT_BUCKETS; i++)
+    {
+        seen += h->buckets[i];
+        if (seen >= target)
+            return lat_bucket_upper(i) < h->max ? lat_bucket_upper(i) : h->max;
+    }
+    return h->max;
+}
+
+// ===== Boot Profiler =====
+
+/*
+app_main brings the I2C slave up first, then runs the remaining init stages in background tasks.
+Each stage waits for the stages it depends on (see boot_steps[] above app_main) and sets its bit
+in s_boot_event_group when done, so independent stages such as SPIFFS and mDNS run concurrently.
+A stage returns the first error it hit instead of aborting, so its status is reported by boot_log_report()
+and GET /boot along with the time the master got its first I2C ACK.
+*/
+
+typedef enum
+{
+    BOOT_I2C,
+    BOOT_NVS,
+    BOOT_NETIF,
+    BOOT_WIFI_NETIF,
+    BOOT_MDNS,
+    BOOT_SPIFFS,
+    BOOT_HTTP,
+    BOOT_WIFI,
+    BOOT_STAGE_MAX
+} boot_stage_t;
+
+#define BOOT_BIT(stage) ((EventBits_t)1 << (stage))
+#define BOOT_ALL_BITS (BOOT_BIT(BOOT_STAGE_MAX) - 1)
+
+typedef struct
+{
+    int64_t start; // esp_timer_get_time(), us since boot
+    int64_t end;
+    esp_err_t status;
+} boot_timing_t;
+
+typedef struct
+{
+    const char *name;
+    EventBits_t deps; // BOOT_BIT()s of the stages that must complete first
+    esp_err_t (*init)(void);
+} boot_step_t;
+
+static esp_err_t init_i2c_slave(void);
+static esp_err_t init_nvs(void);
+static esp_err_t init_netif(void);
+static esp_err_t init_wifi_netif(void);
+static esp_err_t init_mdns(void);
+static esp_err_t init_spiffs(void);
+static esp_err_t start_http_server(void);
+static esp_err_t init_wifi(void);
+
+// Indexed by boot_stage_t
+static const boot_step_t boot_steps[BOOT_STAGE_MAX] = {
+    {"i2c", 0, init_i2c_slave},
+    {"nvs", 0, init_nvs},
+    {"netif", 0, init_netif},
+    {"wifi_netif", BOOT_BIT(BOOT_NETIF), init_wifi_netif},
+    {"mdns", BOOT_BIT(BOOT_NVS) | BOOT_BIT(BOOT_NETIF) | BOOT_BIT(BOOT_WIFI_NETIF), init_mdns},
+    {"spiffs", 0, init_spiffs},
+    {"http", BOOT_BIT(BOOT_NETIF), start_http_server},
+    {"wifi", BOOT_BIT(BOOT_NVS) | BOOT_BIT(BOOT_WIFI_NETIF), init_wifi},
+};
+
+static EventGroupHandle_t s_boot_event_group;
+static boot_timing_t boot_timing[BOOT_STAGE_MAX];
+static int64_t boot_app_main_time; // app_main entered
+// Written by the I2C slave callbacks in ISR context, read with boot_get_first_i2c()
+static portMUX_TYPE boot_i2c_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t boot_first_i2c_ack; // first transaction ACKed by the slave (read or write), 0 until then
+static int64_t boot_first_i2c_rx;  // first I2C write from the master, 0 until then
+
+// Block until all stages in bits have completed
+static void boot_wait(EventBits_t bits)
+{
+    xEventGroupWaitBits(s_boot_event_group, bits, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+static void boot_run_step(boot_stage_t stage)
+{
+    const boot_step_t *step = &boot_steps[stage];
+    if (step->deps)
+        boot_wait(step->deps);
+    boot_timing[stage].start = esp_timer_get_time();
+    boot_timing[stage].status = step->init();
+    boot_timing[stage].end = esp_timer_get_time();
+    if (boot_timing[stage].status != ESP_OK)
+        ESP_LOGE("BOOT", "Init stage %s failed (%s)", step->name, esp_err_to_name(boot_timing[stage].status));
+    xEventGroupSetBits(s_boot_event_group, BOOT_BIT(stage));
+}
+
+// Called from the I2C slave callbacks, rx is true for a write from the master
+static void boot_note_i2c_from_isr(int64_t now, bool rx)
+{
+    portENTER_CRITICAL_ISR(&boot_i2c_lock);
+    if (boot_first_i2c_ack == 0)
+        boot_first_i2c_ack = now;
+    if (rx && boot_first_i2c_rx == 0)
+        boot_first_i2c_rx = now;
+    portEXIT_CRITICAL_ISR(&boot_i2c_lock);
+}
+
+static void boot_get_first_i2c(int64_t *ack, int64_t *rx)
+{
+    portENTER_CRITICAL(&boot_i2c_lock);
+    *ack = boot_first_i2c_ack;
+    *rx = boot_first_i2c_rx;
+    portEXIT_CRITICAL(&boot_i2c_lock);
+}
+
+// Runs one background init stage, arg is the boot_stage_t
+static void boot_step_task(void *arg)
+{
+    boot_run_step((boot_stage_t)(intptr_t)arg);
+    vTaskDelete(NULL);
+}
+
+static void boot_log_report(void)
+{
+    ESP_LOGI("BOOT", "app_main entered at %lld us", boot_app_main_time);
+    for (int i = 0; i < BOOT_STAGE_MAX; i++)
+    {
+        ESP_LOGI("BOOT", "%-10s start %8lld us, end %8lld us, took %7lld us (%s)",
+                 boot_steps[i].name, boot_timing[i].start, boot_timing[i].end,
+                 boot_timing[i].end - boot_timing[i].start, esp_err_to_name(boot_timing[i].status));
+    }
+    int64_t first_ack, first_rx;
+    boot_get_first_i2c(&first_ack, &first_rx);
+    if (first_ack)
+        ESP_LOGI("BOOT", "first I2C ACK at %lld us, %lld us after app_main", first_ack, first_ack - boot_app_main_time);
+    if (first_rx)
+        ESP_LOGI("BOOT", "first I2C command at %lld us", first_rx);
+}
+
+// ===== Config Store =====
+
+/*
+Settings that survive a reset live in NVS namespace CONFIG_NVS_NAMESPACE, one typed key per field
+plus a schema version. Setters only stage a change; the commit timer wakes the config task, which writes
+all staged changes at once CONFIG_COMMIT_DELAY_MS after the last one, so a burst of I2C provisioning
+commands costs one flash write and no flash erase runs on the shared esp_timer task.
+*/
+
+#define CONFIG_NVS_NAMESPACE "iot_cfg"
+#define CONFIG_VERSION 1
+#define CONFIG_COMMIT_DELAY_MS 2000
+
+typedef struct
+{
+    char wifi_ssid[WIFI_SSID_MAXLEN];
+    char wifi_pass[WIFI_PASS_MAXLEN];
+    char mdns_name[MDNS_NAME_MAXLEN];
+    wifi_cache_t wifi_cache;
+} persisted_config_t;
+
+static persisted_config_t s_config_committed; // contents of NVS
+static persisted_config_t s_config_staged;    // contents of NVS after the next commit
+static SemaphoreHandle_t s_config_mutex;
+static esp_timer_handle_t s_config_commit_timer;
+static TaskHandle_t s_config_task;
+
+static void config_get_str(nvs_handle_t handle, const char *key, char *out, size_t out_len)
+{
+    size_t len = out_len;
+    if (nvs_get_str(handle, key, out, &len) != ESP_OK)
+        out[0] = '\0';
+}
+
+static esp_err_t config_set_str_if_changed(nvs_handle_t handle, const char *key, const char *old_value, const char *new_value)
+{
+    if (strcmp(old_value, new_value) == 0)
+        return ESP_OK;
+    return nvs_set_str(handle, key, new_value);
+}
+
+static void config_commit(void)
+{
+    persisted_config_t config;
+    xSemaphoreTake(s_config_mutex, portMAX_DELAY);
+    config = s_config_staged;
+    xSemaphoreGive(s_config_mutex);
+
+    if (memcmp(&config, &s_config_committed, sizeof(config)) == 0)
+        return;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE("CONFIG", "Failed to open NVS (%s)", esp_err_to_name(err));
+        return;
+    }
+    err = nvs_set_u16(handle, "version", CONFIG_VERSION);
+    if (err == ESP_OK)
+        err = config_set_str_if_changed(handle, "wifi_ssid", s_config_committed.wifi_ssid, config.wifi_ssid);
+    if (err == ESP_OK)
+        err = config_set_str_if_changed(handle, "wifi_pass", s_config_committed.wifi_pass, config.wifi_pass);
+    if (err == ESP_OK)
+        err = config_set_str_if_changed(handle, "mdns_name", s_config_committed.mdns_name, config.mdns_name);
+    if (err == ESP_OK && memcmp(&config.wifi_cache, &s_config_committed.wifi_cache, sizeof(config.wifi_cache)) != 0)
+        err = nvs_set_blob(handle, "wifi_cache", &config.wifi_cache, sizeof(config.wifi_cache));
+    if (err == ESP_OK)
+        err = nvs_commit(handle);
+    nvs_close(handle);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE("CONFIG", "Failed to commit config (%s)", esp_err_to_name(err));
+        return;
+    }
+    s_config_committed = config;
+    ESP_LOGI("CONFIG", "Config committed to NVS");
+}
+
+static void config_commit_timer_cb(void *arg)
+{
+    xTaskNotifyGive(s_config_task);
+}
+
+static void config_task(void *arg)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        config_commit();
+    }
+}
+
+// (Re)start the coalescing window, the commit runs once no change arrived for CONFIG_COMMIT_DELAY_MS
+static void config_schedule_commit(void)
+{
+    esp_timer_stop(s_config_commit_timer);
+    esp_timer_start_once(s_config_commit_timer, CONFIG_COMMIT_DELAY_MS * 1000ULL);
+}
+
+static void config_stage_wifi(const char *ssid, const char *pass)
+{
+    xSemaphoreTake(s_config_mutex, portMAX_DELAY);
+    // The cached association belongs to the old network
+    if (strcmp(s_config_staged.wifi_ssid, ssid) != 0)
+        memset(&s_config_staged.wifi_cache, 0, sizeof(s_config_staged.wifi_cache));
+    strlcpy(s_config_staged.wifi_ssid, ssid, sizeof(s_config_staged.wifi_ssid));
+    strlcpy(s_config_staged.wifi_pass, pass, sizeof(s_config_staged.wifi_pass));
+    xSemaphoreGive(s_config_mutex);
+    config_schedule_commit();
+}
+
+static void config_stage_mdns_name(const char *name)
+{
+    xSemaphoreTake(s_config_mutex, portMAX_DELAY);
+    strlcpy(s_config_staged.mdns_name, name, sizeof(s_config_staged.mdns_name));
+    xSemaphoreGive(s_config_mutex);
+    config_schedule_commit();
+}
+
+static void config_stage_wifi_cache(const wifi_cache_t *cache)
+{
+    xSemaphoreTake(s_config_mutex, portMAX_DELAY);
+    s_config_staged.wifi_cache = *cache;
+    xSemaphoreGive(s_config_mutex);
+    config_schedule_commit();
+}
+
+// Load the stored config into context, must run after nvs_flash_init() and before WiFi or mDNS start
+static esp_err_t config_load(void)
+{
+    s_config_mutex = xSemaphoreCreateMutex();
+    if (xTaskCreate(config_task, "config", 4096, NULL, 5, &s_config_task) != pdPASS)
+        return ESP_ERR_NO_MEM;
+    esp_timer_create_args_t timer_args = {
+        .callback = config_commit_timer_cb,
+        .name = "config_commit"};
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &s_config_commit_timer), "CONFIG", "Failed to create the commit timer");
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(CONFIG_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        ESP_LOGI("CONFIG", "No stored config");
+        return ESP_OK;
+    }
+    if (err != ESP_OK)
+        return err;
+
+    uint16_t version = 0;
+    nvs_get_u16(handle, "version", &version);
+    if (version == 0 || version > CONFIG_VERSION)
+    {
+        // Written by newer firmware or corrupted, leave it alone and run with defaults
+        ESP_LOGW("CONFIG", "Ignoring stored config version %d", version);
+        nvs_close(handle);
+        return ESP_OK;
+    }
+    // Version 1 is the only layout so far, migrations from older versions go here
+    config_get_str(handle, "wifi_ssid", s_config_committed.wifi_ssid, sizeof(s_config_committed.wifi_ssid));
+    config_get_str(handle, "wifi_pass", s_config_committed.wifi_pass, sizeof(s_config_committed.wifi_pass));
+    config_get_str(handle, "mdns_name", s_config_committed.mdns_name, sizeof(s_config_committed.mdns_name));
+    size_t cache_len = sizeof(s_config_committed.wifi_cache);
+    if (nvs_get_blob(handle, "wifi_cache", &s_config_committed.wifi_cache, &cache_len) != ESP_OK ||
+        cache_len != sizeof(s_config_committed.wifi_cache))
+    {
+        memset(&s_config_committed.wifi_cache, 0, sizeof(s_config_committed.wifi_cache));
+    }
+    nvs_close(handle);
+    s_config_staged = s_config_committed;
+
+    strlcpy(context.wifi_ssid, s_config_committed.wifi_ssid, sizeof(context.wifi_ssid));
+    strlcpy(context.wifi_pass, s_config_committed.wifi_pass, sizeof(context.wifi_pass));
+    if (s_config_committed.mdns_name[0])
+        strlcpy(context.mdns_name, s_config_committed.mdns_name, sizeof(context.mdns_name));
+    context.wifi_cache = s_config_committed.wifi_cache;
+    ESP_LOGI("CONFIG", "Restored config: SSID [%s], mDNS name [%s]", context.wifi_ssid, context.mdns_name);
+    return ESP_OK;
+}
+
 // ===== mDNS ======
 
-static void initialise_mdns(const char *hostname = "esp32-iot")
+static esp_err_t initialise_mdns(const char *hostname = "esp32-iot")
 {
     // Initialize mDNS
-    ESP_ERROR_CHECK(mdns_init());
+    ESP_RETURN_ON_ERROR(mdns_init(), "mDNS", "mdns_init failed");
 
     // Set mDNS hostname
-    ESP_ERROR_CHECK(mdns_hostname_set(hostname));
+    ESP_RETURN_ON_ERROR(mdns_hostname_set(hostname), "mDNS", "Failed to set the hostname");
     ESP_LOGI("mDNS", "mDNS hostname set to: [%s]", hostname);
 
-    // Set default mDNS instance name
-    ESP_ERROR_CHECK(mdns_instance_name_set("ESP32 IoT Device"));
+    // Set default mDNS instance name
+    ESP_RETURN_ON_ERROR(mdns_instance_name_set("ESP32 IoT Device"), "mDNS", "Failed to set the instance name");
+
+    // Web UI and its JSON endpoints, under the default instance name
+    mdns_txt_item_t http_txt[] = {
+        {"path", "/"},
+    };
+    return mdns_service_add(NULL, "_http", "_tcp", HTTP_SERVER_PORT, http_txt, 1);
+}
+
+/*
+Every channel set up with CMD_SENSOR_SETUP is advertised as an _iot-sensor._tcp instance named after the
+sensor and its unit, on the HTTP server port with the /sensor endpoint in its TXT record. The TXT record also
+carries the value rounded to a bucket of sensor_bucket_step[unit], so noise within a bucket causes no
+traffic. Samples are collected for SENSOR_MDNS_COALESCE_MS before the changed buckets are published, and a
+channel is re-announced at most every SENSOR_MDNS_MIN_INTERVAL_MS. A TXT update is only announced, the
+instance name is probed again only when the sensor is renamed or its unit changes. The publish runs in its
+own task, the coalescing timer only wakes it: the esp_timer task must not wait for the sensor data or the
+mDNS service lock.
+*/
+
+#define SENSOR_MDNS_SERVICE "_iot-sensor"
+#define SENSOR_MDNS_PROTO "_tcp"
+#define SENSOR_MDNS_PATH "/sensor"
+#define SENSOR_MDNS_INSTANCE_MAXLEN (SENSOR_NAME_MAXLEN + 12) // "<name> (<unit>) #<channel>"
+#define SENSOR_MDNS_COALESCE_MS 250
+#define SENSOR_MDNS_MIN_INTERVAL_MS 2000
+
+static const char *unit_symbols[UNIT_NONE + 1] = {"°C", "°F", "K", "cm", "%", ""};
+static const float sensor_bucket_step[UNIT_NONE + 1] = {0.5f, 1.0f, 0.5f, 1.0f, 1.0f, 0.1f};
+
+// Advertisement of one sensor channel, protected by s_sensor_mdns_mutex
+typedef struct
+{
+    char instance[SENSOR_MDNS_INSTANCE_MAXLEN]; // registered instance name, empty while not advertised
+    int32_t bucket;                             // value bucket in the TXT record
+    int64_t published;                          // last TXT update, esp_timer_get_time()
+} sensor_mdns_t;
+
+static sensor_mdns_t s_sensor_mdns[SENSOR_CHANNELS];
+static SemaphoreHandle_t s_sensor_mdns_mutex;
+static esp_timer_handle_t s_sensor_mdns_timer;
+static TaskHandle_t s_sensor_mdns_task;
+static uint8_t s_sensor_mdns_advertised; // channel bitmask, protected by context.sensor_mutex
+static uint8_t s_sensor_mdns_dirty;      // channels sampled since the last publish, protected by context.sensor_mutex
+
+static int32_t sensor_bucket(float value, uint8_t unit)
+{
+    if (!isfinite(value))
+        return INT32_MIN;
+    return (int32_t)lroundf(value / sensor_bucket_step[unit]);
+}
+
+static void sensor_bucket_str(char *out, size_t out_len, int32_t bucket, uint8_t unit)
+{
+    if (bucket == INT32_MIN)
+        strlcpy(out, "nan", out_len);
+    else
+        snprintf(out, out_len, "%.1f", bucket * sensor_bucket_step[unit]);
+}
+
+// Publishes the buckets changed since the last run, channels still within their minimum interval are retried later
+static void sensor_mdns_publish(void)
+{
+    float values[SENSOR_CHANNELS];
+    uint8_t units[SENSOR_CHANNELS];
+    xSemaphoreTake(context.sensor_mutex, portMAX_DELAY);
+    uint8_t dirty = s_sensor_mdns_dirty & s_sensor_mdns_advertised;
+    s_sensor_mdns_dirty = 0;
+    memcpy(values, context.sensor_data, sizeof(values));
+    memcpy(units, context.sensor_unit, sizeof(units));
+    xSemaphoreGive(context.sensor_mutex);
+
+    int64_t now = esp_timer_get_time();
+    int64_t next = 0;
+    uint8_t deferred = 0;
+    xSemaphoreTake(s_sensor_mdns_mutex, portMAX_DELAY);
+    for (int i = 0; i < SENSOR_CHANNELS; i++)
+    {
+        sensor_mdns_t *m = &s_sensor_mdns[i];
+        if (!(dirty & (1 << i)) || !m->instance[0])
+            continue;
+        int32_t bucket = sensor_bucket(values[i], units[i]);
+        if (bucket == m->bucket)
+            continue;
+        int64_t due = m->published + SENSOR_MDNS_MIN_INTERVAL_MS * 1000LL;
+        if (due > now)
+        {
+            deferred |= 1 << i;
+            if (!next || due < next)
+                next = due;
+            continue;
+        }
+        char value[16];
+        sensor_bucket_str(value, sizeof(value), bucket, units[i]);
+        if (mdns_service_txt_item_set_for_host(m->instance, SENSOR_MDNS_SERVICE, SENSOR_MDNS_PROTO, NULL, "v", value) == ESP_OK)
+        {
+            m->bucket = bucket;
+            m->published = now;
+        }
+    }
+    xSemaphoreGive(s_sensor_mdns_mutex);
+
+    if (deferred)
+    {
+        xSemaphoreTake(context.sensor_mutex, portMAX_DELAY);
+        s_sensor_mdns_dirty |= deferred;
+        xSemaphoreGive(context.sensor_mutex);
+        // Fails if a new sample armed the timer meanwhile, that run picks the deferred channels up again
+        esp_timer_start_once(s_sensor_mdns_timer, next - now);
+    }
+}
+
+static void sensor_mdns_timer_cb(void *arg)
+{
+    xTaskNotifyGive(s_sensor_mdns_task);
+}
+
+static void sensor_mdns_task(void *arg)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        sensor_mdns_publish();
+    }
+}
+
+// Called after a sample of an advertised channel was stored, opens the coalescing window unless one is open
+static void sensor_mdns_schedule(void)
+{
+    if (!esp_timer_is_active(s_sensor_mdns_timer))
+        esp_timer_start_once(s_sensor_mdns_timer, SENSOR_MDNS_COALESCE_MS * 1000ULL);
+}
+
+// Registers, renames or removes the service of a channel after CMD_SENSOR_SETUP, mDNS must be up
+static void sensor_mdns_setup(uint8_t channel)
+{
+    char name[SENSOR_NAME_MAXLEN];
+    xSemaphoreTake(context.sensor_mutex, portMAX_DELAY);
+    strlcpy(name, context.sensor_name[channel], sizeof(name));
+    uint8_t unit = context.sensor_unit[channel];
+    int32_t bucket = sensor_bucket(context.sensor_data[channel], unit);
+    xSemaphoreGive(context.sensor_mutex);
+
+    char channel_str[4];
+    char value[16];
+    snprintf(channel_str, sizeof(channel_str), "%u", channel);
+    sensor_bucket_str(value, sizeof(value), bucket, unit);
+    mdns_txt_item_t txt[] = {
+        {"ch", channel_str},
+        {"unit", unit_symbols[unit]},
+        {"v", value},
+        {"path", SENSOR_MDNS_PATH},
+    };
+
+    xSemaphoreTake(s_sensor_mdns_mutex, portMAX_DELAY);
+    sensor_mdns_t *m = &s_sensor_mdns[channel];
+    char instance[SENSOR_MDNS_INSTANCE_MAXLEN];
+    if (unit_symbols[unit][0])
+        snprintf(instance, sizeof(instance), "%s (%s)", name, unit_symbols[unit]);
+    else
+        strlcpy(instance, name, sizeof(instance));
+    // Two channels with the same name and unit are told apart by the channel number
+    for (int i = 0; i < SENSOR_CHANNELS; i++)
+    {
+        if (name[0] && i != channel && strcasecmp(s_sensor_mdns[i].instance, instance) == 0)
+        {
+            size_t len = strlen(instance);
+            snprintf(instance + len, sizeof(instance) - len, " #%u", channel);
+            break;
+        }
+    }
+
+    esp_err_t err = ESP_OK;
+    if (!name[0])
+    {
+        if (m->instance[0])
+            err = mdns_service_remove_for_host(m->instance, SENSOR_MDNS_SERVICE, SENSOR_MDNS_PROTO, NULL);
+        m->instance[0] = '\0';
+    }
+    else if (!m->instance[0])
+    {
+        err = mdns_service_add(instance, SENSOR_MDNS_SERVICE, SENSOR_MDNS_PROTO, HTTP_SERVER_PORT, txt, 4);
+        if (err == ESP_OK)
+            strlcpy(m->instance, instance, sizeof(m->instance));
+    }
+    else
+    {
+        // The instance name carries the unit, so a new unit renames the instance as a new name does
+        if (strcmp(m->instance, instance) != 0)
+        {
+            err = mdns_service_instance_name_set_for_host(m->instance, SENSOR_MDNS_SERVICE, SENSOR_MDNS_PROTO, NULL, instance);
+            if (err == ESP_OK)
+                strlcpy(m->instance, instance, sizeof(m->instance));
+        }
+        if (err == ESP_OK)
+            err = mdns_service_txt_set_for_host(m->instance, SENSOR_MDNS_SERVICE, SENSOR_MDNS_PROTO, NULL, txt, 4);
+    }
+    if (err == ESP_OK)
+    {
+        m->bucket = bucket;
+        m->published = esp_timer_get_time();
+    }
+    bool advertised = m->instance[0] != '\0';
+    xSemaphoreGive(s_sensor_mdns_mutex);
+
+    xSemaphoreTake(context.sensor_mutex, portMAX_DELAY);
+    if (advertised)
+        s_sensor_mdns_advertised |= 1 << channel;
+    else
+        s_sensor_mdns_advertised &= ~(1 << channel);
+    xSemaphoreGive(context.sensor_mutex);
+
+    if (err != ESP_OK)
+        ESP_LOGW("mDNS", "Failed to update the service of sensor %u (%s)", channel, esp_err_to_name(err));
+    else if (advertised)
+        ESP_LOGI("mDNS", "Sensor %u advertised as [%s]", channel, instance);
+}
+
+static esp_err_t init_mdns(void)
+{
+    s_sensor_mdns_mutex = xSemaphoreCreateMutex();
+    if (xTaskCreate(sensor_mdns_task, "sensor_mdns", 4096, NULL, 5, &s_sensor_mdns_task) != pdPASS)
+        return ESP_ERR_NO_MEM;
+    esp_timer_create_args_t timer_args = {
+        .callback = sensor_mdns_timer_cb,
+        .name = "sensor_mdns"};
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &s_sensor_mdns_timer), "mDNS", "Failed to create the sensor timer");
+
+    return initialise_mdns(context.mdns_name);
+}
+
+// ===== WiFi Power Policy =====
+
+/*
+The configured policy applies while the device is idle. Within POWER_BURST_HOLD_MS of the last /set_cmd
+the station is switched to max performance, so the responses of a burst of commands are not held back to
+the next DTIM. Polling requests do not hold the station awake, an open connection alone costs no power.
+
+Requests sent to the device wait at the AP until the station wakes, which only the client can see. Every
+response names the effective mode in X-Power-Mode, and the web UI reports the round trip it measured with
+its next request as "X-Power-RTT: <mode> <us>". GET /power shows these round trips per mode.
+
+The idle timer only wakes the power task, esp_wifi_set_ps() and s_power_mutex stay off the esp_timer task.
+*/
+
+#define POWER_BURST_HOLD_MS 2000
+#define POWER_DEFAULT_LISTEN_INTERVAL 3 // beacons, only used by low_power
+
+typedef enum
+{
+    POWER_MAX_PERFORMANCE, // WIFI_PS_NONE
+    POWER_BALANCED,        // WIFI_PS_MIN_MODEM, wake every DTIM
+    POWER_LOW_POWER,       // WIFI_PS_MAX_MODEM, wake every listen_interval beacons
+    POWER_MODE_MAX
+} power_mode_t;
+
+static const char *power_mode_names[POWER_MODE_MAX] = {
+    "max_performance",
+    "balanced",
+    "low_power",
+};
+
+static const wifi_ps_type_t power_mode_ps[POWER_MODE_MAX] = {
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM,
+    WIFI_PS_MAX_MODEM,
+};
+
+static SemaphoreHandle_t s_power_mutex;
+static esp_timer_handle_t s_power_idle_timer;
+static TaskHandle_t s_power_task;
+static power_mode_t s_power_policy = POWER_BALANCED; // WiFi driver default is modem sleep
+static power_mode_t s_power_effective = POWER_BALANCED;
+static uint16_t s_power_listen_interval = POWER_DEFAULT_LISTEN_INTERVAL;
+static int64_t s_power_last_cmd; // last /set_cmd
+static bool s_power_wifi_ready;
+static lat_hist_t s_power_latency[POWER_MODE_MAX]; // client round trips per effective mode, under lat_lock
+
+// Re-evaluate the effective mode and push it to the driver if it changed, call with s_power_mutex held
+static void power_update_locked(bool force)
+{
+    bool burst = s_power_last_cmd && esp_timer_get_time() - s_power_last_cmd < POWER_BURST_HOLD_MS * 1000LL;
+    power_mode_t mode = burst ? POWER_MAX_PERFORMANCE : s_power_policy;
+    if (!s_power_wifi_ready || (mode == s_power_effective && !force))
+    {
+        s_power_effective = mode;
+        return;
+    }
+    esp_err_t err = esp_wifi_set_ps(power_mode_ps[mode]);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE("POWER", "Failed to set power save mode (%s)", esp_err_to_name(err));
+        return;
+    }
+    if (mode != s_power_effective)
+        ESP_LOGI("POWER", "Power mode %s -> %s", power_mode_names[s_power_effective], power_mode_names[mode]);
+    s_power_effective = mode;
+}
+
+static void power_update(void)
+{
+    xSemaphoreTake(s_power_mutex, portMAX_DELAY);
+    power_update_locked(false);
+    xSemaphoreGive(s_power_mutex);
+}
+
+static void power_idle_timer_cb(void *arg)
+{
+    xTaskNotifyGive(s_power_task);
+}
+
+static void power_task(void *arg)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        power_update();
+    }
+}
+
+static void power_init(void)
+{
+    s_power_mutex = xSemaphoreCreateMutex();
+    xTaskCreate(power_task, "power", 4096, NULL, 5, &s_power_task);
+    esp_timer_create_args_t timer_args = {
+        .callback = power_idle_timer_cb,
+        .name = "power_idle"};
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_power_idle_timer));
+}
+
+// Called once esp_wifi_start() succeeded, applies the current mode to the driver
+static void power_wifi_started(void)
+{
+    xSemaphoreTake(s_power_mutex, portMAX_DELAY);
+    s_power_wifi_ready = true;
+    power_update_locked(true);
+    xSemaphoreGive(s_power_mutex);
+}
+
+// A /set_cmd arrived: hold max performance until POWER_BURST_HOLD_MS after the last one
+static void power_note_command(void)
+{
+    xSemaphoreTake(s_power_mutex, portMAX_DELAY);
+    s_power_last_cmd = esp_timer_get_time();
+    power_update_locked(false);
+    xSemaphoreGive(s_power_mutex);
+    esp_timer_stop(s_power_idle_timer);
+    esp_timer_start_once(s_power_idle_timer, (POWER_BURST_HOLD_MS + 10) * 1000ULL);
+}
+
+static power_mode_t power_effective_mode(void)
+{
+    return s_power_effective;
+}
+
+// Listen interval for the next (re)connect, changed by POST /power
+static uint16_t power_listen_interval(void)
+{
+    xSemaphoreTake(s_power_mutex, portMAX_DELAY);
+    uint16_t listen_interval = s_power_listen_interval;
+    xSemaphoreGive(s_power_mutex);
+    return listen_interval;
+}
+
+// Record the round trip the client reports for its previous request and tag the response with the current mode
+static void power_track_request(httpd_req_t *req)
+{
+    char value[48];
+    char mode_name[24];
+    unsigned long us;
+    if (httpd_req_get_hdr_value_str(req, "X-Power-RTT", value, sizeof(value)) == ESP_OK &&
+        sscanf(value, "%23s %lu", mode_name, &us) == 2)
+    {
+        for (int mode = 0; mode < POWER_MODE_MAX; mode++)
+        {
+            if (strcmp(mode_name, power_mode_names[mode]) != 0)
+                continue;
+            taskENTER_CRITICAL(&lat_lock);
+            lat_hist_add(&s_power_latency[mode], us);
+            taskEXIT_CRITICAL(&lat_lock);
+            break;
+        }
+    }
+    httpd_resp_set_hdr(req, "X-Power-Mode", power_mode_names[power_effective_mode()]);
+}
+
+// ===== WiFi Station =====
+
+/* FreeRTOS event group to signal when we are connected*/
+static EventGroupHandle_t s_wifi_event_group;
+
+/* The event group allows multiple bits for each event, but we only care about two events:
+ * - we are connected to the AP with an IP
+ * - we failed to connect after WIFI_FAIL_REPORT_RETRIES attempts (retrying carries on in the background) */
+#define WIFI_CONNECTED_BIT BIT0 
+#define WIFI_FAIL_BIT BIT1
+
+#define WIFI_FAIL_REPORT_RETRIES 20
+#define WIFI_BACKOFF_MIN_MS 250
+#define WIFI_BACKOFF_MAX_MS 30000
+
+static const char *TAG = "wifi station";
+static int s_retry_num = 0;
+
+/*
+Reconnect state machine, driven by event_handler():
+- a connect first goes straight to the cached BSSID/channel (no scan) when the cache is valid,
+- a failed attempt is retried after an exponential backoff with jitter, with a full scan, forever,
+- a lost connection goes back to the targeted attempt first.
+All transitions run on the default event loop: the backoff timer and a config change from the I2C task
+post WIFI_LINK_EVENT events instead of acting themselves.
+*/
+
+ESP_EVENT_DEFINE_BASE(WIFI_LINK_EVENT);
+
+enum
+{
+    WIFI_LINK_EVENT_RETRY,    // backoff expired
+    WIFI_LINK_EVENT_RECONFIG, // new credentials, event data is the wifi_config_t
+};
+typedef enum
+{
+    WIFI_LINK_DOWN,
+    WIFI_LINK_FAST_CONNECT, // targeted attempt in flight
+    WIFI_LINK_SCAN_CONNECT, // full-scan attempt in flight
+    WIFI_LINK_BACKOFF,      // waiting for s_wifi_retry_timer
+    WIFI_LINK_UP
+} wifi_link_state_t;
+
+typedef struct
+{
+    uint32_t connects;       // got an IP
+    uint32_t disconnects;    // lost an established connection
+    uint32_t attempts;       // esp_wifi_connect() calls
+    uint32_t fast_attempts;  // of which targeted
+    uint32_t fast_successes; // targeted attempts that got an IP
+    uint32_t lease_reused;   // got the cached IP back
+    uint32_t last_reason;    // last wifi_err_reason_t
+    uint32_t backoff_ms;     // last backoff delay
+    uint32_t last_us;        // down (or start) -> got IP
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+} wifi_reconnect_stats_t;
+
+static wifi_link_state_t s_link_state = WIFI_LINK_DOWN; // written on the event loop under s_wifi_stats_lock
+static int64_t s_link_down_since;
+static uint8_t s_assoc_bssid[6]; // from WIFI_EVENT_STA_CONNECTED, cached once an IP is obtained
+static uint8_t s_assoc_channel;
+static esp_timer_handle_t s_wifi_retry_timer;
+static wifi_reconnect_stats_t s_wifi_stats;
+static portMUX_TYPE s_wifi_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Point the station at the cached AP, or let it scan all channels
+static void wifi_set_target(bool targeted)
+{
+    wifi_config_t wifi_config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) != ESP_OK)
+        return;
+    wifi_config.sta.bssid_set = targeted;
+    if (targeted)
+    {
+        memcpy(wifi_config.sta.bssid, context.wifi_cache.bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = context.wifi_cache.channel;
+    }
+    else
+    {
+        wifi_config.sta.channel = 0;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+}
+
+static void wifi_set_link_state(wifi_link_state_t state)
+{
+    taskENTER_CRITICAL(&s_wifi_stats_lock);
+    s_link_state = state;
+    taskEXIT_CRITICAL(&s_wifi_stats_lock);
 }
 
-// ===== WiFi Station =====
+static void wifi_connect_attempt(bool targeted)
+{
+    targeted = targeted && context.wifi_cache.valid;
+    wifi_set_target(targeted);
+    taskENTER_CRITICAL(&s_wifi_stats_lock);
+    s_link_state = targeted ? WIFI_LINK_FAST_CONNECT : WIFI_LINK_SCAN_CONNECT;
+    s_wifi_stats.attempts++;
+    if (targeted)
+        s_wifi_stats.fast_attempts++;
+    taskEXIT_CRITICAL(&s_wifi_stats_lock);
+    esp_wifi_connect();
+}
 
-/* FreeRTOS event group to signal when we are connected*/
-static EventGroupHandle_t s_wifi_event_group;
+static void wifi_retry_timer_cb(void *arg)
+{
+    // Never block the esp_timer task, try again shortly when the event queue is full
+    if (esp_event_post(WIFI_LINK_EVENT, WIFI_LINK_EVENT_RETRY, NULL, 0, 0) != ESP_OK)
+        esp_timer_start_once(s_wifi_retry_timer, WIFI_BACKOFF_MIN_MS * 1000ULL);
+}
 
-/* The event group allows multiple bits for each event, but we only care about two events:
- * - we are connected to the AP with an IP
- * - we failed to connect after the maximum amount of retries */
-#define WIFI_CONNECTED_BIT BIT0 
-#define WIFI_FAIL_BIT BIT1
+// Full jitter over the upper half of the exponential window: [d/2, d], d = min(MIN * 2^retry, MAX)
+static uint32_t wifi_backoff_ms(int retry)
+{
+    uint32_t delay = WIFI_BACKOFF_MAX_MS;
+    if (retry < 16)
+    {
+        delay = WIFI_BACKOFF_MIN_MS << retry;
+        if (delay > WIFI_BACKOFF_MAX_MS)
+            delay = WIFI_BACKOFF_MAX_MS;
+    }
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
 
-static const char *TAG = "wifi station";
-static int s_retry_num = 0;
+static void wifi_record_connect(const esp_netif_ip_info_t *ip_info)
+{
+    uint32_t us = lat_elapsed(s_link_down_since, esp_timer_get_time());
+    bool reused = context.wifi_cache.valid && context.wifi_cache.ip == ip_info->ip.addr;
+    taskENTER_CRITICAL(&s_wifi_stats_lock);
+    s_wifi_stats.connects++;
+    if (s_link_state == WIFI_LINK_FAST_CONNECT)
+        s_wifi_stats.fast_successes++;
+    if (reused)
+        s_wifi_stats.lease_reused++;
+    s_wifi_stats.last_us = us;
+    if (s_wifi_stats.connects == 1 || us < s_wifi_stats.min_us)
+        s_wifi_stats.min_us = us;
+    if (us > s_wifi_stats.max_us)
+        s_wifi_stats.max_us = us;
+    s_wifi_stats.sum_us += us;
+    taskEXIT_CRITICAL(&s_wifi_stats_lock);
+}
 
 static void event_handler(void *arg, esp_event_base_t event_base,
                           int32_t event_id, void *event_data)
 {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
+    if (event_base == WIFI_LINK_EVENT && event_id == WIFI_LINK_EVENT_RETRY)
     {
-        esp_wifi_connect();
+        if (s_link_state == WIFI_LINK_BACKOFF)
+            wifi_connect_attempt(false);
     }
-    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    else if (event_base == WIFI_LINK_EVENT && event_id == WIFI_LINK_EVENT_RECONFIG)
     {
-        if (s_retry_num < 20) // Retry up to 20 times
+        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+        esp_timer_stop(s_wifi_retry_timer);
+        s_retry_num = 0;
+        // The cached association belongs to the old network
+        memset(&context.wifi_cache, 0, sizeof(context.wifi_cache));
+        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, (wifi_config_t *)event_data));
+        s_link_down_since = esp_timer_get_time();
+        if (s_link_state == WIFI_LINK_BACKOFF || s_link_state == WIFI_LINK_DOWN)
         {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "retry to connect to the AP");
+            wifi_connect_attempt(false);
         }
         else
         {
+            // The resulting STA_DISCONNECTED event reconnects with the new config
+            esp_wifi_disconnect();
+        }
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
+    {
+        s_link_down_since = esp_timer_get_time();
+        wifi_connect_attempt(true);
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
+    {
+        wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
+        memcpy(s_assoc_bssid, event->bssid, sizeof(s_assoc_bssid));
+        s_assoc_channel = event->channel;
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
+        taskENTER_CRITICAL(&s_wifi_stats_lock);
+        s_wifi_stats.last_reason = event->reason;
+        if (s_link_state == WIFI_LINK_UP)
+            s_wifi_stats.disconnects++;
+        taskEXIT_CRITICAL(&s_wifi_stats_lock);
+
+        if (s_link_state == WIFI_LINK_UP)
+        {
+            // Lost an established link, most likely the same AP is coming back: go straight to it
+            ESP_LOGI(TAG, "disconnected (reason %d), reconnecting", event->reason);
+            xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+            s_link_down_since = esp_timer_get_time();
+            s_retry_num = 0;
+            wifi_connect_attempt(true);
+            return;
+        }
+
+        s_retry_num++;
+        if (s_retry_num == WIFI_FAIL_REPORT_RETRIES)
+        {
+            // Unblock wifi_init_sta(), retrying carries on in the background
             xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
         }
-        ESP_LOGI(TAG, "connect to the AP fail");
+        uint32_t delay_ms = wifi_backoff_ms(s_retry_num - 1);
+        taskENTER_CRITICAL(&s_wifi_stats_lock);
+        s_wifi_stats.backoff_ms = delay_ms;
+        s_link_state = WIFI_LINK_BACKOFF;
+        taskEXIT_CRITICAL(&s_wifi_stats_lock);
+        esp_timer_stop(s_wifi_retry_timer);
+        esp_timer_start_once(s_wifi_retry_timer, delay_ms * 1000ULL);
+        ESP_LOGI(TAG, "connect to the AP fail (reason %d), retry %d in %lu ms", event->reason, s_retry_num, (unsigned long)delay_ms);
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
     {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
         ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+        wifi_record_connect(&event->ip_info);
+        wifi_set_link_state(WIFI_LINK_UP);
         s_retry_num = 0;
+
+        wifi_cache_t cache = {
+            .ip = event->ip_info.ip.addr,
+            .netmask = event->ip_info.netmask.addr,
+            .gw = event->ip_info.gw.addr,
+            .bssid = {0},
+            .channel = s_assoc_channel,
+            .valid = 1,
+        };
+        memcpy(cache.bssid, s_assoc_bssid, sizeof(cache.bssid));
+        if (memcmp(&cache, &context.wifi_cache, sizeof(cache)) != 0)
+        {
+            context.wifi_cache = cache;
+            config_stage_wifi_cache(&cache);
+        }
+        xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
-void wifi_init_sta(void)
+// Start the station with the credentials in context, connecting continues in event_handler()
+static esp_err_t wifi_start_sta(void)
 {
     s_wifi_event_group = xEventGroupCreate();
+    esp_timer_create_args_t timer_args = {
+        .callback = wifi_retry_timer_cb,
+        .name = "wifi_retry"};
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &s_wifi_retry_timer), TAG, "esp_timer_create failed");
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_RETURN_ON_ERROR(esp_wifi_init(&cfg), TAG, "esp_wifi_init failed");
 
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &event_handler,
-                                                        NULL,
-                                                        &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
-                                                        IP_EVENT_STA_GOT_IP,
-                                                        &event_handler,
-                                                        NULL,
-                                                        &instance_got_ip));
+    esp_event_handler_instance_t instance_link;
+    ESP_RETURN_ON_ERROR(esp_event_handler_instance_register(WIFI_EVENT,
+                                                            ESP_EVENT_ANY_ID,
+                                                            &event_handler,
+                                                            NULL,
+                                                            &instance_any_id), TAG, "esp_event_handler_instance_register failed");
+    ESP_RETURN_ON_ERROR(esp_event_handler_instance_register(IP_EVENT,
+                                                            IP_EVENT_STA_GOT_IP,
+                                                            &event_handler,
+                                                            NULL,
+                                                            &instance_got_ip), TAG, "esp_event_handler_instance_register failed");
+    ESP_RETURN_ON_ERROR(esp_event_handler_instance_register(WIFI_LINK_EVENT,
+                                                            ESP_EVENT_ANY_ID,
+                                                            &event_handler,
+                                                            NULL,
+                                                            &instance_link), TAG, "esp_event_handler_instance_register failed");
+
+    wifi_config_t wifi_config = {};
+    strlcpy((char *)wifi_config.sta.ssid, context.wifi_ssid, WIFI_SSID_MAXLEN);
+    strlcpy((char *)wifi_config.sta.password, context.wifi_pass, WIFI_PASS_MAXLEN);
+
+    wifi_config.sta.listen_interval = power_listen_interval();
+
+    ESP_RETURN_ON_ERROR(esp_wifi_set_mode(WIFI_MODE_STA), TAG, "esp_wifi_set_mode failed");
+    ESP_RETURN_ON_ERROR(esp_wifi_set_config(WIFI_IF_STA, &wifi_config), TAG, "esp_wifi_set_config failed");
+    ESP_RETURN_ON_ERROR(esp_wifi_start(), TAG, "esp_wifi_start failed");
+    power_wifi_started();
 
+    ESP_LOGI(TAG, "wifi_start_sta finished.");
+    return ESP_OK;
+}
+
+// True if the credentials in context differ from the ones the station is configured with
+static bool wifi_config_changed(void)
+{
+    wifi_config_t current = {};
+    if (esp_wifi_get_config(WIFI_IF_STA, &current) != ESP_OK)
+        return true;
+    return strncmp((const char *)current.sta.ssid, context.wifi_ssid, sizeof(current.sta.ssid)) != 0 ||
+           strncmp((const char *)current.sta.password, context.wifi_pass, sizeof(current.sta.password)) != 0;
+}
+
+// Switch a running station over to the credentials in context, the switch itself runs on the event loop
+static void wifi_apply_config(void)
+{
     wifi_config_t wifi_config = {};
     strlcpy((char *)wifi_config.sta.ssid, context.wifi_ssid, WIFI_SSID_MAXLEN);
     strlcpy((char *)wifi_config.sta.password, context.wifi_pass, WIFI_PASS_MAXLEN);
+    wifi_config.sta.listen_interval = power_listen_interval();
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
+    ESP_ERROR_CHECK(esp_event_post(WIFI_LINK_EVENT, WIFI_LINK_EVENT_RECONFIG, &wifi_config, sizeof(wifi_config), portMAX_DELAY));
+    ESP_LOGI(TAG, "wifi config updated, reconnecting");
+}
 
-    ESP_LOGI(TAG, "wifi_init_sta finished.");
+void wifi_init_sta(void)
+{
+    esp_err_t err = wifi_start_sta();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start the station (%s)", esp_err_to_name(err));
+        return;
+    }
 
     /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
      * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
@@ -211,9 +1319,49 @@ void wifi_init_sta(void)
 }
 
 // ===== SPIFFS File Server =====
+static esp_err_t init_spiffs(void)
+{
+    esp_vfs_spiffs_conf_t spiffs_conf = {
+        .base_path = "/spiffs",
+        .partition_label = "storage",
+        .max_files = 5,
+        .format_if_mount_failed = true};
+
+    esp_err_t ret = esp_vfs_spiffs_register(&spiffs_conf);
+    if (ret != ESP_OK)
+    {
+        if (ret == ESP_FAIL)
+        {
+            ESP_LOGE("SPIFFS", "Failed to mount or format filesystem");
+        }
+        else if (ret == ESP_ERR_NOT_FOUND)
+        {
+            ESP_LOGE("SPIFFS", "Failed to find SPIFFS partition");
+        }
+        else
+        {
+            ESP_LOGE("SPIFFS", "Failed to initialize SPIFFS (%s)", esp_err_to_name(ret));
+        }
+        return ret;
+    }
+
+    ESP_LOGI("SPIFFS", "SPIFFS mounted successfully");
+
+    // Check SPIFFS usage
+    size_t total = 0, used = 0;
+    if (esp_spiffs_info("storage", &total, &used) == ESP_OK)
+    {
+        ESP_LOGI("SPIFFS", "Partition size: total: %d, used: %d", total, used);
+    }
+    return ESP_OK;
+}
+
 // ===== Set Command Handler =====
 static esp_err_t set_cmd_handler(httpd_req_t *req)
 {
+    int64_t rx_time = esp_timer_get_time();
+    power_track_request(req);
+    power_note_command();
     ESP_LOGI("HTTP", "Received set_cmd request");
     char buf[32];
     int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
@@ -236,7 +1384,12 @@ static esp_err_t set_cmd_handler(httpd_req_t *req)
     context.response_data[1] = (uint8_t)door;
     context.response_data[2] = (uint8_t)fan;
     context.response_data[3] = (uint8_t)light;
+    int64_t commit_time = esp_timer_get_time();
+    context.cmd_stamp.http_rx = rx_time;
+    context.cmd_stamp.commit = commit_time;
+    context.cmd_stamp.pending = true;
     xSemaphoreGive(context.ret_cmd_mutex);
+    lat_record(LAT_CMD_COMMIT, rx_time, commit_time);
     
     ESP_LOGI("HTTP", "Updated: door=%d, fan=%d, light=%d", door, fan, light);
     httpd_resp_sendstr(req, "OK");
@@ -246,6 +1399,7 @@ static esp_err_t set_cmd_handler(httpd_req_t *req)
 // ===== Status GET Handler =====
 static esp_err_t status_handler(httpd_req_t *req)
 {
+    power_track_request(req);
     ESP_LOGI("HTTP", "Received status request");
 
     // Get current status
@@ -270,12 +1424,17 @@ static esp_err_t status_handler(httpd_req_t *req)
 }
 static esp_err_t sensor_handler(httpd_req_t *req)
 {
+    power_track_request(req);
     ESP_LOGI("HTTP", "Received sensor request");
 
     // Get current status
-    float sensor_snapshot[8];
+    float sensor_snapshot[SENSOR_CHANNELS];
+    sensor_stamp_t stamp_snapshot[SENSOR_CHANNELS];
     xSemaphoreTake(context.sensor_mutex, portMAX_DELAY);
     memcpy(sensor_snapshot, context.sensor_data, sizeof(sensor_snapshot));
+    memcpy(stamp_snapshot, context.sensor_stamp, sizeof(stamp_snapshot));
+    for (int i = 0; i < SENSOR_CHANNELS; i++)
+        context.sensor_stamp[i].pending = false;
     xSemaphoreGive(context.sensor_mutex);
 
     // Compose JSON response with door_state, fan_level, light_level, and sensor_data
@@ -284,6 +1443,100 @@ static esp_err_t sensor_handler(httpd_req_t *req)
                        "{\"sensor_data\":[%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f]}",
                        sensor_snapshot[0], sensor_snapshot[1], sensor_snapshot[2], sensor_snapshot[3],
                        sensor_snapshot[4], sensor_snapshot[5], sensor_snapshot[6], sensor_snapshot[7]);
+    int64_t serialized = esp_timer_get_time();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_sendstr(req, response);
+    int64_t sent = esp_timer_get_time();
+
+    // Only the first response carrying a sample counts towards its visibility latency
+    for (int i = 0; i < SENSOR_CHANNELS; i++)
+    {
+        if (!stamp_snapshot[i].pending)
+            continue;
+        lat_record(LAT_SENSOR_SERIALIZE, stamp_snapshot[i].isr, serialized);
+        lat_record(LAT_SENSOR_SEND, stamp_snapshot[i].isr, sent);
+    }
+    return ESP_OK;
+}
+
+// ===== Latency GET Handler =====
+// GET /latency returns all histograms as JSON, GET /latency?reset=1 also clears them afterwards
+static esp_err_t latency_handler(httpd_req_t *req)
+{
+    bool reset = false;
+    char query[32];
+    char value[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "reset", value, sizeof(value)) == ESP_OK)
+    {
+        reset = strcmp(value, "1") == 0;
+    }
+
+    // Snapshot one histogram at a time to keep the critical section short
+    static lat_hist_t snapshot;
+    char chunk[128];
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_sendstr_chunk(req, "{\"unit\":\"us\"");
+    for (int stage = 0; stage < LAT_MAX; stage++)
+    {
+        taskENTER_CRITICAL(&lat_lock);
+        snapshot = lat_hist[stage];
+        if (reset)
+            memset(&lat_hist[stage], 0, sizeof(lat_hist[stage]));
+        taskEXIT_CRITICAL(&lat_lock);
+
+        snprintf(chunk, sizeof(chunk),
+                 ",\"%s\":{\"count\":%lu,\"min\":%lu,\"max\":%lu,\"mean\":%llu,\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"buckets\":[",
+                 lat_stage_names[stage], (unsigned long)snapshot.count, (unsigned long)snapshot.min,
+                 (unsigned long)snapshot.max, snapshot.count ? snapshot.sum / snapshot.count : 0ULL,
+                 (unsigned long)lat_hist_percentile(&snapshot, 500), (unsigned long)lat_hist_percentile(&snapshot, 900),
+                 (unsigned long)lat_hist_percentile(&snapshot, 990));
+        httpd_resp_sendstr_chunk(req, chunk);
+
+        // Only non-empty buckets, as [lower_bound_us, count] pairs
+        bool first = true;
+        for (uint32_t i = 0; i < LAT_BUCKETS; i++)
+        {
+            if (snapshot.buckets[i] == 0)
+                continue;
+            snprintf(chunk, sizeof(chunk), "%s[%lu,%lu]", first ? "" : ",",
+                     (unsigned long)lat_bucket_lower(i), (unsigned long)snapshot.buckets[i]);
+            httpd_resp_sendstr_chunk(req, chunk);
+            first = false;
+        }
+        httpd_resp_sendstr_chunk(req, "]}");
+    }
+    httpd_resp_sendstr_chunk(req, "}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
+// ===== WiFi GET Handler =====
+// GET /wifi returns the reconnect statistics, times in us
+static esp_err_t wifi_handler(httpd_req_t *req)
+{
+    wifi_reconnect_stats_t stats;
+    wifi_link_state_t state;
+    taskENTER_CRITICAL(&s_wifi_stats_lock);
+    stats = s_wifi_stats;
+    state = s_link_state;
+    taskEXIT_CRITICAL(&s_wifi_stats_lock);
+
+    static const char *state_names[] = {"down", "fast_connect", "scan_connect", "backoff", "up"};
+    char response[512];
+    snprintf(response, sizeof(response),
+             "{\"state\":\"%s\",\"cache_valid\":%s,\"connects\":%lu,\"disconnects\":%lu,\"attempts\":%lu,"
+             "\"fast_attempts\":%lu,\"fast_successes\":%lu,\"lease_reused\":%lu,\"last_reason\":%lu,\"backoff_ms\":%lu,"
+             "\"reconnect_us\":{\"last\":%lu,\"min\":%lu,\"max\":%lu,\"mean\":%llu}}",
+             state_names[state], context.wifi_cache.valid ? "true" : "false",
+             (unsigned long)stats.connects, (unsigned long)stats.disconnects, (unsigned long)stats.attempts,
+             (unsigned long)stats.fast_attempts, (unsigned long)stats.fast_successes, (unsigned long)stats.lease_reused,
+             (unsigned long)stats.last_reason, (unsigned long)stats.backoff_ms, (unsigned long)stats.last_us,
+             (unsigned long)stats.min_us, (unsigned long)stats.max_us, stats.connects ? stats.sum_us / stats.connects : 0ULL);
     httpd_resp_set_type(req, "application/json");
     httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
@@ -291,6 +1544,130 @@ static esp_err_t sensor_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// ===== Power Handlers =====
+// GET /power returns the policy, the effective mode and the client round trips per effective mode
+static esp_err_t power_get_handler(httpd_req_t *req)
+{
+    static lat_hist_t snapshot;
+    char chunk[256];
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    xSemaphoreTake(s_power_mutex, portMAX_DELAY);
+    snprintf(chunk, sizeof(chunk), "{\"policy\":\"%s\",\"effective\":\"%s\",\"listen_interval\":%d,\"rtt_us\":{",
+             power_mode_names[s_power_policy], power_mode_names[s_power_effective], s_power_listen_interval);
+    xSemaphoreGive(s_power_mutex);
+    httpd_resp_sendstr_chunk(req, chunk);
+
+    for (int mode = 0; mode < POWER_MODE_MAX; mode++)
+    {
+        taskENTER_CRITICAL(&lat_lock);
+        snapshot = s_power_latency[mode];
+        taskEXIT_CRITICAL(&lat_lock);
+        snprintf(chunk, sizeof(chunk), "%s\"%s\":{\"count\":%lu,\"mean\":%llu,\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"max\":%lu}",
+                 mode ? "," : "", power_mode_names[mode], (unsigned long)snapshot.count,
+                 snapshot.count ? snapshot.sum / snapshot.count : 0ULL,
+                 (unsigned long)lat_hist_percentile(&snapshot, 500), (unsigned long)lat_hist_percentile(&snapshot, 900),
+                 (unsigned long)lat_hist_percentile(&snapshot, 990), (unsigned long)snapshot.max);
+        httpd_resp_sendstr_chunk(req, chunk);
+    }
+    httpd_resp_sendstr_chunk(req, "}}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
+// POST /power with "mode=<max_performance|balanced|low_power>[&listen_interval=<beacons>]"
+static esp_err_t power_post_handler(httpd_req_t *req)
+{
+    char buf[64];
+    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+    if (ret <= 0)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No data");
+        return ESP_FAIL;
+    }
+    buf[ret] = 0;
+
+    char value[24];
+    int mode = -1;
+    if (httpd_query_key_value(buf, "mode", value, sizeof(value)) == ESP_OK)
+    {
+        for (int i = 0; i < POWER_MODE_MAX; i++)
+        {
+            if (strcmp(value, power_mode_names[i]) == 0)
+                mode = i;
+        }
+    }
+    bool set_interval = httpd_query_key_value(buf, "listen_interval", value, sizeof(value)) == ESP_OK;
+    int listen_interval = set_interval ? atoi(value) : 0;
+    if (mode < 0 || (set_interval && (listen_interval < 1 || listen_interval > 100)))
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid value");
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTake(s_power_mutex, portMAX_DELAY);
+    s_power_policy = (power_mode_t)mode;
+    if (!set_interval)
+        listen_interval = s_power_listen_interval;
+    if (listen_interval != s_power_listen_interval)
+    {
+        // Negotiated at association, so it takes effect on the next (re)connect
+        s_power_listen_interval = listen_interval;
+        wifi_config_t wifi_config;
+        if (s_power_wifi_ready && esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK)
+        {
+            wifi_config.sta.listen_interval = listen_interval;
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+        }
+    }
+    power_update_locked(false);
+    xSemaphoreGive(s_power_mutex);
+
+    ESP_LOGI("HTTP", "Power policy set to %s, listen interval %d", power_mode_names[mode], listen_interval);
+    httpd_resp_sendstr(req, "OK");
+    return ESP_OK;
+}
+
+// ===== Boot GET Handler =====
+// GET /boot returns the init stage timings and their dependency graph, all times in us since boot
+static esp_err_t boot_handler(httpd_req_t *req)
+{
+    char chunk[192];
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    EventBits_t done = xEventGroupGetBits(s_boot_event_group);
+    int64_t first_ack, first_rx;
+    boot_get_first_i2c(&first_ack, &first_rx);
+    snprintf(chunk, sizeof(chunk), "{\"app_main\":%lld,\"i2c_ready\":%lld,\"first_i2c_ack\":%lld,\"first_i2c_rx\":%lld,\"stages\":[",
+             boot_app_main_time, boot_timing[BOOT_I2C].end, first_ack, first_rx);
+    httpd_resp_sendstr_chunk(req, chunk);
+    for (int i = 0; i < BOOT_STAGE_MAX; i++)
+    {
+        bool complete = done & BOOT_BIT(i);
+        snprintf(chunk, sizeof(chunk), "%s{\"name\":\"%s\",\"done\":%s,\"start\":%lld,\"end\":%lld,\"status\":\"%s\",\"deps\":[",
+                 i ? "," : "", boot_steps[i].name, complete ? "true" : "false", boot_timing[i].start,
+                 boot_timing[i].end, complete ? esp_err_to_name(boot_timing[i].status) : "");
+        httpd_resp_sendstr_chunk(req, chunk);
+        bool first = true;
+        for (int dep = 0; dep < BOOT_STAGE_MAX; dep++)
+        {
+            if (!(boot_steps[i].deps & BOOT_BIT(dep)))
+                continue;
+            snprintf(chunk, sizeof(chunk), "%s\"%s\"", first ? "" : ",", boot_steps[dep].name);
+            httpd_resp_sendstr_chunk(req, chunk);
+            first = false;
+        }
+        httpd_resp_sendstr_chunk(req, "]}");
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
 static const char *get_mime_type(const char *filename)
 {
     if (strstr(filename, ".html"))
@@ -354,10 +1731,10 @@ static esp_err_t file_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-// ===== HTTP Server Task =====
-static void http_server_task(void *arg)
+// ===== HTTP Server =====
+static esp_err_t start_http_server(void)
 {
-    ESP_LOGI("HTTP", "Starting HTTP server task");
+    ESP_LOGI("HTTP", "Starting HTTP server");
     static httpd_handle_t server = NULL;
     if (server)
     {
@@ -365,8 +1742,10 @@ static void http_server_task(void *arg)
         server = NULL;
     }
     httpd_config_t server_config = HTTPD_DEFAULT_CONFIG();
+    server_config.server_port = HTTP_SERVER_PORT;
     server_config.uri_match_fn = httpd_uri_match_wildcard;
-    ESP_ERROR_CHECK(httpd_start(&server, &server_config));
+    server_config.max_uri_handlers = 12;
+    ESP_RETURN_ON_ERROR(httpd_start(&server, &server_config), "HTTP", "httpd_start failed");
 
     // Store server handle for SSE
     context.http_server = server;
@@ -377,7 +1756,7 @@ static void http_server_task(void *arg)
         .method = HTTP_POST,
         .handler = set_cmd_handler,
         .user_ctx = NULL};
-    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &set_cmd_uri));
+    ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &set_cmd_uri), "HTTP", "Failed to register %s", set_cmd_uri.uri);
 
     // /status GET handler for polling
     httpd_uri_t status_uri = {
@@ -385,7 +1764,7 @@ static void http_server_task(void *arg)
         .method = HTTP_GET,
         .handler = status_handler,
         .user_ctx = NULL};
-    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &status_uri));
+    ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &status_uri), "HTTP", "Failed to register %s", status_uri.uri);
 
     // /sensor GET handler for polling
     httpd_uri_t sensor_uri = {
@@ -393,7 +1772,45 @@ static void http_server_task(void *arg)
         .method = HTTP_GET,
         .handler = sensor_handler,
         .user_ctx = NULL};
-    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &sensor_uri));
+    ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &sensor_uri), "HTTP", "Failed to register %s", sensor_uri.uri);
+
+    // /latency GET handler for latency histograms
+    httpd_uri_t latency_uri = {
+        .uri = "/latency",
+        .method = HTTP_GET,
+        .handler = latency_handler,
+        .user_ctx = NULL};
+    ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &latency_uri), "HTTP", "Failed to register %s", latency_uri.uri);
+
+    // /boot GET handler for init stage timings
+    httpd_uri_t boot_uri = {
+        .uri = "/boot",
+        .method = HTTP_GET,
+        .handler = boot_handler,
+        .user_ctx = NULL};
+    ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &boot_uri), "HTTP", "Failed to register %s", boot_uri.uri);
+
+    // /wifi GET handler for reconnect statistics
+    httpd_uri_t wifi_uri = {
+        .uri = "/wifi",
+        .method = HTTP_GET,
+        .handler = wifi_handler,
+        .user_ctx = NULL};
+    ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &wifi_uri), "HTTP", "Failed to register %s", wifi_uri.uri);
+
+    // /power GET and POST handlers for the WiFi power policy
+    httpd_uri_t power_get_uri = {
+        .uri = "/power",
+        .method = HTTP_GET,
+        .handler = power_get_handler,
+        .user_ctx = NULL};
+    ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &power_get_uri), "HTTP", "Failed to register %s", power_get_uri.uri);
+    httpd_uri_t power_post_uri = {
+        .uri = "/power",
+        .method = HTTP_POST,
+        .handler = power_post_handler,
+        .user_ctx = NULL};
+    ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &power_post_uri), "HTTP", "Failed to register %s", power_post_uri.uri);
 
     // Universal file handler for all requests
     httpd_uri_t file_uri = {
@@ -401,10 +1818,10 @@ static void http_server_task(void *arg)
         .method = HTTP_GET,
         .handler = file_handler,
         .user_ctx = NULL};
-    ESP_ERROR_CHECK(httpd_register_uri_handler(server, &file_uri));
+    ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &file_uri), "HTTP", "Failed to register %s", file_uri.uri);
 
     ESP_LOGI("HTTP", "HTTP server started with SPIFFS file serving");
-    vTaskDelete(NULL);
+    return ESP_OK;
 }
 
 // ===== I2C Slave Task =====
@@ -419,23 +1836,40 @@ typedef enum
 static bool i2c_slave_request_cb(i2c_slave_dev_handle_t i2c_slave, const i2c_slave_request_event_data_t *evt_data, void *arg)
 {
     uint32_t write_len = 0;
+    boot_note_i2c_from_isr(esp_timer_get_time(), false);
     xSemaphoreTake(context.ret_cmd_mutex, 0);
     i2c_slave_write(i2c_slave, context.response_data, 4, &write_len, 0);
+    if (context.cmd_stamp.pending)
+    {
+        context.cmd_stamp.pending = false;
+        lat_record_from_isr(LAT_CMD_DELIVER, context.cmd_stamp.http_rx, esp_timer_get_time());
+    }
     xSemaphoreGive(context.ret_cmd_mutex);
     return false;
 }
 
-// I2C slave receive callback (unchanged)
+// Received I2C command, as queued on cmd_queue
+typedef struct
+{
+    int64_t rx_time; // esp_timer_get_time() in i2c_slave_receive_cb
+    uint8_t length;
+    uint8_t data[];
+} i2c_rx_cmd_t;
+
+// I2C slave receive callback
 static bool i2c_slave_receive_cb(i2c_slave_dev_handle_t i2c_slave, const i2c_slave_rx_done_event_data_t *evt_data, void *arg)
 {
     i2c_slave_event_t evt = I2C_SLAVE_EVT_RX;
     BaseType_t xTaskWoken = 0;
+    int64_t rx_time = esp_timer_get_time();
+    boot_note_i2c_from_isr(rx_time, true);
     // Allocate buffer for command and copy data
-    uint8_t *cmd_buf = (uint8_t *)malloc(evt_data->length + 1); // +1 for length
+    i2c_rx_cmd_t *cmd_buf = (i2c_rx_cmd_t *)malloc(sizeof(i2c_rx_cmd_t) + evt_data->length);
     if (cmd_buf)
     {
-        cmd_buf[0] = evt_data->length;
-        memcpy(&cmd_buf[1], evt_data->buffer, evt_data->length);
+        cmd_buf->rx_time = rx_time;
+        cmd_buf->length = evt_data->length;
+        memcpy(cmd_buf->data, evt_data->buffer, evt_data->length);
         if (xQueueSendFromISR(context.cmd_queue, &cmd_buf, &xTaskWoken) != pdPASS)
         {
             // cmd_queue full, dropping command
@@ -458,11 +1892,12 @@ static void i2c_slave_task(void *arg)
         {
             if (evt == I2C_SLAVE_EVT_RX)
             {
-                uint8_t *cmd_buf = NULL;
+                i2c_rx_cmd_t *cmd_buf = NULL;
                 while (xQueueReceive(context.cmd_queue, &cmd_buf, 0) == pdPASS)
                 {
-                    uint8_t cmd_len = cmd_buf[0];
-                    uint8_t *cmd_data = &cmd_buf[1];
+                    int64_t dequeue_time = esp_timer_get_time();
+                    uint8_t cmd_len = cmd_buf->length;
+                    uint8_t *cmd_data = cmd_buf->data;
                     uint8_t cmd = cmd_data[0];
                     ESP_LOGI("I2C", "Processing RX cmd 0x%02X of length %d", cmd, cmd_len);
                     switch (cmd)
@@ -471,25 +1906,26 @@ static void i2c_slave_task(void *arg)
                     {
                         if (cmd_len > 1)
                         {
+                            // Wait for mDNS (and so the restored config) so this command wins over NVS
+                            boot_wait(BOOT_BIT(BOOT_MDNS));
                             size_t mdns_len = cmd_len - 1;
                             if (mdns_len > MDNS_NAME_MAXLEN)
                                 mdns_len = MDNS_NAME_MAXLEN;
                             memcpy(context.mdns_name, &cmd_data[1], mdns_len);
                             context.mdns_name[mdns_len] = '\0';
                             mdns_hostname_set(context.mdns_name);
+                            config_stage_mdns_name(context.mdns_name);
                             ESP_LOGI("I2C", "mDNS name set to: %s", context.mdns_name);
                         }
                         break;
                     }
                     case CMD_WIFI_SSID:
                     {
-                        if (context.wifi_started)
-                        {
-                            ESP_LOGW("I2C", "Cannot set WiFi SSID while WiFi is started");
-                            break;
-                        }
                         if (cmd_len > 1)
                         {
+                            // Takes effect on the next CMD_WIFI_START, also when WiFi was started from NVS.
+                            // The wifi stage reads the credentials, so they are only written once it is done.
+                            boot_wait(BOOT_BIT(BOOT_WIFI));
                             size_t ssid_len = cmd_len - 1;
                             if (ssid_len > WIFI_SSID_MAXLEN)
                                 ssid_len = WIFI_SSID_MAXLEN;
@@ -501,13 +1937,9 @@ static void i2c_slave_task(void *arg)
                     }
                     case CMD_WIFI_PASS:
                     {
-                        if (context.wifi_started)
-                        {
-                            ESP_LOGW("I2C", "Cannot set WiFi password while WiFi is started");
-                            break;
-                        }
                         if (cmd_len > 1)
                         {
+                            boot_wait(BOOT_BIT(BOOT_WIFI));
                             size_t pass_len = cmd_len - 1;
                             if (pass_len > WIFI_PASS_MAXLEN)
                                 pass_len = WIFI_PASS_MAXLEN;
@@ -519,30 +1951,73 @@ static void i2c_slave_task(void *arg)
                     }
                     case CMD_WIFI_START:
                     {
+                        // The HTTP server is already started by the boot graph
+                        boot_wait(BOOT_BIT(BOOT_WIFI));
+                        // Staged before connecting, a changed SSID drops the cached association
+                        config_stage_wifi(context.wifi_ssid, context.wifi_pass);
                         if (context.wifi_started)
                         {
-                            ESP_LOGW("I2C", "WiFi already started");
-                            break;
+                            // Started from the stored config, switch over to the credentials sent over I2C
+                            // unless they are the ones in use, reapplying would only drop the connection
+                            if (wifi_config_changed())
+                                wifi_apply_config();
+                            else
+                                ESP_LOGI(TAG, "wifi config unchanged, keeping the connection");
+                        }
+                        else
+                        {
+                            wifi_init_sta();
+                            context.wifi_started = true;
                         }
-                        wifi_init_sta();
-                        context.wifi_started = true;
-
-                        // Restart HTTP server if needed
-                        xTaskCreate(http_server_task, "http_server_task", 4096, NULL, 6, NULL);
                         break;
                     }
                     case CMD_SENSOR_READ:
                     {
                         // sensor read
-                        if (cmd_len == 5)
+                        if (cmd_len == 6 && cmd_data[1] < SENSOR_CHANNELS)
                         {
+                            uint8_t channel = cmd_data[1];
+                            float value;
+                            memcpy(&value, &cmd_data[2], sizeof(value));
+
+                            xSemaphoreTake(context.sensor_mutex, portMAX_DELAY);
+                            context.sensor_data[channel] = value;
+                            int64_t commit_time = esp_timer_get_time();
+                            sensor_stamp_t *stamp = &context.sensor_stamp[channel];
+                            stamp->isr = cmd_buf->rx_time;
+                            stamp->dequeue = dequeue_time;
+                            stamp->commit = commit_time;
+                            stamp->pending = true;
+                            bool advertised = s_sensor_mdns_advertised & (1 << channel);
+                            if (advertised)
+                                s_sensor_mdns_dirty |= 1 << channel;
+                            xSemaphoreGive(context.sensor_mutex);
+                            if (advertised)
+                                sensor_mdns_schedule();
+
+                            lat_record(LAT_SENSOR_DEQUEUE, cmd_buf->rx_time, dequeue_time);
+                            lat_record(LAT_SENSOR_COMMIT, cmd_buf->rx_time, commit_time);
                         }
                         break;
                     }
                     case CMD_SENSOR_SETUP:
                     {
-                        if (cmd_len > 1)
-                            ESP_LOGI("I2C", "Sensor data updated");
+                        if (cmd_len >= 3 && cmd_data[1] < SENSOR_CHANNELS && cmd_data[2] <= UNIT_NONE)
+                        {
+                            uint8_t channel = cmd_data[1];
+                            size_t name_len = cmd_len - 3;
+                            if (name_len > SENSOR_NAME_MAXLEN - 1)
+                                name_len = SENSOR_NAME_MAXLEN - 1;
+                            // The service is registered right away, so mDNS has to be up
+                            boot_wait(BOOT_BIT(BOOT_MDNS));
+                            xSemaphoreTake(context.sensor_mutex, portMAX_DELAY);
+                            memcpy(context.sensor_name[channel], &cmd_data[3], name_len);
+                            context.sensor_name[channel][name_len] = '\0';
+                            context.sensor_unit[channel] = cmd_data[2];
+                            xSemaphoreGive(context.sensor_mutex);
+                            sensor_mdns_setup(channel);
+                            ESP_LOGI("I2C", "Sensor %u set up as [%s]", channel, context.sensor_name[channel]);
+                        }
                         break;
                     }
                     default:
@@ -600,54 +2075,48 @@ static void print_wifi_info_task(void *arg)
     vTaskDelete(NULL);
 }
 
-extern "C" void app_main(void)
+static esp_err_t init_nvs(void)
 {
-    ESP_ERROR_CHECK(nvs_flash_init());
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        // NVS partition was truncated or written by a newer format, erase and start over
+        ESP_RETURN_ON_ERROR(nvs_flash_erase(), "NVS", "nvs_flash_erase failed");
+        ret = nvs_flash_init();
+    }
+    ESP_RETURN_ON_ERROR(ret, "NVS", "nvs_flash_init failed");
+    return config_load();
+}
 
+static esp_err_t init_netif(void)
+{
     // Initialize netif and event loop ONCE
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-
-    initialise_mdns();
-
-    esp_netif_create_default_wifi_sta();
+    ESP_RETURN_ON_ERROR(esp_netif_init(), TAG, "esp_netif_init failed");
+    return esp_event_loop_create_default();
+}
 
-    // Initialize SPIFFS
-    esp_vfs_spiffs_conf_t spiffs_conf = {
-        .base_path = "/spiffs",
-        .partition_label = "storage",
-        .max_files = 5,
-        .format_if_mount_failed = true};
+static esp_err_t init_wifi_netif(void)
+{
+    if (esp_netif_create_default_wifi_sta() == NULL)
+        return ESP_FAIL;
+    return ESP_OK;
+}
 
-    esp_err_t ret = esp_vfs_spiffs_register(&spiffs_conf);
-    if (ret != ESP_OK)
-    {
-        if (ret == ESP_FAIL)
-        {
-            ESP_LOGE("SPIFFS", "Failed to mount or format filesystem");
-        }
-        else if (ret == ESP_ERR_NOT_FOUND)
-        {
-            ESP_LOGE("SPIFFS", "Failed to find SPIFFS partition");
-        }
-        else
-        {
-            ESP_LOGE("SPIFFS", "Failed to initialize SPIFFS (%s)", esp_err_to_name(ret));
-        }
-    }
-    else
+// Zero-touch reboot: bring WiFi straight up with the restored credentials, if any
+static esp_err_t init_wifi(void)
+{
+    if (context.wifi_ssid[0] == '\0')
     {
-        ESP_LOGI("SPIFFS", "SPIFFS mounted successfully");
-
-        // Check SPIFFS usage
-        size_t total = 0, used = 0;
-        ret = esp_spiffs_info("storage", &total, &used);
-        if (ret == ESP_OK)
-        {
-            ESP_LOGI("SPIFFS", "Partition size: total: %d, used: %d", total, used);
-        }
+        ESP_LOGI(TAG, "No stored WiFi credentials, waiting for CMD_WIFI_START");
+        return ESP_OK;
     }
+    ESP_RETURN_ON_ERROR(wifi_start_sta(), TAG, "Failed to start the station");
+    context.wifi_started = true;
+    return ESP_OK;
+}
 
+static esp_err_t init_i2c_slave(void)
+{
     // I2C slave config
     i2c_slave_config_t conf = {
         .i2c_port = I2C_SLAVE_NUM,
@@ -662,32 +2131,53 @@ extern "C" void app_main(void)
     context.ret_cmd_mutex = xSemaphoreCreateMutex();
     context.sensor_mutex = xSemaphoreCreateMutex();
     // Create RX command queue (pointer to malloc'd buffers)
-    context.cmd_queue = xQueueCreate(16, sizeof(uint8_t *));
+    context.cmd_queue = xQueueCreate(16, sizeof(i2c_rx_cmd_t *));
     if (context.cmd_queue == NULL)
     {
         ESP_LOGE("I2C", "Failed to create RX command queue");
-        return;
+        return ESP_ERR_NO_MEM;
     }
 
-    ESP_ERROR_CHECK(i2c_new_slave_device(&conf, &context.slave_handle));
-
     // Create event queue for RX/TX events
     context.event_queue = xQueueCreate(16, sizeof(i2c_slave_event_t));
     if (context.event_queue == NULL)
     {
         ESP_LOGE("I2C", "Failed to create event queue");
-        return;
+        return ESP_ERR_NO_MEM;
     }
 
+    ESP_RETURN_ON_ERROR(i2c_new_slave_device(&conf, &context.slave_handle), "I2C", "i2c_new_slave_device failed");
+
     // Register callback in a task
     i2c_slave_event_callbacks_t cbs = {
         .on_request = i2c_slave_request_cb,
         .on_receive = i2c_slave_receive_cb,
     };
-    ESP_ERROR_CHECK(i2c_slave_register_event_callbacks(context.slave_handle, &cbs, &context));
+    ESP_RETURN_ON_ERROR(i2c_slave_register_event_callbacks(context.slave_handle, &cbs, &context), "I2C", "Failed to register the callbacks");
 
     ESP_LOGI("I2C", "I2C slave initialized on SCL %d, SDA %d", I2C_SLAVE_SCL_IO, I2C_SLAVE_SDA_IO);
 
-    xTaskCreate(i2c_slave_task, "i2c_slave_task", 4 * 1024, &context, 10, NULL);
+    if (xTaskCreate(i2c_slave_task, "i2c_slave_task", 4 * 1024, &context, 10, NULL) != pdPASS)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+extern "C" void app_main(void)
+{
+    boot_app_main_time = esp_timer_get_time();
+    s_boot_event_group = xEventGroupCreate();
+    power_init();
+
+    // I2C ingest comes up first so the master is ACKed as early as possible
+    boot_run_step(BOOT_I2C);
+
+    // Everything else initializes in the background, ordered only by boot_steps[].deps
+    for (int stage = BOOT_I2C + 1; stage < BOOT_STAGE_MAX; stage++)
+    {
+        xTaskCreate(boot_step_task, boot_steps[stage].name, 4096, (void *)(intptr_t)stage, 5, NULL);
+    }
+
+    boot_wait(BOOT_ALL_BITS);
+    boot_log_report();
     // xTaskCreate(print_wifi_info_task, "print_wifi_info_task", 4096, &context, 5, NULL);
-}
\ No newline at end of file
+}